@@ -44,6 +44,8 @@
 #include <Libpfs/frame.h>
 
 #include <Core/IOWorker.h>
+#include <HdrWizard/BatchHdrEngine.h>
+#include <HdrWizard/ExifIndex.h>
 #include <Libpfs/pfs.h>
 #include <OsIntegration/osintegration.h>
 #include <arch/math.h>
@@ -56,6 +58,7 @@ BatchHDRDialog::BatchHDRDialog(QWidget *p, QSqlDatabase db)
       m_numProcessed(0),
       m_processed(0),
       m_total(0),
+      m_bracketSize(0),
       m_errors(false),
       m_loading_error(false),
       m_abort(false),
@@ -67,12 +70,15 @@ BatchHDRDialog::BatchHDRDialog(QWidget *p, QSqlDatabase db)
     m_Ui->progressBar->hide();
 
     m_hdrCreationManager = new HdrCreationManager;
+    m_engine = new BatchHdrEngine(this);
     m_IO_Worker = new IOWorker;
 
     connect(m_Ui->horizontalSlider, &QAbstractSlider::valueChanged, this,
             &BatchHDRDialog::num_bracketed_changed);
     connect(m_Ui->spinBox, SIGNAL(valueChanged(int)), this,
             SLOT(num_bracketed_changed(int)));
+    connect(m_Ui->autoGroupCheckBox, &QAbstractButton::toggled, this,
+            &BatchHDRDialog::auto_group_toggled);
 
     connect(m_Ui->MTBRadioButton, &QAbstractButton::clicked, this,
             &BatchHDRDialog::align_selection_clicked);
@@ -114,6 +120,17 @@ BatchHDRDialog::BatchHDRDialog(QWidget *p, QSqlDatabase db)
     connect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
             &BatchHDRDialog::createHdrFinished, Qt::DirectConnection);
 
+    connect(m_engine, &BatchHdrEngine::bracketWritten, this,
+            &BatchHDRDialog::bracketWritten);
+    connect(m_engine, &BatchHdrEngine::bracketFailed, this,
+            &BatchHDRDialog::bracketFailed);
+    connect(m_engine, &BatchHdrEngine::bracketDone, this,
+            &BatchHDRDialog::bracketDone);
+    connect(m_engine, &BatchHdrEngine::finished, this,
+            &BatchHDRDialog::finish_batch);
+    connect(&m_groupWatcher, &QFutureWatcherBase::finished, this,
+            &BatchHDRDialog::brackets_grouped);
+
     m_formatHelper.initConnection(m_Ui->formatComboBox,
                                   m_Ui->formatSettingsButton, true);
 
@@ -170,49 +187,16 @@ BatchHDRDialog::BatchHDRDialog(QWidget *p, QSqlDatabase db)
 
         m_customConfig.push_back(ct);
     }
-    // process input images
-    QStringList filters;
-    filters << QStringLiteral("*.jpg") << QStringLiteral("*.jpeg")
-            << QStringLiteral("*.tiff") << QStringLiteral("*.tif")
-            << QStringLiteral("*.crw") << QStringLiteral("*.cr2")
-            << QStringLiteral("*.nef") << QStringLiteral("*.dng")
-            << QStringLiteral("*.mrw") << QStringLiteral("*.orf")
-            << QStringLiteral("*.kdc") << QStringLiteral("*.dcr")
-            << QStringLiteral("*.arw") << QStringLiteral("*.raf")
-            << QStringLiteral("*.ptx") << QStringLiteral("*.pef")
-            << QStringLiteral("*.x3f") << QStringLiteral("*.raw")
-            << QStringLiteral("*.rw2") << QStringLiteral("*.sr2")
-            << QStringLiteral("*.3fr") << QStringLiteral("*.mef")
-            << QStringLiteral("*.mos") << QStringLiteral("*.erf")
-            << QStringLiteral("*.nrw") << QStringLiteral("*.srw");
-    filters << QStringLiteral("*.JPG") << QStringLiteral("*.JPEG")
-            << QStringLiteral("*.TIFF") << QStringLiteral("*.TIF")
-            << QStringLiteral("*.CRW") << QStringLiteral("*.CR2")
-            << QStringLiteral("*.NEF") << QStringLiteral("*.DNG")
-            << QStringLiteral("*.MRW") << QStringLiteral("*.ORF")
-            << QStringLiteral("*.KDC") << QStringLiteral("*.DCR")
-            << QStringLiteral("*.ARW") << QStringLiteral("*.RAF")
-            << QStringLiteral("*.PTX") << QStringLiteral("*.PEF")
-            << QStringLiteral("*.X3F") << QStringLiteral("*.RAW")
-            << QStringLiteral("*.RW2") << QStringLiteral("*.SR2")
-            << QStringLiteral("*.3FR") << QStringLiteral("*.MEF")
-            << QStringLiteral("*.MOS") << QStringLiteral("*.ERF")
-            << QStringLiteral("*.NRW") << QStringLiteral("*.SRW");
-
-    QDir chosenInputDir(m_batchHdrInputDir);
-    chosenInputDir.setFilter(QDir::Files);
-    chosenInputDir.setSorting(QDir::Name);
-    chosenInputDir.setNameFilters(filters);
-    m_bracketed = chosenInputDir.entryList();
-    // hack to prepend to this list the path as prefix.
-    m_bracketed.replaceInStrings(QRegExp("(.+)"),
-                                 chosenInputDir.path() + "/\\1");
-
     check_start_button();
 }
 
 BatchHDRDialog::~BatchHDRDialog() {
     qDebug() << "BatchHDRDialog::~BatchHDRDialog()";
+    m_engine->disconnect(this);
+    m_engine->cancel();
+    m_engine->waitForDone();
+    m_groupWatcher.disconnect(this);
+    m_groupWatcher.waitForFinished();
     // DAVIDE _ HDR WIZARD
     m_hdrCreationManager->reset();
     delete m_hdrCreationManager;
@@ -229,6 +213,14 @@ void BatchHDRDialog::num_bracketed_changed(int value) {
     }
 }
 
+void BatchHDRDialog::auto_group_toggled(bool checked) {
+    m_Ui->horizontalSlider->setEnabled(!checked);
+    m_Ui->spinBox->setEnabled(!checked);
+    // the size of the brackets is known only once they are grouped
+    num_bracketed_changed(checked ? m_Ui->spinBox->maximum()
+                                  : m_Ui->spinBox->value());
+}
+
 void BatchHDRDialog::on_selectInputFolder_clicked() {
     QString inputDir = QFileDialog::getExistingDirectory(
         this, tr("Choose a source directory"), m_batchHdrInputDir);
@@ -300,18 +292,13 @@ void BatchHDRDialog::on_startButton_clicked() {
                     QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
     }
 
-    if (m_bracketed.count() < m_Ui->spinBox->value()) {
-        qDebug() << "Total number of pictures must be a multiple of number of "
-                    "bracketed images";
-        QMessageBox::warning(
-            0, tr("Warning"),
-            tr("Total number of pictures must be a multiple of "
-               "number of bracketed images."),
-            QMessageBox::Ok, QMessageBox::NoButton);
-        return;
-    }
+    const QStringList inputFiles =
+        BatchHdrEngine::inputFiles(m_Ui->inputLineEdit->text());
+    const bool autoGroup = m_Ui->autoGroupCheckBox->isChecked();
+    const int bracketSize = m_Ui->spinBox->value();
 
-    if (m_bracketed.count() % m_Ui->spinBox->value() != 0) {
+    if (!autoGroup && (inputFiles.count() < bracketSize ||
+                       inputFiles.count() % bracketSize != 0)) {
         qDebug() << "Total number of pictures must be a multiple of number of "
                     "bracketed images";
         QMessageBox::warning(
@@ -325,18 +312,138 @@ void BatchHDRDialog::on_startButton_clicked() {
     if (doStart) {
         m_Ui->horizontalSlider->setEnabled(false);
         m_Ui->spinBox->setEnabled(false);
+        m_Ui->autoGroupCheckBox->setEnabled(false);
         m_Ui->groupBoxOutput->setEnabled(false);
         m_Ui->groupBoxAlignment->setEnabled(false);
         m_Ui->groupBoxAg->setEnabled(false);
         m_Ui->groupBoxIO->setEnabled(false);
         m_Ui->startButton->setEnabled(false);
-        m_total = m_bracketed.count() / m_Ui->spinBox->value();
-        m_Ui->progressBar->setMaximum(m_total);
         m_Ui->textEdit->append(tr("Started processing..."));
         // mouse pointer to busy
         QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
+        if (autoGroup) {
+            m_processing = true;
+            m_Ui->textEdit->append(tr("Reading EXIF data..."));
+            m_groupWatcher.setFuture(QtConcurrent::run([inputFiles]() {
+                Grouping grouping;
+                grouping.first = ExifIndex::groupBrackets(
+                    ExifIndex::scan(inputFiles), &grouping.second);
+                return grouping;
+            }));
+        } else {
+            QList<QStringList> brackets;
+            for (int i = 0; i < inputFiles.count(); i += bracketSize) {
+                brackets << inputFiles.mid(i, bracketSize);
+            }
+            start_batch(brackets);
+        }
+    }
+}
+
+void BatchHDRDialog::brackets_grouped() {
+    if (m_abort) {
+        finish_batch();
+        return;
+    }
+    const Grouping grouping = m_groupWatcher.result();
+    const QList<QStringList> &brackets = grouping.first;
+    foreach (const QString &file, grouping.second) {
+        m_Ui->textEdit->append(
+            tr("Skipped %1: no exposure data").arg(QFileInfo(file).fileName()));
+    }
+    m_Ui->textEdit->append(tr("Found %n bracket(s)", "", brackets.count()));
+    start_batch(brackets);
+}
+
+void BatchHDRDialog::start_batch(const QList<QStringList> &brackets) {
+    m_brackets = brackets;
+    m_total = m_brackets.count();
+    m_Ui->progressBar->setMaximum(m_total);
+    if (m_brackets.isEmpty()) {
+        finish_batch();
+        return;
+    }
+    // align_image_stack runs as an event driven external process: AIS
+    // alignment keeps the sequential path
+    if (m_Ui->autoAlignCheckBox->isChecked() &&
+        m_Ui->aisRadioButton->isChecked())
         batch_hdr();
+    else
+        start_pipeline();
+}
+
+void BatchHDRDialog::start_pipeline() {
+    m_processing = true;
+    m_Ui->progressBar->setValue(0);
+    m_Ui->progressBar->show();
+
+    FusionOperatorConfig cfg = predef_confs[0];
+    cfg.weightFunction = m_hdrCreationManager->getWeightFunction().getType();
+    cfg.responseCurve = m_hdrCreationManager->getResponseCurve().getType();
+    cfg.fusionOperator = m_hdrCreationManager->getFusionOperator();
+    m_engine->setConfig(cfg);
+    m_engine->setResponseSampleSize(
+        m_hdrCreationManager->responseSampleSize());
+    m_engine->setResponseCacheEnabled(
+        m_hdrCreationManager->isResponseCacheEnabled());
+    m_engine->setAlignment(m_Ui->autoAlignCheckBox->isChecked()
+                               ? BatchHdrEngine::MTB_ALIGNMENT
+                               : BatchHdrEngine::NO_ALIGNMENT);
+    m_engine->setAntiGhosting(m_Ui->autoAG_checkBox->isChecked()
+                                  ? m_Ui->threshold_doubleSpinBox->value()
+                                  : 0.f);
+    m_engine->setParams(m_formatHelper.getParams());
+
+    for (int index = 1; !m_brackets.isEmpty(); ++index) {
+        const QStringList toProcess = m_brackets.takeFirst();
+        QFileInfo fi1(toProcess.first());
+        QFileInfo fi2(toProcess.last());
+        m_output_file_name_base =
+            fi1.completeBaseName() + "-" + fi2.completeBaseName();
+
+        qDebug() << "BatchHDRDialog::start_pipeline() Files to process: "
+                 << toProcess;
+        m_engine->enqueue(toProcess, outputFileName(index));
+    }
+}
+
+QString BatchHDRDialog::outputFileName(int index) const {
+    QString suffix = m_Ui->formatComboBox->currentText();
+    QString caption = QString(
+        QObject::tr("Weights= ") +
+        getQString(m_hdrCreationManager->getWeightFunction().getType()) +
+        QObject::tr(" - Response curve= ") +
+        getQString(m_hdrCreationManager->getResponseCurve().getType()) +
+        QObject::tr(" - Model= ") +
+        getQString(m_hdrCreationManager->getFusionOperator()));
+
+    if (m_Ui->proposedFilenameCheckBox->isChecked()) {
+        return m_Ui->outputLineEdit->text() + "/" + m_output_file_name_base +
+               "_" + caption + "." + suffix;
     }
+    int paddingLength = ceil(log10(m_total + 1.0f));
+    return m_Ui->outputLineEdit->text() + "/" + m_Ui->prefixLineEdit->text() +
+           "_" + caption + "_" +
+           QStringLiteral("%1").arg(index, paddingLength, 10, QChar('0')) +
+           "." + suffix;
+}
+
+void BatchHDRDialog::bracketWritten(const QString &outName) {
+    m_Ui->textEdit->append(tr("Written ") + outName);
+}
+
+void BatchHDRDialog::bracketFailed(const QString &message) {
+    qDebug() << message;
+    m_Ui->textEdit->append(tr("Error: ") + message);
+    m_errors = true;
+}
+
+void BatchHDRDialog::bracketDone() {
+    int progressValue = m_Ui->progressBar->value() + 1;
+    m_Ui->progressBar->setValue(progressValue);
+    OsIntegration::getInstance().setProgress(
+        progressValue,
+        m_Ui->progressBar->maximum() - m_Ui->progressBar->minimum());
 }
 
 void BatchHDRDialog::batch_hdr() {
@@ -349,34 +456,42 @@ void BatchHDRDialog::batch_hdr() {
         // m_hdrCreationManager->reset();
         this->reject();
     }
-    if (!m_bracketed.isEmpty()) {
-        QFileInfo fi1(m_bracketed.at(0));
-        QFileInfo fi2(m_bracketed.at(m_Ui->spinBox->value() - 1));
+    if (!m_brackets.isEmpty()) {
+        const QStringList toProcess = m_brackets.takeFirst();
+        QFileInfo fi1(toProcess.first());
+        QFileInfo fi2(toProcess.last());
         m_output_file_name_base =
             fi1.completeBaseName() + "-" + fi2.completeBaseName();
         m_Ui->textEdit->append(tr("Loading files..."));
         m_numProcessed++;
-        QStringList toProcess;
-        for (int i = 0; i < m_Ui->spinBox->value(); ++i) {
-            toProcess << m_bracketed.takeFirst();
-        }
+        m_bracketSize = toProcess.count();
         qDebug() << "BatchHDRDialog::batch_hdr() Files to process: "
                  << toProcess;
         // DAVIDE _ HDR CREATION
         QtConcurrent::run(std::bind(&HdrCreationManager::loadFiles,
                                       m_hdrCreationManager, toProcess));
     } else {
-        m_Ui->closeButton->show();
-        m_Ui->cancelButton->hide();
-        m_Ui->startButton->hide();
-        m_Ui->progressBar->hide();
-        OsIntegration::getInstance().setProgress(-1);
+        finish_batch();
+    }
+}
+
+void BatchHDRDialog::finish_batch() {
+    if (m_abort) {
+        qDebug() << "Aborted";
         QApplication::restoreOverrideCursor();
-        if (m_errors)
-            m_Ui->textEdit->append(tr("Completed with errors"));
-        else
-            m_Ui->textEdit->append(tr("Completed without errors"));
+        this->reject();
+        return;
     }
+    m_Ui->closeButton->show();
+    m_Ui->cancelButton->hide();
+    m_Ui->startButton->hide();
+    m_Ui->progressBar->hide();
+    OsIntegration::getInstance().setProgress(-1);
+    QApplication::restoreOverrideCursor();
+    if (m_errors)
+        m_Ui->textEdit->append(tr("Completed with errors"));
+    else
+        m_Ui->textEdit->append(tr("Completed without errors"));
 }
 
 void BatchHDRDialog::align() {
@@ -415,7 +530,8 @@ void BatchHDRDialog::create_hdr(int) {
     if (m_Ui->autoAG_checkBox->isChecked()) {
         m_Ui->textEdit->append(tr("Doing auto anti-ghosting..."));
         QList<QPair<int, int>> HV_offsets;
-        for (int i = 0; i < m_Ui->spinBox->value(); i++) {
+        for (size_t i = 0; i < m_hdrCreationManager->availableInputFiles();
+             i++) {
             HV_offsets.append(qMakePair(0, 0));
         }
         float patchesPercent;
@@ -444,27 +560,7 @@ void BatchHDRDialog::createHdrFinished() {
         this->reject();
         return;
     }
-    QString outName;
-    QString suffix = m_Ui->formatComboBox->currentText();
-    QString caption = QString(
-        QObject::tr("Weights= ") +
-        getQString(m_hdrCreationManager->getWeightFunction().getType()) +
-        QObject::tr(" - Response curve= ") +
-        getQString(m_hdrCreationManager->getResponseCurve().getType()) +
-        QObject::tr(" - Model= ") +
-        getQString(m_hdrCreationManager->getFusionOperator()));
-
-    if (m_Ui->proposedFilenameCheckBox->isChecked()) {
-        outName = m_Ui->outputLineEdit->text() + "/" + m_output_file_name_base +
-                  "_" + caption + "." + suffix;
-    } else {
-        int paddingLength = ceil(log10(m_total + 1.0f));
-        outName = m_Ui->outputLineEdit->text() + "/" +
-                  m_Ui->prefixLineEdit->text() + "_" + caption + "_" +
-                  QStringLiteral("%1").arg(m_numProcessed, paddingLength, 10,
-                                           QChar('0')) +
-                  "." + suffix;
-    }
+    QString outName = outputFileName(m_numProcessed);
     try {
         m_IO_Worker->write_hdr_frame(resultHDR.get(), outName,
                                      m_formatHelper.getParams());
@@ -521,6 +617,7 @@ void BatchHDRDialog::on_cancelButton_clicked() {
     if (m_processing) {
         m_abort = true;
         m_ph.qtCancel();
+        m_engine->cancel();
         m_hdrCreationManager->reset();
         m_Ui->cancelButton->setText(tr("Aborting..."));
         m_Ui->cancelButton->setEnabled(false);
@@ -539,7 +636,7 @@ void BatchHDRDialog::processed() {
 }
 
 void BatchHDRDialog::try_to_continue() {
-    if (m_processed == m_Ui->spinBox->value()) {
+    if (m_processed == m_bracketSize) {
         m_processed = 0;
         if (m_loading_error) {
             m_loading_error = false;
@@ -29,6 +29,7 @@
 #include <QDialog>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QPair>
 #include <QtSql/QSqlDatabase>
 
 #include "Common/LuminanceOptions.h"
@@ -37,6 +38,7 @@
 #include "LibpfsAdditions/formathelper.h"
 
 // Forward declaration
+class BatchHdrEngine;
 class IOWorker;
 class HdrCreationManager;
 
@@ -58,6 +60,7 @@ class BatchHDRDialog : public QDialog {
 
    protected slots:
     void num_bracketed_changed(int);
+    void auto_group_toggled(bool);
     void on_selectInputFolder_clicked();
     void on_selectOutputFolder_clicked();
     void add_output_directory(QString dir = QString());
@@ -78,20 +81,32 @@ class BatchHDRDialog : public QDialog {
     void createHdrFinished();
     void loadFilesAborted();
     void on_profileComboBox_activated(int);
+    void bracketWritten(const QString &);
+    void bracketFailed(const QString &);
+    void bracketDone();
+    void finish_batch();
+    void brackets_grouped();
 
    protected:
+    QString outputFileName(int index) const;
+    void start_batch(const QList<QStringList> &brackets);
+    void start_pipeline();
+
     // Application-wide settings, loaded via QSettings
     QString m_batchHdrInputDir;
     QString m_batchHdrOutputDir;
     QString m_tempDir;
 
-    QStringList m_bracketed;
+    QList<QStringList> m_brackets;
     QString m_output_file_name_base;
     IOWorker *m_IO_Worker;
     HdrCreationManager *m_hdrCreationManager;
+    BatchHdrEngine *m_engine;
     int m_numProcessed;
     int m_processed;
     int m_total;
+    //! size of the bracket processed by batch_hdr()
+    int m_bracketSize;
     bool m_errors;
     bool m_loading_error;
     bool m_abort;
@@ -99,6 +114,9 @@ class BatchHDRDialog : public QDialog {
     QSqlDatabase m_db;
     QVector<FusionOperatorConfig> m_customConfig;
     QFutureWatcher<void> m_futureWatcher;
+    //! brackets found by ExifIndex, and the images left out of them
+    typedef QPair<QList<QStringList>, QStringList> Grouping;
+    QFutureWatcher<Grouping> m_groupWatcher;
     QFuture<pfs::Frame *> m_future;
     ProgressHelper m_ph;
     bool m_patches[agGridSize][agGridSize];
@@ -703,6 +703,8 @@ void BatchTMDialog::from_database() {
                     tm_opt->operator_options.reinhard02options.upper =
                         query.value(5).toInt();
                     tm_opt->pregamma = query.value(6).toFloat();
+                    tm_opt->operator_options.reinhard02options.fftconvolution =
+                        query.value(10).toBool();
                 }
             } else if (tmOperator == QLatin1String("reinhard05")) {
                 m_Ui->listWidget_TMopts->addItem(tmOperator + ": " + comment);
@@ -28,8 +28,20 @@
 #include <QFileInfo>
 #include <QRgb>
 #include <QUuid>
+#include <algorithm>
 #include <valarray>
 
+#if defined(Q_OS_WIN)
+#define NOMINMAX
+#define _WINSOCKAPI_  // stops windows.h including winsock.h
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#include <unistd.h>
+#endif
+
 #include <Core/IOWorker.h>
 #include <Exif/ExifOperations.h>
 #include <Libpfs/colorspace/colorspace.h>
@@ -60,8 +72,23 @@ using namespace pfs;
 using namespace pfs::io;
 using namespace libhdr::fusion;
 
-static void build_histogram(valarray<float> &hist, const valarray<uint8_t> &src) {
-    const size_t size = src.size();
+//! \brief HSL lightness of \a rgb, as QColor::toHsl().lightness()
+static inline int hsl_lightness(QRgb rgb) {
+    const int r = qRed(rgb);
+    const int g = qGreen(rgb);
+    const int b = qBlue(rgb);
+    const int mx = std::max(r, std::max(g, b));
+    const int mn = std::min(r, std::min(g, b));
+    // qRound((mx + mn) / 2 * 257) >> 8
+    return ((mx + mn) * 257 + 1) >> 9;
+}
+
+//! \brief histograms of the lightness and of the red, green and blue samples
+//! of \a src, built in a single pass
+static void build_histograms(const QRgb *src, size_t size,
+                             valarray<float> &histL, valarray<float> &histR,
+                             valarray<float> &histG, valarray<float> &histB) {
+    const size_t bins = histL.size();
 
     size_t numThreads = 1;
 
@@ -76,34 +103,39 @@ static void build_histogram(valarray<float> &hist, const valarray<uint8_t> &src)
 
     // Original version used a valarray<float>
     // We use a valarray<uint32_t>, because incrementing a float value of 0.f by 1.f saturates at 16777215.f
-    valarray<uint32_t> histInt(0u, hist.size());
+    valarray<uint32_t> histInt(0u, 4 * bins);
 
 #pragma omp parallel num_threads(numThreads)
 {
-    valarray<uint32_t> histThr(0u, hist.size());
+    // L, R, G, B
+    valarray<uint32_t> histThr(0u, 4 * bins);
 
     #pragma omp for nowait
     for (size_t i = 0; i < size; i++) {
-        histThr[src[i]]++;
+        const QRgb rgb = src[i];
+        histThr[hsl_lightness(rgb)]++;
+        histThr[bins + qRed(rgb)]++;
+        histThr[2 * bins + qGreen(rgb)]++;
+        histThr[3 * bins + qBlue(rgb)]++;
     }
 
     // add per thread histogram to global histogram
     #pragma omp critical
-    for(size_t i = 0; i < hist.size(); i++) {
-        histInt[i] += histThr[i];
-    }
+    histInt += histThr;
 }
 
-    // copy to float histogram
-    for(size_t i = 0; i < hist.size(); i++) {
-        hist[i] = histInt[i];
-    }
+    valarray<float> *hists[4] = {&histL, &histR, &histG, &histB};
+    for (int h = 0; h < 4; h++) {
+        valarray<float> &hist = *hists[h];
 
-    // find max
-    float hist_max = hist.max();
+        // copy to float histogram
+        for (size_t i = 0; i < bins; i++) {
+            hist[i] = histInt[h * bins + i];
+        }
 
-    // normalize in the range [0...1]
-    hist /= hist_max;
+        // normalize in the range [0...1]
+        hist /= hist.max();
+    }
 }
 
 static void compute_histogram_minmax(const valarray<float> &hist,
@@ -194,44 +226,15 @@ void computeAutolevels(const QImage *data, const float threshold,
     float minG, maxG;
     float minB, maxB;
 
-    // Convert to lightness
-    valarray<uint8_t> lightness(ELEMENTS);
-
-    #pragma omp parallel for
-    for (int i = 0; i < ELEMENTS; i++) {
-        lightness[i] = QColor::fromRgb(src[i]).toHsl().lightness();
-    }
-
-    // Build histogram
     valarray<float> histL(0.f, COLOR_DEPTH);
-    build_histogram(histL, lightness);
-    compute_histogram_minmax(histL, threshold, minL, maxL);
-
-    // get Red, Gree, Blue
-    valarray<uint8_t> red(ELEMENTS);
-    valarray<uint8_t> green(ELEMENTS);
-    valarray<uint8_t> blue(ELEMENTS);
-
-    #pragma omp parallel for
-    for (int i = 0; i < ELEMENTS; i++) {
-        red[i] = qRed(src[i]);
-        green[i] = qGreen(src[i]);
-        blue[i] = qBlue(src[i]);
-    }
-
-    // Build histogram
     valarray<float> histR(0.f, COLOR_DEPTH);
-    build_histogram(histR, red);
-    compute_histogram_minmax(histR, threshold, minR, maxR);
-
-    // Build histogram
     valarray<float> histG(0.f, COLOR_DEPTH);
-    build_histogram(histG, green);
-    compute_histogram_minmax(histG, threshold, minG, maxG);
-
-    // Build histogram
     valarray<float> histB(0.f, COLOR_DEPTH);
-    build_histogram(histB, blue);
+    build_histograms(src, ELEMENTS, histL, histR, histG, histB);
+
+    compute_histogram_minmax(histL, threshold, minL, maxL);
+    compute_histogram_minmax(histR, threshold, minR, maxR);
+    compute_histogram_minmax(histG, threshold, minG, maxG);
     compute_histogram_minmax(histB, threshold, minB, maxB);
 
     minHist = min(min(minL, minR), min(minG, minB));
@@ -481,3 +484,52 @@ QString getQString(libhdr::fusion::ResponseCurveType rf) {
 
     return QString();
 }
+
+size_t getAvailableMemory() {
+#if defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        return static_cast<size_t>(status.ullAvailPhys);
+    }
+    return 0;
+#elif defined(Q_OS_MACOS)
+    // free memory is not meaningful on macOS (file cache): use half of the
+    // physical memory
+    int64_t memsize = 0;
+    size_t length = sizeof(memsize);
+    if (sysctlbyname("hw.memsize", &memsize, &length, nullptr, 0) == 0) {
+        return static_cast<size_t>(memsize / 2);
+    }
+    return 0;
+#else
+#if defined(Q_OS_LINUX)
+    // free memory leaves out the page cache that the kernel reclaims on
+    // demand, MemAvailable accounts for it
+    QFile meminfo(QStringLiteral("/proc/meminfo"));
+    if (meminfo.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QByteArray line;
+        while (!(line = meminfo.readLine()).isEmpty()) {
+            if (line.startsWith("MemAvailable:")) {
+                const QList<QByteArray> fields = line.simplified().split(' ');
+                bool ok = false;
+                const qulonglong kb =
+                    fields.size() > 1 ? fields[1].toULongLong(&ok) : 0;
+                if (ok) {
+                    return static_cast<size_t>(kb) * 1024;
+                }
+                break;
+            }
+        }
+    }
+#endif
+#if defined(_SC_AVPHYS_PAGES)
+    const long pages = sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        return static_cast<size_t>(pages) * static_cast<size_t>(pageSize);
+    }
+#endif
+    return 0;
+#endif
+}
@@ -159,4 +159,7 @@ struct RefreshPreview {
 QString getQString(libhdr::fusion::FusionOperator fo);
 QString getQString(libhdr::fusion::WeightFunctionType wf);
 QString getQString(libhdr::fusion::ResponseCurveType rf);
+
+//! \return physical memory currently available, in bytes (0 if unknown)
+size_t getAvailableMemory();
 #endif
@@ -42,6 +42,7 @@
 
 #include "Common/LuminanceOptions.h"
 #include "Common/config.h"
+#include "Libpfs/tm/TonemapStageCache.h"
 
 #if defined(Q_OS_WIN)
 const QString LuminanceOptions::LUMINANCE_HDR_HOME_FOLDER = "LuminanceHDR";
@@ -616,6 +617,19 @@ void LuminanceOptions::setBatchTmNumThreads(int v) {
     m_settingHolder->setValue(KEY_BATCH_TM_NUM_THREADS, v);
 }
 
+int LuminanceOptions::getTmStageCacheSize() {
+    return m_settingHolder->value(KEY_TM_STAGE_CACHE_SIZE, 512).toInt();
+}
+
+void LuminanceOptions::setTmStageCacheSize(int v) {
+    m_settingHolder->setValue(KEY_TM_STAGE_CACHE_SIZE, v);
+}
+
+void LuminanceOptions::applyTmStageCacheSize() {
+    TonemapStageCache::instance().setCapacity(
+        static_cast<size_t>(qMax(0, getTmStageCacheSize())) * 1024u * 1024u);
+}
+
 namespace {
 #ifdef QT_DEBUG
 struct PrintTempDir {
@@ -718,6 +732,22 @@ void LuminanceOptions::setShowMissingEVsWarning(const bool b) {
     m_settingHolder->setValue(KEY_WIZARD_SHOW_MISSING_EVS_WARNING, b);
 }
 
+int LuminanceOptions::getResponseSampleSize() {
+    return m_settingHolder->value(KEY_WIZARD_RESPONSE_SAMPLES, 0).toInt();
+}
+
+void LuminanceOptions::setResponseSampleSize(int samples) {
+    m_settingHolder->setValue(KEY_WIZARD_RESPONSE_SAMPLES, samples);
+}
+
+bool LuminanceOptions::isResponseCacheEnabled() {
+    return m_settingHolder->value(KEY_WIZARD_RESPONSE_CACHE, false).toBool();
+}
+
+void LuminanceOptions::setResponseCacheEnabled(bool b) {
+    m_settingHolder->setValue(KEY_WIZARD_RESPONSE_CACHE, b);
+}
+
 QString LuminanceOptions::getDefaultPathTmoSettings() {
     return m_settingHolder
         ->value(KEY_RECENT_PATH_LOAD_SAVE_TMO_SETTINGS, QDir::currentPath())
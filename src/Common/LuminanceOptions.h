@@ -188,6 +188,12 @@ class LuminanceOptions : public QObject {
     int getNumThreads() { return getBatchTmNumThreads(); }
     void setNumThreads(int i) { setBatchTmNumThreads(i); }
 
+    // Tonemapping stage cache, in MB (0 disables it)
+    int getTmStageCacheSize();
+    void setTmStageCacheSize(int);
+    //! \brief set the capacity of TonemapStageCache to the preference
+    void applyTmStageCacheSize();
+
     // Default Paths
     // Path to save temporary cached files
     QString getTempDir();
@@ -216,6 +222,13 @@ class LuminanceOptions : public QObject {
 
     bool isShowMissingEVsWarning();
     void setShowMissingEVsWarning(const bool b);
+    //! \brief number of pixels used to estimate the response curve
+    //! (0 means all of them)
+    int getResponseSampleSize();
+    void setResponseSampleSize(int samples);
+    //! \brief reuse response curves estimated for the same camera and ISO
+    bool isResponseCacheEnabled();
+    void setResponseCacheEnabled(bool b);
 
     // MainWindow
     int getMainWindowToolBarMode();
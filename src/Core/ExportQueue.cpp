@@ -0,0 +1,360 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <Core/ExportQueue.h>
+
+#ifdef QT_DEBUG
+#include <QDebug>
+#endif
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <Common/CommonFunctions.h>
+#include <Core/IOWorker.h>
+#include <Core/TMWorker.h>
+#include <Core/TonemappingOptions.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/manip/copy.h>
+
+namespace {
+//! memory needed by a job, in working frames: the working frame, its
+//! tonemapped result and the buffers of the operator
+const size_t JOB_MEMORY_FACTOR = 6;
+//! tonemapped frames that can wait to be saved
+const int SAVE_SLOTS = 2;
+
+bool changesGeometry(const TonemappingOptions *tm_options) {
+    return tm_options->tonemapSelection ||
+           tm_options->xsize != tm_options->origxsize;
+}
+
+size_t workingFrameBytes(const pfs::Frame *frame,
+                         const TonemappingOptions *tm_options) {
+    size_t width = frame->getWidth();
+    size_t height = frame->getHeight();
+    if (tm_options->tonemapSelection) {
+        width = tm_options->selection_x_bottom_right -
+                tm_options->selection_x_up_left;
+        height = tm_options->selection_y_bottom_right -
+                 tm_options->selection_y_up_left;
+    } else if (tm_options->xsize != tm_options->origxsize) {
+        height = height * tm_options->xsize / std::max<size_t>(width, 1);
+        width = tm_options->xsize;
+    }
+    return width * height * 3 * sizeof(float);
+}
+
+//! \return number of jobs that fit in the memory available right now
+int workerCount(size_t jobBytes) {
+    const int ideal = std::max(1, QThread::idealThreadCount());
+    const size_t available = getAvailableMemory();
+    if (available == 0 || jobBytes == 0) return 1;
+
+    return static_cast<int>(std::max<size_t>(
+        1, std::min<size_t>(ideal, available / (JOB_MEMORY_FACTOR * jobBytes))));
+}
+}
+
+//! \brief Working frames shared by the queued jobs
+//! \note An entry lives as long as there are queued jobs needing it: it is
+//! computed by the first one that runs and dropped after the last one has
+//! made its own copy.
+class ExportQueue::FrameCache {
+   public:
+    typedef std::tuple<const pfs::Frame *, bool, int, int, int, int, int, int>
+        Key;
+
+    static Key key(const pfs::Frame *frame,
+                   const TonemappingOptions *tm_options,
+                   InterpolationMethod m) {
+        if (tm_options->tonemapSelection) {
+            return Key(frame, true, tm_options->selection_x_up_left,
+                       tm_options->selection_y_up_left,
+                       tm_options->selection_x_bottom_right,
+                       tm_options->selection_y_bottom_right, 0, 0);
+        }
+        return Key(frame, false, 0, 0, 0, 0, tm_options->xsize,
+                   static_cast<int>(m));
+    }
+
+    void retain(const Key &key) {
+        QMutexLocker locker(&m_Mutex);
+        ++m_Entries[key].pending;
+    }
+
+    void release(const Key &key) {
+        QMutexLocker locker(&m_Mutex);
+        std::map<Key, Entry>::iterator it = m_Entries.find(key);
+        if (it != m_Entries.end() && --it->second.pending == 0) {
+            m_Entries.erase(it);
+        }
+    }
+
+    //! \pre the caller has retained \a key
+    std::shared_ptr<const pfs::Frame> get(const Key &key, pfs::Frame *frame,
+                                          const TonemappingOptions *tm_options,
+                                          InterpolationMethod m) {
+        Entry *entry;
+        {
+            QMutexLocker locker(&m_Mutex);
+            entry = &m_Entries[key];
+        }
+        QMutexLocker locker(&entry->mutex);
+        if (!entry->frame) {
+            entry->frame.reset(TMWorker::cropOrResize(frame, tm_options, m));
+        }
+        return entry->frame;
+    }
+
+   private:
+    struct Entry {
+        Entry() : pending(0) {}
+
+        int pending;
+        QMutex mutex;
+        std::shared_ptr<const pfs::Frame> frame;
+    };
+
+    QMutex m_Mutex;
+    std::map<Key, Entry> m_Entries;
+};
+
+//! \brief Save a tonemapped frame, on the save pool
+class ExportQueue::SaveJob : public QRunnable {
+   public:
+    SaveJob(ExportQueue *queue, pfs::Frame *frame,
+            TonemappingOptions *tm_options, const pfs::Params &params,
+            const QString &fileName, const QString &inputfname,
+            const QVector<float> &inputExpoTimes)
+        : m_Queue(queue),
+          m_Frame(frame),
+          m_Options(tm_options),
+          m_Params(params),
+          m_FileName(fileName),
+          m_InputFileName(inputfname),
+          m_InputExpoTimes(inputExpoTimes) {}
+
+    void run() override {
+        IOWorker io_worker;
+        if (!io_worker.write_ldr_frame(m_Frame.data(), m_FileName,
+                                       m_InputFileName, m_InputExpoTimes,
+                                       m_Options.data(), m_Params)) {
+            emit m_Queue->exportFailed(
+                QObject::tr("Cannot save to file: %1")
+                    .arg(QFileInfo(m_FileName).fileName()));
+        }
+
+        m_Frame.reset();
+        m_Queue->releaseFileName(m_FileName);
+        m_Queue->m_SaveSlots.release();
+        emit m_Queue->exportEnd();
+    }
+
+   private:
+    ExportQueue *m_Queue;
+    QScopedPointer<pfs::Frame> m_Frame;
+    QScopedPointer<TonemappingOptions> m_Options;
+    pfs::Params m_Params;
+    QString m_FileName;
+    QString m_InputFileName;
+    QVector<float> m_InputExpoTimes;
+};
+
+//! \brief Prepare the working frame and tonemap it, on the tonemap pool
+class ExportQueue::TonemapJob : public QRunnable {
+   public:
+    TonemapJob(ExportQueue *queue, pfs::Frame *frame,
+               TonemappingOptions *tm_options, const pfs::Params &params,
+               const QString &fileName, const QString &inputfname,
+               const QVector<float> &inputExpoTimes, InterpolationMethod m)
+        : m_Queue(queue),
+          m_Frame(frame),
+          m_Options(tm_options),
+          m_Params(params),
+          m_FileName(fileName),
+          m_InputFileName(inputfname),
+          m_InputExpoTimes(inputExpoTimes),
+          m_Method(m),
+          m_Shared(changesGeometry(tm_options)),
+          m_Key(FrameCache::key(frame, tm_options, m)) {
+        if (m_Shared) m_Queue->m_Frames->retain(m_Key);
+    }
+
+    //! \note also run for the jobs dropped by waitForDone()
+    ~TonemapJob() {
+        if (m_Shared) m_Queue->m_Frames->release(m_Key);
+        if (!m_FileName.isEmpty()) m_Queue->releaseFileName(m_FileName);
+    }
+
+    void run() override {
+        emit m_Queue->exportBegin();
+
+#ifdef _OPENMP
+        // share the cores among the running jobs
+        omp_set_num_threads(std::max(1, QThread::idealThreadCount() /
+                                            m_Queue->m_TonemapPool.maxThreadCount()));
+#endif
+
+        pfs::Frame *working_frame;
+        if (m_Shared) {
+            std::shared_ptr<const pfs::Frame> source =
+                m_Queue->m_Frames->get(m_Key, m_Frame, m_Options.data(), m_Method);
+            working_frame = pfs::copy(source.get());
+            m_Queue->m_Frames->release(m_Key);
+            m_Shared = false;
+        } else {
+            working_frame = pfs::copy(m_Frame);
+        }
+
+        TMWorker tm_worker;
+        QObject::connect(&tm_worker, &TMWorker::tonemapFailed, m_Queue,
+                         &ExportQueue::exportFailed, Qt::DirectConnection);
+        QObject::connect(&tm_worker, &TMWorker::tonemapSetMaximum, m_Queue,
+                         &ExportQueue::exportSetMaximum, Qt::DirectConnection);
+        QObject::connect(&tm_worker, &TMWorker::tonemapSetMinimum, m_Queue,
+                         &ExportQueue::exportSetMinimum, Qt::DirectConnection);
+        QObject::connect(&tm_worker, &TMWorker::tonemapSetValue, m_Queue,
+                         &ExportQueue::exportSetValue, Qt::DirectConnection);
+
+        m_Queue->addRunning(&tm_worker);
+        pfs::Frame *result =
+            tm_worker.tonemapWorkingFrame(working_frame, m_Options.data());
+        m_Queue->removeRunning(&tm_worker);
+
+        if (result == nullptr) {
+            emit m_Queue->exportEnd();
+            return;
+        }
+
+        // hand the frame over to the save pool and move on to the next job
+        m_Queue->m_SaveSlots.acquire();
+        m_Queue->m_SavePool.start(new SaveJob(
+            m_Queue, result, m_Options.take(), m_Params, m_FileName,
+            m_InputFileName, m_InputExpoTimes));
+        m_FileName.clear();
+    }
+
+   private:
+    ExportQueue *m_Queue;
+    pfs::Frame *m_Frame;
+    QScopedPointer<TonemappingOptions> m_Options;
+    pfs::Params m_Params;
+    QString m_FileName;
+    QString m_InputFileName;
+    QVector<float> m_InputExpoTimes;
+    InterpolationMethod m_Method;
+    bool m_Shared;
+    FrameCache::Key m_Key;
+};
+
+ExportQueue::ExportQueue(QObject *parent)
+    : QObject(parent), m_Frames(new FrameCache), m_SaveSlots(SAVE_SLOTS) {
+    m_TonemapPool.setMaxThreadCount(1);
+    m_SavePool.setMaxThreadCount(1);
+}
+
+ExportQueue::~ExportQueue() { waitForDone(); }
+
+void ExportQueue::enqueue(pfs::Frame *frame, TonemappingOptions *tm_options,
+                          const pfs::Params &params, const QString &exportDir,
+                          const QString &hdrName, const QString &inputfname,
+                          const QVector<float> &inputExpoTimes,
+                          InterpolationMethod m) {
+    const int workers = workerCount(workingFrameBytes(frame, tm_options));
+#ifdef QT_DEBUG
+    qDebug() << "ExportQueue::enqueue(): workers =" << workers;
+#endif
+    m_TonemapPool.setMaxThreadCount(workers);
+
+    const QString fileName =
+        reserveFileName(exportDir, hdrName, tm_options, params);
+    m_TonemapPool.start(new TonemapJob(this, frame, tm_options, params,
+                                       fileName, inputfname, inputExpoTimes,
+                                       m));
+}
+
+void ExportQueue::waitForDone() {
+    m_TonemapPool.clear();
+    m_TonemapPool.waitForDone();
+    m_SavePool.waitForDone();
+}
+
+void ExportQueue::requestTermination() {
+    QMutexLocker locker(&m_Mutex);
+    foreach (TMWorker *worker, m_Running) {
+        emit worker->tonemapRequestTermination(true);
+    }
+}
+
+QString ExportQueue::reserveFileName(const QString &exportDir,
+                                     const QString &hdrName,
+                                     TonemappingOptions *tm_options,
+                                     const pfs::Params &params) {
+    QDir dir(exportDir);
+
+    const QString firstPart = hdrName + "_" + tm_options->getPostfix();
+    QString extension;
+    if (!params.get("fileextension", extension))
+        extension = QStringLiteral("tiff");
+    extension = "." + extension;
+
+    QMutexLocker locker(&m_Mutex);
+
+    // files of the jobs still in the queue do not exist yet
+    QString outputFilename;
+    int idx = 1;
+    do {
+        outputFilename = dir.filePath(
+            firstPart + (idx > 1 ? "-" + QString::number(idx) : QString()) +
+            extension);
+        idx++;
+    } while (QFileInfo::exists(outputFilename) ||
+             m_ReservedNames.contains(outputFilename));
+
+    m_ReservedNames.insert(outputFilename);
+    return outputFilename;
+}
+
+void ExportQueue::releaseFileName(const QString &fileName) {
+    QMutexLocker locker(&m_Mutex);
+    m_ReservedNames.remove(fileName);
+}
+
+void ExportQueue::addRunning(TMWorker *worker) {
+    QMutexLocker locker(&m_Mutex);
+    m_Running.insert(worker);
+}
+
+void ExportQueue::removeRunning(TMWorker *worker) {
+    QMutexLocker locker(&m_Mutex);
+    m_Running.remove(worker);
+}
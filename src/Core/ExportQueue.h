@@ -0,0 +1,105 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef EXPORTQUEUE_H
+#define EXPORTQUEUE_H
+
+#include <QMutex>
+#include <QObject>
+#include <QScopedPointer>
+#include <QSemaphore>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <Common/global.h>
+#include <Libpfs/params.h>
+
+// Forward declaration
+namespace pfs {
+class Frame;
+}
+
+class TonemappingOptions;
+class TMWorker;
+
+//! \brief Tonemap and save the exports queued from the tonemapping panel
+//! \note Exports run on a pool of workers: their number is chosen when a job
+//! is queued, against the memory available for the size of its working
+//! frame. Jobs with the same geometry (crop or resize) of the same HDR share
+//! a single copy of the working frame. Saving runs on a separate thread, so
+//! that the encoding of an export overlaps with the tonemap of the next one.
+class ExportQueue : public QObject {
+    Q_OBJECT
+
+   public:
+    explicit ExportQueue(QObject *parent = 0);
+    ~ExportQueue();
+
+    //! \brief queue the export of \a frame
+    //! \note \a tm_options is owned by the queue from now on
+    void enqueue(pfs::Frame *frame, TonemappingOptions *tm_options,
+                 const pfs::Params &params, const QString &exportDir,
+                 const QString &hdrName, const QString &inputfname,
+                 const QVector<float> &inputExpoTimes, InterpolationMethod m);
+
+    //! \brief drop the jobs that are not running yet and wait for the others
+    void waitForDone();
+
+   public Q_SLOTS:
+    //! \brief interrupt the running tonemaps
+    void requestTermination();
+
+   Q_SIGNALS:
+    void exportBegin();
+    //! \brief emitted once per queued job, whatever its outcome
+    void exportEnd();
+    void exportFailed(QString);
+    //! \brief progress of the running tonemap, forwarded from its worker
+    void exportSetMaximum(int);
+    void exportSetMinimum(int);
+    void exportSetValue(int);
+
+   private:
+    class FrameCache;
+    class TonemapJob;
+    class SaveJob;
+
+    QString reserveFileName(const QString &exportDir, const QString &hdrName,
+                            TonemappingOptions *tm_options,
+                            const pfs::Params &params);
+    void releaseFileName(const QString &fileName);
+
+    void addRunning(TMWorker *worker);
+    void removeRunning(TMWorker *worker);
+
+    QScopedPointer<FrameCache> m_Frames;
+    QThreadPool m_TonemapPool;
+    QThreadPool m_SavePool;
+    //! bounds the tonemapped frames waiting to be saved
+    QSemaphore m_SaveSlots;
+
+    QMutex m_Mutex;
+    QSet<QString> m_ReservedNames;
+    QSet<TMWorker *> m_Running;
+};
+
+#endif  // EXPORTQUEUE_H
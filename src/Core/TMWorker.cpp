@@ -28,28 +28,34 @@
 #ifdef QT_DEBUG
 #include <QDebug>
 #endif
-#include <QDir>
-#include <QVector>
 
-#include <Core/IOWorker.h>
+#include <algorithm>
+#include <memory>
+
 #include <Libpfs/frame.h>
 #include <Libpfs/manip/copy.h>
 #include <Libpfs/manip/cut.h>
 #include <Libpfs/manip/gamma.h>
 #include <Libpfs/manip/resize.h>
 #include <Libpfs/manip/saturation.h>
-#include <Libpfs/params.h>
 #include <Libpfs/tm/TonemapOperator.h>
 #include <Common/ProgressHelper.h>
 #include <Core/TonemappingOptions.h>
 
+namespace {
+//! downscale factors of the passes of a progressive tonemap, coarse to fine
+const int PROGRESSIVE_DOWNSCALES[] = {8, 2, 1};
+//! coarse passes narrower than this are skipped: they would not be worth
+//! their cost over the next pass
+const int PROGRESSIVE_MIN_WIDTH = 256;
+}
+
 TMWorker::TMWorker(QObject *parent)
-    : QObject(parent), m_Callback(new ProgressHelper) {
+    : QObject(parent), m_Callback(new ProgressHelper(this)), m_Generation(0) {
 #ifdef QT_DEBUG
     qDebug() << "TMWorker::TMWorker() ctor";
 #endif
 
-    connect(this, &QObject::destroyed, m_Callback, &QObject::deleteLater);
     connect(this, &TMWorker::tonemapRequestTermination, m_Callback,
             &ProgressHelper::qtCancel, Qt::DirectConnection);
     connect(m_Callback, &ProgressHelper::qtSetValue, this,
@@ -73,8 +79,24 @@ pfs::Frame *TMWorker::computeTonemap(/* const */ pfs::Frame *in_frame,
     qDebug() << "TMWorker::getTonemappedFrame()";
 #endif
 
-    pfs::Frame *working_frame = preprocessFrame(in_frame, tm_options, m);
+    // a new request: a previous cancel does not apply to it
+    m_Callback->cancel(false);
+    pfs::Frame *working_frame =
+        tonemapWorkingFrame(cropOrResize(in_frame, tm_options, m), tm_options);
+    if (working_frame == nullptr) return nullptr;
+
+    emit tonemapSuccess(working_frame, tm_options);
+    return working_frame;
+}
+
+pfs::Frame *TMWorker::tonemapWorkingFrame(pfs::Frame *working_frame,
+                                          TonemappingOptions *tm_options) {
     if (working_frame == nullptr) return nullptr;
+
+    if (tm_options->pregamma != 1.0f) {
+        pfs::applyGamma(working_frame, tm_options->pregamma);
+    }
+
     try {
         tonemapFrame(working_frame, tm_options);
     } catch (...) {
@@ -85,83 +107,84 @@ pfs::Frame *TMWorker::computeTonemap(/* const */ pfs::Frame *in_frame,
 
     if (m_Callback->canceled()) {
         emit tonemapFailed(QStringLiteral("Canceled"));
-        m_Callback->cancel(false);  // double check this
         delete working_frame;
         return nullptr;
     }
 
     postprocessFrame(working_frame, tm_options);
 
-    emit tonemapSuccess(working_frame, tm_options);
     return working_frame;
 }
 
-void TMWorker::computeTonemapAndExport(/* const */ pfs::Frame *in_frame,
-                                       TonemappingOptions *tm_options,
-                                       pfs::Params params, QString exportDir,
-                                       QString hdrName, QString inputfname,
-                                       QVector<float> inputExpoTimes,
-                                       InterpolationMethod m) {
-    pfs::Frame *working_frame = preprocessFrame(in_frame, tm_options, m);
-    if (working_frame == nullptr) return;
-    try {
-        tonemapFrame(working_frame, tm_options);
-    } catch (...) {
-        emit tonemapFailed(QStringLiteral("Tonemap failed!"));
-        delete working_frame;
-        return;
-    }
-
-    if (m_Callback->canceled()) {
-        m_Callback->cancel(false);  // double check this
-        delete working_frame;
-        return;
-    }
+void TMWorker::computeProgressiveTonemap(/* const */ pfs::Frame *in_frame,
+                                         TonemappingOptions *tm_options,
+                                         InterpolationMethod m,
+                                         int generation) {
+    const int width =
+        tm_options->tonemapSelection
+            ? tm_options->selection_x_bottom_right -
+                  tm_options->selection_x_up_left
+            : tm_options->xsize;
 
-    postprocessFrame(working_frame, tm_options);
+    // the flag still holds the cancel of the superseded request. It is
+    // cleared once, before the generation is checked: a supersede() from now
+    // on either changes the generation or cancels the operator, and a cancel
+    // of the user stops every following pass
+    m_Callback->cancel(false);
+    if (!isCurrent(generation)) return;
 
-    QDir dir(exportDir);
+    for (int downscale : PROGRESSIVE_DOWNSCALES) {
+        if (downscale > 1 && width / downscale < PROGRESSIVE_MIN_WIDTH) {
+            continue;
+        }
+        if (m_Callback->canceled()) {
+            if (isCurrent(generation)) {
+                emit tonemapFailed(QStringLiteral("Canceled"));
+            }
+            return;
+        }
 
-    const QString firstPart = hdrName + "_" + tm_options->getPostfix();
-    QString extension;
-    if (!params.get("fileextension", extension))
-        extension = QStringLiteral("tiff");
-    extension = "." + extension;
+        pfs::Frame *working_frame =
+            preprocessFrame(in_frame, tm_options, m, downscale);
+        if (working_frame == nullptr) return;
+        try {
+            tonemapFrame(working_frame, tm_options);
+        } catch (...) {
+            emit tonemapFailed(QStringLiteral("Tonemap failed!"));
+            delete working_frame;
+            return;
+        }
 
-    QString outputFilename;
+        // superseded: the newer request takes over the viewer
+        if (!isCurrent(generation)) {
+            delete working_frame;
+            return;
+        }
 
-    int idx = 1;
-    do {
-        outputFilename = firstPart +
-                         (idx > 1 ? "-" + QString::number(idx) : QString()) +
-                         extension;
-        idx++;
-    } while (dir.exists(outputFilename));
+        if (m_Callback->canceled()) {
+            emit tonemapFailed(QStringLiteral("Canceled"));
+            delete working_frame;
+            return;
+        }
 
-    IOWorker io_worker;
+        postprocessFrame(working_frame, tm_options);
 
-    if (io_worker.write_ldr_frame(working_frame, dir.filePath(outputFilename),
-                                  inputfname, inputExpoTimes, tm_options,
-                                  params)) {
-        // emit add_log_message( tr("[T%1] Successfully saved LDR file:
-        // %2").arg(m_thread_id).arg(QFileInfo(output_file_name).completeBaseName())
-        // );
-    } else {
-        // emit add_log_message( tr("[T%1] ERROR: Cannot save to file:
-        // %2").arg(m_thread_id).arg(QFileInfo(output_file_name).completeBaseName())
-        // );
+        emit tonemapPassSuccess(working_frame, tm_options, generation);
     }
+}
+
+int TMWorker::supersede() {
+    const int generation = m_Generation.fetchAndAddOrdered(1) + 1;
+    m_Callback->cancel(true);
+    return generation;
+}
 
-    delete tm_options;
-    // emit tonemapSuccess(working_frame, tm_options);
-    // return working_frame;
-    delete working_frame;
+bool TMWorker::isCurrent(int generation) const {
+    return m_Generation.loadAcquire() == generation;
 }
 
 void TMWorker::tonemapFrame(pfs::Frame *working_frame,
                             TonemappingOptions *tm_options) {
-    m_Callback->cancel(false);
-
     emit tonemapBegin();
     // build tonemap object
     TonemapOperator *tmEngine =
@@ -176,7 +199,21 @@ void TMWorker::tonemapFrame(pfs::Frame *working_frame,
 
 pfs::Frame *TMWorker::preprocessFrame(pfs::Frame *input_frame,
                                       TonemappingOptions *tm_options,
-                                      InterpolationMethod m) {
+                                      InterpolationMethod m,
+                                      int downscale) {
+    pfs::Frame *working_frame =
+        cropOrResize(input_frame, tm_options, m, downscale);
+
+    if (tm_options->pregamma != 1.0f) {
+        pfs::applyGamma(working_frame, tm_options->pregamma);
+    }
+
+    return working_frame;
+}
+
+pfs::Frame *TMWorker::cropOrResize(pfs::Frame *input_frame,
+                                   const TonemappingOptions *tm_options,
+                                   InterpolationMethod m, int downscale) {
     pfs::Frame *working_frame = nullptr;
 
     if (tm_options->tonemapSelection) {
@@ -189,18 +226,20 @@ pfs::Frame *TMWorker::preprocessFrame(pfs::Frame *input_frame,
                                  tm_options->selection_y_up_left,
                                  tm_options->selection_x_bottom_right,
                                  tm_options->selection_y_bottom_right);
-    } else if (tm_options->xsize != tm_options->origxsize) {
+        if (downscale > 1) {
+            std::unique_ptr<pfs::Frame> crop(working_frame);
+            working_frame = pfs::resize(
+                crop.get(), std::max(1, int(crop->getWidth()) / downscale), m);
+        }
+    } else if (tm_options->xsize != tm_options->origxsize || downscale > 1) {
         // workingframe = "resize"
-        working_frame = pfs::resize(input_frame, tm_options->xsize, m);
+        working_frame = pfs::resize(
+            input_frame, std::max(1, tm_options->xsize / downscale), m);
     } else {
         // workingframe = "full res"
         working_frame = pfs::copy(input_frame);
     }
 
-    if (tm_options->pregamma != 1.0f) {
-        pfs::applyGamma(working_frame, tm_options->pregamma);
-    }
-
     return working_frame;
 }
 
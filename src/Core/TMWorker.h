@@ -26,11 +26,11 @@
 #ifndef TMWORKER_H
 #define TMWORKER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include <QString>
 
 #include <Common/global.h>
-#include <Libpfs/params.h>
 
 // Forward declaration
 namespace pfs {
@@ -55,24 +55,60 @@ class TMWorker : public QObject {
     pfs::Frame *computeTonemap(/* const */ pfs::Frame *, TonemappingOptions *,
                                InterpolationMethod m);
 
-    void computeTonemapAndExport(/* const */ pfs::Frame *, TonemappingOptions *,
-                                 pfs::Params, QString exportDir,
-                                 QString hdrName, QString inputfname,
-                                 QVector<float> inputExpoTimes,
-                                 InterpolationMethod m);
+    //!
+    //!  Progressive version of computeTonemap(): the frame is tonemapped at
+    //!  1/8 and 1/2 of the requested size first, then at full size, and every
+    //!  pass is returned through tonemapPassSuccess(). The request is
+    //!  abandoned as soon as it is no longer the current \a generation.
+    //!
+    void computeProgressiveTonemap(/* const */ pfs::Frame *,
+                                   TonemappingOptions *, InterpolationMethod m,
+                                   int generation);
 
     //!
-    //! This function tonemap the input frame
+    //! This function tonemap the input frame. The cancel flag is left as it
+    //! is: it is cleared when a request starts, not by every pass
     //!
     void tonemapFrame(pfs::Frame *, TonemappingOptions *);
 
+   public:
+    //!
+    //! Tonemap a working frame already cut or resized by the caller: apply
+    //! pregamma, tonemap and postprocess it. Takes ownership of the frame.
+    //! \return the tonemapped frame, nullptr if tonemapping failed or was
+    //! canceled (tonemapFailed() is emitted)
+    //!
+    pfs::Frame *tonemapWorkingFrame(pfs::Frame *, TonemappingOptions *);
+
+    //!
+    //! \return a new frame holding the selection or the resized version of
+    //! the input frame as requested by the options, further scaled down by
+    //! \a downscale
+    //!
+    static pfs::Frame *cropOrResize(pfs::Frame *,
+                                    const TonemappingOptions *,
+                                    InterpolationMethod m, int downscale = 1);
+
+    //!
+    //! Make the running progressive request outdated and interrupt its
+    //! current pass. Thread safe: meant to be called from the GUI thread
+    //! right before queueing a new request.
+    //! \return generation of the new request
+    //!
+    int supersede();
+
+    //! \return true if \a generation is the most recent request
+    bool isCurrent(int generation) const;
+
    private:
     pfs::Frame *preprocessFrame(pfs::Frame *, TonemappingOptions *,
-                                InterpolationMethod m);
+                                InterpolationMethod m, int downscale = 1);
     void postprocessFrame(pfs::Frame *, TonemappingOptions *);
 
    Q_SIGNALS:
     void tonemapSuccess(pfs::Frame *, TonemappingOptions *);
+    void tonemapPassSuccess(pfs::Frame *, TonemappingOptions *,
+                            int generation);
     void tonemapFailed(QString);
 
     void tonemapBegin();
@@ -83,7 +119,10 @@ class TMWorker : public QObject {
     void tonemapRequestTermination(bool);
 
    private:
+    //! child of the worker: workers run by the export queue live on pool
+    //! threads with no event loop, where deleteLater() would never run
     ProgressHelper *m_Callback;
+    QAtomicInt m_Generation;
 };
 
 #endif  // TMWORKER_H
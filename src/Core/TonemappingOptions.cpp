@@ -92,6 +92,8 @@ void TonemappingOptions::setDefaultTonemapParameters() {
     operator_options.reinhard02options.range = REINHARD02_RANGE;
     operator_options.reinhard02options.lower = REINHARD02_LOWER;
     operator_options.reinhard02options.upper = REINHARD02_UPPER;
+    operator_options.reinhard02options.fftconvolution =
+        REINHARD02_FFT_CONVOLUTION;
 
     // Reinhard 05
     operator_options.reinhard05options.brightness = REINHARD05_BRIGHTNESS;
@@ -508,6 +510,9 @@ const QString TonemappingOptions::getCaption(bool includePregamma,
                 caption += QString(QObject::tr("Lower") + "=%1").arg(lower) +
                            separator;
                 caption += QString(QObject::tr("Upper") + "=%1").arg(upper);
+                if (!operator_options.reinhard02options.fftconvolution) {
+                    caption += separator + QObject::tr("Recursive");
+                }
             }
         } break;
         case reinhard05: {
@@ -725,6 +730,9 @@ TonemappingOptions *TMOptionsOperations::parseFile(const QString &fname) {
             toreturn->operator_options.reinhard02options.lower = value.toInt();
         } else if (field == QLatin1String("UPPER")) {
             toreturn->operator_options.reinhard02options.upper = value.toInt();
+        } else if (field == QLatin1String("FFTCONVOLUTION")) {
+            toreturn->operator_options.reinhard02options.fftconvolution =
+                (value != QLatin1String("NO"));
         } else if (field == QLatin1String("BRIGHTNESS")) {
             toreturn->operator_options.reinhard05options.brightness =
                 value.toFloat();
@@ -924,6 +932,9 @@ QString TMOptionsOperations::getExifComment() {
                 exif_comment += QStringLiteral("Range: %1\n").arg(range);
                 exif_comment += QStringLiteral("Lower: %1\n").arg(lower);
                 exif_comment += QStringLiteral("Upper: %1\n").arg(upper);
+                if (!opts->operator_options.reinhard02options.fftconvolution) {
+                    exif_comment += QStringLiteral("Recursive Gaussian\n");
+                }
             }
         } break;
         case reinhard05: {
@@ -107,6 +107,7 @@ class TonemappingOptions {
             int range;
             int lower;
             int upper;
+            bool fftconvolution;  // false means recursive gaussian
         } reinhard02options;
         struct {
             float brightness;
@@ -408,4 +408,46 @@ float getAverageLuminance(const std::string &filename) {
     }
 }
 
+std::string getCameraIdentifier(const std::string &filename) {
+    try {
+        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(filename);
+        image->readMetadata();
+        Exiv2::ExifData &exifData = image->exifData();
+
+        const char *keys[] = {"Exif.Image.Make", "Exif.Image.Model",
+                              "Exif.Photo.BodySerialNumber"};
+        std::string identifier;
+        for (const char *key : keys) {
+            Exiv2::ExifData::const_iterator it =
+                exifData.findKey(Exiv2::ExifKey(key));
+            if (it == exifData.end()) continue;
+
+            const std::string value = it->toString();
+            if (value.empty()) continue;
+            if (!identifier.empty()) identifier += ' ';
+            identifier += value;
+        }
+        return identifier;
+    } catch (Exiv2::AnyError &e) {
+        return std::string();
+    }
+}
+
+int getIsoSpeed(const std::string &filename) {
+    try {
+        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(filename);
+        image->readMetadata();
+        Exiv2::ExifData &exifData = image->exifData();
+
+        Exiv2::ExifData::const_iterator it =
+            exifData.findKey(Exiv2::ExifKey("Exif.Photo.ISOSpeedRatings"));
+        if (it != exifData.end()) {
+            return static_cast<int>(it->toLong());
+        }
+        return -1;
+    } catch (Exiv2::AnyError &e) {
+        return -1;
+    }
+}
+
 }  // ExifOperations
@@ -45,6 +45,15 @@ void copyExifData(const std::string &from, const std::string &to,
 float getAverageLuminance(const std::string &filename);
 
 float getExposureTime(const std::string &filename);
+
+//! \brief identify the camera that shot \c filename (make, model and body
+//! serial number when available)
+//! \return camera identifier or an empty string if unknown
+std::string getCameraIdentifier(const std::string &filename);
+
+//! \brief retrieve ISO speed of \c filename
+//! \return ISO speed or -1 if the value is not available
+int getIsoSpeed(const std::string &filename);
 }
 
 #endif
@@ -76,8 +76,9 @@ QImage *fromLDRPFStoQImage(pfs::Frame *in_frame, float min_luminance,
 
     assert(in_frame != nullptr);
 
-    pfs::Channel *Xc, *Yc, *Zc;
-    in_frame->getXYZChannels(Xc, Yc, Zc);
+    // read only: keeps the data cached by the frame
+    const pfs::Channel *Xc, *Yc, *Zc;
+    static_cast<const pfs::Frame *>(in_frame)->getXYZChannels(Xc, Yc, Zc);
     assert(Xc != nullptr && Yc != nullptr && Zc != nullptr);
 
     QImage *temp_qimage = new QImage(
@@ -28,6 +28,7 @@
 //! \author Franco Comida <fcomida@users.sourceforge.net>
 
 #include "HdrCreation/debevec.h"
+#include "HdrCreation/fusionkernels.h"
 #include <Libpfs/colorspace/normalizer.h>
 #include <Libpfs/utils/msec_timer.h>
 #include <Libpfs/utils/numeric.h>
@@ -40,11 +41,6 @@
 #include <functional>
 #include <iostream>
 #include <vector>
-#include "../sleef.c"
-#include "../opthelper.h"
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 
 #include "Libpfs/array2d.h"
 
@@ -92,105 +88,22 @@ void DebevecOperator::computeFusion(ResponseCurve &response,
     frame.resize(W, H);
     Channel *Ch[3];
     frame.createXYZChannels(Ch[0], Ch[1], Ch[2]);
-    Array2Df *resultCh[channels] = {Ch[0], Ch[1], Ch[2]};
-
-#ifdef _OPENMP
-    #pragma omp parallel for
-#endif
-    for (int c = 0; c < channels; c++) {
-        resultCh[c]->fill(0.f);
-    }
-    Array2Df weight_sum(W, H);
-    weight_sum.fill(0.f);
-
-    int length = images.size();
-
-#ifdef _OPENMP
-    int numthreads = omp_get_max_threads();
-    int nestedthreads = std::max(numthreads / length, 1);
-    bool oldNested = omp_get_nested();
-    if(nestedthreads > 1) {
-        omp_set_nested(true);
-    }
-    #pragma omp parallel for
-#endif
-    for (int i = 0; i < length; i++) {
-        Channel *Ch[channels];
-        images[i].frame()->getXYZChannels(Ch[0], Ch[1], Ch[2]);
-        Array2Df *imagesCh[channels] = {Ch[0], Ch[1], Ch[2]};
-
-        Array2Df response_img(W, H);
-        Array2Df w(W, H);
-
-        float cmul = 1.f / channels;
-#ifdef _OPENMP
-        #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
-#endif
-        for (size_t k = 0; k < size; k++) {
-            w(k) = cmul * (weight((*imagesCh[0])(k)) + weight((*imagesCh[1])(k)) + weight((*imagesCh[2])(k)));
-        }
-        float cadd = -logf(times.at((int)i));
-        for (int c = 0; c < channels; c++) {
-            #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
-            for (size_t k = 0; k < size; k++) {
-                (response_img)(k) = response((*imagesCh[c])(k));
-            }
-#ifdef __SSE2__
-            vfloat caddv = F2V(cadd);
-#ifdef _OPENMP
-            #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
-#endif
-            for (size_t k = 0; k < size - 3; k+=4) {
-                STVFU((response_img)(k), (xlogf(LVFU((response_img)(k))) + caddv) * LVFU(w(k)));
-            }
-            for (size_t k = size - (size % 4); k < size; k++) {
-                (response_img)(k) = (xlogf((response_img)(k)) + cadd) * w(k);
-            }
-#else
-#ifdef _OPENMP
-            #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
-#endif
-            for (size_t k = 0; k < size; k++) {
-                (response_img)(k) = (xlogf((response_img)(k)) + cadd) * w(k);
-            }
-#endif
 
-#ifdef _OPENMP
-            #pragma omp critical
-#endif
-            vadd(resultCh[c]->data(), response_img.data(), resultCh[c]->data(), size);
-        }
+    DataList redChannels(images.size());
+    DataList greenChannels(images.size());
+    DataList blueChannels(images.size());
 
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        vadd(weight_sum.data(), w.data(), weight_sum.data(), size);
-    }
-#ifdef _OPENMP
-    omp_set_nested(oldNested);
-#endif
+    fillDataLists(images, redChannels, greenChannels, blueChannels);
 
-    for (int c = 0; c < channels; c++) {
-#ifdef _OPENMP
-        #pragma omp parallel for
-#endif
-        for(size_t y = 0; y < H; ++y) {
-            size_t x = 0;
-#ifdef __SSE2__
-            for(; x < W - 3; x += 4) {
-                STVFU((*resultCh[c])(x, y), xexpf(LVFU((*resultCh[c])(x,y)) / LVFU(weight_sum(x,y))));
-            }
-#endif
-            for(; x < W; ++x) {
-                (*resultCh[c])(x, y) = xexpf((*resultCh[c])(x,y) / weight_sum(x,y));
-            }
-        }
-    }
+    FusionLuts luts(response, weight);
+    fuseDebevec(luts, redChannels, greenChannels, blueChannels,
+                exp_values.data(), Ch[0]->data(), Ch[1]->data(),
+                Ch[2]->data(), size);
 
     float cmax[3];
     float cmin[3];
 #ifdef _OPENMP
-    #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
+    #pragma omp parallel for
 #endif
     for (int c = 0; c < channels; c++) {
         float minval = numeric_limits<float>::max();
@@ -235,7 +148,7 @@ void DebevecOperator::computeFusion(ResponseCurve &response,
     }
 
 #ifdef _OPENMP
-    #pragma omp parallel for num_threads(nestedthreads) if (nestedthreads>1)
+    #pragma omp parallel for
 #endif
     for (int c = 0; c < channels; c++) {
         transform(Ch[c]->begin(), Ch[c]->end(), Ch[c]->begin(),
@@ -0,0 +1,233 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "HdrCreation/fusionkernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "../sleef.c"
+
+namespace libhdr {
+namespace fusion {
+
+static_assert(WeightFunction::NUM_BINS == ResponseCurve::NUM_BINS,
+              "weight and response must share the same binning");
+
+FusionLuts::FusionLuts(const ResponseCurve &response,
+                       const WeightFunction &weight)
+    : m_weightType(weight.getType()), m_weight(weight.getWeights()) {
+    for (int c = 0; c < 3; ++c) {
+        const ResponseCurve::ResponseContainer &r =
+            response.get(static_cast<ResponseChannel>(c));
+        for (size_t i = 0; i < NUM_BINS; ++i) {
+            m_logResponse[c][i] = xlogf(r[i]);
+            m_weightedResponse[c][i] = m_weight[i] * r[i];
+        }
+    }
+}
+
+namespace {
+
+template <WeightFunctionType Type>
+struct WeightLookup {
+    static float get(const float *w, size_t idx) { return w[idx]; }
+
+    static float average(const float *w, size_t r, size_t g, size_t b) {
+        return (1.f / 3.f) * (w[r] + w[g] + w[b]);
+    }
+};
+
+template <>
+struct WeightLookup<WEIGHT_FLAT> {
+    static float get(const float *, size_t) { return 1.f; }
+
+    static float average(const float *, size_t, size_t, size_t) {
+        return 1.f;
+    }
+};
+
+template <WeightFunctionType Type>
+void fuseDebevecImpl(const FusionLuts &luts, const DataList &redChannels,
+                     const DataList &greenChannels,
+                     const DataList &blueChannels,
+                     const float *logExposureTimes, float *outRed,
+                     float *outGreen, float *outBlue, size_t size) {
+    typedef WeightLookup<Type> Weight;
+
+    const size_t numExposures = redChannels.size();
+    const float *w = luts.weight().data();
+    const float *lr = luts.logResponse(RESPONSE_CHANNEL_RED).data();
+    const float *lg = luts.logResponse(RESPONSE_CHANNEL_GREEN).data();
+    const float *lb = luts.logResponse(RESPONSE_CHANNEL_BLUE).data();
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t k = 0; k < size; ++k) {
+        float sumRed = 0.f;
+        float sumGreen = 0.f;
+        float sumBlue = 0.f;
+        float sumWeight = 0.f;
+
+        for (size_t i = 0; i < numExposures; ++i) {
+            const size_t ir = FusionLuts::getIdx(redChannels[i][k]);
+            const size_t ig = FusionLuts::getIdx(greenChannels[i][k]);
+            const size_t ib = FusionLuts::getIdx(blueChannels[i][k]);
+            const float wi = Weight::average(w, ir, ig, ib);
+            const float lt = logExposureTimes[i];
+
+            sumRed += (lr[ir] - lt) * wi;
+            sumGreen += (lg[ig] - lt) * wi;
+            sumBlue += (lb[ib] - lt) * wi;
+            sumWeight += wi;
+        }
+
+        outRed[k] = xexpf(sumRed / sumWeight);
+        outGreen[k] = xexpf(sumGreen / sumWeight);
+        outBlue[k] = xexpf(sumBlue / sumWeight);
+    }
+}
+
+template <WeightFunctionType Type>
+size_t fuseRobertsonImpl(const FusionLuts &luts, ResponseChannel channel,
+                         const DataList &inputData, const float *exposureTimes,
+                         float *outputData, size_t size, float minAllowedValue,
+                         float maxAllowedValue) {
+    typedef WeightLookup<Type> Weight;
+
+    const size_t numExposures = inputData.size();
+    const float *w = luts.weight().data();
+    const float *wr = luts.weightedResponse(channel).data();
+
+    size_t saturatedPixels = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+ : saturatedPixels)
+#endif
+    for (size_t j = 0; j < size; ++j) {
+        float sum = 0.0f;
+        float div = 0.0f;
+        float maxti = -1e6f;
+        float minti = +1e6f;
+
+        for (size_t i = 0; i < numExposures; ++i) {
+            const float m = inputData[i][j];
+            const float ti = exposureTimes[i];
+            const size_t idx = FusionLuts::getIdx(m);
+
+            // --- anti saturation: observe minimum exposure time at which
+            // saturated value is present, and maximum exp time at which
+            // black value is present
+            if (m > maxAllowedValue) {
+                minti = std::min(minti, ti);
+            }
+            if (m < minAllowedValue) {
+                maxti = std::max(maxti, ti);
+            }
+
+            sum += ti * wr[idx];
+            div += ti * ti * Weight::get(w, idx);
+        }
+
+        // --- anti saturation: if a meaningful representation of pixel
+        // was not found, replace it with information from observed data
+        if (div == 0.0f) {
+            ++saturatedPixels;
+        }
+        if (div == 0.0f && maxti > -1e6f) {
+            sum = minAllowedValue;
+            div = maxti;
+        }
+        if (div == 0.0f && minti < +1e6f) {
+            sum = maxAllowedValue;
+            div = minti;
+        }
+
+        outputData[j] = (div != 0.0f) ? sum / div : 0.0f;
+    }
+
+    return saturatedPixels;
+}
+
+}  // anonymous
+
+void fuseDebevec(const FusionLuts &luts, const DataList &redChannels,
+                 const DataList &greenChannels, const DataList &blueChannels,
+                 const float *logExposureTimes, float *outRed,
+                 float *outGreen, float *outBlue, size_t size) {
+    assert(redChannels.size() == greenChannels.size());
+    assert(redChannels.size() == blueChannels.size());
+
+    switch (luts.weightType()) {
+        case WEIGHT_FLAT:
+            fuseDebevecImpl<WEIGHT_FLAT>(luts, redChannels, greenChannels,
+                                         blueChannels, logExposureTimes,
+                                         outRed, outGreen, outBlue, size);
+            break;
+        case WEIGHT_TRIANGULAR:
+            fuseDebevecImpl<WEIGHT_TRIANGULAR>(
+                luts, redChannels, greenChannels, blueChannels,
+                logExposureTimes, outRed, outGreen, outBlue, size);
+            break;
+        case WEIGHT_PLATEAU:
+            fuseDebevecImpl<WEIGHT_PLATEAU>(luts, redChannels, greenChannels,
+                                            blueChannels, logExposureTimes,
+                                            outRed, outGreen, outBlue, size);
+            break;
+        case WEIGHT_GAUSSIAN:
+        default:
+            fuseDebevecImpl<WEIGHT_GAUSSIAN>(luts, redChannels, greenChannels,
+                                             blueChannels, logExposureTimes,
+                                             outRed, outGreen, outBlue, size);
+            break;
+    }
+}
+
+size_t fuseRobertson(const FusionLuts &luts, ResponseChannel channel,
+                     const DataList &inputData, const float *exposureTimes,
+                     float *outputData, size_t size, float minAllowedValue,
+                     float maxAllowedValue) {
+    assert(inputData.size());
+
+    switch (luts.weightType()) {
+        case WEIGHT_FLAT:
+            return fuseRobertsonImpl<WEIGHT_FLAT>(
+                luts, channel, inputData, exposureTimes, outputData, size,
+                minAllowedValue, maxAllowedValue);
+        case WEIGHT_TRIANGULAR:
+            return fuseRobertsonImpl<WEIGHT_TRIANGULAR>(
+                luts, channel, inputData, exposureTimes, outputData, size,
+                minAllowedValue, maxAllowedValue);
+        case WEIGHT_PLATEAU:
+            return fuseRobertsonImpl<WEIGHT_PLATEAU>(
+                luts, channel, inputData, exposureTimes, outputData, size,
+                minAllowedValue, maxAllowedValue);
+        case WEIGHT_GAUSSIAN:
+        default:
+            return fuseRobertsonImpl<WEIGHT_GAUSSIAN>(
+                luts, channel, inputData, exposureTimes, outputData, size,
+                minAllowedValue, maxAllowedValue);
+    }
+}
+
+}  // fusion
+}  // libhdr
@@ -0,0 +1,93 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef LIBHDR_FUSION_FUSIONKERNELS_H
+#define LIBHDR_FUSION_FUSIONKERNELS_H
+
+//! \brief Fused per-pixel kernels for the fusion operators
+//! \note Weight and response are sampled once per bin into lookup tables, so
+//! that the inner loops of the operators reduce to table gathers and
+//! multiply-adds. Kernels are instantiated for each \c WeightFunctionType:
+//! a flat weight does not touch its table at all.
+
+#include <array>
+#include <cstddef>
+
+#include <HdrCreation/fusionoperator.h>
+#include <HdrCreation/responses.h>
+#include <HdrCreation/weights.h>
+
+namespace libhdr {
+namespace fusion {
+
+class FusionLuts {
+   public:
+    static const size_t NUM_BINS = WeightFunction::NUM_BINS;
+    typedef std::array<float, NUM_BINS> Lut;
+
+    FusionLuts(const ResponseCurve &response, const WeightFunction &weight);
+
+    //! \brief same bin mapping of \c WeightFunction and \c ResponseCurve
+    static size_t getIdx(float sample) { return WeightFunction::getIdx(sample); }
+
+    WeightFunctionType weightType() const { return m_weightType; }
+
+    //! \brief weight(i)
+    const Lut &weight() const { return m_weight; }
+    //! \brief log(response(i))
+    const Lut &logResponse(ResponseChannel channel) const {
+        return m_logResponse[channel];
+    }
+    //! \brief weight(i) * response(i)
+    const Lut &weightedResponse(ResponseChannel channel) const {
+        return m_weightedResponse[channel];
+    }
+
+   private:
+    WeightFunctionType m_weightType;
+    Lut m_weight;
+    std::array<Lut, 3> m_logResponse;
+    std::array<Lut, 3> m_weightedResponse;
+};
+
+//! \brief Debevec merge of the three channels in a single pass:
+//! out_c = exp(sum_i(w_i * (log(response_c) - log(t_i))) / sum_i(w_i))
+//! where w_i is the average weight of the three samples of exposure i
+//! \note every channel goes through its own response curve. Before these
+//! kernels the red curve was used for the three channels: the predefined
+//! curves are the same for every channel, only custom curves (loaded from
+//! file or estimated by Robertson02) give a different result.
+void fuseDebevec(const FusionLuts &luts, const DataList &redChannels,
+                 const DataList &greenChannels, const DataList &blueChannels,
+                 const float *logExposureTimes, float *outRed,
+                 float *outGreen, float *outBlue, size_t size);
+
+//! \brief Robertson merge of one channel: out = sum_i(w * t_i * response) /
+//! sum_i(w * t_i^2), with the anti saturation fallback of Robertson02
+//! \return number of pixels without any trusted sample
+size_t fuseRobertson(const FusionLuts &luts, ResponseChannel channel,
+                     const DataList &inputData, const float *exposureTimes,
+                     float *outputData, size_t size, float minAllowedValue,
+                     float maxAllowedValue);
+
+}  // fusion
+}  // libhdr
+
+#endif  // LIBHDR_FUSION_FUSIONKERNELS_H
@@ -32,6 +32,7 @@
 
 #include <Common/global.h>
 #include <Libpfs/array2d.h>
+#include <Libpfs/array2dview.h>
 #include <Libpfs/colorspace/convert.h>
 #include <Libpfs/colorspace/xyz.h>
 #include <Libpfs/frame.h>
@@ -56,17 +57,23 @@ typedef Array2D<bool> Array2Db;
 
 namespace libhdr {
 
+// the border of the shifted image has no mask: only the overlap is compared
 long XORimages(const Array2Db &img1, const Array2Db &mask1,
-               const Array2Db &img2, const Array2Db &mask2) {
+               const Array2DView<bool> &img2, const Array2DView<bool> &mask2) {
+    const size_t colBegin = img2.colBegin();
+    const size_t colEnd = img2.colEnd();
+
     long err = 0;
-    for (size_t i = 0; i < img1.getRows(); i++) {
-        Array2Db::const_iterator p1 = img1.row_begin(i);
+    for (size_t i = img2.rowBegin(); i < img2.rowEnd(); i++) {
+        Array2Db::const_iterator p1 = img1.row_begin(i) + colBegin;
         Array2Db::const_iterator p2 = img2.row_begin(i);
-        Array2Db::const_iterator m1 = mask1.row_begin(i);
+        Array2Db::const_iterator m1 = mask1.row_begin(i) + colBegin;
         Array2Db::const_iterator m2 = mask2.row_begin(i);
 
-        for (size_t j = 0; j < img1.getCols(); j++) {
-            err += (long)((*p1++ xor *p2++) and *m1++ and *m2++);
+        // the iterators are moved outside of the expression: "and" would
+        // skip the increments of the masks where the bits are equal
+        for (size_t j = colBegin; j < colEnd; ++j, ++p1, ++p2, ++m1, ++m2) {
+            err += (long)((*p1 xor *p2) and *m1 and *m2);
         }
     }
     return err;
@@ -129,20 +136,16 @@ void getExpShift(const Array2D8u &img1, const int median1,
     setThreshold(img1, median1, noise, img1threshold, img1mask);
     setThreshold(img2, median2, noise, img2threshold, img2mask);
 
-    Array2Db img2_shifted(img2.getCols(), img2.getRows());
-    Array2Db img2mask_shifted(img2.getCols(), img2.getRows());
-
     int minerr = img1.size();
     for (int i = -1; i <= 1; i++) {
         for (int j = -1; j <= 1; j++) {
             int dx = curr_x + i;
             int dy = curr_y + j;
 
-            pfs::shift(img2threshold, dx, dy, img2_shifted);
-            pfs::shift(img2mask, dx, dy, img2mask_shifted);
-
-            long err = XORimages(img1threshold, img1mask, img2_shifted,
-                                 img2mask_shifted);
+            long err = XORimages(
+                img1threshold, img1mask,
+                Array2DView<bool>(img2threshold).shift(dx, dy),
+                Array2DView<bool>(img2mask).shift(dx, dy));
 
             if (err < minerr) {
                 minerr = err;
@@ -26,11 +26,13 @@
 //! to Giuseppe Rota)
 
 #include "robertson02.h"
+#include "fusionkernels.h"
 #include <Libpfs/colorspace/normalizer.h>
 #include "arch/math.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <iterator>
 #include <vector>
@@ -58,69 +60,12 @@ void RobertsonOperator::applyResponse(
     float minAllowedValue, float maxAllowedValue, const float *arrayofexptime) {
     assert(inputData.size());
 
-    size_t saturatedPixels = 0;
-
-    int numPixels = (int)width * height;
-    for (int j = 0; j < numPixels; ++j) {
-        // all exposures for each pixel
-        float sum = 0.0f;
-        float div = 0.0f;
-        float maxti = -1e6f;
-        float minti = +1e6f;
-
-        // for all exposures
-        for (int i = 0; i < (int)inputData.size(); ++i) {
-            float m = inputData[i][j];
-            float ti = arrayofexptime[i];
-
-            float w = weight(m);
-            float r = response(m, channel);
-            // --- anti saturation: observe minimum exposure time at which
-            // saturated value is present, and maximum exp time at which
-            // black value is present
-            if (m > maxAllowedValue) {
-                minti = min(minti, ti);
-            }
-            if (m < minAllowedValue) {
-                maxti = max(maxti, ti);
-            }
-
-            // --- anti-ghosting: monotonous increase in time should result
-            // in monotonous increase in intensity; make forward and
-            // backward check, ignore value if condition not satisfied
-            //            int m_lower = inputData.getSample(i_lower[i], j);
-            //            int m_upper = inputData.getSample(i_upper[i], j);
-
-            //            if ( N > 1) {
-            //                if ( m_lower > m || m_upper < m ) {
-            //                    continue;
-            //                }
-            //            }
-
-            sum += w * ti * r;
-            div += w * ti * ti;
-        }
-
-        // --- anti saturation: if a meaningful representation of pixel
-        // was not found, replace it with information from observed data
-        if (div == 0.0f) {
-            ++saturatedPixels;
-        }
-        if (div == 0.0f && maxti > -1e6f) {
-            sum = minAllowedValue;
-            div = maxti;
-        }
-        if (div == 0.0f && minti < +1e6f) {
-            sum = maxAllowedValue;
-            div = minti;
-        }
-
-        if (div != 0.0f) {
-            outputData[j] = sum / div;
-        } else {
-            outputData[j] = 0.0f;
-        }
-    }
+    FusionLuts luts(response, weight);
+#ifndef NDEBUG
+    size_t saturatedPixels =
+#endif
+        fuseRobertson(luts, channel, inputData, arrayofexptime, outputData,
+                      width * height, minAllowedValue, maxAllowedValue);
 
     PRINT_DEBUG("Saturated pixels: " << saturatedPixels);
 }
@@ -251,6 +196,84 @@ float normalizeI(ResponseCurve::ResponseContainer &I) {
     return mid;
 }
 
+// number of pixels tried in each cell of the sampling grid
+const int CANDIDATES_PER_CELL = 4;
+
+//! \brief Pick one pixel for each cell of a regular grid of about
+//! \a sampleSize cells. Among a few (deterministic) candidates of each cell,
+//! the one whose samples carry the largest total weight is kept, so that the
+//! estimation is not wasted on pixels clipped in most exposures.
+vector<size_t> stratifiedSample(const DataList &redChannels,
+                                const DataList &greenChannels,
+                                const DataList &blueChannels,
+                                const WeightFunction &weight, size_t width,
+                                size_t height, size_t sampleSize) {
+    const size_t cell = std::max<size_t>(
+        1, static_cast<size_t>(std::sqrt(double(width * height) / sampleSize)));
+    const size_t cellsX = (width + cell - 1) / cell;
+    const size_t cellsY = (height + cell - 1) / cell;
+    const size_t numExposures = redChannels.size();
+
+    vector<size_t> samples(cellsX * cellsY);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t cy = 0; cy < cellsY; ++cy) {
+        for (size_t cx = 0; cx < cellsX; ++cx) {
+            const size_t x0 = cx * cell;
+            const size_t y0 = cy * cell;
+            const size_t cellWidth = std::min(cell, width - x0);
+            const size_t cellHeight = std::min(cell, height - y0);
+
+            // LCG seeded with the cell index: same sample on every run
+            unsigned int seed = static_cast<unsigned int>(cy * cellsX + cx);
+            size_t best = y0 * width + x0;
+            float bestWeight = -1.f;
+            for (int k = 0; k < CANDIDATES_PER_CELL; ++k) {
+                seed = seed * 1664525u + 1013904223u;
+                const size_t x = x0 + (seed >> 8) % cellWidth;
+                seed = seed * 1664525u + 1013904223u;
+                const size_t y = y0 + (seed >> 8) % cellHeight;
+                const size_t idx = y * width + x;
+
+                float w = 0.f;
+                for (size_t i = 0; i < numExposures; ++i) {
+                    w += weight(redChannels[i][idx]) +
+                         weight(greenChannels[i][idx]) +
+                         weight(blueChannels[i][idx]);
+                }
+                if (w > bestWeight) {
+                    bestWeight = w;
+                    best = idx;
+                }
+            }
+            samples[cy * cellsX + cx] = best;
+        }
+    }
+    return samples;
+}
+
+//! \brief copy the samples at \a indexes of every exposure in \a buffer and
+//! build a \c DataList pointing at them
+void gatherSamples(const DataList &inputData, const vector<size_t> &indexes,
+                   vector<float> &buffer, DataList &outputData) {
+    const size_t numSamples = indexes.size();
+    buffer.resize(inputData.size() * numSamples);
+    outputData.resize(inputData.size());
+
+    for (size_t i = 0; i < inputData.size(); ++i) {
+        float *samples = buffer.data() + i * numSamples;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (size_t j = 0; j < numSamples; ++j) {
+            samples[j] = inputData[i][indexes[j]];
+        }
+        outputData[i] = samples;
+    }
+}
+
 /*
 void pseudoSort(const float* arrayofexptime, int* i_lower, int* i_upper, int N)
 {
@@ -292,6 +315,7 @@ void RobertsonOperatorAuto::computeResponse(
     typedef ResponseCurve::ResponseContainer ResponseContainer;
 
     int N = inputData.size();
+    const size_t numPixels = width * height;
 
     // 0 . initialization
     // a. normalize response
@@ -318,23 +342,35 @@ void RobertsonOperatorAuto::computeResponse(
         fill(sum.begin(), sum.end(), 0.f);
 
         // 1. Minimize with respect to I
-        for (int i = 0; i < N; ++i) {
-            float ti = arrayofexptime[i];
-            // this is probably uglier than necessary, (I copy th FOR in order
-            // not to do the IFs inside them) but I don't know how to improve it
-            for (size_t j = 0; j < width * height; ++j) {
-                size_t sample = response.getIdx(inputData[i][j]);
-                // if ((sample < ResponseCurve::NUM_BINS) && (sample >= 0)) //
-                // sample is
-                // unsigned so always >= 0
-                if (sample < ResponseCurve::NUM_BINS) {
-                    sum[sample] += ti * outputData[j];
-                    cardEm[sample]++;
+        // each thread fills its own histogram, merged at the end
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+        {
+            vector<long> cardEmThr(ResponseCurve::NUM_BINS, 0);
+            vector<float> sumThr(ResponseCurve::NUM_BINS, 0.f);
+
+            for (int i = 0; i < N; ++i) {
+                float ti = arrayofexptime[i];
+#ifdef _OPENMP
+#pragma omp for nowait
+#endif
+                for (size_t j = 0; j < numPixels; ++j) {
+                    size_t sample = response.getIdx(inputData[i][j]);
+                    // sample is unsigned so always >= 0
+                    if (sample < ResponseCurve::NUM_BINS) {
+                        sumThr[sample] += ti * outputData[j];
+                        cardEmThr[sample]++;
+                    }
                 }
-#ifndef NDEBUG
-                else
-                    PRINT_DEBUG("robertson02: sample out of range: " << sample);
+            }
+
+#ifdef _OPENMP
+#pragma omp critical
 #endif
+            for (size_t m = 0; m < ResponseCurve::NUM_BINS; ++m) {
+                sum[m] += sumThr[m];
+                cardEm[m] += cardEmThr[m];
             }
         }
 
@@ -419,21 +455,51 @@ void RobertsonOperatorAuto::computeFusion(
                    back_inserter(averageLuminances),
                    bind(&FrameEnhanced::averageLuminance, _1));
 
-    // red
-    computeResponse(response, weight, RESPONSE_CHANNEL_RED, redChannels,
-                    outputRed->data(), tempFrame.getWidth(),
-                    tempFrame.getHeight(), minAllowedValue, maxAllowedValue,
-                    averageLuminances.data());
-    // green
-    computeResponse(response, weight, RESPONSE_CHANNEL_GREEN, greenChannels,
-                    outputGreen->data(), tempFrame.getWidth(),
-                    tempFrame.getHeight(), minAllowedValue, maxAllowedValue,
-                    averageLuminances.data());
-    // blue
-    computeResponse(response, weight, RESPONSE_CHANNEL_BLUE, blueChannels,
-                    outputBlue->data(), tempFrame.getWidth(),
-                    tempFrame.getHeight(), minAllowedValue, maxAllowedValue,
-                    averageLuminances.data());
+    if (m_sampleSize != 0 && m_sampleSize < W * H) {
+        // estimate on a sample, then apply the final curve to the whole frame
+        const vector<size_t> samples =
+            stratifiedSample(redChannels, greenChannels, blueChannels, weight,
+                             W, H, m_sampleSize);
+        PRINT_DEBUG("Response estimated on " << samples.size() << " pixels");
+
+        const DataList *channels[3] = {&redChannels, &greenChannels,
+                                       &blueChannels};
+        const ResponseChannel ids[3] = {RESPONSE_CHANNEL_RED,
+                                        RESPONSE_CHANNEL_GREEN,
+                                        RESPONSE_CHANNEL_BLUE};
+        Channel *outputs[3] = {outputRed, outputGreen, outputBlue};
+
+        vector<float> sampleBuffer;
+        DataList sampleData;
+        vector<float> sampleOutput(samples.size());
+        for (int c = 0; c < 3; ++c) {
+            gatherSamples(*channels[c], samples, sampleBuffer, sampleData);
+            computeResponse(response, weight, ids[c], sampleData,
+                            sampleOutput.data(), samples.size(), 1,
+                            minAllowedValue, maxAllowedValue,
+                            averageLuminances.data());
+            applyResponse(response, weight, ids[c], *channels[c],
+                          outputs[c]->data(), W, H, minAllowedValue,
+                          maxAllowedValue, averageLuminances.data());
+        }
+    } else {
+        // red
+        computeResponse(response, weight, RESPONSE_CHANNEL_RED, redChannels,
+                        outputRed->data(), tempFrame.getWidth(),
+                        tempFrame.getHeight(), minAllowedValue,
+                        maxAllowedValue, averageLuminances.data());
+        // green
+        computeResponse(response, weight, RESPONSE_CHANNEL_GREEN,
+                        greenChannels, outputGreen->data(),
+                        tempFrame.getWidth(), tempFrame.getHeight(),
+                        minAllowedValue, maxAllowedValue,
+                        averageLuminances.data());
+        // blue
+        computeResponse(response, weight, RESPONSE_CHANNEL_BLUE, blueChannels,
+                        outputBlue->data(), tempFrame.getWidth(),
+                        tempFrame.getHeight(), minAllowedValue,
+                        maxAllowedValue, averageLuminances.data());
+    }
 
     float cmax[3];
     cmax[0] = *max_element(outputRed->begin(), outputRed->end());
@@ -54,10 +54,17 @@ class RobertsonOperator : public IFusionOperator {
 
 class RobertsonOperatorAuto : public RobertsonOperator {
    public:
-    RobertsonOperatorAuto() : RobertsonOperator() {}
+    RobertsonOperatorAuto() : RobertsonOperator(), m_sampleSize(0) {}
 
     FusionOperator getType() const override { return ROBERTSON_AUTO; }
 
+    //! \brief estimate the response on about \a sampleSize pixels, picked on
+    //! a regular grid among the best exposed ones, instead of the full frame.
+    //! The estimated curve is then applied once at full resolution.
+    //! 0 (default) means estimation on every pixel
+    void setSampleSize(size_t sampleSize) { m_sampleSize = sampleSize; }
+    size_t sampleSize() const { return m_sampleSize; }
+
    private:
     void computeFusion(ResponseCurve &response, WeightFunction &weight,
                        const std::vector<FrameEnhanced> &frames,
@@ -68,6 +75,8 @@ class RobertsonOperatorAuto : public RobertsonOperator {
                          float *outputData, size_t width, size_t height,
                          float minAllowedValue, float maxAllowedValue,
                          const float *arrayofexptime);
+
+    size_t m_sampleSize;
 };
 
 }  // fusion
@@ -28,6 +28,7 @@
 #include <QtGlobal>
 #include "hdrhtml.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
@@ -39,6 +40,8 @@
 #include <vector>
 
 #include "Libpfs/exception.h"
+#include "opthelper.h"
+#include "sleef.c"
 
 #if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
 #include <QCoreApplication>
@@ -60,6 +63,9 @@ const int pix_per_fstop =
     25;  // Distance in pixels between f-stops shown on the histogram
 const char *hdrhtml_version = "1.0";  // Version of the HDRHTML code
 
+// Samples converted to log2 by a thread at a time
+const int LOG_CHUNK = 16384;
+
 // ================================================
 //                Histogram
 // ================================================
@@ -93,7 +99,8 @@ class Histogram {
             min_val = numeric_limits<T>::max();
             max_val = numeric_limits<T>::min();
 
-            for (size_t k = 0; k < d_size; k++) {
+#pragma omp parallel for reduction(min : min_val) reduction(max : max_val)
+            for (long k = 0; k < (long)d_size; k++) {
                 if (data[k] > max_val) max_val = data[k];
                 if (data[k] < min_val) min_val = data[k];
             }
@@ -113,28 +120,25 @@ class Histogram {
             n[k] = 0;
         }
 
-        if (reject_outofrange) {
-            for (size_t k = 0; k < d_size; k++) {
-                int ind = floor((data[k] - min_val) / (max_val - min_val) *
-                                (float)bins);
-                if (ind < 0) continue;
-                if (ind >= bins) continue;
-                n[ind]++;
-            }
-        } else {
-            for (size_t k = 0; k < d_size; k++) {
+        // every thread counts in its own bins, merged at the end
+#pragma omp parallel
+        {
+            vector<size_t> local_n(bins, 0);
+#pragma omp for nowait
+            for (long k = 0; k < (long)d_size; k++) {
                 int ind = floor((data[k] - min_val) / (max_val - min_val) *
                                 (float)bins);
                 if (ind < 0) {
-                    n[0]++;
-                    continue;
-                }
-                if (ind >= bins) {
-                    n[bins - 1]++;
-                    continue;
+                    if (reject_outofrange) continue;
+                    ind = 0;
+                } else if (ind >= bins) {
+                    if (reject_outofrange) continue;
+                    ind = bins - 1;
                 }
-                n[ind]++;
+                local_n[ind]++;
             }
+#pragma omp critical
+            for (int k = 0; k < bins; k++) n[k] += local_n[k];
         }
     }
 };
@@ -317,12 +321,13 @@ class Percentiles {
     /**
      * @param data - table with samples
      * @param d_size - number of samples
+     * @param min_val, max_val - range of the samples, if known
      */
-    Percentiles(const T *data, size_t d_size)
+    Percentiles(const T *data, size_t d_size, T min_val = 1, T max_val = -1)
         : bin_n(1000),
           d_size(d_size)  // Accuracy 0.1 prctile
     {
-        hist.compute(data, d_size, bin_n, 1, -1, false);
+        hist.compute(data, d_size, bin_n, min_val, max_val, false);
         // Compute cumulative histogram
         for (size_t k = 1; k < bin_n; k++) hist.n[k] += hist.n[k - 1];
 
@@ -361,6 +366,7 @@ class ReplacePattern {
     ReplacePattern(const char *pattern, float replace_with_num)
         : pattern(pattern), callback(nullptr), user_data(nullptr) {
         ostringstream num_str;
+        num_str.imbue(locale::classic());
         num_str << replace_with_num;
         replace_with = num_str.str();
     }
@@ -368,6 +374,7 @@ class ReplacePattern {
     ReplacePattern(const char *pattern, int replace_with_num)
         : pattern(pattern), callback(nullptr), user_data(nullptr) {
         ostringstream num_str;
+        num_str.imbue(locale::classic());
         num_str << replace_with_num;
         replace_with = num_str.str();
     }
@@ -460,6 +467,7 @@ void create_from_template(const char *output_file_name,
                           const char *template_file_name,
                           ReplacePattern *pattern_list) {
     ofstream outfs(output_file_name);
+    outfs.imbue(locale::classic());
     if (!outfs.good()) {
         ostringstream error_message;
         error_message << "Cannot open '" << output_file_name << "' for writing";
@@ -540,12 +548,11 @@ class CSVTable {
                 if (len == 0) {
                     value = numeric_limits<float>::quiet_NaN();
                 } else {
-                    string token = line_str.substr(pos, len);
-                    const char *str_beg = token.c_str();
-                    char *str_end;
-                    // cerr << "token: " << str_beg << "\n";
-                    value = strtof(str_beg, &str_end);
-                    if (str_beg == str_end) {
+                    // the tables use '.' whatever the locale of the user
+                    istringstream token(line_str.substr(pos, len));
+                    token.imbue(locale::classic());
+                    token >> value;
+                    if (token.fail()) {
                         ostringstream error_message;
                         error_message << "Error parsing line " << lines + 1
                                       << " of " << file_name << "\n";
@@ -582,10 +589,6 @@ class CSVTable {
 void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
                            float *Y, const char *base_name, const char *out_dir,
                            int quality, bool verbose) {
-    // THIS CAUSED ME A BIG HEADACHE!!!
-    string user_locale = locale("").name();
-    locale::global(locale::classic());
-
     const int pixels = width * height;
     const int basis_no = quality;
 
@@ -609,39 +612,72 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
         basis_table.data[0][k] = log2f(basis_table.data[0][k]);
     }
 
-    // Fix zero and negative values in the image, convert to log2 space, find
-    // min
-    // and max values
-    float img_min = numeric_limits<float>::max();
-    float img_max = numeric_limits<float>::min();
+    // Fix zero and negative values in the image and convert to log2 space:
+    // the non positive values take the log of the smallest positive one,
+    // which is also the smallest log, so a single pass finds it, and the
+    // largest log, while converting and a cheap second pass fixes the (few)
+    // non positive values
+    float Y_min_log = 0.f;
+    float Y_max_log = 0.f;
     {
         float *arrays[] = {R, G, B, Y};
+        const float log2e = static_cast<float>(1.0 / std::log(2.0));
+        const float minus_inf = -numeric_limits<float>::infinity();
 
-        int k;
-
-        for (k = 0; k < 4; k++) {
+        for (int k = 0; k < 4; k++) {
             float *x = arrays[k];
-            float min_val = numeric_limits<float>::max(),
-                  max_val = numeric_limits<float>::min();
-            for (int i = 0; i < pixels; i++) {
-                if (x[i] < min_val && x[i] > 0) min_val = x[i];
-                if (x[i] > max_val) max_val = x[i];
+            float min_log = log2f(numeric_limits<float>::max());
+            float max_log = minus_inf;
+#pragma omp parallel reduction(min : min_log) reduction(max : max_log)
+            {
+#ifdef __SSE2__
+                const vfloat log2ev = F2V(log2e);
+                const vfloat minus_infv = F2V(minus_inf);
+                vfloat min_logv = F2V(min_log);
+                vfloat max_logv = minus_infv;
+#endif
+#pragma omp for
+                for (int begin = 0; begin < pixels; begin += LOG_CHUNK) {
+                    const int end = std::min(begin + LOG_CHUNK, pixels);
+                    int i = begin;
+#ifdef __SSE2__
+                    for (; i < end - 3; i += 4) {
+                        const vfloat xv = LVFU(x[i]);
+                        const vmask positive = vmaskf_gt(xv, ZEROV);
+                        const vfloat v =
+                            vself(positive, xlogf(xv) * log2ev, minus_infv);
+                        STVFU(x[i], v);
+                        min_logv = vminf(min_logv, vself(positive, v, min_logv));
+                        max_logv = vmaxf(max_logv, v);
+                    }
+#endif
+                    for (; i < end; i++) {
+                        const float v =
+                            x[i] > 0 ? xlogf(x[i]) * log2e : minus_inf;
+                        x[i] = v;
+                        if (v > minus_inf && v < min_log) min_log = v;
+                        if (v > max_log) max_log = v;
+                    }
+                }
+#ifdef __SSE2__
+                min_log = std::min(min_log, vhmin(min_logv));
+                max_log = std::max(max_log, vhmax(max_logv));
+#endif
             }
-            img_max = max(img_max, log2f(max_val));
-            img_min = min(img_min, log2f(min_val));
-
+#pragma omp parallel for
             for (int i = 0; i < pixels; i++) {
-                if (x[i] < min_val)
-                    x[i] = log2f(min_val);
-                else
-                    x[i] = log2f(x[i]);
+                if (x[i] < min_log) x[i] = min_log;
+            }
+            if (x == Y) {
+                Y_min_log = min_log;
+                Y_max_log = std::max(max_log, min_log);
             }
         }
     }
 
-    Percentiles<float> prc(Y, pixels);
-    img_min = prc.prctile(0.1);
-    img_max = prc.prctile(99.9);
+    Percentiles<float> prc(Y, pixels, Y_min_log, Y_max_log);
+    float img_min = prc.prctile(0.1);
+    float img_max = prc.prctile(99.9);
 
     img_min -= 4;  // give extra room for brightenning
     // how many 8-fstop segments we need to cover the DR
@@ -700,7 +736,7 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
         // imwrite( hist_img, plot_name );
 
         QImage hist_image(hist_buffer_c, hist_width, hist_height,
-                          QImage::Format_RGB888);
+                          hist_width * 3, QImage::Format_RGB888);
         ostringstream img_filename;
         if (out_dir != nullptr) img_filename << out_dir << "/";
         if (image_dir != nullptr) img_filename << image_dir << "/";
@@ -711,20 +747,18 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
         hist_image.save(QString::fromStdString(img_filename.str()));
 
         delete[] hist_buffer;
+        delete[] hist_buffer_c;
     }
 
-    // generate basis images
-
-    // unsigned short *imgBuffer =
-    // new unsigned short[pixels*3];
-    vector<float> imgBuffer(pixels * 3);
-    vector<unsigned char> imgBuffer_c(pixels * 3);
+    // generate basis images: each one is computed and encoded on its own
+    // thread
+    struct BasisImage {
+        int segment;
+        int basis;
+        string file_name;
+    };
+    vector<BasisImage> basis_images;
     for (int k = 1; k <= f8_stops + 1; k++) {
-        float max_value =
-            (float)numeric_limits<unsigned char>::max();  //(1<<16) -1;
-
-        float exp_multip = log2f(1 / powf(2, l_start + k * 8));
-
         int max_basis = basis_no;
         if (k ==
             f8_stops +
@@ -732,29 +766,6 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
             max_basis = 1;
 
         for (int b = 0; b < max_basis; b++) {
-            UniformArrayLUT basis_lut(basis_table.rows, basis_table.data[0],
-                                      basis_table.data[b + 1]);
-
-            int i = 0;
-            for (int pix = 0; pix < pixels; pix++) {
-                float rgb[3];
-                rgb[0] = R[pix];
-                rgb[1] = G[pix];
-                rgb[2] = B[pix];
-
-                for (int c = 0; c < 3; c++) {
-                    float exposure_comp_v = rgb[c] + exp_multip;
-                    float v = (basis_lut.interp(exposure_comp_v) * max_value);
-                    imgBuffer[i++] = v;
-                }
-            }
-            for (int pix = 0; pix < pixels * 3; pix++) {
-                float r = imgBuffer[pix];
-                imgBuffer_c[pix] = (unsigned char)r;
-            }
-            QImage imImage(imgBuffer_c.data(), width, height,
-                           QImage::Format_RGB888);
-
             ostringstream img_filename;
             if (out_dir != nullptr) img_filename << out_dir << "/";
             if (image_dir != nullptr) img_filename << image_dir << "/";
@@ -762,8 +773,37 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
             if (verbose)
                 cout << QObject::tr("Writing: ").toStdString()
                      << img_filename.str() << endl;
-            imImage.save(QString::fromStdString(img_filename.str()));
+
+            BasisImage basis_image = {k, b, img_filename.str()};
+            basis_images.push_back(basis_image);
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int j = 0; j < (int)basis_images.size(); j++) {
+        const int k = basis_images[j].segment;
+        const int b = basis_images[j].basis;
+        const float max_value =
+            (float)numeric_limits<unsigned char>::max();  //(1<<16) -1;
+
+        const float exp_multip = log2f(1 / powf(2, l_start + k * 8));
+
+        const UniformArrayLUT basis_lut(basis_table.rows, basis_table.data[0],
+                                        basis_table.data[b + 1]);
+
+        vector<unsigned char> imgBuffer_c(pixels * 3);
+        unsigned char *out = imgBuffer_c.data();
+        for (int pix = 0; pix < pixels; pix++) {
+            const float rgb[3] = {R[pix], G[pix], B[pix]};
+            for (int c = 0; c < 3; c++) {
+                float exposure_comp_v = rgb[c] + exp_multip;
+                *out++ = (unsigned char)(basis_lut.interp(exposure_comp_v) *
+                                         max_value);
+            }
         }
+        QImage imImage(imgBuffer_c.data(), width, height, width * 3,
+                       QImage::Format_RGB888);
+        imImage.save(QString::fromStdString(basis_images[j].file_name));
     }
 
     HDRHTMLImage new_image(base_name, width, height);
@@ -779,7 +819,6 @@ void HDRHTMLSet::add_image(int width, int height, float *R, float *G, float *B,
 
     image_list.push_back(new_image);
 
-    locale::global(locale(user_locale.c_str()));
 }
 
 void print_image_objects(ostream &out, void *user_data, const char *parameter);
@@ -832,6 +871,7 @@ void HDRHTMLSet::generate_webpage(const char *page_template,
 
     if (object_output != nullptr) {
         ofstream oofs(object_output);
+        oofs.imbue(locale::classic());
         if (!oofs.good()) {
             ostringstream error_message;
             error_message << "Cannot open '" << object_output
@@ -847,6 +887,7 @@ void HDRHTMLSet::generate_webpage(const char *page_template,
 
     if (html_output != nullptr) {
         ofstream hofs(html_output);
+        hofs.imbue(locale::classic());
         if (!hofs.good()) {
             ostringstream error_message;
             error_message << "Cannot open '" << html_output << "' for writing";
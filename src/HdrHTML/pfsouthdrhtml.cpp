@@ -34,6 +34,7 @@
 #include <QObject>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include "hdrhtml-path.hxx"
 #include "Libpfs/frame.h"
@@ -41,6 +42,7 @@
 #include "Libpfs/colorspace/colorspace.h"
 #include "Libpfs/exception.h"
 #include "Libpfs/frame.h"
+#include "Libpfs/utils/msec_timer.h"
 #include "hdrhtml-path.hxx"
 
 using namespace hdrhtml;
@@ -80,26 +82,25 @@ void generate_hdrhtml(pfs::Frame *frame, string page_name, string out_dir,
         throw pfs::Exception(QObject::tr("nullptr frame passed.").toStdString());
     }
 
+#ifdef TIMER_PROFILING
+    msec_timer stop_watch;
+    stop_watch.start();
+#endif
+
     pfs::Channel *R, *G, *B;
     frame->getXYZChannels(R, G, B);
 
-    int size = frame->getWidth() * frame->getHeight();
-
     pfs::Array2Df X(frame->getWidth(), frame->getHeight());
     pfs::Array2Df Y(frame->getWidth(), frame->getHeight());
     pfs::Array2Df Z(frame->getWidth(), frame->getHeight());
 
     pfs::transformColorSpace(pfs::CS_RGB, R, G, B, pfs::CS_XYZ, &X, &Y, &Z);
 
-    float *R1 = new float[size];
-    float *G1 = new float[size];
-    float *B1 = new float[size];
-    float *Y1 = new float[size];
-
-    copy(R->begin(), R->end(), R1);
-    copy(G->begin(), G->end(), G1);
-    copy(B->begin(), B->end(), B1);
-    copy(Y.begin(), Y.end(), Y1);
+    // add_image() works in place
+    vector<float> R1(R->begin(), R->end());
+    vector<float> G1(G->begin(), G->end());
+    vector<float> B1(B->begin(), B->end());
+    vector<float> Y1(Y.begin(), Y.end());
     // Get base_name if needed
     string base_name;
     string tmp_str(page_name);
@@ -124,8 +125,8 @@ void generate_hdrhtml(pfs::Frame *frame, string page_name, string out_dir,
              << QObject::tr(" to the web page").toStdString() << endl;
 
     try {
-        image_set.add_image(frame->getWidth(), frame->getHeight(), R1, G1, B1,
-                            Y1, base_name.c_str(),
+        image_set.add_image(frame->getWidth(), frame->getHeight(), R1.data(),
+                            G1.data(), B1.data(), Y1.data(), base_name.c_str(),
                             out_dir.empty() ? nullptr : out_dir.c_str(), quality,
                             verbose);
     } catch (pfs::Exception &e) {
@@ -142,8 +143,10 @@ void generate_hdrhtml(pfs::Frame *frame, string page_name, string out_dir,
         throw;
     }
 
-    delete[] R1;
-    delete[] G1;
-    delete[] B1;
-    delete[] Y1;
+#ifdef TIMER_PROFILING
+    stop_watch.stop_and_update();
+    if (verbose)
+        cout << "generate_hdrhtml = " << stop_watch.get_time() << " msec"
+             << endl;
+#endif
 }
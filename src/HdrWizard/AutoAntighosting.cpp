@@ -27,7 +27,11 @@
 #include <stdlib.h>
 #include <boost/bind.hpp>
 #include <boost/math/constants/constants.hpp>
+#include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -38,7 +42,6 @@
 #include <Libpfs/frame.h>
 #include <Libpfs/manip/copy.h>
 #include <Libpfs/utils/minmax.h>
-#include <Libpfs/utils/msec_timer.h>
 
 #include "AutoAntighosting.h"
 // --- LEGACY CODE ---
@@ -49,29 +52,44 @@ float max(const Array2Df &u) { return *std::max_element(u.begin(), u.end()); }
 
 float min(const Array2Df &u) { return *std::min_element(u.begin(), u.end()); }
 
-void solve_pde_dct(Array2Df &F, Array2Df &U) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
+PdeDctPlan::PdeDctPlan(int width) : m_width(width) {
     // activate parallel execution of fft routines
     init_fftw();
 
+    std::vector<float> row(width);
+    std::lock_guard<std::mutex> lock(FFTW_MUTEX::fftw_mutex_plan);
+    m_plan = fftwf_plan_r2r_1d(width, row.data(), row.data(), FFTW_REDFT00,
+                               FFTW_ESTIMATE | FFTW_UNALIGNED);
+}
+
+PdeDctPlan::~PdeDctPlan() {
+    std::lock_guard<std::mutex> lock(FFTW_MUTEX::fftw_mutex_destroy_plan);
+    fftwf_destroy_plan(m_plan);
+}
+
+void PdeDctPlan::execute(float *row) const {
+    fftwf_execute_r2r(m_plan, row, row);
+}
+
+void solve_pde_dct(Array2Df &F, Array2Df &U) {
+    const PdeDctPlan plan(U.getCols());
+    solve_pde_dct(F, U, plan);
+}
+
+void solve_pde_dct(Array2Df &F, Array2Df &U, const PdeDctPlan &plan) {
     const int width = U.getCols();
     const int height = U.getRows();
     assert((int)F.getCols() == width && (int)F.getRows() == height);
+    assert(plan.width() == width);
 
     Array2Df Ftr(width, height);
 
-    FFTW_MUTEX::fftw_mutex_plan.lock();
-    fftwf_plan p = fftwf_plan_r2r_1d(width, F.data() + width,
-                              Ftr.data() + width, FFTW_REDFT00,
-                              FFTW_ESTIMATE);
-    FFTW_MUTEX::fftw_mutex_plan.unlock();
-
+    // the plan is in place: the rows are copied first
 #pragma omp parallel for
     for (int j = 0; j < height; j++) {
-        fftwf_execute_r2r(p, F.data() + width * j, Ftr.data() + width * j);
+        float *row = Ftr.data() + width * j;
+        std::copy(F.data() + width * j, F.data() + width * (j + 1), row);
+        plan.execute(row);
     }
 
 #pragma omp parallel
@@ -104,21 +122,12 @@ void solve_pde_dct(Array2Df &F, Array2Df &U) {
     const float invDivisor = 1.0f / (2.0f * (width - 1));
 #pragma omp parallel for
     for (int j = 0; j < height; j++) {
-        fftwf_execute_r2r(p, U.data() + width * j, U.data() + width * j);
+        plan.execute(U.data() + width * j);
 
         for (int i = 0; i < width; i++) {
             U(i, j) *= invDivisor;
         }
     }
-
-    FFTW_MUTEX::fftw_mutex_destroy_plan.lock();
-    fftwf_destroy_plan(p);
-    FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "solve_pde_dct = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 int findIndex(const float *data, int size) {
@@ -142,221 +151,197 @@ inline float hueMean(const BufferF &data) {
 }
 
 void hueSquaredMean(const HdrCreationItemContainer &data, vector<float> &HE) {
-    size_t width = data[0].frame()->getWidth();
-    size_t height = data[0].frame()->getHeight();
-    size_t numItems = data.size();
+    const int width = data[0].frame()->getWidth();
+    const int height = data[0].frame()->getHeight();
+    const size_t numItems = data.size();
 
-    float r, g, b, h, s, l;
+    vector<const Channel *> X(numItems), Y(numItems), Z(numItems);
+    for (size_t w = 0; w < numItems; w++) {
+        data[w].frame()->getXYZChannels(X[w], Y[w], Z[w]);
+    }
 
-    BufferF hues(numItems, 0.f);
-    BufferF HS(numItems, 0.f);
+    vector<double> HS(numItems, 0.0);
 
-    const Channel *X, *Y, *Z;
+#pragma omp parallel
+    {
+        BufferF hues(numItems, 0.f);
+        vector<double> threadHS(numItems, 0.0);
+        float h, s, l;
+
+#pragma omp for schedule(static) nowait
+        for (int j = 0; j < height; j++) {
+            for (int i = 0; i < width; i++) {
+                for (size_t w = 0; w < numItems; w++) {
+                    rgb2hsl((*X[w])(i, j), (*Y[w])(i, j), (*Z[w])(i, j), h, s,
+                            l);
+                    hues[w] = h;
+                }
 
-    for (size_t j = 0; j < height; j++) {
-        for (size_t i = 0; i < width; i++) {
-            for (size_t w = 0; w < numItems; w++) {
-                data[w].frame()->getXYZChannels(X, Y, Z);
+                float hueMean_ = hueMean(hues);
 
-                r = (*X)(i, j);
-                g = (*Y)(i, j);
-                b = (*Z)(i, j);
-                rgb2hsl(r, g, b, h, s, l);
-                hues[w] = h;
+                for (size_t w = 0; w < numItems; w++) {
+                    float H = hueMean_ - hues[w];
+                    threadHS[w] += H * H;
+                }
             }
+        }
 
-            float hueMean_ = hueMean(hues);
-
-            for (size_t w = 0; w < numItems; w++) {
-                float H = hueMean_ - hues[w];
-                HS[w] += H * H;
-            }
+#pragma omp critical
+        for (size_t w = 0; w < numItems; w++) {
+            HS[w] += threadHS[w];
         }
     }
 
     for (size_t w = 0; w < numItems; w++) {
-        HE[w] = HS[w] / (width * height);
+        HE[w] = HS[w] / (static_cast<double>(width) * height);
     }
 }
 
+namespace {
+//! \brief offset of the log ratio of the two exposures of a comparison
+inline float logShift(float deltaEV) {
+    const float logDeltaEV = log(std::abs(deltaEV));
+    return (deltaEV > 0) ? logDeltaEV : -logDeltaEV;
+}
+
+inline bool isClipped(float a, float b) {
+    return a >= 1.0f || b >= 1.0f || a <= 0.0f || b <= 0.0f;
+}
+}
+
 void sdv(const HdrCreationItem &item1, const HdrCreationItem &item2,
          const float deltaEV, const int dx, const int dy, float &sR, float &sG,
          float &sB) {
-    Channel *X1, *Y1, *Z1, *X2, *Y2, *Z2;
-    item1.frame()->getXYZChannels(X1, Y1, Z1);
-    item2.frame()->getXYZChannels(X2, Y2, Z2);
-    Array2Df &R1 = *X1;
-    Array2Df &G1 = *Y1;
-    Array2Df &B1 = *Z1;
-    Array2Df &R2 = *X2;
-    Array2Df &G2 = *Y2;
-    Array2Df &B2 = *Z2;
-
-    const size_t W = item1.frame()->getWidth();
-    const size_t H = item1.frame()->getHeight();
-
-    vector<float> logRed(W * H);
-    vector<float> logGreen(W * H);
-    vector<float> logBlue(W * H);
-
-    float logDeltaEV = log(std::abs(deltaEV));
-
-    int count = 0;
-    float mR = 0.0f;
-    float mG = 0.0f;
-    float mB = 0.0f;
-    for (size_t y = 0; y < H; y++) {
-        if (y + dy < 0 || y + dy > H - 1) continue;
-        for (size_t x = 0; x < W; x++) {
-            if (x + dx < 0 || x + dx > W - 1) continue;
-            if (R1(x, y) >= 1.0f || R2(x + dx, y + dy) >= 1.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
-                continue;
-            }
-            if (G1(x, y) >= 1.0f || G2(x + dx, y + dy) >= 1.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
-                continue;
-            }
-            if (B1(x, y) >= 1.0f || B2(x + dx, y + dy) >= 1.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
-                continue;
-            }
-            if (R1(x, y) <= 0.0f || R2(x + dx, y + dy) <= 0.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
-                continue;
-            }
-            if (G1(x, y) <= 0.0f || G2(x + dx, y + dy) <= 0.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
-                continue;
-            }
-            if (B1(x, y) <= 0.0f || B2(x + dx, y + dy) <= 0.0f) {
-                logRed[count] = 0.0f;
-                logGreen[count] = 0.0f;
-                logBlue[count++] = 0.0f;
+    const Channel *R1, *G1, *B1, *R2, *G2, *B2;
+    item1.frame()->getXYZChannels(R1, G1, B1);
+    item2.frame()->getXYZChannels(R2, G2, B2);
+
+    const int W = item1.frame()->getWidth();
+    const int H = item1.frame()->getHeight();
+    const float shift = logShift(deltaEV);
+
+    // mean and variance of the absolute log ratios in a single pass: clipped
+    // samples count as a null ratio
+    long count = 0;
+    double mR = 0.0, mG = 0.0, mB = 0.0;
+    double qR = 0.0, qG = 0.0, qB = 0.0;
+#pragma omp parallel for schedule(static) \
+    reduction(+ : count, mR, mG, mB, qR, qG, qB)
+    for (int y = std::max(0, -dy); y < std::min(H, H - dy); y++) {
+        for (int x = std::max(0, -dx); x < std::min(W, W - dx); x++) {
+            count++;
+            const float r1 = (*R1)(x, y), r2 = (*R2)(x + dx, y + dy);
+            const float g1 = (*G1)(x, y), g2 = (*G2)(x + dx, y + dy);
+            const float b1 = (*B1)(x, y), b2 = (*B2)(x + dx, y + dy);
+            if (isClipped(r1, r2) || isClipped(g1, g2) || isClipped(b1, b2)) {
                 continue;
             }
 
-            if (deltaEV > 0) {
-                logRed[count] =
-                    log(R1(x, y)) - log(R2(x + dx, y + dy)) - logDeltaEV;
-                logGreen[count] =
-                    log(G1(x, y)) - log(G2(x + dx, y + dy)) - logDeltaEV;
-                logBlue[count] =
-                    log(B1(x, y)) - log(B2(x + dx, y + dy)) - logDeltaEV;
-                mR += std::abs(logRed[count]);
-                mG += std::abs(logGreen[count]);
-                mB += std::abs(logBlue[count]);
-                count++;
-            } else {
-                logRed[count] =
-                    log(R1(x, y)) - log(R2(x + dx, y + dy)) + logDeltaEV;
-                logGreen[count] =
-                    log(G1(x, y)) - log(G2(x + dx, y + dy)) + logDeltaEV;
-                logBlue[count] =
-                    log(B1(x, y)) - log(B2(x + dx, y + dy)) + logDeltaEV;
-                mR += std::abs(logRed[count]);
-                mG += std::abs(logGreen[count]);
-                mB += std::abs(logBlue[count]);
-                count++;
-            }
+            const float lR = std::abs(log(r1) - log(r2) - shift);
+            const float lG = std::abs(log(g1) - log(g2) - shift);
+            const float lB = std::abs(log(b1) - log(b2) - shift);
+            mR += lR;
+            mG += lG;
+            mB += lB;
+            qR += lR * lR;
+            qG += lG * lG;
+            qB += lB * lB;
         }
     }
     mR /= count;
     mG /= count;
     mB /= count;
 
-    sR = 0.0f;
-    sG = 0.0f;
-    sB = 0.0f;
-    for (int i = 0; i < count; i++) {
-        sR += std::pow(std::abs(logRed[i]) - mR, 2.0f);
-        sG += std::pow(std::abs(logGreen[i]) - mG, 2.0f);
-        sB += std::pow(std::abs(logBlue[i]) - mB, 2.0f);
-    }
-    sR /= count;
-    sG /= count;
-    sB /= count;
-
-    sR = mR + std::sqrt(sR);
-    sG = mG + std::sqrt(sG);
-    sB = mB + std::sqrt(sB);
+    sR = mR + std::sqrt(std::max(0.0, qR / count - mR * mR));
+    sG = mG + std::sqrt(std::max(0.0, qG / count - mG * mG));
+    sB = mB + std::sqrt(std::max(0.0, qB / count - mB * mB));
 }
 
-bool comparePatches(const HdrCreationItem &item1, const HdrCreationItem &item2,
-                    const int i, const int j, const int gridX, const int gridY,
-                    const float threshold, const float sR, const float sG,
-                    const float sB, const float deltaEV, const int dx,
-                    const int dy) {
-    const int gridSize = gridX * gridY;
-    vector<float> logRed(gridSize);
-    vector<float> logGreen(gridSize);
-    vector<float> logBlue(gridSize);
-
-    Channel *X1, *Y1, *Z1, *X2, *Y2, *Z2;
-    item1.frame()->getXYZChannels(X1, Y1, Z1);
-    item2.frame()->getXYZChannels(X2, Y2, Z2);
-    Array2Df &R1 = *X1;
-    Array2Df &G1 = *Y1;
-    Array2Df &B1 = *Z1;
-    Array2Df &R2 = *X2;
-    Array2Df &G2 = *Y2;
-    Array2Df &B2 = *Z2;
-
-    float logDeltaEV = log(std::abs(deltaEV));
+namespace {
+//! \brief whether the share of outliers of patch (\a i, \a j) of \a exposure
+//! is above \a threshold
+//! \param logGood logarithm of the samples of the patch in the good exposure
+//! \note stops as soon as the outcome is known
+bool patchDiffers(const AgExposure &exposure, const vector<float> &logGood,
+                  const int i, const int j, const int gridX, const int gridY,
+                  const float threshold) {
+    const Channel *R2, *G2, *B2;
+    exposure.item->frame()->getXYZChannels(R2, G2, B2);
 
     const int width = gridX * agGridSize;
     const int height = gridY * agGridSize;
+    const float gridSize = static_cast<float>(gridX * gridY);
+    const float shift = logShift(exposure.deltaEV);
+    const float maxR = 2.0f * exposure.sR;
+    const float maxG = 2.0f * exposure.sG;
+    const float maxB = 2.0f * exposure.sB;
+    const int dx = exposure.dx;
+    const int dy = exposure.dy;
+
     int count = 0;
-    for (int y = j * gridY; y < (j + 1) * gridY; y++) {
-        if (y + dy < 0 || y + dy > height - 1) continue;
-        for (int x = i * gridX; x < (i + 1) * gridX; x++) {
-            if (x + dx < 0 || x + dx > width - 1) continue;
-            if (deltaEV > 0) {
-                logRed[count] =
-                    log(R1(x, y)) - log(R2(x + dx, y + dy)) - logDeltaEV;
-                logGreen[count] =
-                    log(G1(x, y)) - log(G2(x + dx, y + dy)) - logDeltaEV;
-                logBlue[count++] =
-                    log(B1(x, y)) - log(B2(x + dx, y + dy)) - logDeltaEV;
-            } else {
-                logRed[count] =
-                    log(R1(x, y)) - log(R2(x + dx, y + dy)) + logDeltaEV;
-                logGreen[count] =
-                    log(G1(x, y)) - log(G2(x + dx, y + dy)) + logDeltaEV;
-                logBlue[count++] =
-                    log(B1(x, y)) - log(B2(x + dx, y + dy)) + logDeltaEV;
+    for (int py = 0; py < gridY; py++) {
+        const int y = j * gridY + py;
+        if (y + dy >= 0 && y + dy <= height - 1) {
+            for (int px = 0; px < gridX; px++) {
+                const int x = i * gridX + px;
+                if (x + dx < 0 || x + dx > width - 1) continue;
+
+                const float *lg = &logGood[3 * (py * gridX + px)];
+                if (std::abs(lg[0] - log((*R2)(x + dx, y + dy)) - shift) > maxR ||
+                    std::abs(lg[1] - log((*G2)(x + dx, y + dy)) - shift) > maxG ||
+                    std::abs(lg[2] - log((*B2)(x + dx, y + dy)) - shift) > maxB) {
+                    count++;
+                }
             }
         }
-    }
 
-    count = 0;
-    for (int h = 0; h < gridSize; h++) {
-        if (std::abs(logRed[h]) > 2.0f * sR ||
-            std::abs(logGreen[h]) > 2.0f * sG ||
-            std::abs(logBlue[h]) > 2.0f * sB)
-            count++;
+        if (count / gridSize > threshold) return true;
+        const int left = (gridY - 1 - py) * gridX;
+        if ((count + left) / gridSize <= threshold) return false;
     }
+    return false;
+}
+}
+
+void findGhostPatches(const HdrCreationItem &good,
+                      const vector<AgExposure> &exposures, const int gridX,
+                      const int gridY, const float threshold,
+                      bool patches[agGridSize][agGridSize]) {
+    const Channel *R1, *G1, *B1;
+    good.frame()->getXYZChannels(R1, G1, B1);
 
-    return (static_cast<float>(count) / static_cast<float>(gridX * gridY)) >
-           threshold;
+#pragma omp parallel
+    {
+        vector<float> logGood(3 * gridX * gridY);
+
+#pragma omp for schedule(dynamic)
+        for (int p = 0; p < agGridSize * agGridSize; p++) {
+            const int i = p % agGridSize;
+            const int j = p / agGridSize;
+
+            // shared by the comparisons with all the exposures
+            for (int py = 0; py < gridY; py++) {
+                for (int px = 0; px < gridX; px++) {
+                    const int x = i * gridX + px;
+                    const int y = j * gridY + py;
+                    float *lg = &logGood[3 * (py * gridX + px)];
+                    lg[0] = log((*R1)(x, y));
+                    lg[1] = log((*G1)(x, y));
+                    lg[2] = log((*B1)(x, y));
+                }
+            }
+
+            // a ghost in any exposure is enough
+            patches[i][j] = false;
+            for (size_t e = 0; e < exposures.size() && !patches[i][j]; e++) {
+                patches[i][j] = patchDiffers(exposures[e], logGood, i, j,
+                                             gridX, gridY, threshold);
+            }
+        }
+    }
 }
 
 void computeIrradiance(Array2Df &irradiance, const Array2Df &in) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
-
     const int width = in.getCols();
     const int height = in.getRows();
 
@@ -365,18 +350,9 @@ void computeIrradiance(Array2Df &irradiance, const Array2Df &in) {
         irradiance(i) = std::exp(in(i));
     }
 
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "computeIrradiance = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void computeLogIrradiance(Array2Df &logIrradiance, const Array2Df &u) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
     const int width = u.getCols();
     const int height = u.getRows();
 
@@ -392,20 +368,10 @@ void computeLogIrradiance(Array2Df &logIrradiance, const Array2Df &u) {
         logIrradiance(i) = logIr;
     }
 
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "computeLogIrradiance = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void computeGradient(Array2Df &gradientX, Array2Df &gradientY,
                      const Array2Df &in) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
-
     const int width = in.getCols();
     const int height = in.getRows();
 
@@ -436,19 +402,10 @@ void computeGradient(Array2Df &gradientX, Array2Df &gradientY,
         gradientX(width - 1, height - 1) = 0.0f;
     gradientY(0, 0) = gradientY(0, height - 1) = gradientY(width - 1, 0) =
         gradientY(width - 1, height - 1) = 0.0f;
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "computeGradient = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void computeDivergence(Array2Df &divergence, const Array2Df &gradientX,
                        const Array2Df &gradientY) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
     const int width = gradientX.getCols();
     const int height = gradientX.getRows();
 
@@ -478,11 +435,6 @@ void computeDivergence(Array2Df &divergence, const Array2Df &gradientX,
                 (gradientX(i + 1, height - 1) - gradientX(i - 1, height - 1)) +
             gradientY(i, height - 1) - gradientY(i, height - 2);
     }
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "computeDivergence = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void blendGradients(Array2Df &gradientXBlended, Array2Df &gradientYBlended,
@@ -491,10 +443,6 @@ void blendGradients(Array2Df &gradientXBlended, Array2Df &gradientYBlended,
                     const Array2Df &gradientYGood,
                     bool patches[agGridSize][agGridSize], const int gridX,
                     const int gridY) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
     int width = gradientX.getCols();
     int height = gradientY.getRows();
 
@@ -533,21 +481,12 @@ void blendGradients(Array2Df &gradientXBlended, Array2Df &gradientYBlended,
             }
         }
     }
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "blendGradients = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void blendGradients(Array2Df &gradientXBlended, Array2Df &gradientYBlended,
                     const Array2Df &gradientX, const Array2Df &gradientY,
                     const Array2Df &gradientXGood,
                     const Array2Df &gradientYGood, const QImage &agMask) {
-#ifdef TIMER_PROFILING
-    msec_timer stop_watch;
-    stop_watch.start();
-#endif
     int width = gradientX.getCols();
     int height = gradientY.getRows();
 
@@ -563,11 +502,6 @@ void blendGradients(Array2Df &gradientXBlended, Array2Df &gradientYBlended,
             }
         }
     }
-#ifdef TIMER_PROFILING
-    stop_watch.stop_and_update();
-    std::cout << "blendGradients = " << stop_watch.get_time() << " msec"
-              << std::endl;
-#endif
 }
 
 void colorBalance(pfs::Array2Df &U, const pfs::Array2Df &F, const int x,
@@ -28,6 +28,8 @@
 
 #include "HdrCreationItem.h"
 
+struct fftwf_plan_s;
+
 #define agGridSize 40
 
 using namespace std;
@@ -35,7 +37,27 @@ using namespace pfs;
 
 float max(const Array2Df &u);
 float min(const Array2Df &u);
+
+//! \brief in place DCT-I of the rows of solve_pde_dct, for frames of one
+//! width: the channels of a frame share it
+class PdeDctPlan {
+   public:
+    explicit PdeDctPlan(int width);
+    ~PdeDctPlan();
+
+    int width() const { return m_width; }
+    void execute(float *row) const;
+
+   private:
+    PdeDctPlan(const PdeDctPlan &);
+    PdeDctPlan &operator=(const PdeDctPlan &);
+
+    int m_width;
+    fftwf_plan_s *m_plan;
+};
+
 void solve_pde_dct(Array2Df &F, Array2Df &U);
+void solve_pde_dct(Array2Df &F, Array2Df &U, const PdeDctPlan &plan);
 void clampToZero(Array2Df &R, Array2Df &G, Array2Df &B, float m);
 int findIndex(const float *data, int size);
 void hueSquaredMean(const HdrCreationItemContainer &data, vector<float> &HE);
@@ -43,11 +65,23 @@ void sdv(const HdrCreationItem &item1, const HdrCreationItem &item2,
          const float deltaEV, const int dx, const int dy, float &sR, float &sG,
          float &sB);
 
-bool comparePatches(const HdrCreationItem &item1, const HdrCreationItem &item2,
-                    const int i, const int j, const int gridX, const int gridY,
-                    const float threshold, const float sR, const float sG,
-                    const float sB, const float deltaEV, const int dx,
-                    const int dy);
+//! \brief an exposure compared with the good one by findGhostPatches
+struct AgExposure {
+    const HdrCreationItem *item;
+    //! difference of average luminance with the good exposure, in EV
+    float deltaEV;
+    //! offset with the good exposure
+    int dx, dy;
+    //! outlier thresholds of the log ratios, computed by sdv()
+    float sR, sG, sB;
+};
+
+//! \brief mark the patches of the grid where the share of outliers of any of
+//! \a exposures, compared with \a good, is above \a threshold
+void findGhostPatches(const HdrCreationItem &good,
+                      const vector<AgExposure> &exposures, const int gridX,
+                      const int gridY, const float threshold,
+                      bool patches[agGridSize][agGridSize]);
 
 void computeIrradiance(Array2Df &irradiance, const Array2Df &in);
 void computeLogIrradiance(Array2Df &logIrradiance, const Array2Df &u);
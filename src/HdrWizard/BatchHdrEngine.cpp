@@ -0,0 +1,371 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <HdrWizard/BatchHdrEngine.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QList>
+#include <QMutexLocker>
+#include <QPair>
+#include <QRunnable>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+#include <Common/CommonFunctions.h>
+#include <Common/ProgressHelper.h>
+#include <Core/IOWorker.h>
+#include <HdrWizard/HdrCreationManager.h>
+#include <Libpfs/frame.h>
+
+namespace {
+//! one bracket per stage of the pipeline
+const int MAX_IN_FLIGHT = 3;
+//! share of the available memory left to the rest of the system
+const size_t MEMORY_FACTOR = 2;
+
+//! \return memory held by a loaded bracket until it is fused: the input
+//! frames, their previews, the HDR and the buffers of the fusion
+size_t bracketBytes(const HdrCreationManager &manager) {
+    size_t bytes = 0;
+    size_t frameBytes = 0;
+    for (const HdrCreationItem &item : manager) {
+        frameBytes = item.frame()->getWidth() * item.frame()->getHeight() * 3 *
+                     sizeof(float);
+        bytes += frameBytes + item.qimage().width() * item.qimage().height() * 4;
+    }
+    return bytes + 2 * frameBytes;
+}
+}
+
+//! \brief A bracket moving through the pipeline
+//! \note Whichever stage drops it completes it: its token is given back and
+//! the engine is told, even when the bracket failed or was canceled.
+struct BatchHdrEngine::Bracket {
+    Bracket(BatchHdrEngine *engine, const QStringList &files,
+            const QString &outName)
+        : engine(engine),
+          files(files),
+          outName(outName),
+          config(engine->m_Config),
+          alignment(engine->m_Alignment),
+          agThreshold(engine->m_AgThreshold),
+          responseSampleSize(engine->m_ResponseSampleSize),
+          responseCache(engine->m_ResponseCache),
+          params(engine->m_Params),
+          hasToken(false) {}
+
+    ~Bracket() {
+        manager.reset();
+        hdr.reset();
+        engine->bracketFinished(hasToken);
+    }
+
+    BatchHdrEngine *engine;
+    QStringList files;
+    QString outName;
+    FusionOperatorConfig config;
+    Alignment alignment;
+    float agThreshold;
+    int responseSampleSize;
+    bool responseCache;
+    pfs::Params params;
+    bool hasToken;
+
+    std::unique_ptr<HdrCreationManager> manager;
+    std::unique_ptr<pfs::Frame> hdr;
+};
+
+//! \brief Write the HDR of a bracket, on the save pool
+class BatchHdrEngine::SaveJob : public QRunnable {
+   public:
+    explicit SaveJob(std::unique_ptr<Bracket> bracket)
+        : m_Bracket(std::move(bracket)) {}
+
+    void run() override {
+        BatchHdrEngine *engine = m_Bracket->engine;
+        if (engine->m_Canceled.load()) return;
+
+        bool status;
+        try {
+            IOWorker io_worker;
+            status = io_worker.write_hdr_frame(
+                m_Bracket->hdr.get(), m_Bracket->outName, m_Bracket->params);
+        } catch (...) {
+            status = false;
+        }
+
+        if (status) {
+            emit engine->bracketWritten(m_Bracket->outName);
+        } else {
+            emit engine->bracketFailed(
+                BatchHdrEngine::tr("Cannot save to file: %1")
+                    .arg(m_Bracket->outName));
+        }
+    }
+
+   private:
+    std::unique_ptr<Bracket> m_Bracket;
+};
+
+//! \brief Align and fuse a loaded bracket, on the fuse pool
+class BatchHdrEngine::FuseJob : public QRunnable {
+   public:
+    explicit FuseJob(std::unique_ptr<Bracket> bracket)
+        : m_Bracket(std::move(bracket)) {}
+
+    void run() override {
+        BatchHdrEngine *engine = m_Bracket->engine;
+        HdrCreationManager &manager = *m_Bracket->manager;
+        if (engine->m_Canceled.load()) return;
+
+        const QStringList filesLackingExif = manager.getFilesWithoutExif();
+        if (!filesLackingExif.isEmpty()) {
+            emit engine->bracketFailed(
+                BatchHdrEngine::tr("Missing EXIF data: %1")
+                    .arg(filesLackingExif.join(QStringLiteral(", "))));
+            return;
+        }
+
+        const size_t size = manager.availableInputFiles();
+        try {
+            if (m_Bracket->alignment == MTB_ALIGNMENT && size > 1) {
+                manager.align_with_mtb();
+            }
+            if (engine->m_Canceled.load()) return;
+
+            if (m_Bracket->agThreshold > 0.f && size > 1) {
+                QList<QPair<int, int>> HV_offsets;
+                for (size_t i = 0; i < size; ++i) {
+                    HV_offsets.append(qMakePair(0, 0));
+                }
+                bool patches[agGridSize][agGridSize];
+                float patchesPercent;
+                const int h0 = manager.computePatches(
+                    m_Bracket->agThreshold, patches, patchesPercent,
+                    HV_offsets);
+
+                ProgressHelper ph;
+                engine->addRunning(&ph);
+                // false means auto anti-ghosting
+                m_Bracket->hdr.reset(
+                    manager.doAntiGhosting(patches, h0, false, &ph));
+                engine->removeRunning(&ph);
+            } else {
+                m_Bracket->hdr.reset(manager.createHdr());
+            }
+        } catch (std::exception &e) {
+            emit engine->bracketFailed(QString::fromLocal8Bit(e.what()));
+            return;
+        }
+
+        // the input frames are not needed anymore
+        m_Bracket->manager.reset();
+
+        if (!m_Bracket->hdr) {
+            if (!engine->m_Canceled.load()) {
+                emit engine->bracketFailed(
+                    BatchHdrEngine::tr("Cannot create the HDR of %1")
+                        .arg(QFileInfo(m_Bracket->outName).fileName()));
+            }
+            return;
+        }
+
+        engine->m_SavePool.start(new SaveJob(std::move(m_Bracket)));
+    }
+
+   private:
+    std::unique_ptr<Bracket> m_Bracket;
+};
+
+//! \brief Load the files of a bracket, on the load pool
+class BatchHdrEngine::LoadJob : public QRunnable {
+   public:
+    explicit LoadJob(Bracket *bracket) : m_Bracket(bracket) {}
+
+    void run() override {
+        BatchHdrEngine *engine = m_Bracket->engine;
+        if (engine->m_Canceled.load()) return;
+
+        // wait for the memory of a bracket
+        engine->m_InFlight.acquire();
+        m_Bracket->hasToken = true;
+        if (engine->m_Canceled.load()) return;
+
+        m_Bracket->manager.reset(new HdrCreationManager(true));
+        HdrCreationManager &manager = *m_Bracket->manager;
+        QObject::connect(&manager, &HdrCreationManager::errorWhileLoading,
+                         engine, &BatchHdrEngine::bracketFailed,
+                         Qt::DirectConnection);
+
+        manager.setConfig(m_Bracket->config);
+        manager.setResponseSampleSize(m_Bracket->responseSampleSize);
+        manager.setResponseCacheEnabled(m_Bracket->responseCache);
+        if (!manager.loadFilesAndWait(m_Bracket->files)) return;
+
+        engine->setBudget(bracketBytes(manager));
+
+        // the manager is used and destroyed by the next stages, which run
+        // on other threads: detach it from this one
+        manager.moveToThread(nullptr);
+        engine->m_FusePool.start(new FuseJob(std::move(m_Bracket)));
+    }
+
+   private:
+    std::unique_ptr<Bracket> m_Bracket;
+};
+
+BatchHdrEngine::BatchHdrEngine(QObject *parent)
+    : QObject(parent),
+      m_Alignment(NO_ALIGNMENT),
+      m_AgThreshold(0.f),
+      m_ResponseSampleSize(0),
+      m_ResponseCache(false),
+      m_InFlight(1),
+      m_Budgeted(false),
+      m_Canceled(0),
+      m_Pending(0) {
+    m_Config = predef_confs[0];
+
+    m_LoadPool.setMaxThreadCount(1);
+    m_FusePool.setMaxThreadCount(1);
+    m_SavePool.setMaxThreadCount(1);
+}
+
+BatchHdrEngine::~BatchHdrEngine() {
+    cancel();
+    waitForDone();
+}
+
+void BatchHdrEngine::enqueue(const QStringList &files, const QString &outName) {
+    {
+        QMutexLocker locker(&m_Mutex);
+        // a new run starts when the engine is idle: the brackets enqueued
+        // while a canceled run drains are canceled too
+        if (m_Pending++ == 0) m_Canceled.store(0);
+    }
+    m_LoadPool.start(new LoadJob(new Bracket(this, files, outName)));
+}
+
+void BatchHdrEngine::waitForDone() {
+    // a stage hands its bracket over to the next one before finishing
+    m_LoadPool.waitForDone();
+    m_FusePool.waitForDone();
+    m_SavePool.waitForDone();
+}
+
+void BatchHdrEngine::cancel() {
+    m_Canceled.store(1);
+
+    // the dropped jobs complete their brackets, giving their tokens back to
+    // a load job possibly waiting for one
+    m_LoadPool.clear();
+    m_FusePool.clear();
+    m_SavePool.clear();
+
+    QMutexLocker locker(&m_Mutex);
+    foreach (ProgressHelper *ph, m_Running) {
+        ph->qtCancel();
+    }
+}
+
+QStringList BatchHdrEngine::inputFiles(const QString &dir) {
+    QStringList filters;
+    filters << QStringLiteral("*.jpg") << QStringLiteral("*.jpeg")
+            << QStringLiteral("*.tiff") << QStringLiteral("*.tif")
+            << QStringLiteral("*.crw") << QStringLiteral("*.cr2")
+            << QStringLiteral("*.nef") << QStringLiteral("*.dng")
+            << QStringLiteral("*.mrw") << QStringLiteral("*.orf")
+            << QStringLiteral("*.kdc") << QStringLiteral("*.dcr")
+            << QStringLiteral("*.arw") << QStringLiteral("*.raf")
+            << QStringLiteral("*.ptx") << QStringLiteral("*.pef")
+            << QStringLiteral("*.x3f") << QStringLiteral("*.raw")
+            << QStringLiteral("*.rw2") << QStringLiteral("*.sr2")
+            << QStringLiteral("*.3fr") << QStringLiteral("*.mef")
+            << QStringLiteral("*.mos") << QStringLiteral("*.erf")
+            << QStringLiteral("*.nrw") << QStringLiteral("*.srw");
+    filters << QStringLiteral("*.JPG") << QStringLiteral("*.JPEG")
+            << QStringLiteral("*.TIFF") << QStringLiteral("*.TIF")
+            << QStringLiteral("*.CRW") << QStringLiteral("*.CR2")
+            << QStringLiteral("*.NEF") << QStringLiteral("*.DNG")
+            << QStringLiteral("*.MRW") << QStringLiteral("*.ORF")
+            << QStringLiteral("*.KDC") << QStringLiteral("*.DCR")
+            << QStringLiteral("*.ARW") << QStringLiteral("*.RAF")
+            << QStringLiteral("*.PTX") << QStringLiteral("*.PEF")
+            << QStringLiteral("*.X3F") << QStringLiteral("*.RAW")
+            << QStringLiteral("*.RW2") << QStringLiteral("*.SR2")
+            << QStringLiteral("*.3FR") << QStringLiteral("*.MEF")
+            << QStringLiteral("*.MOS") << QStringLiteral("*.ERF")
+            << QStringLiteral("*.NRW") << QStringLiteral("*.SRW");
+
+    QDir chosenInputDir(dir);
+    chosenInputDir.setFilter(QDir::Files);
+    chosenInputDir.setSorting(QDir::Name);
+    chosenInputDir.setNameFilters(filters);
+
+    QStringList files;
+    foreach (const QString &file, chosenInputDir.entryList()) {
+        files << chosenInputDir.path() + "/" + file;
+    }
+    return files;
+}
+
+void BatchHdrEngine::setBudget(size_t bracketBytes) {
+    QMutexLocker locker(&m_Mutex);
+    if (m_Budgeted) return;
+    m_Budgeted = true;
+
+    // the first bracket is already in memory
+    const size_t available = getAvailableMemory();
+    int extra = 0;
+    if (available != 0 && bracketBytes != 0) {
+        extra = static_cast<int>(std::min<size_t>(
+            MAX_IN_FLIGHT - 1, available / (MEMORY_FACTOR * bracketBytes)));
+    }
+    qDebug() << "BatchHdrEngine::setBudget(): brackets in flight ="
+             << extra + 1;
+    m_InFlight.release(extra);
+}
+
+void BatchHdrEngine::bracketFinished(bool hasToken) {
+    if (hasToken) m_InFlight.release();
+    emit bracketDone();
+
+    bool last;
+    {
+        QMutexLocker locker(&m_Mutex);
+        last = --m_Pending == 0;
+    }
+    if (last) emit finished();
+}
+
+void BatchHdrEngine::addRunning(ProgressHelper *ph) {
+    QMutexLocker locker(&m_Mutex);
+    m_Running.insert(ph);
+    if (m_Canceled.load()) ph->qtCancel();
+}
+
+void BatchHdrEngine::removeRunning(ProgressHelper *ph) {
+    QMutexLocker locker(&m_Mutex);
+    m_Running.remove(ph);
+}
@@ -0,0 +1,119 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef BATCHHDRENGINE_H
+#define BATCHHDRENGINE_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <HdrCreation/createhdr.h>
+#include <Libpfs/params.h>
+
+class ProgressHelper;
+
+//! \brief Create the HDRs of a sequence of brackets
+//! \note The brackets go through a pipeline of three stages, one thread each:
+//! loading (the files of a bracket are decoded in parallel), alignment and
+//! fusion, saving. Bracket k+1 is decoded while bracket k is fused and
+//! bracket k-1 is written. How many brackets can be in flight at the same
+//! time is decided once the first one is loaded, against the memory
+//! available.
+class BatchHdrEngine : public QObject {
+    Q_OBJECT
+
+   public:
+    enum Alignment { NO_ALIGNMENT, MTB_ALIGNMENT };
+
+    explicit BatchHdrEngine(QObject *parent = 0);
+    //! \note cancels the brackets not written yet
+    ~BatchHdrEngine();
+
+    //! \brief settings of the brackets queued from now on
+    void setConfig(const FusionOperatorConfig &cfg) { m_Config = cfg; }
+    void setAlignment(Alignment alignment) { m_Alignment = alignment; }
+    //! \brief auto anti-ghosting with \a threshold, disabled if not positive
+    void setAntiGhosting(float threshold) { m_AgThreshold = threshold; }
+    void setParams(const pfs::Params &params) { m_Params = params; }
+    //! \brief Robertson02 response estimation, see HdrCreationManager
+    void setResponseSampleSize(int samples) { m_ResponseSampleSize = samples; }
+    void setResponseCacheEnabled(bool b) { m_ResponseCache = b; }
+
+    //! \brief queue the creation of the HDR of \a files, saved to \a outName
+    //! \note a canceled engine accepts new brackets once it has finished
+    void enqueue(const QStringList &files, const QString &outName);
+
+    //! \brief wait for all the queued brackets
+    void waitForDone();
+
+    //! \return images of \a dir that can be part of a bracket, sorted by name
+    static QStringList inputFiles(const QString &dir);
+
+   public Q_SLOTS:
+    //! \brief drop the queued brackets and interrupt the running ones
+    void cancel();
+
+   Q_SIGNALS:
+    void bracketWritten(const QString &outName);
+    void bracketFailed(const QString &message);
+    //! \brief emitted once per queued bracket, whatever its outcome
+    void bracketDone();
+    //! \brief emitted when no queued bracket is left
+    void finished();
+
+   private:
+    struct Bracket;
+    class LoadJob;
+    class FuseJob;
+    class SaveJob;
+
+    void setBudget(size_t bracketBytes);
+    void bracketFinished(bool hasToken);
+
+    void addRunning(ProgressHelper *ph);
+    void removeRunning(ProgressHelper *ph);
+
+    FusionOperatorConfig m_Config;
+    Alignment m_Alignment;
+    float m_AgThreshold;
+    int m_ResponseSampleSize;
+    bool m_ResponseCache;
+    pfs::Params m_Params;
+
+    QThreadPool m_LoadPool;
+    QThreadPool m_FusePool;
+    QThreadPool m_SavePool;
+    //! one token per bracket in flight, from its loading to its saving
+    QSemaphore m_InFlight;
+    bool m_Budgeted;
+
+    QAtomicInt m_Canceled;
+    QMutex m_Mutex;
+    int m_Pending;
+    QSet<ProgressHelper *> m_Running;
+};
+
+#endif  // BATCHHDRENGINE_H
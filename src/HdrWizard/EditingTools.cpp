@@ -314,16 +314,19 @@ void EditingTools::cropStack() {
     // relationship with the pixel coordinates.
     origSize();
 
-    m_hcm->applyShiftsToItems(m_HV_offsets);
+    const QList<QPair<int, int>> offsets = m_HV_offsets;
     resetAll();
     QRect ca = m_previewWidget->getSelectionRect();
-    if (ca.width() <= 0 || ca.height() <= 0) return;
+    if (ca.width() <= 0 || ca.height() <= 0) {
+        m_hcm->applyShiftsToItems(offsets);
+        return;
+    }
 
     QImage *tmp = m_previewWidget->getMask();
     delete m_antiGhostingMasksList[m_currentAgMaskIndex];
     m_antiGhostingMasksList.replace(m_currentAgMaskIndex, tmp);
     cropAgMasks(ca);
-    m_hcm->cropItems(ca);
+    m_hcm->cropItems(ca, offsets);
     m_originalImagesList.clear();
     HdrCreationItemContainer data = m_hcm->getData();
     for (HdrCreationItemContainer::iterator it = data.begin(),
@@ -0,0 +1,239 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "ExifIndex.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+#include <Libpfs/exif/exifdata.hpp>
+
+#include "SettingsConnection.h"
+
+namespace {
+
+//! EVs closer than this are the same exposure (brackets use 1/3 EV steps
+//! at least)
+const float EV_TOLERANCE = 0.15f;
+
+const QString CREATE_TABLE = QStringLiteral(
+    " CREATE TABLE IF NOT EXISTS exif_index (path varchar(1024) NOT NULL, \
+    size integer, modified integer, timestamp real, luminance real, \
+    exposure real, fnumber real, iso real, width integer, height integer, \
+    PRIMARY KEY (path));");
+
+//! \brief read the EXIF data of a file, no pixel is decoded
+struct ReadEntry {
+    typedef ExifIndex::Entry result_type;
+
+    ExifIndex::Entry operator()(const ExifIndex::Entry &stale) const {
+        ExifIndex::Entry entry(stale);
+        pfs::exif::ExifData exifData(
+            QFile::encodeName(entry.fileName).constData());
+
+        entry.timestamp = exifData.getTimestamp();
+        entry.averageLuminance = exifData.getAverageSceneLuminance();
+        entry.exposureTime = exifData.getExposureTime();
+        entry.fNumber = exifData.getFNumber();
+        entry.iso = exifData.getIsoSpeed();
+        entry.width = exifData.getWidth();
+        entry.height = exifData.getHeight();
+        return entry;
+    }
+};
+
+bool sameSettings(const ExifIndex::Entry &a, const ExifIndex::Entry &b) {
+    return a.iso == b.iso &&
+           std::fabs(a.fNumber - b.fNumber) <= 0.01f * std::fabs(a.fNumber) &&
+           a.width == b.width && a.height == b.height;
+}
+
+}  // anonymous
+
+ExifIndex::Entry::Entry()
+    : fileSize(-1),
+      modified(-1),
+      timestamp(-1.),
+      averageLuminance(-1.f),
+      exposureTime(-1.f),
+      fNumber(-1.f),
+      iso(-1.f),
+      width(0),
+      height(0) {}
+
+float ExifIndex::Entry::getEV() const { return std::log2(averageLuminance); }
+
+QVector<ExifIndex::Entry> ExifIndex::scan(const QStringList &files) {
+    QVector<Entry> entries(files.size());
+    QVector<int> stale;
+
+    SettingsConnection connection(QStringLiteral("ExifIndex"), CREATE_TABLE);
+    QSqlQuery select(connection.database());
+    if (connection.isOpen()) {
+        select.prepare(QStringLiteral(
+            "SELECT size, modified, timestamp, luminance, exposure, fnumber, "
+            "iso, width, height FROM exif_index WHERE path = :path;"));
+    }
+
+    for (int i = 0; i < files.size(); ++i) {
+        Entry &entry = entries[i];
+        QFileInfo fi(files[i]);
+        entry.fileName = files[i];
+        entry.fileSize = fi.size();
+        entry.modified = fi.lastModified().toMSecsSinceEpoch();
+
+        bool found = false;
+        if (connection.isOpen()) {
+            select.bindValue(QStringLiteral(":path"), fi.absoluteFilePath());
+            if (select.exec() && select.next() &&
+                select.value(0).toLongLong() == entry.fileSize &&
+                select.value(1).toLongLong() == entry.modified) {
+                entry.timestamp = select.value(2).toDouble();
+                entry.averageLuminance = select.value(3).toFloat();
+                entry.exposureTime = select.value(4).toFloat();
+                entry.fNumber = select.value(5).toFloat();
+                entry.iso = select.value(6).toFloat();
+                entry.width = select.value(7).toInt();
+                entry.height = select.value(8).toInt();
+                found = true;
+            }
+            select.finish();
+        }
+        if (!found) stale.push_back(i);
+    }
+
+    qDebug() << "ExifIndex::scan():" << stale.size() << "of" << files.size()
+             << "files to read";
+    if (stale.isEmpty()) return entries;
+
+    QVector<Entry> toRead;
+    toRead.reserve(stale.size());
+    foreach (int i, stale) {
+        toRead.push_back(entries[i]);
+    }
+    const QVector<Entry> read = QtConcurrent::blockingMapped<QVector<Entry>>(
+        toRead, ReadEntry());
+    for (int j = 0; j < stale.size(); ++j) {
+        entries[stale[j]] = read[j];
+    }
+
+    if (!connection.isOpen()) return entries;
+
+    QSqlDatabase db = connection.database();
+    db.transaction();
+    QSqlQuery insert(db);
+    insert.prepare(QStringLiteral(
+        "INSERT OR REPLACE INTO exif_index (path, size, modified, timestamp, "
+        "luminance, exposure, fnumber, iso, width, height) VALUES (:path, "
+        ":size, :modified, :timestamp, :luminance, :exposure, :fnumber, :iso, "
+        ":width, :height);"));
+    foreach (const Entry &entry, read) {
+        insert.bindValue(QStringLiteral(":path"),
+                         QFileInfo(entry.fileName).absoluteFilePath());
+        insert.bindValue(QStringLiteral(":size"), entry.fileSize);
+        insert.bindValue(QStringLiteral(":modified"), entry.modified);
+        insert.bindValue(QStringLiteral(":timestamp"), entry.timestamp);
+        insert.bindValue(QStringLiteral(":luminance"), entry.averageLuminance);
+        insert.bindValue(QStringLiteral(":exposure"), entry.exposureTime);
+        insert.bindValue(QStringLiteral(":fnumber"), entry.fNumber);
+        insert.bindValue(QStringLiteral(":iso"), entry.iso);
+        insert.bindValue(QStringLiteral(":width"), entry.width);
+        insert.bindValue(QStringLiteral(":height"), entry.height);
+        if (!insert.exec()) {
+            qDebug() << insert.lastError();
+            db.rollback();
+            return entries;
+        }
+    }
+    db.commit();
+    return entries;
+}
+
+QList<QStringList> ExifIndex::groupBrackets(const QVector<Entry> &entries,
+                                            QStringList *withoutEV,
+                                            double maxGap) {
+    QVector<const Entry *> sorted;
+    sorted.reserve(entries.size());
+    bool timestamps = true;
+    foreach (const Entry &entry, entries) {
+        sorted.push_back(&entry);
+        timestamps = timestamps && entry.timestamp >= 0.;
+    }
+    // without a timestamp for every image, keep the order of the caller
+    if (timestamps) {
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Entry *a, const Entry *b) {
+                             if (a->timestamp != b->timestamp)
+                                 return a->timestamp < b->timestamp;
+                             return a->fileName < b->fileName;
+                         });
+    }
+
+    QList<QStringList> brackets;
+    QVector<const Entry *> current;
+    const auto flush = [&]() {
+        if (current.isEmpty()) return;
+        QStringList bracket;
+        foreach (const Entry *entry, current) {
+            bracket << entry->fileName;
+        }
+        brackets << bracket;
+        current.clear();
+    };
+
+    foreach (const Entry *entry, sorted) {
+        if (!entry->hasEV()) {
+            if (withoutEV) *withoutEV << entry->fileName;
+            continue;
+        }
+
+        bool split = current.isEmpty() || !sameSettings(*current.back(), *entry);
+        if (!split && timestamps) {
+            const Entry *previous = current.back();
+            const double end =
+                previous->timestamp + std::max(0.f, previous->exposureTime);
+            split = entry->timestamp - end > maxGap;
+        }
+        if (!split) {
+            const float ev = entry->getEV();
+            foreach (const Entry *other, current) {
+                if (std::fabs(other->getEV() - ev) < EV_TOLERANCE) {
+                    split = true;
+                    break;
+                }
+            }
+        }
+
+        if (split) flush();
+        current.push_back(entry);
+    }
+    flush();
+    return brackets;
+}
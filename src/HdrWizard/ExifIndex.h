@@ -0,0 +1,75 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef EXIFINDEX_H
+#define EXIFINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+//! \brief EXIF metadata of the input images, read without decoding a pixel
+//! and kept in the settings database, so that planning a batch over
+//! thousands of files only reads the files added or modified since the last
+//! scan.
+class ExifIndex {
+   public:
+    struct Entry {
+        Entry();
+
+        bool hasEV() const { return averageLuminance > 0.f; }
+        //! \brief EV, as HdrCreationItem::getEV()
+        float getEV() const;
+
+        QString fileName;
+        qint64 fileSize;
+        //! last modification, in ms since the epoch
+        qint64 modified;
+
+        //! seconds since the epoch of the camera clock, negative if unknown
+        double timestamp;
+        //! average scene luminance, negative if unknown
+        float averageLuminance;
+        float exposureTime;
+        float fNumber;
+        float iso;
+        int width;
+        int height;
+    };
+
+    //! \brief metadata of \a files, in the same order
+    //! \note The files missing from the index, or changed since they were
+    //! indexed, are read in parallel and stored back in a single transaction.
+    static QVector<Entry> scan(const QStringList &files);
+
+    //! \brief split \a entries into brackets
+    //! \note The entries are sorted by timestamp (by name when it is
+    //! missing). A new bracket starts when the gap from the end of the
+    //! previous exposure is longer than \a maxGap seconds, when ISO, aperture
+    //! or size change, or when the EV of an image is already in the current
+    //! bracket. Images without EV cannot be fused: they are left out of the
+    //! brackets and appended to \a withoutEV, if not null.
+    static QList<QStringList> groupBrackets(const QVector<Entry> &entries,
+                                            QStringList *withoutEV = nullptr,
+                                            double maxGap = 2.0);
+};
+
+#endif  // EXIFINDEX_H
@@ -47,6 +47,7 @@
 #include <Libpfs/colorspace/convert.h>
 #include <Libpfs/colorspace/normalizer.h>
 #include <Libpfs/frame.h>
+#include <Libpfs/frameview.h>
 #include <Libpfs/io/framereader.h>
 #include <Libpfs/io/framereaderfactory.h>
 #include <Libpfs/io/framewriter.h>
@@ -61,6 +62,8 @@
 
 #include <Exif/ExifOperations.h>
 #include <HdrCreation/mtb_alignment.h>
+#include <HdrCreation/robertson02.h>
+#include <HdrWizard/ResponseCurveCache.h>
 #include <HdrWizard/WhiteBalance.h>
 #include <TonemappingOperators/fattal02/pde.h>
 #include <arch/math.h>
@@ -85,24 +88,31 @@ const FusionOperatorConfig predef_confs[6] = {
 // --- NEW CODE ---
 namespace {
 
-QImage *shiftQImage(const QImage *in, int dx, int dy) {
-    QImage *out = new QImage(in->size(), QImage::Format_ARGB32);
+// copy of \a area of \a in, with the content moved by \a dx \a dy: the
+// pixels that come from outside of \a in are transparent black
+QImage *shiftQImage(const QImage *in, int dx, int dy, const QRect &area) {
+    QImage *out = new QImage(area.size(), QImage::Format_ARGB32);
     assert(out != nullptr);
     out->fill(qRgba(0, 0, 0, 0));  // transparent black
-    for (int i = 0; i < in->height(); i++) {
-        if ((i + dy) < 0) continue;
-        if ((i + dy) >= in->height()) break;
-        QRgb *inp = (QRgb *)in->scanLine(i);
-        QRgb *outp = (QRgb *)out->scanLine(i + dy);
-        for (int j = 0; j < in->width(); j++) {
-            if ((j + dx) >= in->width()) break;
-            if ((j + dx) >= 0) outp[j + dx] = *inp;
-            inp++;
+    for (int i = 0; i < out->height(); i++) {
+        const int y = i + area.y() - dy;
+        if (y < 0) continue;
+        if (y >= in->height()) break;
+        const QRgb *inp = (const QRgb *)in->constScanLine(y);
+        QRgb *outp = (QRgb *)out->scanLine(i);
+        for (int j = 0; j < out->width(); j++) {
+            const int x = j + area.x() - dx;
+            if (x >= in->width()) break;
+            if (x >= 0) outp[j] = inp[x];
         }
     }
     return out;
 }
 
+QImage *shiftQImage(const QImage *in, int dx, int dy) {
+    return shiftQImage(in, dx, dy, in->rect());
+}
+
 void shiftItem(HdrCreationItem &item, int dx, int dy) {
     FramePtr shiftedFrame(pfs::shift(*item.frame(), dx, dy));
     item.frame().swap(shiftedFrame);
@@ -118,7 +128,7 @@ static bool checkFileName(const HdrCreationItem &item, const QString &str) {
     return (item.filename().compare(str) == 0);
 }
 
-void HdrCreationManager::loadFiles(const QStringList &filenames) {
+void HdrCreationManager::scheduleFiles(const QStringList &filenames) {
     for (const auto &filename : filenames) {
         qDebug() << QStringLiteral(
                         "HdrCreationManager::loadFiles(): Checking %1")
@@ -140,6 +150,10 @@ void HdrCreationManager::loadFiles(const QStringList &filenames) {
                             .arg(filename);
         }
     }
+}
+
+void HdrCreationManager::loadFiles(const QStringList &filenames) {
+    scheduleFiles(filenames);
 
     // parallel load of the data...
     connect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
@@ -150,17 +164,37 @@ void HdrCreationManager::loadFiles(const QStringList &filenames) {
         QtConcurrent::map(m_tmpdata.begin(), m_tmpdata.end(), LoadFile()));
 }
 
+bool HdrCreationManager::loadFilesAndWait(const QStringList &filenames) {
+    scheduleFiles(filenames);
+
+    QFuture<void> future =
+        QtConcurrent::map(m_tmpdata.begin(), m_tmpdata.end(), LoadFile());
+    bool failed = false;
+    try {
+        future.waitForFinished();
+    } catch (...) {
+        failed = true;
+    }
+    return insertLoadedFiles(failed || future.isCanceled());
+}
+
 void HdrCreationManager::loadFilesDone() {
     qDebug() << "HdrCreationManager::loadFilesDone(): Data loaded ... move to \
                 internal structure!";
-    if (m_futureWatcher.isCanceled())  // LoadFile() threw an exception
-    {
+    disconnect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
+               &HdrCreationManager::loadFilesDone);
+    // LoadFile() threw an exception if the watcher has been canceled
+    if (insertLoadedFiles(m_futureWatcher.isCanceled())) {
+        emit finishedLoadingFiles();
+    }
+}
+
+bool HdrCreationManager::insertLoadedFiles(bool failed) {
+    if (failed) {
         emit errorWhileLoading(
             tr("HdrCreationManager::loadFilesDone(): Error loading a file."));
-        disconnect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
-                   &HdrCreationManager::loadFilesDone);
         m_tmpdata.clear();
-        return;
+        return false;
     }
 
     if (isLoadResponseCurve()) {
@@ -172,8 +206,6 @@ void HdrCreationManager::loadFilesDone() {
             emit errorWhileLoading(QString(e.what()));
         }
     }
-    disconnect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
-               &HdrCreationManager::loadFilesDone);
     for (const auto &hdrCreationItem : m_tmpdata) {
         if (hdrCreationItem.isValid()) {
             qDebug() << QStringLiteral(
@@ -192,9 +224,9 @@ void HdrCreationManager::loadFilesDone() {
         emit errorWhileLoading(
             tr("HdrCreationManager::loadFilesDone(): The images have different "
                "size."));
-    } else {
-        emit finishedLoadingFiles();
+        return false;
     }
+    return true;
 }
 
 void HdrCreationManager::refreshEVOffset() {
@@ -272,7 +304,9 @@ HdrCreationManager::HdrCreationManager(bool fromCommandLine)
       m_align(),
       m_ais_crop_flag(false),
       fromCommandLine(fromCommandLine),
-      m_isLoadResponseCurve(false) {
+      m_isLoadResponseCurve(false),
+      m_responseSampleSize(m_luminance_options.getResponseSampleSize()),
+      m_responseCacheEnabled(m_luminance_options.isResponseCacheEnabled()) {
     // setConfig(predef_confs[0]);
     setFusionOperator(predef_confs[0].fusionOperator);
 
@@ -380,11 +414,43 @@ pfs::Frame *HdrCreationManager::createHdr() {
                           std::pow(2.f, m_data[idx].getEV() - m_evOffset)));
     }
 
+    // Robertson02 response estimation is expensive and depends only on the
+    // camera and on the settings of the estimation: reuse the curve of a
+    // previous stack when allowed. A curve loaded from file is not cached.
+    FusionOperator fusionOperator = m_fusionOperator;
+    ResponseCurveCache::Key key;
+    key.weight = m_weight->getType();
+    key.response = m_response->getType();
+    const bool useCache = fusionOperator == ROBERTSON_AUTO &&
+                          m_responseCacheEnabled &&
+                          key.response != RESPONSE_CUSTOM;
+    if (useCache) {
+        const std::string filename(
+            QFile::encodeName(m_data[0].filename()).constData());
+        key.camera = QString::fromStdString(
+            ExifOperations::getCameraIdentifier(filename));
+        key.iso = ExifOperations::getIsoSpeed(filename);
+        if (!key.camera.isEmpty() &&
+            ResponseCurveCache::load(key, *m_response)) {
+            qDebug() << "Using cached response curve for" << key.camera
+                     << key.iso;
+            fusionOperator = ROBERTSON;
+        }
+    }
+
     libhdr::fusion::FusionOperatorPtr fusionOperatorPtr =
-        IFusionOperator::build(m_fusionOperator);
+        IFusionOperator::build(fusionOperator);
+    if (RobertsonOperatorAuto *robertson =
+            dynamic_cast<RobertsonOperatorAuto *>(fusionOperatorPtr.get())) {
+        robertson->setSampleSize(std::max(0, m_responseSampleSize));
+    }
     pfs::Frame *outputFrame(
         fusionOperatorPtr->computeFusion(*m_response, *m_weight, frames));
 
+    if (useCache && fusionOperator == ROBERTSON_AUTO && !key.camera.isEmpty()) {
+        ResponseCurveCache::store(key, *m_response);
+    }
+
     if (!m_responseCurveOutputFilename.isEmpty()) {
         m_response->writeToFile(
             QFile::encodeName(m_responseCurveOutputFilename).constData());
@@ -406,25 +472,34 @@ void HdrCreationManager::applyShiftsToItems(
     }
 }
 
-void HdrCreationManager::cropItems(const QRect &ca) {
-    // crop all frames and images
+void HdrCreationManager::cropItems(const QRect &ca,
+                                   const QList<QPair<int, int>> &hvOffsets) {
+    int x_ul, y_ur, x_bl, y_br;
+    ca.getCoords(&x_ul, &y_ur, &x_bl, &y_br);
+
+    // crop all frames and images, the shifts are applied in the same pass
     int size = m_data.size();
     for (int idx = 0; idx < size; idx++) {
+        const QPair<int, int> offset = hvOffsets.value(idx, qMakePair(0, 0));
+
         std::unique_ptr<QImage> newimage(
-            new QImage(m_data[idx].qimage().copy(ca)));
+            (offset.first == 0 && offset.second == 0)
+                ? new QImage(m_data[idx].qimage().copy(ca))
+                : shiftQImage(&m_data[idx].qimage(), offset.first,
+                              offset.second, ca));
         if (newimage == nullptr) {
             exit(1);  // TODO: exit gracefully
         }
         m_data[idx].qimage().swap(*newimage);
         newimage.reset();
 
-        int x_ul, y_ur, x_bl, y_br;
-        ca.getCoords(&x_ul, &y_ur, &x_bl, &y_br);
-
-        FramePtr cropped(
-            cut(m_data[idx].frame().get(), static_cast<size_t>(x_ul),
-                static_cast<size_t>(y_ur), static_cast<size_t>(x_bl),
-                static_cast<size_t>(y_br)));
+        FramePtr cropped(FrameView(*m_data[idx].frame())
+                             .shift(offset.first, offset.second)
+                             .cut(static_cast<size_t>(x_ul),
+                                  static_cast<size_t>(y_ur),
+                                  static_cast<size_t>(x_bl),
+                                  static_cast<size_t>(y_br))
+                             .materialize());
         m_data[idx].frame().swap(cropped);
         cropped.reset();
     }
@@ -479,31 +554,25 @@ int HdrCreationManager::computePatches(float threshold,
     m_agGoodImageIndex = findIndex(HE.data(), size);
     qDebug() << "h0: " << m_agGoodImageIndex;
 
-    for (int j = 0; j < agGridSize; j++) {
-        for (int i = 0; i < agGridSize; i++) {
-            m_patches[i][j] = false;
-        }
-    }
-
+    vector<AgExposure> exposures;
     for (int h = 0; h < size; h++) {
         if (h == m_agGoodImageIndex) continue;
-        float deltaEV = log2(m_data[m_agGoodImageIndex].getAverageLuminance()) -
-                        log2(m_data[h].getAverageLuminance());
-        int dx = HV_offset[m_agGoodImageIndex].first - HV_offset[h].first;
-        int dy = HV_offset[m_agGoodImageIndex].second - HV_offset[h].second;
-        float sR, sG, sB;
-        sdv(m_data[m_agGoodImageIndex], m_data[h], deltaEV, dx, dy, sR, sG, sB);
-        //#pragma omp parallel for schedule(static)
-        for (int j = 0; j < agGridSize; j++) {
-            for (int i = 0; i < agGridSize; i++) {
-                if (comparePatches(m_data[m_agGoodImageIndex], m_data[h], i, j,
-                                   gridX, gridY, threshold, sR, sG, sB, deltaEV,
-                                   dx, dy)) {
-                    m_patches[i][j] = true;
-                }
-            }
-        }
-    }
+        AgExposure exposure;
+        exposure.item = &m_data[h];
+        exposure.deltaEV =
+            log2(m_data[m_agGoodImageIndex].getAverageLuminance()) -
+            log2(m_data[h].getAverageLuminance());
+        exposure.dx = HV_offset[m_agGoodImageIndex].first - HV_offset[h].first;
+        exposure.dy =
+            HV_offset[m_agGoodImageIndex].second - HV_offset[h].second;
+        sdv(m_data[m_agGoodImageIndex], m_data[h], exposure.deltaEV,
+            exposure.dx, exposure.dy, exposure.sR, exposure.sG, exposure.sB);
+        exposures.push_back(exposure);
+    }
+
+    // a single pass over the patches, for all the exposures
+    findGhostPatches(m_data[m_agGoodImageIndex], exposures, gridX, gridY,
+                     threshold, m_patches);
 
     int count = 0;
     for (int i = 0; i < agGridSize; i++)
@@ -581,6 +650,13 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     Gc = Ch[1];
     Bc = Ch[2];
 
+    // each channel is brought back to irradiance right after its solve, so
+    // that the buffers of the log irradiance and of the divergence are reused
+    // by the next channel
+    std::unique_ptr<Frame> deghosted(new Frame(width, height));
+    Channel *Uc[3];
+    deghosted->createXYZChannels(Uc[0], Uc[1], Uc[2]);
+
     ph->setValue(5);
     if (ph->canceled()) return nullptr;
 
@@ -635,8 +711,11 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
         return nullptr;
     }
 
+    // the three channels share the plan of the transforms
+    const PdeDctPlan dctPlan(width);
     qDebug() << "solve_pde";
-    solve_pde_dct(*divergence_R, *logIrradiance_R);
+    solve_pde_dct(*divergence_R, *logIrradiance_R, dctPlan);
+    computeIrradiance(*Uc[0], *logIrradiance_R);
     ph->setValue(33);
     if (ph->canceled()) {
         return nullptr;
@@ -649,7 +728,7 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     if (ph->canceled()) {
         return nullptr;
     }
-    std::unique_ptr<Array2Df> logIrradiance_G(new Array2Df(width, height));
+    std::unique_ptr<Array2Df> logIrradiance_G = std::move(logIrradiance_R);
     computeLogIrradiance(*logIrradiance_G, *Gc);
     ph->setValue(38);
     if (ph->canceled()) {
@@ -686,7 +765,7 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
         return nullptr;
     }
 
-    std::unique_ptr<Array2Df> divergence_G(new Array2Df(width, height));
+    std::unique_ptr<Array2Df> divergence_G = std::move(divergence_R);
     computeDivergence(*divergence_G, *gradientXBlended_G, *gradientYBlended_G);
     ph->setValue(60);
     if (ph->canceled()) {
@@ -694,7 +773,8 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     }
 
     qDebug() << "solve_pde";
-    solve_pde_dct(*divergence_G, *logIrradiance_G);
+    solve_pde_dct(*divergence_G, *logIrradiance_G, dctPlan);
+    computeIrradiance(*Uc[1], *logIrradiance_G);
     ph->setValue(66);
     if (ph->canceled()) {
         return nullptr;
@@ -707,7 +787,7 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     if (ph->canceled()) {
         return nullptr;
     }
-    std::unique_ptr<Array2Df> logIrradiance_B(new Array2Df(width, height));
+    std::unique_ptr<Array2Df> logIrradiance_B = std::move(logIrradiance_G);
     computeLogIrradiance(*logIrradiance_B, *Bc);
     ph->setValue(76);
     if (ph->canceled()) {
@@ -744,7 +824,7 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
         return nullptr;
     }
 
-    std::unique_ptr<Array2Df> divergence_B(new Array2Df(width, height));
+    std::unique_ptr<Array2Df> divergence_B = std::move(divergence_G);
     computeDivergence(*divergence_B, *gradientXBlended_B, *gradientYBlended_B);
     ph->setValue(93);
     if (ph->canceled()) {
@@ -752,36 +832,14 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     }
 
     qDebug() << "solve_pde";
-    solve_pde_dct(*divergence_B, *logIrradiance_B);
-    ph->setValue(94);
-    if (ph->canceled()) {
-        return nullptr;
-    }
-
-    //Blend
-    Frame *deghosted = new Frame(width, height);
-    // Channel *Urc, *Ugc, *Ubc;
-    Channel *Uc[3];
-    deghosted->createXYZChannels(Uc[0], Uc[1], Uc[2]);
-
-    computeIrradiance(*Uc[0], *logIrradiance_R);
-    ph->setValue(95);
-    if (ph->canceled()) {
-        delete deghosted;
-        return nullptr;
-    }
-    computeIrradiance(*Uc[1], *logIrradiance_G);
-    ph->setValue(97);
-    if (ph->canceled()) {
-        delete deghosted;
-        return nullptr;
-    }
+    solve_pde_dct(*divergence_B, *logIrradiance_B, dctPlan);
     computeIrradiance(*Uc[2], *logIrradiance_B);
     ph->setValue(99);
     if (ph->canceled()) {
-        delete deghosted;
         return nullptr;
     }
+
+    //Blend
     // shadesOfGrayAWB(*Uc[0], *Uc[1], *Uc[2]);
 
     for (int c = 0; c < 3; c++) {
@@ -809,7 +867,7 @@ pfs::Frame *HdrCreationManager::doAntiGhosting(bool patches[][agGridSize],
     std::cout << "doAntiGhosting = " << stop_watch.get_time() << " msec"
               << std::endl;
 #endif
-    return deghosted;
+    return deghosted.release();
 }
 
 void HdrCreationManager::getAgData(bool patches[][agGridSize], int &h0) {
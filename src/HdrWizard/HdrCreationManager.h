@@ -66,6 +66,10 @@ class HdrCreationManager : public QObject {
     const HdrCreationItem &getFile(size_t idx) const { return m_data[idx]; }
 
     void loadFiles(const QStringList &filenames);
+    //! \brief load \a filenames and wait for them, in the calling thread
+    //! \return false (having emitted errorWhileLoading) if the files could
+    //! not be loaded
+    bool loadFilesAndWait(const QStringList &filenames);
     void removeFile(int idx);
     void clearFiles() {
         m_data.clear();
@@ -120,6 +124,16 @@ class HdrCreationManager : public QObject {
 
     void setConfig(const FusionOperatorConfig &cfg);
 
+    //! \brief estimate the Robertson02 response on about \a samples pixels,
+    //! 0 for every pixel. Defaults to the preferences
+    void setResponseSampleSize(int samples) { m_responseSampleSize = samples; }
+    int responseSampleSize() const { return m_responseSampleSize; }
+
+    //! \brief reuse the Robertson02 response estimated for a previous stack
+    //! shot with the same camera. Defaults to the preferences
+    void setResponseCacheEnabled(bool b) { m_responseCacheEnabled = b; }
+    bool isResponseCacheEnabled() const { return m_responseCacheEnabled; }
+
     pfs::Frame *createHdr();
 
     void set_ais_crop_flag(bool flag);
@@ -135,7 +149,11 @@ class HdrCreationManager : public QObject {
     QVector<float> getExpotimes() const;
 
     void applyShiftsToItems(const QList<QPair<int, int>> &);
-    void cropItems(const QRect &ca);
+    //! \brief crop all items to \a ca, after moving each of them by its
+    //! offset in \a hvOffsets (if any): one copy per item
+    void cropItems(const QRect &ca,
+                   const QList<QPair<int, int>> &hvOffsets =
+                       QList<QPair<int, int>>());
     void cropAgMasks(const QRect &ca);
 
     void saveImages(const QString &prefix);
@@ -175,6 +193,8 @@ class HdrCreationManager : public QObject {
     void loadFilesAborted();
 
    private:
+    void scheduleFiles(const QStringList &filenames);
+    bool insertLoadedFiles(bool failed);
     bool framesHaveSameSize();
     void refreshEVOffset();
 
@@ -200,6 +220,8 @@ class HdrCreationManager : public QObject {
     int m_agGoodImageIndex;
     bool m_patches[agGridSize][agGridSize];
     bool m_isLoadResponseCurve;
+    int m_responseSampleSize;
+    bool m_responseCacheEnabled;
 
    private slots:
     void ais_failed_slot(QProcess::ProcessError);
@@ -0,0 +1,265 @@
+/**
+ * This file is a part of Luminance HDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "PreviewBlend.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const QRgb OPAQUE = 0xff000000;
+//! side of the tiles the samples of a PreviewLevel are taken in
+const int LEVEL_TILE_SIZE = 256;
+
+#ifdef __SSE2__
+//! \brief exact x / 255 for 0 <= x <= 255 * 255
+inline __m128i div255(__m128i x) {
+    return _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)),
+                      _mm_srli_epi16(x, 8)),
+        8);
+}
+
+//! \brief samples of two pixels (16 bits each) times their alpha
+inline __m128i premultiply(__m128i px) {
+    const __m128i alpha = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)),
+        _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_mullo_epi16(px, alpha);
+}
+
+template <bool Diff>
+inline __m128i combine(__m128i p, __m128i m) {
+    if (Diff) {
+        return div255(_mm_or_si128(_mm_subs_epu16(p, m), _mm_subs_epu16(m, p)));
+    }
+    // (p + m) / 510 == ((p + m) / 2) / 255, without overflowing 16 bits
+    const __m128i half = _mm_add_epi16(
+        _mm_add_epi16(_mm_srli_epi16(p, 1), _mm_srli_epi16(m, 1)),
+        _mm_and_si128(_mm_and_si128(p, m), _mm_set1_epi16(1)));
+    return div255(half);
+}
+#endif
+
+template <bool Diff>
+void blendRow(const QRgb *movable, const QRgb *pivot, QRgb *out, int width) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(OPAQUE));
+    for (; i + 4 <= width; i += 4) {
+        const __m128i m =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(movable + i));
+        const __m128i p =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(pivot + i));
+
+        const __m128i lo =
+            combine<Diff>(premultiply(_mm_unpacklo_epi8(p, zero)),
+                          premultiply(_mm_unpacklo_epi8(m, zero)));
+        const __m128i hi =
+            combine<Diff>(premultiply(_mm_unpackhi_epi8(p, zero)),
+                          premultiply(_mm_unpackhi_epi8(m, zero)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+#endif
+    const PreviewBlendMode mode = Diff ? BLEND_DIFF : BLEND_ADD;
+    for (; i < width; ++i) {
+        out[i] = blendPreviewPixel(mode, movable[i], pivot[i]);
+    }
+}
+
+void copyRow(const QRgb *in, QRgb *out, int width) {
+    for (int i = 0; i < width; ++i) {
+        out[i] = in[i] | OPAQUE;
+    }
+}
+}
+
+void blendPreviewRow(PreviewBlendMode mode, const QRgb *movable,
+                     const QRgb *pivot, QRgb *out, int width) {
+    switch (mode) {
+        case BLEND_DIFF:
+            blendRow<true>(movable, pivot, out, width);
+            break;
+        case BLEND_ADD:
+            blendRow<false>(movable, pivot, out, width);
+            break;
+        case BLEND_ONLY_MOVABLE:
+            copyRow(movable, out, width);
+            break;
+        case BLEND_ONLY_PIVOT:
+            copyRow(pivot, out, width);
+            break;
+    }
+}
+
+void blendPreviewRect(PreviewBlendMode mode, const QImage &movable, int mx,
+                      int my, const QImage &pivot, int px, int py,
+                      QImage &out, const QRect &rect) {
+    const QRect area = rect & out.rect();
+    if (area.isEmpty()) return;
+
+    blendPreviewRect(mode, movable, mx, my, pivot, px, py, out.bits(),
+                     out.bytesPerLine(), area);
+}
+
+void blendPreviewRect(PreviewBlendMode mode, const QImage &movable, int mx,
+                      int my, const QImage &pivot, int px, int py,
+                      uchar *outBits, int bytesPerLine, const QRect &rect) {
+    if (rect.isEmpty()) return;
+
+    const bool usesMovable = mode != BLEND_ONLY_PIVOT;
+    const bool usesPivot = mode != BLEND_ONLY_MOVABLE;
+    const int x0 = rect.left();
+    const int x1 = rect.right() + 1;
+
+    const uchar *movBits = movable.constBits();
+    const int movBytesPerLine = movable.bytesPerLine();
+    const uchar *pivBits = pivot.constBits();
+    const int pivBytesPerLine = pivot.bytesPerLine();
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        QRgb *outLine = reinterpret_cast<QRgb *>(outBits + y * bytesPerLine);
+
+        const QRgb *movLine = nullptr;
+        if (y - my >= 0 && y - my < movable.height()) {
+            movLine = reinterpret_cast<const QRgb *>(
+                movBits + (y - my) * movBytesPerLine);
+        }
+        const QRgb *pivLine = nullptr;
+        if (y - py >= 0 && y - py < pivot.height()) {
+            pivLine = reinterpret_cast<const QRgb *>(
+                pivBits + (y - py) * pivBytesPerLine);
+        }
+
+        // [begin, end) has all the samples the blend mode needs
+        int begin = x0;
+        int end = x1;
+        if (usesMovable) {
+            begin = std::max(begin, mx);
+            end = movLine ? std::min(end, mx + movable.width()) : begin;
+        }
+        if (usesPivot) {
+            begin = std::max(begin, px);
+            end = pivLine ? std::min(end, px + pivot.width()) : begin;
+        }
+        if (end <= begin) begin = end = x1;
+
+        const auto blendOutOfBounds = [&](int from, int to) {
+            for (int x = from; x < to; ++x) {
+                const QRgb m =
+                    (movLine && x - mx >= 0 && x - mx < movable.width())
+                        ? movLine[x - mx]
+                        : PREVIEW_OUT_OF_BOUNDS;
+                const QRgb p =
+                    (pivLine && x - px >= 0 && x - px < pivot.width())
+                        ? pivLine[x - px]
+                        : PREVIEW_OUT_OF_BOUNDS;
+                outLine[x] = blendPreviewPixel(mode, m, p) | OPAQUE;
+            }
+        };
+
+        blendOutOfBounds(x0, begin);
+        if (begin < end) {
+            blendPreviewRow(mode, usesMovable ? movLine + (begin - mx) : nullptr,
+                            usesPivot ? pivLine + (begin - px) : nullptr,
+                            outLine + begin, end - begin);
+        }
+        blendOutOfBounds(end, x1);
+    }
+}
+
+PreviewLevel::PreviewLevel()
+    : m_source(nullptr), m_sourceKey(0), m_step(0), m_tilesX(0) {}
+
+void PreviewLevel::reset(const QImage *source, int step) {
+    if (source == m_source && step == m_step &&
+        source->cacheKey() == m_sourceKey) {
+        return;
+    }
+    m_source = source;
+    m_step = step;
+    invalidate();
+}
+
+void PreviewLevel::invalidate() {
+    m_sourceKey = m_source->cacheKey();
+    if (m_step <= 1) {
+        // shares the data of the source
+        m_image = *m_source;
+        m_validTiles.clear();
+        m_tilesX = 0;
+        return;
+    }
+    m_image = QImage((m_source->width() + m_step - 1) / m_step,
+                     (m_source->height() + m_step - 1) / m_step,
+                     QImage::Format_ARGB32);
+    m_tilesX = (m_image.width() + LEVEL_TILE_SIZE - 1) / LEVEL_TILE_SIZE;
+    const int tilesY =
+        (m_image.height() + LEVEL_TILE_SIZE - 1) / LEVEL_TILE_SIZE;
+    m_validTiles.fill(false, m_tilesX * tilesY);
+}
+
+void PreviewLevel::prepare(const QRect &rect) {
+    const QRect area = rect & m_image.rect();
+    if (m_step <= 1 || area.isEmpty()) return;
+
+    QVector<QRect> tiles;
+    for (int ty = area.top() / LEVEL_TILE_SIZE;
+         ty <= area.bottom() / LEVEL_TILE_SIZE; ++ty) {
+        for (int tx = area.left() / LEVEL_TILE_SIZE;
+             tx <= area.right() / LEVEL_TILE_SIZE; ++tx) {
+            bool &valid = m_validTiles[ty * m_tilesX + tx];
+            if (!valid) {
+                tiles.push_back(QRect(tx * LEVEL_TILE_SIZE,
+                                      ty * LEVEL_TILE_SIZE, LEVEL_TILE_SIZE,
+                                      LEVEL_TILE_SIZE) &
+                                m_image.rect());
+                valid = true;
+            }
+        }
+    }
+    if (tiles.isEmpty()) return;
+
+    const int step = m_step;
+    const uchar *inBits = m_source->constBits();
+    const int inBytesPerLine = m_source->bytesPerLine();
+    uchar *outBits = m_image.bits();
+    const int outBytesPerLine = m_image.bytesPerLine();
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles.size(); t++) {
+        const QRect &tile = tiles.at(t);
+        for (int y = tile.top(); y <= tile.bottom(); ++y) {
+            const QRgb *inLine = reinterpret_cast<const QRgb *>(
+                inBits + y * step * inBytesPerLine);
+            QRgb *outLine =
+                reinterpret_cast<QRgb *>(outBits + y * outBytesPerLine);
+            for (int x = tile.left(); x <= tile.right(); ++x) {
+                outLine[x] = inLine[x * step];
+            }
+        }
+    }
+}
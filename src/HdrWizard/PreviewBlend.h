@@ -0,0 +1,114 @@
+/**
+ * This file is a part of Luminance HDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef PREVIEWBLEND_H
+#define PREVIEWBLEND_H
+
+#include <QImage>
+#include <QRect>
+#include <QRgb>
+#include <QVector>
+
+//! \brief Blend modes of the alignment preview, in the order of the combo box
+//! of the editing tools
+enum PreviewBlendMode {
+    BLEND_DIFF = 0,
+    BLEND_ADD = 1,
+    BLEND_ONLY_MOVABLE = 2,
+    BLEND_ONLY_PIVOT = 3
+};
+
+//! \brief pixels outside of the shifted images
+const QRgb PREVIEW_OUT_OF_BOUNDS = 0xff000000;
+
+//! \brief blend two pixels, weighting the samples with their alpha.
+//! The result is opaque.
+inline QRgb blendPreviewPixel(PreviewBlendMode mode, QRgb m, QRgb p) {
+    const int ma = qAlpha(m);
+    const int pa = qAlpha(p);
+    switch (mode) {
+        case BLEND_DIFF:
+            return qRgba(qAbs(qRed(p) * pa - qRed(m) * ma) / 255,
+                         qAbs(qGreen(p) * pa - qGreen(m) * ma) / 255,
+                         qAbs(qBlue(p) * pa - qBlue(m) * ma) / 255, 255);
+        case BLEND_ADD:
+            return qRgba((qRed(p) * pa + qRed(m) * ma) / 510,
+                         (qGreen(p) * pa + qGreen(m) * ma) / 510,
+                         (qBlue(p) * pa + qBlue(m) * ma) / 510, 255);
+        case BLEND_ONLY_MOVABLE:
+            return m;
+        case BLEND_ONLY_PIVOT:
+        default:
+            return p;
+    }
+}
+
+//! \brief blend \a width pixels of a row of the movable and of the pivot image
+void blendPreviewRow(PreviewBlendMode mode, const QRgb *movable,
+                     const QRgb *pivot, QRgb *out, int width);
+
+//! \brief render \a rect of \a out, blending \a movable shifted by
+//! (\a mx, \a my) and \a pivot shifted by (\a px, \a py).
+//! \note shifts are handled as offsets of the source rows, the images are
+//! never copied. \a out must be a 32 bits image as large as \a movable.
+void blendPreviewRect(PreviewBlendMode mode, const QImage &movable, int mx,
+                      int my, const QImage &pivot, int px, int py,
+                      QImage &out, const QRect &rect);
+
+//! \brief as above, writing to the rows of \a outBits, \a bytesPerLine
+//! apart: \a rect must lie inside the output. The pointer is taken once by
+//! the caller, so that the tiles of an image can be rendered in parallel.
+void blendPreviewRect(PreviewBlendMode mode, const QImage &movable, int mx,
+                      int my, const QImage &pivot, int px, int py,
+                      uchar *outBits, int bytesPerLine, const QRect &rect);
+
+//! \brief An image seen at one sample every \a step pixels, for the zoomed
+//! out views of the preview.
+//! \note The samples are taken tile by tile, the first time a tile is
+//! needed, and kept until the image or the step change: shifting the image
+//! only moves the tiles. At step 1 it is the image itself.
+class PreviewLevel {
+   public:
+    PreviewLevel();
+
+    //! \brief drop the samples, unless \a source and \a step are those
+    //! of the samples already taken
+    void reset(const QImage *source, int step);
+    //! \brief drop the samples, the content of the image has changed
+    void invalidate();
+
+    int step() const { return m_step; }
+    //! \brief the samples, valid in the rects passed to prepare()
+    const QImage &image() const { return m_image; }
+
+    //! \brief take the samples of the tiles of \a rect, in the coordinates
+    //! of image(), that are missing
+    void prepare(const QRect &rect);
+
+   private:
+    const QImage *m_source;
+    qint64 m_sourceKey;
+    int m_step;
+    QImage m_image;
+    QVector<bool> m_validTiles;
+    int m_tilesX;
+};
+
+#endif  // PREVIEWBLEND_H
@@ -27,6 +27,7 @@
 #include <QApplication>
 #include <QDebug>
 #include <QPainter>
+#include <QPainterPath>
 #include <cassert>
 
 #include "Viewers/GenericViewer.h"
@@ -40,7 +41,40 @@ namespace {
 // define the number of pixels to count as border of the image, because of the
 // shadow
 static const int BORDER_SIZE = 30;
-}
+// side of the tiles the preview is rendered in
+static const int TILE_SIZE = 256;
+// largest distance between the samples of a zoomed out preview
+static const int MAX_STEP = 16;
+}
+
+//! \brief Item with the size of the images that paints nothing itself
+//! \note The scene, the selection and the masks use the coordinates of the
+//! images, while the preview is rendered at the resolution of the view and
+//! drawn by a scaled child.
+class PreviewFrameItem : public IGraphicsPixmapItem {
+   public:
+    void setImageSize(const QSize &size) {
+        prepareGeometryChange();
+        m_size = size;
+    }
+
+    QRectF boundingRect() const override {
+        return QRectF(QPointF(0, 0), m_size);
+    }
+    QPainterPath shape() const override {
+        QPainterPath path;
+        path.addRect(boundingRect());
+        return path;
+    }
+    bool contains(const QPointF &point) const override {
+        return boundingRect().contains(point);
+    }
+    void paint(QPainter *, const QStyleOptionGraphicsItem *,
+               QWidget *) override {}
+
+   private:
+    QSizeF m_size;
+};
 
 PreviewWidget::PreviewWidget(QWidget *parent, QImage *m, const QImage *p)
     : QWidget(parent),
@@ -51,7 +85,10 @@ PreviewWidget::PreviewWidget(QWidget *parent, QImage *m, const QImage *p)
       m_patchesMask(nullptr),
       m_agMaskPixmap(nullptr),
       m_savedMask(nullptr),
-      m_prevComputed(),
+      m_blendMode(BLEND_DIFF),
+      m_step(0),
+      m_tilesX(0),
+      m_tilesY(0),
       m_mx(0),
       m_my(0),
       m_px(0),
@@ -71,11 +108,9 @@ PreviewWidget::PreviewWidget(QWidget *parent, QImage *m, const QImage *p)
     m_previousPixmapColor = QColor();
     fillAntiGhostingCursorPixmap();
 
-    m_previewImage = new QImage(m_movableImage->size(), QImage::Format_ARGB32);
-    m_previewImage->fill(qRgba(255, 0, 0, 255));
-    blendmode = &PreviewWidget::computeDiffRgba;
+    // sized for the zoom of the view by updateLevel()
+    m_previewImage = new QImage();
     m_mode = EditingMode;
-    m_rect = m_movableImage->rect();
 
     mVBL = new QVBoxLayout(this);
     mVBL->setSpacing(0);
@@ -112,10 +147,13 @@ PreviewWidget::PreviewWidget(QWidget *parent, QImage *m, const QImage *p)
     mVBL->addWidget(mView);
     mView->show();
 
-    mPixmap = new IGraphicsPixmapItem();
+    mPixmap = new PreviewFrameItem();
     mPixmap->setZValue(0);
-    renderPreviewImage(blendmode, m_rect);
-    mPixmap->setPixmap(QPixmap::fromImage(*m_previewImage));
+    mPixmap->setImageSize(m_movableImage->size());
+    m_displayItem = new QGraphicsPixmapItem(mPixmap);
+    m_displayItem->setZValue(0);
+    m_displayItem->setTransformationMode(Qt::SmoothTransformation);
+    m_displayItem->setAcceptedMouseButtons(0);
     fitToWindow();
     connect(mPixmap, &IGraphicsPixmapItem::selectionReady, this,
             &PreviewWidget::selectionReady);
@@ -141,82 +179,124 @@ PreviewWidget::~PreviewWidget() {
     }
 }
 
-QRgb outofbounds = qRgba(0, 0, 0, 255);
-
-void PreviewWidget::renderPreviewImage(
-    QRgb (PreviewWidget::*rendermode)(const QRgb *, const QRgb *) const,
-    const QRect rect) {
-    int originx = rect.x();
-    int originy = rect.y();
-    int W = rect.width();
-    int H = rect.height();
-    if (rect.isNull()) {
-        // requested fullsize render
-        QRegion areaToRender =
-            QRegion(QRect(0, 0, m_previewImage->size().width(),
-                          m_previewImage->size().height())) -
-            m_prevComputed;
-        if (!areaToRender.isEmpty()) {
-            // render only what you have to
-            originx = areaToRender.boundingRect().x();
-            originy = areaToRender.boundingRect().y();
-            W = areaToRender.boundingRect().width();
-            H = areaToRender.boundingRect().height();
-            m_prevComputed += areaToRender;
-        } else  // image already rendered fullsize
-            return;
+PreviewBlendMode PreviewWidget::effectiveBlendMode() const {
+    return (m_pivotImage == m_movableImage) ? BLEND_ONLY_MOVABLE : m_blendMode;
+}
+
+void PreviewWidget::resetTiles() {
+    m_tilesX = (m_previewImage->width() + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (m_previewImage->height() + TILE_SIZE - 1) / TILE_SIZE;
+    m_validTiles.fill(false, m_tilesX * m_tilesY);
+}
+
+void PreviewWidget::invalidateTiles() { m_validTiles.fill(false); }
+
+void PreviewWidget::invalidateMovable() {
+    if (effectiveBlendMode() != BLEND_ONLY_PIVOT) invalidateTiles();
+}
+
+void PreviewWidget::invalidatePivot() {
+    if (effectiveBlendMode() != BLEND_ONLY_MOVABLE) invalidateTiles();
+}
+
+QRect PreviewWidget::exposedRect() const {
+    const QRectF visible =
+        mView->mapToScene(mView->viewport()->rect()).boundingRect();
+    return visible.toAlignedRect() & QRect(QPoint(0, 0), sizeHint());
+}
+
+void PreviewWidget::updateLevel() {
+    // the preview is shown between half and full resolution
+    int step = 1;
+    const qreal scale = getScaleFactor();
+    while (step < MAX_STEP && scale * step * 2 <= 1.0) step *= 2;
+
+    m_movableLevel.reset(m_movableImage, step);
+    m_pivotLevel.reset(m_pivotImage, step);
+    if (step == m_step &&
+        m_previewImage->size() == m_movableLevel.image().size()) {
+        return;
     }
-    // these kind of things can happen and lead to strange and nasty runtime
-    // errors!
-    // usually it's an error of 2,3 px
-    if ((originy + H - 1) >= m_movableImage->height())
-        H = m_movableImage->height() - originy;
-    if ((originx + W - 1) >= m_movableImage->width())
-        W = m_movableImage->width() - originx;
-
-    const QRgb *movVal = nullptr;
-    const QRgb *pivVal = nullptr;
-    QRgb *movLine = nullptr;
-    QRgb *pivLine = nullptr;
-    QRgb *out = nullptr;
-
-// for all the rows that we have to paint
-#pragma omp parallel for private(out, movVal, pivVal, movLine, pivLine)
-    for (int i = originy; i < originy + H; i++) {
-        out = (QRgb *)m_previewImage->scanLine(i);
-
-        // if within bounds considering vertical offset
-        if (!((i - m_my) < 0 || (i - m_my) >= m_movableImage->height()))
-            movLine = (QRgb *)(m_movableImage->scanLine(i - m_my));
-        else
-            movLine = nullptr;
-
-        if (!((i - m_py) < 0 || (i - m_py) >= m_pivotImage->height()))
-            pivLine = (QRgb *)(m_pivotImage->scanLine(i - m_py));
-        else
-            pivLine = nullptr;
-
-        // for all the columns that we have to paint
-        for (int j = originx; j < originx + W; j++) {
-            // if within bounds considering horizontal offset
-            if (movLine == nullptr || (j - m_mx) < 0 ||
-                (j - m_mx) >= m_movableImage->width())
-                movVal = &outofbounds;
-            else
-                movVal = &movLine[j - m_mx];
 
-            if (pivLine == nullptr || (j - m_px) < 0 ||
-                (j - m_px) >= m_pivotImage->width())
-                pivVal = &outofbounds;
-            else
-                pivVal = &pivLine[j - m_px];
+    m_step = step;
+    delete m_previewImage;
+    m_previewImage =
+        new QImage(m_movableLevel.image().size(), QImage::Format_RGB32);
+    resetTiles();
+    m_displayItem->setScale(step);
+}
+
+void PreviewWidget::renderPreviewImage(const QRect &rect) {
+    updateLevel();
+
+    QPixmap pixmap = m_displayItem->pixmap();
+    // a new pixmap is uploaded as a whole
+    const bool newPixmap = pixmap.size() != m_previewImage->size();
+    const QRect area =
+        (rect.isNull() || newPixmap)
+            ? m_previewImage->rect()
+            : QRect(QPoint(rect.left() / m_step, rect.top() / m_step),
+                    QPoint(rect.right() / m_step, rect.bottom() / m_step)) &
+                  m_previewImage->rect();
+    if (area.isEmpty()) return;
+
+    QVector<QRect> tiles;
+    for (int ty = area.top() / TILE_SIZE; ty <= area.bottom() / TILE_SIZE;
+         ++ty) {
+        for (int tx = area.left() / TILE_SIZE;
+             tx <= area.right() / TILE_SIZE; ++tx) {
+            bool &valid = m_validTiles[ty * m_tilesX + tx];
+            if (!valid) {
+                tiles.push_back(
+                    QRect(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE) &
+                    m_previewImage->rect());
+                valid = true;
+            }
+        }
+    }
+    if (tiles.isEmpty() && !newPixmap) return;
+
+    const PreviewBlendMode mode = effectiveBlendMode();
+    // the shifts are offsets of the samples, rounded to the zoom level
+    const int mx = qRound(qreal(m_mx) / m_step);
+    const int my = qRound(qreal(m_my) / m_step);
+    const int px = qRound(qreal(m_px) / m_step);
+    const int py = qRound(qreal(m_py) / m_step);
+
+    QRect sources;
+    foreach (const QRect &tile, tiles) {
+        sources |= tile;
+    }
+    if (mode != BLEND_ONLY_PIVOT) {
+        m_movableLevel.prepare(sources.translated(-mx, -my));
+    }
+    if (mode != BLEND_ONLY_MOVABLE) {
+        m_pivotLevel.prepare(sources.translated(-px, -py));
+    }
 
-            if (m_pivotImage == m_movableImage)
-                out[j] = *movVal;
-            else
-                out[j] = (this->*rendermode)(movVal, pivVal);
+    // detach once, outside of the parallel region
+    uchar *bits = m_previewImage->bits();
+    const int bytesPerLine = m_previewImage->bytesPerLine();
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles.size(); t++) {
+        blendPreviewRect(mode, m_movableLevel.image(), mx, my,
+                         m_pivotLevel.image(), px, py, bits, bytesPerLine,
+                         tiles.at(t));
+    }
+
+    // drop the reference of the item first, or painting on the pixmap would
+    // copy it as a whole
+    m_displayItem->setPixmap(QPixmap());
+    if (newPixmap) {
+        pixmap = QPixmap::fromImage(*m_previewImage);
+    } else {
+        QPainter painter(&pixmap);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        foreach (const QRect &tile, tiles) {
+            painter.drawImage(tile.topLeft(), *m_previewImage, tile);
         }
     }
+    m_displayItem->setPixmap(pixmap);
 }
 
 namespace {
@@ -258,7 +338,7 @@ void PreviewWidget::renderAgMask() {
             for (int j = 0; j < W; j++) {
                 // if within bounds considering horizontal offset
                 if (maskLine == nullptr || (j - m_mx) < 0 || (j - m_mx) >= W)
-                    maskVal = &outofbounds;
+                    maskVal = &PREVIEW_OUT_OF_BOUNDS;
                 else
                     maskVal = &maskLine[j - m_mx];
 
@@ -284,30 +364,28 @@ void PreviewWidget::renderPatchesMask() {
         }
     }
     painter.end();
-    renderPreviewImage(blendmode, m_rect);
-    mPixmap->setPixmap(QPixmap::fromImage(*m_previewImage));
+    renderExposedTiles();
     delete m_agMaskPixmap;
     m_agMaskPixmap = new QPixmap(QPixmap::fromImage(*m_patchesMask));
     mAgPixmap->setPixmap(*m_agMaskPixmap);
 }
 
 void PreviewWidget::requestedBlendMode(int newindex) {
-    if (newindex == 0)
-        blendmode = &PreviewWidget::computeDiffRgba;
-    else if (newindex == 1)
-        blendmode = &PreviewWidget::computeAddRgba;
-    else if (newindex == 2)
-        blendmode = &PreviewWidget::computeOnlyMovable;
-    else if (newindex == 3)
-        blendmode = &PreviewWidget::computeOnlyPivot;
-
-    m_prevComputed = QRegion();
-    renderPreviewImage(blendmode, m_rect);
-    mPixmap->setPixmap(QPixmap::fromImage(*m_previewImage));
+    if (newindex < BLEND_DIFF || newindex > BLEND_ONLY_PIVOT) return;
+
+    m_blendMode = static_cast<PreviewBlendMode>(newindex);
+    invalidateTiles();
+    renderExposedTiles();
     // updateView();
 }
 
 bool PreviewWidget::eventFilter(QObject *object, QEvent *event) {
+    // a larger viewport exposes tiles without moving the scrollbars, also
+    // when the view keeps its size and only the scrollbars come and go
+    if (object == mView->viewport() && event->type() == QEvent::Resize) {
+        renderExposedTiles();
+        return false;
+    }
     // if (m_mode == EditingMode || m_mode == ViewPatches) return false;
     if (m_mode == EditingMode) return false;
     if (event->type() == QEvent::MouseButtonPress) {
@@ -401,23 +479,26 @@ void PreviewWidget::setPivot(QImage *p, int p_px, int p_py) {
     m_pivotImage = p;
     m_px = p_px;
     m_py = p_py;
-    m_prevComputed = QRegion();
+    invalidateTiles();
 }
 
-void PreviewWidget::setPivot(QImage *p) { m_pivotImage = p; }
+void PreviewWidget::setPivot(QImage *p) {
+    m_pivotImage = p;
+    invalidateTiles();
+}
 
 void PreviewWidget::setMovable(QImage *m, int p_mx, int p_my) {
     m_movableImage = m;
     m_mx = p_mx;
     m_my = p_my;
-    m_prevComputed = QRegion();
+    invalidateTiles();
 }
 
 void PreviewWidget::setMovable(QImage *m) {
     m_movableImage = m;
-    // TODO: check this
-    delete m_previewImage;
-    m_previewImage = new QImage(m_movableImage->size(), QImage::Format_ARGB32);
+    // the preview is resized by the next render
+    mPixmap->setImageSize(m_movableImage->size());
+    invalidateTiles();
     updateView();
 }
 
@@ -428,6 +509,7 @@ void PreviewWidget::setMask(QImage *mask) {
     m_agMaskPixmap = new QPixmap(QPixmap::fromImage(*m_agMask));
     mAgPixmap->setPixmap(*m_agMaskPixmap);
     m_mx = m_my = 0;
+    invalidateMovable();
 }
 
 void PreviewWidget::setPatchesMask(QImage *mask) {
@@ -448,7 +530,7 @@ void PreviewWidget::updateVertShiftMovable(int v) {
         m_old_my = v;
     m_my = v;
     m_old_mx = m_mx;
-    m_prevComputed = QRegion();
+    invalidateMovable();
 }
 
 void PreviewWidget::updateHorizShiftMovable(int h) {
@@ -458,17 +540,17 @@ void PreviewWidget::updateHorizShiftMovable(int h) {
         m_old_mx = h;
     m_mx = h;
     m_old_my = m_my;
-    m_prevComputed = QRegion();
+    invalidateMovable();
 }
 
 void PreviewWidget::updateVertShiftPivot(int v) {
     m_py = v;
-    m_prevComputed = QRegion();
+    invalidatePivot();
 }
 
 void PreviewWidget::updateHorizShiftPivot(int h) {
     m_px = h;
-    m_prevComputed = QRegion();
+    invalidatePivot();
 }
 
 void PreviewWidget::fitToWindow() {
@@ -496,6 +578,7 @@ void PreviewWidget::fitToWindow() {
 
         emit changed(this);
     }
+    renderExposedTiles();
 }
 
 bool PreviewWidget::isFittedToWindow() {
@@ -527,6 +610,7 @@ void PreviewWidget::fillToWindow() {
 
         emit changed(this);
     }
+    renderExposedTiles();
 }
 
 bool PreviewWidget::isFilledToWindow() {
@@ -543,6 +627,7 @@ void PreviewWidget::normalSize() {
     qreal scale_by = 1.0f / curr_scale_factor;
 
     mView->scale(scale_by, scale_by);
+    renderExposedTiles();
 
     emit changed(this);
 }
@@ -645,15 +730,17 @@ void PreviewWidget::slotCornerButtonPressed() {
 
     // is there a way to avoid this call?
     // how expensive is to call this function?
-    mPanIconWidget->setImage(m_previewImage);
+    mPanIconWidget->setImage(getPreviewImage());
 
     float zf = this->getScaleFactor();
     float leftviewpos = (float)(mView->horizontalScrollBar()->value());
     float topviewpos = (float)(mView->verticalScrollBar()->value());
     float wps_w = (float)(mView->maximumViewportSize().width());
     float wps_h = (float)(mView->maximumViewportSize().height());
-    QRect r((int)(leftviewpos / zf), (int)(topviewpos / zf), (int)(wps_w / zf),
-            (int)(wps_h / zf));
+    // the pan icon works in the coordinates of the preview
+    const float step = m_step;
+    QRect r((int)(leftviewpos / zf / step), (int)(topviewpos / zf / step),
+            (int)(wps_w / zf / step), (int)(wps_h / zf / step));
     mPanIconWidget->setRegionSelection(r);
     mPanIconWidget->setMouseFocus();
     connect(mPanIconWidget, &PanIconWidget::selectionMoved, this,
@@ -670,9 +757,9 @@ void PreviewWidget::slotCornerButtonPressed() {
 
 void PreviewWidget::slotPanIconSelectionMoved(QRect gotopos) {
     mView->horizontalScrollBar()->setValue(
-        (int)(gotopos.x() * this->getScaleFactor()));
+        (int)(gotopos.x() * m_step * this->getScaleFactor()));
     mView->verticalScrollBar()->setValue(
-        (int)(gotopos.y() * this->getScaleFactor()));
+        (int)(gotopos.y() * m_step * this->getScaleFactor()));
     emit changed(this);
 }
 
@@ -683,11 +770,13 @@ void PreviewWidget::slotPanIconHidden() {
     mCornerButton->blockSignals(false);
 }
 
-void PreviewWidget::scrollBarChanged(int /*value*/) { emit changed(this); }
+void PreviewWidget::scrollBarChanged(int /*value*/) {
+    renderExposedTiles();
+    emit changed(this);
+}
 
 void PreviewWidget::updatePreviewImage() {
-    renderPreviewImage(blendmode, m_rect);
-    mPixmap->setPixmap(QPixmap::fromImage(*m_previewImage));
+    renderExposedTiles();
     if (m_mode == AntighostingMode) {
         if ((m_mx != m_old_mx) && (m_my != m_old_my)) {
             delete m_agMask;
@@ -34,12 +34,15 @@
 #include <QScrollBar>
 #include <QToolButton>
 #include <QVBoxLayout>
+#include <QVector>
 
 #include "AutoAntighosting.h"  // Just for agGridSize !!!
+#include "PreviewBlend.h"
 
 class IGraphicsView;
 class IGraphicsPixmapItem;
 class PanIconWidget;
+class PreviewFrameItem;
 
 class PreviewWidget : public QWidget {
     Q_OBJECT
@@ -49,10 +52,12 @@ class PreviewWidget : public QWidget {
 
     PreviewWidget(QWidget *parent, QImage *m, const QImage *p);
     ~PreviewWidget();
-    QSize sizeHint() const { return m_previewImage->size(); }
+    QSize sizeHint() const { return m_movableImage->size(); }
     float getScaleFactor();
+    //! \brief the whole preview, at the resolution it is shown with: one
+    //! pixel every m_step pixels of the images
     QImage *getPreviewImage() {
-        renderPreviewImage(blendmode);
+        renderPreviewImage();
         return m_previewImage;
     }
     void setPivot(QImage *p, int p_px, int p_py);
@@ -78,6 +83,7 @@ class PreviewWidget : public QWidget {
     void setHV_offset(QPair<int, int> HV_offset) {
         m_mx = HV_offset.first;
         m_my = HV_offset.second;
+        invalidateMovable();
     }
 
     void setDrawWithBrush();
@@ -139,58 +145,31 @@ class PreviewWidget : public QWidget {
     virtual void timerEvent(QTimerEvent *event);
 
    private:
-    // 5 blending modes
-    inline QRgb computeOnlyMovable(const QRgb *Mrgba,
-                                   const QRgb * /*Prgba*/) const {
-        return *Mrgba;
-    }
-    inline QRgb computeOnlyPivot(const QRgb * /*Mrgba*/,
-                                 const QRgb *Prgba) const {
-        return *Prgba;
-    }
-    inline QRgb computeAddRgba(const QRgb *Mrgba, const QRgb *Prgba) const {
-        int ro, go, bo;
-        int Mred = qRed(*Mrgba);
-        int Mgreen = qGreen(*Mrgba);
-        int Mblue = qBlue(*Mrgba);
-        int Malpha = qAlpha(*Mrgba);
-        int Pred = qRed(*Prgba);
-        int Pgreen = qGreen(*Prgba);
-        int Pblue = qBlue(*Prgba);
-        int Palpha = qAlpha(*Prgba);
-        // blend samples using alphas as weights
-        ro = (Pred * Palpha + Mred * Malpha) / 510;
-        go = (Pgreen * Palpha + Mgreen * Malpha) / 510;
-        bo = (Pblue * Palpha + Mblue * Malpha) / 510;
-        // the output image still has alpha=255 (opaque)
-        return qRgba(ro, go, bo, 255);
-    }
-    inline QRgb computeDiffRgba(const QRgb *Mrgba, const QRgb *Prgba) const {
-        int ro, go, bo;
-        int Mred = qRed(*Mrgba);
-        int Mgreen = qGreen(*Mrgba);
-        int Mblue = qBlue(*Mrgba);
-        int Malpha = qAlpha(*Mrgba);
-        int Pred = qRed(*Prgba);
-        int Pgreen = qGreen(*Prgba);
-        int Pblue = qBlue(*Prgba);
-        int Palpha = qAlpha(*Prgba);
-        // blend samples using alphas as weights
-        ro = qAbs(Pred * Palpha - Mred * Malpha) / 255;
-        go = qAbs(Pgreen * Palpha - Mgreen * Malpha) / 255;
-        bo = qAbs(Pblue * Palpha - Mblue * Malpha) / 255;
-        // the output image still has alpha=255 (opaque)
-        return qRgba(ro, go, bo, 255);
-    }
-
-    QRgb (PreviewWidget::*blendmode)(const QRgb *, const QRgb *) const;
-    void renderPreviewImage(QRgb (PreviewWidget::*rendermode)(const QRgb *, const QRgb *)
-                                const,
-                            const QRect rect = QRect());
+    //! \brief blend mode actually rendered: the movable alone when it is
+    //! also the pivot
+    PreviewBlendMode effectiveBlendMode() const;
+    //! \brief sample the images for the zoom of the view, and resize the
+    //! preview when the zoom level changes
+    void updateLevel();
+    //! \brief render the tiles of \a rect, in the coordinates of the images,
+    //! that are out of date and upload them to the pixmap, the null rect
+    //! renders the whole image
+    void renderPreviewImage(const QRect &rect = QRect());
+    //! \brief part of the image visible in the viewport
+    QRect exposedRect() const;
+    void renderExposedTiles() { renderPreviewImage(exposedRect()); }
+    //! \brief tile grid for the size of the preview image, all out of date
+    void resetTiles();
+    void invalidateTiles();
+    //! \brief the movable (pivot) image has moved: only the blend modes
+    //! showing it need a new render
+    void invalidateMovable();
+    void invalidatePivot();
     void renderAgMask();
     void scrollAgMask(int, int);
 
-    // the out and 2 in images
+    // the out and 2 in images: the out image has one pixel every m_step
+    // pixels of the in images
     QImage *m_previewImage;
     QImage *m_movableImage;
     const QImage *m_pivotImage;
@@ -208,10 +187,22 @@ class PreviewWidget : public QWidget {
     QGraphicsScene *mScene;
     IGraphicsView *mView;
     ViewerMode mViewerMode;
-    IGraphicsPixmapItem *mPixmap, *mAgPixmap;
-
-    QRegion m_prevComputed;
-    QRect m_rect;
+    // mPixmap has the size of the images, for the selection and the masks,
+    // and draws the preview through m_displayItem, scaled by m_step
+    PreviewFrameItem *mPixmap;
+    QGraphicsPixmapItem *m_displayItem;
+    IGraphicsPixmapItem *mAgPixmap;
+
+    PreviewBlendMode m_blendMode;
+    // zoomed out views blend one sample every m_step pixels: the samples of
+    // the two images are kept while they move
+    int m_step;
+    PreviewLevel m_movableLevel;
+    PreviewLevel m_pivotLevel;
+    // the preview is rendered in square tiles, and only the tiles exposed in
+    // the viewport are kept up to date
+    QVector<bool> m_validTiles;
+    int m_tilesX, m_tilesY;
     // movable and pivot's x,y shifts
     int m_mx, m_my, m_px, m_py;
     int m_old_mx, m_old_my;
@@ -0,0 +1,121 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "ResponseCurveCache.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include <cstring>
+
+#include "SettingsConnection.h"
+
+using namespace libhdr::fusion;
+
+namespace {
+
+const int BLOB_SIZE = sizeof(float) * ResponseCurve::NUM_BINS;
+
+const QString CREATE_TABLE = QStringLiteral(
+    " CREATE TABLE IF NOT EXISTS response_curves (camera varchar(150) NOT \
+    NULL, iso integer NOT NULL, weight integer NOT NULL, response integer \
+    NOT NULL, red blob, green blob, blue blob, \
+    PRIMARY KEY (camera, iso, weight, response));");
+
+void bindKey(QSqlQuery &query, const ResponseCurveCache::Key &key) {
+    query.bindValue(QStringLiteral(":camera"), key.camera);
+    query.bindValue(QStringLiteral(":iso"), key.iso);
+    query.bindValue(QStringLiteral(":weight"), static_cast<int>(key.weight));
+    query.bindValue(QStringLiteral(":response"),
+                    static_cast<int>(key.response));
+}
+
+QByteArray toBlob(const ResponseCurve::ResponseContainer &response) {
+    return QByteArray(reinterpret_cast<const char *>(response.data()),
+                      BLOB_SIZE);
+}
+
+bool fromBlob(const QByteArray &blob,
+              ResponseCurve::ResponseContainer &response) {
+    if (blob.size() != BLOB_SIZE) return false;
+
+    std::memcpy(response.data(), blob.constData(), BLOB_SIZE);
+    return true;
+}
+
+}  // anonymous
+
+bool ResponseCurveCache::load(const Key &key, ResponseCurve &response) {
+    SettingsConnection connection(QStringLiteral("ResponseCurveCache"),
+                                  CREATE_TABLE);
+    if (!connection.isOpen()) return false;
+
+    QSqlQuery query(connection.database());
+    query.prepare(QStringLiteral(
+        "SELECT red, green, blue FROM response_curves WHERE camera = :camera "
+        "AND iso = :iso AND weight = :weight AND response = :response;"));
+    bindKey(query, key);
+    if (!query.exec()) {
+        qDebug() << query.lastError();
+        return false;
+    }
+    if (!query.next()) return false;
+
+    ResponseCurve::ResponseContainer red, green, blue;
+    if (!fromBlob(query.value(0).toByteArray(), red) ||
+        !fromBlob(query.value(1).toByteArray(), green) ||
+        !fromBlob(query.value(2).toByteArray(), blue)) {
+        return false;
+    }
+
+    response.setType(RESPONSE_CUSTOM);
+    response.get(RESPONSE_CHANNEL_RED) = red;
+    response.get(RESPONSE_CHANNEL_GREEN) = green;
+    response.get(RESPONSE_CHANNEL_BLUE) = blue;
+    return true;
+}
+
+bool ResponseCurveCache::store(const Key &key, const ResponseCurve &response) {
+    SettingsConnection connection(QStringLiteral("ResponseCurveCache"),
+                                  CREATE_TABLE);
+    if (!connection.isOpen()) return false;
+
+    QSqlQuery query(connection.database());
+    query.prepare(QStringLiteral(
+        "INSERT OR REPLACE INTO response_curves (camera, iso, weight, "
+        "response, red, green, blue) VALUES (:camera, :iso, :weight, "
+        ":response, :red, :green, :blue);"));
+    bindKey(query, key);
+    query.bindValue(QStringLiteral(":red"),
+                    toBlob(response.get(RESPONSE_CHANNEL_RED)));
+    query.bindValue(QStringLiteral(":green"),
+                    toBlob(response.get(RESPONSE_CHANNEL_GREEN)));
+    query.bindValue(QStringLiteral(":blue"),
+                    toBlob(response.get(RESPONSE_CHANNEL_BLUE)));
+    if (!query.exec()) {
+        qDebug() << query.lastError();
+        return false;
+    }
+    return true;
+}
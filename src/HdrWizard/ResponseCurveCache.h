@@ -0,0 +1,54 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef RESPONSECURVECACHE_H
+#define RESPONSECURVECACHE_H
+
+#include <QString>
+
+#include <HdrCreation/responses.h>
+#include <HdrCreation/weights.h>
+
+//! \brief Response curves estimated by Robertson02, stored in the settings
+//! database, so that a new stack shot with the same camera does not need to
+//! go through the estimation again.
+//! \note Every call opens its own connection: the cache can be used from the
+//! worker thread that runs the HDR creation.
+class ResponseCurveCache {
+   public:
+    //! \brief everything the estimated curve depends on, besides the images
+    struct Key {
+        QString camera;
+        int iso;
+        libhdr::fusion::WeightFunctionType weight;
+        //! curve the estimation starts from
+        libhdr::fusion::ResponseCurveType response;
+    };
+
+    //! \brief load the curve stored for \c key into \c response
+    //! \return true if a curve was found
+    static bool load(const Key &key, libhdr::fusion::ResponseCurve &response);
+
+    //! \brief store (or replace) the curve of \c key
+    static bool store(const Key &key,
+                      const libhdr::fusion::ResponseCurve &response);
+};
+
+#endif  // RESPONSECURVECACHE_H
@@ -0,0 +1,59 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "SettingsConnection.h"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <atomic>
+
+#include <Common/LuminanceOptions.h>
+
+namespace {
+std::atomic<int> s_counter(0);
+}
+
+SettingsConnection::SettingsConnection(const QString &prefix,
+                                       const QString &createTable)
+    : m_name(QStringLiteral("%1_%2").arg(prefix).arg(s_counter.fetch_add(1))),
+      m_isOpen(false) {
+    QSqlDatabase db =
+        QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_name);
+    db.setDatabaseName(LuminanceOptions().getDatabaseFileName());
+    db.setHostName(QStringLiteral("localhost"));
+    if (!db.open()) {
+        qDebug() << db.lastError();
+        return;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec(createTable)) {
+        qDebug() << query.lastError();
+        return;
+    }
+    m_isOpen = true;
+}
+
+SettingsConnection::~SettingsConnection() {
+    QSqlDatabase::database(m_name, false).close();
+    QSqlDatabase::removeDatabase(m_name);
+}
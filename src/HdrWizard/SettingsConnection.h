@@ -0,0 +1,50 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef SETTINGSCONNECTION_H
+#define SETTINGSCONNECTION_H
+
+#include <QSqlDatabase>
+#include <QString>
+
+//! \brief private connection to the settings database, removed on exit
+//! \note QSqlDatabase connections cannot be shared among threads: every
+//! instance opens its own, under a unique name, so that it can be used from
+//! any thread.
+class SettingsConnection {
+   public:
+    //! \param prefix of the name of the connection
+    //! \param createTable statement creating the table used by the caller,
+    //! if it does not exist
+    SettingsConnection(const QString &prefix, const QString &createTable);
+    ~SettingsConnection();
+
+    bool isOpen() const { return m_isOpen; }
+    QSqlDatabase database() const { return QSqlDatabase::database(m_name); }
+
+   private:
+    SettingsConnection(const SettingsConnection &);
+    SettingsConnection &operator=(const SettingsConnection &);
+
+    QString m_name;
+    bool m_isOpen;
+};
+
+#endif  // SETTINGSCONNECTION_H
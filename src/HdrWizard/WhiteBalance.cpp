@@ -12,6 +12,7 @@
 #include <Libpfs/utils/chain.h>
 #include <Libpfs/utils/clamp.h>
 #include <Libpfs/utils/numeric.h>
+#include <Libpfs/utils/statistics.h>
 #include <Libpfs/utils/transform.h>
 #include "Libpfs/utils/msec_timer.h"
 
@@ -19,72 +20,25 @@ using namespace pfs;
 using namespace pfs::colorspace;
 using namespace pfs::utils;
 
-void computeHistogram(const pfs::Array2Df &data, std::vector<size_t> &histogram,
-                      float min, float max) {
-    Normalizer norm(min, max);
-    for (pfs::Array2Df::const_iterator it = data.begin(), itEnd = data.end();
-         it != itEnd; ++it) {
-        // 1.0f -> histogram.size() - 1
-
-        size_t bin =
-            static_cast<size_t>(norm(*it) * (histogram.size() - 1) + 0.5f);
-        ++histogram[bin];
-    }
+namespace {
+//! fractions of the darkest and of the brightest samples clipped by
+//! WB_COLORBALANCE
+const float COLORBALANCE_MIN = 0.005f;
+const float COLORBALANCE_MAX = 0.995f;
 }
 
-std::pair<float, float> quantiles(const pfs::Array2Df &data, float nb_min,
-                                  float nb_max, float min, float max) {
-    // compute histogram (less expensive than sorting the entire sequence...
-    std::vector<size_t> hist(65535, 0);
-    computeHistogram(data, hist, min, max);
-
-    // normalize percentiles to image size...
-    size_t lb_percentile = static_cast<size_t>(nb_min * data.size() + 0.5f);
-    size_t ub_percentile = static_cast<size_t>(nb_max * data.size() + 0.5f);
-
-    size_t counter = 0;
-    std::pair<float, float> minmax;
-    for (size_t idx = 0; idx < hist.size(); ++idx) {
-        counter += hist[idx];
-        if (counter >= lb_percentile) {
-            minmax.first =
-                static_cast<float>(idx) / (hist.size() - 1) * (max - min) + min;
-            break;
-        }
-    }
-
-    counter = 0;
-    for (size_t idx = 0; idx < hist.size(); ++idx) {
-        counter += hist[idx];
-        if (counter >= ub_percentile) {
-            minmax.second =
-                static_cast<float>(idx) / (hist.size() - 1) * (max - min) + min;
-            break;
-        }
+//! \brief range of the samples to stretch to [0, 1]: [min, max], or the
+//! percentiles \a nb_min and \a nb_max when they clip some samples
+std::pair<float, float> balanceRange(const ChannelStatistics &stats,
+                                     float nb_min, float nb_max) {
+    if (nb_min > 0.f || nb_max < 1.f) {
+        return std::pair<float, float>(stats.getPercentile(nb_min),
+                                       stats.getPercentile(nb_max));
     }
-
-#ifndef NDEBUG
-    std::cout << "([" << nb_min << ", " << min << ", " << lb_percentile << "]"
-                                                                           ", ["
-              << nb_max << ", " << max << ", " << ub_percentile << "])"
-              << std::endl;
-#endif
-
-    return minmax;
+    return std::pair<float, float>(stats.getMin(), stats.getMax());
 }
 
-std::pair<float, float> getMinMax(const pfs::Array2Df &data) {
-    std::pair<pfs::Array2Df::const_iterator, pfs::Array2Df::const_iterator>
-        minmax = minmax_element(data.begin(), data.end());
-
-    return std::pair<float, float>(*minmax.first, *minmax.second);
-}
-
-void balance(pfs::Array2Df &data, float nb_min, float nb_max) {
-    std::pair<float, float> minmax = getMinMax(data);
-    if (nb_min > 0.f || nb_max < 1.f) {
-        minmax = quantiles(data, nb_min, nb_max, minmax.first, minmax.second);
-    }
+void balance(pfs::Array2Df &data, const std::pair<float, float> &minmax) {
     std::transform(data.begin(), data.end(), data.begin(),
                    utils::chain(utils::ClampF32(minmax.first, minmax.second),
                                 Normalizer(minmax.first, minmax.second)));
@@ -102,7 +56,10 @@ void checkParameterValidity(float &nb_min, float &nb_max) {
     }
 }
 
-void colorBalanceRGB(Array2Df &R, Array2Df &G, Array2Df &B, float nb_min,
+void colorBalanceRGB(Array2Df &R, Array2Df &G, Array2Df &B,
+                     const ChannelStatistics &statsR,
+                     const ChannelStatistics &statsG,
+                     const ChannelStatistics &statsB, float nb_min,
                      float nb_max) {
     checkParameterValidity(nb_min, nb_max);
 
@@ -111,21 +68,27 @@ void colorBalanceRGB(Array2Df &R, Array2Df &G, Array2Df &B, float nb_min,
 #pragma omp section
         {
             /* Executes in thread 1 */
-            balance(R, nb_min, nb_max);
+            balance(R, balanceRange(statsR, nb_min, nb_max));
         }
 #pragma omp section
         {
             /* Executes in thread 2 */
-            balance(G, nb_min, nb_max);
+            balance(G, balanceRange(statsG, nb_min, nb_max));
         }
 #pragma omp section
         {
             /* Executes in thread 3 */
-            balance(B, nb_min, nb_max);
+            balance(B, balanceRange(statsB, nb_min, nb_max));
         }
     }
 }
 
+void colorBalanceRGB(Array2Df &R, Array2Df &G, Array2Df &B, float nb_min,
+                     float nb_max) {
+    colorBalanceRGB(R, G, B, ChannelStatistics(R), ChannelStatistics(G),
+                    ChannelStatistics(B), nb_min, nb_max);
+}
+
 void robustAWB(Array2Df *R_orig, Array2Df *G_orig, Array2Df *B_orig) {
 #ifdef TIMER_PROFILING
     msec_timer stop_watch;
@@ -286,6 +249,28 @@ void shadesOfGrayAWB(Array2Df &R, Array2Df &G, Array2Df &B) {
 }
 
 void whiteBalance(Frame &frame, WhiteBalanceType type) {
+    if (type == WB_COLORBALANCE) {
+        // the frame keeps the statistics of its channels: take them before
+        // the channels, that drops them
+        const Frame &constFrame = frame;
+        std::shared_ptr<const ChannelStatistics> statsR =
+            constFrame.getStatistics("X");
+        std::shared_ptr<const ChannelStatistics> statsG =
+            constFrame.getStatistics("Y");
+        std::shared_ptr<const ChannelStatistics> statsB =
+            constFrame.getStatistics("Z");
+        if (statsR && statsG && statsB) {
+            Channel *r;
+            Channel *g;
+            Channel *b;
+            frame.getXYZChannels(r, g, b);
+
+            colorBalanceRGB(*r, *g, *b, *statsR, *statsG, *statsB,
+                            COLORBALANCE_MIN, COLORBALANCE_MAX);
+            return;
+        }
+    }
+
     Channel *r;
     Channel *g;
     Channel *b;
@@ -298,7 +283,7 @@ void whiteBalance(pfs::Array2Df &R, pfs::Array2Df &G, pfs::Array2Df &B,
                   WhiteBalanceType type) {
     switch (type) {
         case WB_COLORBALANCE: {
-            colorBalanceRGB(R, G, B, 0.005, 0.995);
+            colorBalanceRGB(R, G, B, COLORBALANCE_MIN, COLORBALANCE_MAX);
         } break;
         case WB_ROBUST: {
             robustAWB(&R, &G, &B);
@@ -0,0 +1,116 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef PFS_ARRAY2DVIEW_H
+#define PFS_ARRAY2DVIEW_H
+
+#include <cstddef>
+
+#include <Libpfs/array2d.h>
+
+//! \file array2dview.h
+//! \brief non-owning rectangular window over an \c Array2D
+
+namespace pfs {
+
+//!
+//! \brief Read-only window of \a cols times \a rows over an \c Array2D
+//!
+//! The window starts at column \a x0 and row \a y0 of the array and walks
+//! it with the stride of the array: cutting or shifting a view never touches
+//! the data. The window can lie partly (or entirely) outside of the array,
+//! as it happens after a shift: the pixels outside read as Type(), as the
+//! border filled by pfs::shift().
+//! The view is valid as long as the array is alive and is not resized.
+//!
+template <typename Type>
+class Array2DView {
+   public:
+    typedef Array2D<Type> ArrayType;
+    typedef typename ArrayType::const_iterator const_iterator;
+    typedef Array2DView<Type> self;
+
+    //! \brief empty view
+    Array2DView();
+
+    //! \brief view of the whole \a array
+    explicit Array2DView(const ArrayType &array);
+
+    //! \brief view of \a cols times \a rows starting at (\a x0, \a y0)
+    Array2DView(const ArrayType &array, int x0, int y0, size_t cols,
+                size_t rows);
+
+    size_t getCols() const { return m_cols; }
+    size_t getRows() const { return m_rows; }
+    size_t size() const { return m_cols * m_rows; }
+
+    //! \brief position of the first pixel of the view in the array
+    int getOffsetX() const { return m_x0; }
+    int getOffsetY() const { return m_y0; }
+    //! \brief elements between two rows of the view
+    size_t getStride() const { return m_array ? m_array->getCols() : 0; }
+
+    const ArrayType *array() const { return m_array; }
+
+    //! \return element (\a col, \a row) of the view, Type() outside the array
+    Type operator()(size_t col, size_t row) const;
+
+    //! \brief view of [\a x_ul, \a x_br) x [\a y_ul, \a y_br), as pfs::cut()
+    //! \note The corners are clamped to the size of this view. O(1).
+    self cut(size_t x_ul, size_t y_ul, size_t x_br, size_t y_br) const;
+
+    //! \brief view of the same size, element (x, y) of which is element
+    //! (x + \a dx, y + \a dy) of this one, as pfs::shift() of an Array2D. O(1).
+    self shift(int dx, int dy) const;
+
+    //! \brief the columns [colBegin(), colEnd()) and rows [rowBegin(),
+    //! rowEnd()) of the view are inside the array, everything else is border
+    size_t colBegin() const;
+    size_t colEnd() const;
+    size_t rowBegin() const;
+    size_t rowEnd() const;
+
+    //! \brief whether the view has no border
+    bool isInside() const;
+
+    //! \brief part of \a row inside the array, from column colBegin() to
+    //! colEnd()
+    //! \note \a row must be in [rowBegin(), rowEnd())
+    const_iterator row_begin(size_t row) const;
+    const_iterator row_end(size_t row) const;
+
+    //! \brief copy the view into \a out, that must be of the same size
+    void copyTo(ArrayType &out) const;
+
+   private:
+    const ArrayType *m_array;
+    int m_x0;
+    int m_y0;
+    size_t m_cols;
+    size_t m_rows;
+};
+
+typedef Array2DView<float> Array2DViewf;
+
+}  // namespace pfs
+
+#include <Libpfs/array2dview.hxx>
+
+#endif  // PFS_ARRAY2DVIEW_H
@@ -0,0 +1,168 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef PFS_ARRAY2DVIEW_HXX
+#define PFS_ARRAY2DVIEW_HXX
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include <Libpfs/array2dview.h>
+
+namespace pfs {
+
+namespace detail {
+inline size_t clampIndex(std::ptrdiff_t value, size_t lo, size_t hi) {
+    if (value < static_cast<std::ptrdiff_t>(lo)) return lo;
+    if (value > static_cast<std::ptrdiff_t>(hi)) return hi;
+    return static_cast<size_t>(value);
+}
+}  // namespace detail
+
+template <typename Type>
+Array2DView<Type>::Array2DView()
+    : m_array(NULL), m_x0(0), m_y0(0), m_cols(0), m_rows(0) {}
+
+template <typename Type>
+Array2DView<Type>::Array2DView(const ArrayType &array)
+    : m_array(&array),
+      m_x0(0),
+      m_y0(0),
+      m_cols(array.getCols()),
+      m_rows(array.getRows()) {}
+
+template <typename Type>
+Array2DView<Type>::Array2DView(const ArrayType &array, int x0, int y0,
+                               size_t cols, size_t rows)
+    : m_array(&array), m_x0(x0), m_y0(y0), m_cols(cols), m_rows(rows) {}
+
+template <typename Type>
+Type Array2DView<Type>::operator()(size_t col, size_t row) const {
+    assert(col < m_cols);
+    assert(row < m_rows);
+    if (col < colBegin() || col >= colEnd() || row < rowBegin() ||
+        row >= rowEnd()) {
+        return Type();
+    }
+    // through the iterators, Array2D<bool> has no reference to an element
+    return *(m_array->row_begin(row + m_y0) + (col + m_x0));
+}
+
+template <typename Type>
+Array2DView<Type> Array2DView<Type>::cut(size_t x_ul, size_t y_ul, size_t x_br,
+                                         size_t y_br) const {
+    x_br = std::min(x_br, m_cols);
+    y_br = std::min(y_br, m_rows);
+    x_ul = std::min(x_ul, x_br);
+    y_ul = std::min(y_ul, y_br);
+
+    self view(*this);
+    view.m_x0 += static_cast<int>(x_ul);
+    view.m_y0 += static_cast<int>(y_ul);
+    view.m_cols = x_br - x_ul;
+    view.m_rows = y_br - y_ul;
+    return view;
+}
+
+template <typename Type>
+Array2DView<Type> Array2DView<Type>::shift(int dx, int dy) const {
+    self view(*this);
+    view.m_x0 += dx;
+    view.m_y0 += dy;
+    return view;
+}
+
+template <typename Type>
+size_t Array2DView<Type>::colBegin() const {
+    return detail::clampIndex(-static_cast<std::ptrdiff_t>(m_x0), 0, m_cols);
+}
+
+template <typename Type>
+size_t Array2DView<Type>::colEnd() const {
+    if (m_array == NULL) return colBegin();
+    return detail::clampIndex(
+        static_cast<std::ptrdiff_t>(m_array->getCols()) - m_x0, colBegin(),
+        m_cols);
+}
+
+template <typename Type>
+size_t Array2DView<Type>::rowBegin() const {
+    return detail::clampIndex(-static_cast<std::ptrdiff_t>(m_y0), 0, m_rows);
+}
+
+template <typename Type>
+size_t Array2DView<Type>::rowEnd() const {
+    if (m_array == NULL) return rowBegin();
+    return detail::clampIndex(
+        static_cast<std::ptrdiff_t>(m_array->getRows()) - m_y0, rowBegin(),
+        m_rows);
+}
+
+template <typename Type>
+bool Array2DView<Type>::isInside() const {
+    return colBegin() == 0 && colEnd() == m_cols && rowBegin() == 0 &&
+           rowEnd() == m_rows;
+}
+
+template <typename Type>
+typename Array2DView<Type>::const_iterator Array2DView<Type>::row_begin(
+    size_t row) const {
+    assert(row >= rowBegin() && row < rowEnd());
+    return m_array->row_begin(row + m_y0) +
+           (static_cast<std::ptrdiff_t>(colBegin()) + m_x0);
+}
+
+template <typename Type>
+typename Array2DView<Type>::const_iterator Array2DView<Type>::row_end(
+    size_t row) const {
+    return row_begin(row) + (colEnd() - colBegin());
+}
+
+template <typename Type>
+void Array2DView<Type>::copyTo(ArrayType &out) const {
+    assert(out.getCols() == m_cols);
+    assert(out.getRows() == m_rows);
+
+    // rows of Array2D<bool> share words, they cannot be written in parallel
+    const bool parallel = !std::is_same<Type, bool>::value;
+
+    const size_t c0 = colBegin();
+    const size_t c1 = colEnd();
+    const int r0 = static_cast<int>(rowBegin());
+    const int r1 = static_cast<int>(rowEnd());
+    const int rEnd = static_cast<int>(m_rows);
+#pragma omp parallel for if (parallel)
+    for (int r = 0; r < rEnd; r++) {
+        typename ArrayType::iterator it = out.row_begin(r);
+        if (r < r0 || r >= r1 || c0 == c1) {
+            std::fill(it, out.row_end(r), Type());
+            continue;
+        }
+        std::fill(it, it + c0, Type());
+        std::copy(row_begin(r), row_end(r), it + c0);
+        std::fill(it + c1, out.row_end(r), Type());
+    }
+}
+
+}  // namespace pfs
+
+#endif  // PFS_ARRAY2DVIEW_HXX
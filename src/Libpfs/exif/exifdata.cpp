@@ -22,6 +22,7 @@
 #include "exifdata.hpp"
 
 #include <cmath>
+#include <cstdio>
 #include <exiv2/exiv2.hpp>
 #include <iostream>
 
@@ -43,6 +44,38 @@ const float DEFAULT_EVCOMP = 0.0f;
 float log_base(float value, float base) {
     return (std::log(value) / std::log(base));
 }
+
+//! \brief days between 1970-01-01 and \a y-\a m-\a d (proleptic Gregorian)
+long daysFromCivil(long y, long m, long d) {
+    y -= (m <= 2);
+    const long era = (y >= 0 ? y : y - 399) / 400;
+    const long yoe = y - era * 400;
+    const long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+//! \brief parse an EXIF date ("YYYY:MM:DD HH:MM:SS") and its sub-seconds
+//! \return seconds since the epoch, or INVALID_VALUE
+double parseDateTime(const std::string &dateTime, const std::string &subSec) {
+    int year, month, day, hour, minute, second;
+    if (std::sscanf(dateTime.c_str(), "%d:%d:%d %d:%d:%d", &year, &month, &day,
+                    &hour, &minute, &second) != 6 ||
+        year <= 0 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return INVALID_VALUE;
+    }
+
+    double timestamp = daysFromCivil(year, month, day) * 86400.0 +
+                       hour * 3600.0 + minute * 60.0 + second;
+    // SubSecTime holds the decimals of the seconds: "5" is 0.5
+    double scale = 0.1;
+    for (char c : subSec) {
+        if (c < '0' || c > '9') break;
+        timestamp += (c - '0') * scale;
+        scale *= 0.1;
+    }
+    return timestamp;
+}
 }
 
 ExifData::ExifData() { reset(); }
@@ -56,6 +89,9 @@ void ExifData::fromFile(const std::string &filename) {
         image->readMetadata();
         ::Exiv2::ExifData &exifData = image->exifData();
 
+        m_width = image->pixelWidth();
+        m_height = image->pixelHeight();
+
         // if data is empty
         if (exifData.empty()) return;
 
@@ -106,6 +142,16 @@ MissingFNumber:
             m_EVCompensation = it->toFloat();
         }
 
+        if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.DateTimeOriginal"))) != exifData.end() ||
+            (it = exifData.findKey(Exiv2::ExifKey("Exif.Image.DateTime"))) != exifData.end()) {
+            const std::string dateTime = it->toString();
+            std::string subSec;
+            if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.SubSecTimeOriginal"))) != exifData.end()) {
+                subSec = it->toString();
+            }
+            m_timestamp = parseDateTime(dateTime, subSec);
+        }
+
         // exif orientation --------
         /*
          *           http://jpegclub.org/exif_orientation.html
@@ -185,6 +231,12 @@ float ExifData::getAverageSceneLuminance() const {
 
 short ExifData::getOrientationDegree() const { return m_orientation; }
 
+const double &ExifData::getTimestamp() const { return m_timestamp; }
+bool ExifData::hasTimestamp() const { return (m_timestamp != INVALID_VALUE); }
+
+int ExifData::getWidth() const { return m_width; }
+int ExifData::getHeight() const { return m_height; }
+
 void ExifData::reset() {
     // reset internal value
     m_exposureTime = INVALID_VALUE;
@@ -192,6 +244,9 @@ void ExifData::reset() {
     m_FNumber = INVALID_VALUE;
     m_EVCompensation = DEFAULT_EVCOMP;
     m_orientation = 0;
+    m_timestamp = INVALID_VALUE;
+    m_width = 0;
+    m_height = 0;
 }
 
 bool ExifData::isValid() const {
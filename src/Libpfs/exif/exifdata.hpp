@@ -98,6 +98,16 @@ class ExifData {
     //! Possible values are 0, 90, 180, 270.
     short getOrientationDegree() const;
 
+    //! \brief time the picture was taken, in seconds since the epoch of the
+    //! camera clock (whose time zone is unknown) with the sub-second part
+    const double& getTimestamp() const;
+    bool hasTimestamp() const;
+
+    //! \brief size of the image, as found while reading the metadata
+    //! \return 0 if unknown
+    int getWidth() const;
+    int getHeight() const;
+
     //! \brief reset Exif Data
     void reset();
 
@@ -114,6 +124,9 @@ class ExifData {
     float m_FNumber;
     float m_EVCompensation;
     short m_orientation;
+    double m_timestamp;
+    int m_width;
+    int m_height;
 };
 
 std::ostream& operator<<(std::ostream& out, const ExifData& exifdata);
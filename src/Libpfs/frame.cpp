@@ -28,16 +28,34 @@
 
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 #include "channel.h"
 #include "frame.h"
+#include "utils/statistics.h"
 
 using namespace std;
 using namespace std::placeholders;
 
 namespace pfs {
+
+//! \brief data derived from the content of the channels
+struct Frame::CachedData {
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const utils::ChannelStatistics>>
+        statistics;
+    //! level i + 1 of the mip pyramid at index i
+    std::vector<std::shared_ptr<const Frame>> pyramid;
+};
+
 Frame::Frame(size_t width, size_t height)
-    : m_width(width), m_height(height), m_X(nullptr), m_Y(nullptr), m_Z(nullptr) {}
+    : m_width(width),
+      m_height(height),
+      m_X(nullptr),
+      m_Y(nullptr),
+      m_Z(nullptr),
+      m_cache(new CachedData) {}
 
 namespace {
 struct ChannelDeleter {
@@ -54,6 +72,7 @@ Frame::~Frame() {
 
 //! \brief Changes the size of the frame
 void Frame::resize(size_t width, size_t height) {
+    contentChanged();
     for_each(m_channels.begin(), m_channels.end(),
              bind(&Channel::ChannelData::resize, _1, width, height));
 
@@ -125,6 +144,8 @@ void Frame::getXYZChannels(const Channel *&X, const Channel *&Y,
 }
 
 void Frame::getXYZChannels(Channel *&X, Channel *&Y, Channel *&Z) {
+    contentChanged();
+
     const Channel *X_;
     const Channel *Y_;
     const Channel *Z_;
@@ -152,11 +173,14 @@ const Channel *Frame::getChannel(const string &name) const {
 }
 
 Channel *Frame::getChannel(const string &name) {
+    contentChanged();
     return const_cast<Channel *>(
         static_cast<const Frame &>(*this).getChannel(name));
 }
 
 Channel *Frame::createChannel(const string &name) {
+    contentChanged();
+
     Channel *ch = nullptr;
     ChannelContainer::iterator it =
         find_if(m_channels.begin(), m_channels.end(), FindChannel(name));
@@ -180,6 +204,8 @@ Channel *Frame::createChannel(const string &name) {
 }
 
 void Frame::removeChannel(const string &channel) {
+    contentChanged();
+
     ChannelContainer::iterator it =
         find_if(m_channels.begin(), m_channels.end(), FindChannel(channel));
     if (it != m_channels.end()) {
@@ -197,7 +223,10 @@ void Frame::removeChannel(const string &channel) {
     }
 }
 
-ChannelContainer &Frame::getChannels() { return this->m_channels; }
+ChannelContainer &Frame::getChannels() {
+    contentChanged();
+    return this->m_channels;
+}
 
 const ChannelContainer &Frame::getChannels() const { return this->m_channels; }
 
@@ -216,6 +245,90 @@ void Frame::swap(Frame &other) {
     swap(m_X, other.m_X);
     swap(m_Y, other.m_Y);
     swap(m_Z, other.m_Z);
+
+    // the cached data follows the channels
+    swap(m_cache, other.m_cache);
+}
+
+std::shared_ptr<const utils::ChannelStatistics> Frame::getStatistics(
+    const string &name) const {
+    const Channel *channel = getChannel(name);
+    if (channel == nullptr) {
+        return std::shared_ptr<const utils::ChannelStatistics>();
+    }
+
+    // computed under the lock: concurrent requests wait for a single pass
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    std::shared_ptr<const utils::ChannelStatistics> &stats =
+        m_cache->statistics[name];
+    if (!stats) {
+        stats = std::make_shared<utils::ChannelStatistics>(*channel);
+    }
+    return stats;
+}
+
+namespace {
+//! \brief 2x2 box filter of \a in into \a out, half its size
+void halve(const Channel &in, Channel &out) {
+    const int inWidth = in.getCols();
+    const int width = out.getCols();
+    const int height = out.getRows();
+
+#pragma omp parallel for
+    for (int y = 0; y < height; ++y) {
+        const float *row0 = in.data() + (2 * y) * inWidth;
+        const float *row1 = row0 + inWidth;
+        float *dst = out.data() + y * width;
+        for (int x = 0; x < width; ++x) {
+            dst[x] = 0.25f * ((row0[2 * x] + row0[2 * x + 1]) +
+                              (row1[2 * x] + row1[2 * x + 1]));
+        }
+    }
+}
+}
+
+std::shared_ptr<const Frame> Frame::getPyramidLevel(size_t minWidth,
+                                                    size_t minHeight) const {
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    std::vector<std::shared_ptr<const Frame>> &pyramid = m_cache->pyramid;
+
+    std::shared_ptr<const Frame> level;
+    for (size_t i = 0;; ++i) {
+        const Frame &previous = (i == 0) ? *this : *pyramid[i - 1];
+        const size_t width = previous.getWidth() / 2;
+        const size_t height = previous.getHeight() / 2;
+        if (width < std::max<size_t>(minWidth, 1) ||
+            height < std::max<size_t>(minHeight, 1)) {
+            return level;
+        }
+
+        if (i == pyramid.size()) {
+            std::shared_ptr<Frame> next = std::make_shared<Frame>(width, height);
+            for (const Channel *channel : previous.getChannels()) {
+                halve(*channel, *next->createChannel(channel->getName()));
+            }
+            copyTags(&previous, next.get());
+            pyramid.push_back(next);
+        }
+        level = pyramid[i];
+    }
+}
+
+void Frame::contentChanged() {
+    std::lock_guard<std::mutex> lock(m_cache->mutex);
+    m_cache->statistics.clear();
+    m_cache->pyramid.clear();
+}
+
+void Frame::copyCachedData(const Frame &other) {
+    if (&other == this) return;
+
+    std::unique_lock<std::mutex> lockThis(m_cache->mutex, std::defer_lock);
+    std::unique_lock<std::mutex> lockOther(other.m_cache->mutex,
+                                           std::defer_lock);
+    std::lock(lockThis, lockOther);
+    m_cache->statistics = other.m_cache->statistics;
+    m_cache->pyramid = other.m_cache->pyramid;
 }
 
 }  // namespace pfs
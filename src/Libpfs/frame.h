@@ -39,6 +39,10 @@
 
 namespace pfs {
 
+namespace utils {
+class ChannelStatistics;
+}
+
 typedef std::vector<Channel *> ChannelContainer;
 
 //! Interface representing a single PFS frame. Frame may contain 0
@@ -127,7 +131,40 @@ class Frame {
 
     void swap(Frame &other);
 
+    //! \brief Statistics of a channel, computed on the first request and
+    //! cached until the frame is modified. Safe to call from several threads
+    //! at once.
+    //! \note Every non-const access to the channels drops the cached data,
+    //! so request the statistics you need before taking the channels for
+    //! writing. Code writing through channel pointers taken before a call to
+    //! getStatistics() must call contentChanged() when done.
+    //!
+    //! \param name [in] name of the channel
+    //! \return statistics or an empty pointer if the channel does not exist
+    std::shared_ptr<const utils::ChannelStatistics> getStatistics(
+        const std::string &name) const;
+
+    //! \brief Smallest level of the mip pyramid of the frame that is still at
+    //! least \a minWidth x \a minHeight. Every level halves the previous one
+    //! with a 2x2 box filter (a trailing odd row or column is dropped). Levels
+    //! are built on the first request and cached like the statistics.
+    //! \note pfs::resize starts from here when shrinking a frame
+    //!
+    //! \return level, or an empty pointer if the first level is already too
+    //! small
+    std::shared_ptr<const Frame> getPyramidLevel(size_t minWidth,
+                                                 size_t minHeight) const;
+
+    //! \brief Drops the data cached from the content of the channels
+    void contentChanged();
+
+    //! \brief Takes over the data cached by \a other, whose channels hold the
+    //! same content (e.g. \a other has just been copied into this frame)
+    void copyCachedData(const Frame &other);
+
    private:
+    struct CachedData;
+
     size_t m_width;
     size_t m_height;
 
@@ -138,6 +175,8 @@ class Frame {
     Channel *m_X;
     Channel *m_Y;
     Channel *m_Z;
+
+    std::unique_ptr<CachedData> m_cache;
 };
 
 typedef std::shared_ptr<pfs::Frame> FramePtr;
@@ -0,0 +1,83 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <Libpfs/frameview.h>
+
+#include <algorithm>
+
+#include <Libpfs/frame.h>
+
+namespace pfs {
+
+FrameView::FrameView(const Frame &frame)
+    : m_frame(&frame),
+      m_x0(0),
+      m_y0(0),
+      m_width(frame.getWidth()),
+      m_height(frame.getHeight()) {}
+
+FrameView FrameView::cut(size_t x_ul, size_t y_ul, size_t x_br,
+                         size_t y_br) const {
+    x_br = std::min(x_br, m_width);
+    y_br = std::min(y_br, m_height);
+    x_ul = std::min(x_ul, x_br);
+    y_ul = std::min(y_ul, y_br);
+
+    FrameView view(*this);
+    view.m_x0 += static_cast<int>(x_ul);
+    view.m_y0 += static_cast<int>(y_ul);
+    view.m_width = x_br - x_ul;
+    view.m_height = y_br - y_ul;
+    return view;
+}
+
+FrameView FrameView::shift(int dx, int dy) const {
+    FrameView view(*this);
+    view.m_x0 -= dx;
+    view.m_y0 -= dy;
+    return view;
+}
+
+Array2DViewf FrameView::channel(const Channel &channel) const {
+    return Array2DViewf(channel, m_x0, m_y0, m_width, m_height);
+}
+
+Array2DViewf FrameView::channel(const std::string &name) const {
+    const Channel *ch = m_frame->getChannel(name);
+    if (ch == NULL) return Array2DViewf();
+    return channel(*ch);
+}
+
+Frame *FrameView::materialize() const {
+    Frame *outFrame = new Frame(m_width, m_height);
+
+    const ChannelContainer &channels = m_frame->getChannels();
+    for (ChannelContainer::const_iterator it = channels.begin();
+         it != channels.end(); ++it) {
+        Channel *outCh = outFrame->createChannel((*it)->getName());
+        channel(**it).copyTo(*outCh);
+    }
+
+    copyTags(m_frame, outFrame);
+
+    return outFrame;
+}
+
+}  // namespace pfs
@@ -0,0 +1,76 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef PFS_FRAMEVIEW_H
+#define PFS_FRAMEVIEW_H
+
+#include <string>
+
+#include <Libpfs/array2dview.h>
+#include <Libpfs/channel.h>
+
+namespace pfs {
+
+class Frame;
+
+//! \brief Read-only window over a \c Frame
+//!
+//! Cuts and shifts only move the window: the pixels are copied once, when
+//! the view is materialised (or read through the views of its channels).
+//! The pixels of the window outside of the frame read as 0.
+//! The view is valid as long as the frame is alive and is not resized.
+class FrameView {
+   public:
+    //! \brief view of the whole \a frame
+    explicit FrameView(const Frame &frame);
+
+    size_t getWidth() const { return m_width; }
+    size_t getHeight() const { return m_height; }
+    int getOffsetX() const { return m_x0; }
+    int getOffsetY() const { return m_y0; }
+
+    const Frame &frame() const { return *m_frame; }
+
+    //! \brief view of [\a x_ul, \a x_br) x [\a y_ul, \a y_br), as pfs::cut()
+    FrameView cut(size_t x_ul, size_t y_ul, size_t x_br, size_t y_br) const;
+
+    //! \brief view with the content moved by \a dx \a dy, as pfs::shift()
+    //! of a Frame
+    FrameView shift(int dx, int dy) const;
+
+    //! \brief the window over \a channel, that must belong to frame()
+    Array2DViewf channel(const Channel &channel) const;
+    //! \brief the window over the channel \a name, empty if it is missing
+    Array2DViewf channel(const std::string &name) const;
+
+    //! \brief new Frame with a copy of the window and the tags of the source
+    Frame *materialize() const;
+
+   private:
+    const Frame *m_frame;
+    int m_x0;
+    int m_y0;
+    size_t m_width;
+    size_t m_height;
+};
+
+}  // namespace pfs
+
+#endif  // PFS_FRAMEVIEW_H
@@ -0,0 +1,227 @@
+/*
+ * This file is a part of Luminance HDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "filesizeestimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iostream>
+
+#include <Libpfs/channel.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/io/jpegwriter.h>
+#include <Libpfs/io/pngwriter.h>
+#include <Libpfs/params.h>
+
+namespace pfs {
+namespace io {
+
+namespace {
+//! multiple of the JPEG MCU, so that no block straddles two tiles
+const int TILE_SIZE = 64;
+//! the sample is a mosaic of SAMPLE_TILES x SAMPLE_TILES tiles
+const int SAMPLE_TILES = 8;
+//! side of the frame encoded to measure the headers
+const int HEADER_SIZE = 16;
+
+//! JPEG switches off chroma subsampling at 70: both sides are sampled
+const int JPEG_QUALITIES[] = {5, 25, 50, 69, 70, 80, 90, 95, 100};
+
+//! same mapping as PngWriterParams::compressionLevel()
+int pngLevel(int quality) {
+    return 9 - static_cast<int>(static_cast<float>(quality) / 11.11111f + 0.5f);
+}
+
+//! \brief copy \a width x \a height pixels at (\a x, \a y) of \a in at
+//! (\a outX, \a outY) of \a out
+void copyTile(const pfs::Frame &in, int x, int y, int width, int height,
+              pfs::Frame &out, int outX, int outY) {
+    const Channel *inC[3];
+    in.getXYZChannels(inC[0], inC[1], inC[2]);
+    Channel *outC[3];
+    out.getXYZChannels(outC[0], outC[1], outC[2]);
+
+    for (int c = 0; c < 3; ++c) {
+        for (int row = 0; row < height; ++row) {
+            const float *src = inC[c]->data() + (y + row) * in.getWidth() + x;
+            std::copy(src, src + width,
+                      outC[c]->data() + (outY + row) * out.getWidth() + outX);
+        }
+    }
+}
+}
+
+bool FileSizeEstimator::fromString(const std::string &format, Format &out) {
+    if (format.compare(0, 2, "jp") == 0) {
+        out = FORMAT_JPEG;
+        return true;
+    }
+    if (format.compare(0, 3, "png") == 0) {
+        out = FORMAT_PNG;
+        return true;
+    }
+    return false;
+}
+
+size_t FileSizeEstimator::encodedSize(const pfs::Frame &frame, Format format,
+                                      int quality) {
+    const Params params("quality", static_cast<size_t>(quality));
+    try {
+        switch (format) {
+            case FORMAT_JPEG: {
+                JpegWriter writer;
+                writer.write(frame, params);
+                return writer.getFileSize();
+            }
+            case FORMAT_PNG: {
+                PngWriter writer;
+                writer.write(frame, params);
+                return writer.getFileSize();
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "FileSizeEstimator: " << e.what() << std::endl;
+    }
+    return 0;
+}
+
+FileSizeEstimator::FileSizeEstimator(const pfs::Frame &frame, Format format)
+    : m_format(format), m_correction(1.0) {
+    switch (format) {
+        case FORMAT_JPEG:
+            m_qualities.assign(std::begin(JPEG_QUALITIES),
+                               std::end(JPEG_QUALITIES));
+            break;
+        case FORMAT_PNG:
+            // one quality per compression level
+            for (int q = 0; q <= 100; ++q) {
+                if (m_qualities.empty() ||
+                    pngLevel(q) != pngLevel(m_qualities.back())) {
+                    m_qualities.push_back(q);
+                }
+            }
+            break;
+    }
+    m_sizes.assign(m_qualities.size(), 0.0);
+
+    const int width = frame.getWidth();
+    const int height = frame.getHeight();
+    const int tilesX = std::min(SAMPLE_TILES, width / TILE_SIZE);
+    const int tilesY = std::min(SAMPLE_TILES, height / TILE_SIZE);
+
+    // small frames are encoded as a whole: the estimate is exact
+    const bool whole = tilesX * tilesY * 2 >= (width / TILE_SIZE) *
+                                                  (height / TILE_SIZE);
+    pfs::Frame sample(whole ? 1 : tilesX * TILE_SIZE,
+                      whole ? 1 : tilesY * TILE_SIZE);
+    pfs::Frame header(std::min(width, HEADER_SIZE),
+                      std::min(height, HEADER_SIZE));
+    if (!whole) {
+        Channel *X, *Y, *Z;
+        sample.createXYZChannels(X, Y, Z);
+        header.createXYZChannels(X, Y, Z);
+
+        // tiles evenly spread over the frame
+        for (int ty = 0; ty < tilesY; ++ty) {
+            const int y = (tilesY == 1)
+                              ? (height - TILE_SIZE) / 2
+                              : ty * (height - TILE_SIZE) / (tilesY - 1);
+            for (int tx = 0; tx < tilesX; ++tx) {
+                const int x = (tilesX == 1)
+                                  ? (width - TILE_SIZE) / 2
+                                  : tx * (width - TILE_SIZE) / (tilesX - 1);
+                copyTile(frame, x, y, TILE_SIZE, TILE_SIZE, sample,
+                         tx * TILE_SIZE, ty * TILE_SIZE);
+            }
+        }
+        copyTile(frame, 0, 0, header.getWidth(), header.getHeight(), header,
+                 0, 0);
+    }
+    const pfs::Frame &encoded = whole ? frame : sample;
+    const double scale = whole ? 1.0
+                               : static_cast<double>(width) * height /
+                                     (static_cast<double>(sample.getWidth()) *
+                                      sample.getHeight());
+
+    const int count = static_cast<int>(m_qualities.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < count; ++i) {
+        const double size =
+            static_cast<double>(encodedSize(encoded, format, m_qualities[i]));
+        if (whole) {
+            m_sizes[i] = size;
+        } else {
+            // the headers do not grow with the image
+            const double overhead =
+                static_cast<double>(encodedSize(header, format, m_qualities[i]));
+            m_sizes[i] = overhead + std::max(size - overhead, 0.0) * scale;
+        }
+    }
+}
+
+double FileSizeEstimator::sampleEstimate(int quality) const {
+    quality = std::max(0, std::min(quality, 100));
+
+    if (m_format == FORMAT_PNG) {
+        for (size_t i = 0; i < m_qualities.size(); ++i) {
+            if (pngLevel(m_qualities[i]) == pngLevel(quality)) {
+                return m_sizes[i];
+            }
+        }
+        return 0.0;
+    }
+
+    // piecewise linear in the log of the size
+    const std::vector<int>::const_iterator it =
+        std::lower_bound(m_qualities.begin(), m_qualities.end(), quality);
+    if (it == m_qualities.begin()) return m_sizes.front();
+    if (it == m_qualities.end()) return m_sizes.back();
+
+    const size_t hi = it - m_qualities.begin();
+    const size_t lo = hi - 1;
+    if (m_sizes[lo] <= 0.0 || m_sizes[hi] <= 0.0) return m_sizes[hi];
+
+    const double t = static_cast<double>(quality - m_qualities[lo]) /
+                     (m_qualities[hi] - m_qualities[lo]);
+    return std::exp((1.0 - t) * std::log(m_sizes[lo]) +
+                    t * std::log(m_sizes[hi]));
+}
+
+size_t FileSizeEstimator::estimate(int quality) const {
+    const std::map<int, size_t>::const_iterator it = m_exact.find(quality);
+    if (it != m_exact.end()) return it->second;
+
+    return static_cast<size_t>(sampleEstimate(quality) * m_correction + 0.5);
+}
+
+void FileSizeEstimator::refine(int quality, size_t size) {
+    m_exact[quality] = size;
+
+    const double estimated = sampleEstimate(quality);
+    if (estimated > 0.0 && size > 0) m_correction = size / estimated;
+}
+
+bool FileSizeEstimator::isExact(int quality) const {
+    return m_exact.count(quality) != 0;
+}
+
+}  // io
+}  // pfs
@@ -0,0 +1,80 @@
+/*
+ * This file is a part of Luminance HDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+//! \brief Estimate of the size of JPEG and PNG files across the quality range
+
+#ifndef PFS_IO_FILESIZEESTIMATOR_H
+#define PFS_IO_FILESIZEESTIMATOR_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pfs {
+class Frame;
+
+namespace io {
+
+//! \brief Predicts the size of the file written by JpegWriter or PngWriter
+//! for any quality in [0, 100]
+//! \note A mosaic of tiles sampled over the frame is encoded at a few quality
+//! values, in parallel. The sizes are scaled to the frame and interpolated in
+//! between. Exact sizes passed to refine() correct the whole curve.
+class FileSizeEstimator {
+   public:
+    enum Format { FORMAT_JPEG, FORMAT_PNG };
+
+    //! \return true if \a format ("jpg", "png"...) has an estimator
+    static bool fromString(const std::string &format, Format &out);
+
+    //! \brief size in bytes of \a frame encoded at \a quality
+    static size_t encodedSize(const pfs::Frame &frame, Format format,
+                              int quality);
+
+    //! \brief encode the samples of \a frame, it takes a fraction of a full
+    //! encode
+    FileSizeEstimator(const pfs::Frame &frame, Format format);
+
+    //! \return estimated size in bytes of the file at \a quality
+    size_t estimate(int quality) const;
+
+    //! \brief record the exact size of the file at \a quality
+    void refine(int quality, size_t size);
+
+    //! \return true if the size at \a quality is exact
+    bool isExact(int quality) const;
+
+   private:
+    double sampleEstimate(int quality) const;
+
+    Format m_format;
+    //! qualities and sizes (scaled to the frame) of the encoded samples
+    std::vector<int> m_qualities;
+    std::vector<double> m_sizes;
+    //! exact over estimated size, from the last refine()
+    double m_correction;
+    std::map<int, size_t> m_exact;
+};
+
+}  // io
+}  // pfs
+
+#endif  // PFS_IO_FILESIZEESTIMATOR_H
@@ -44,6 +44,11 @@ using namespace boost;
 namespace pfs {
 namespace io {
 
+namespace {
+//! pixels read by a single call to fits_read_img
+const size_t MAX_PIXELS_PER_STRIP = 1 << 22;
+}
+
 class FitsReaderData {
    public:
     FitsReaderData()
@@ -159,137 +164,69 @@ void FitsReader::read(Frame &frame, const Params &) {
     std::cout << "contents.size (pixels) = " << width() * height() << std::endl;
 #endif
 
-    long fpixel = 1;
-    long nbuffer = width();
     int anynull;
 
     Frame tempFrame(width(), height());
     Channel *Xc, *Yc, *Zc;
     tempFrame.createXYZChannels(Xc, Yc, Zc);
 
-    Channel::iterator it = Xc->begin();
-
-    float bscale = m_data->m_bscale;
-    float bzero = m_data->m_bzero;
-
-    if (m_data->m_format == FLOAT_IMG) {
-        std::vector<float> buffer(width());
-        float nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TFLOAT, fpixel, nbuffer, &nullval,
-                              buffer.data(), &anynull, &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("FLOAT: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
-            }
-
-            std::transform(
-                buffer.begin(), buffer.end(), buffer.begin(),
-                [bscale, bzero](float c) { return bscale * c + bzero; });
-            it = std::copy(buffer.begin(), buffer.end(), it);
-        }
-    } else if (m_data->m_format == DOUBLE_IMG) {
-        std::vector<double> buffer(width());
-        double nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TDOUBLE, fpixel, nbuffer, &nullval,
-                              buffer.data(), &anynull, &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("DOUBLE: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
-            }
-
-            std::transform(
-                buffer.begin(), buffer.end(), buffer.begin(),
-                [bscale, bzero](double c) { return bscale * c + bzero; });
-            it = std::copy(buffer.begin(), buffer.end(), it);
-        }
-    } else if (m_data->m_format == BYTE_IMG) {
-        std::vector<short> buffer(width());
-        std::vector<float> buffer_flt(width());
-        short nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TINT, fpixel, nbuffer, &nullval,
-                              buffer.data(), &anynull, &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("BYTE: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
-            }
+    const float bscale = m_data->m_bscale;
+    const float bzero = m_data->m_bzero;
+
+    // whole strips of rows per call: CFITSIO converts every integer BITPIX
+    // to float by itself, only DOUBLE_IMG needs a buffer in between
+    const size_t rowsPerStrip =
+        std::max<size_t>(1, MAX_PIXELS_PER_STRIP / std::max<size_t>(1, width()));
+    std::vector<double> buffer;
+    if (m_data->m_format == DOUBLE_IMG) {
+        buffer.resize(std::min(height(), rowsPerStrip) * width());
+    } else if (m_data->m_format != FLOAT_IMG && m_data->m_format != BYTE_IMG &&
+               m_data->m_format != SHORT_IMG && m_data->m_format != LONG_IMG &&
+               m_data->m_format != LONGLONG_IMG) {
+        throw InvalidHeader("Unsupported BITPIX " +
+                            boost::lexical_cast<std::string>(m_data->m_format));
+    }
 
-            std::transform(
-                buffer.begin(), buffer.end(), buffer_flt.begin(),
-                [bscale, bzero](short c) { return bscale * c + bzero; });
-            it = std::copy(buffer_flt.begin(), buffer_flt.end(), it);
-        }
-    } else if (m_data->m_format == SHORT_IMG) {
-        std::vector<int> buffer(width());
-        std::vector<float> buffer_flt(width());
-        int nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TINT, fpixel, nbuffer, &nullval,
-                              buffer.data(), &anynull, &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("SHORT: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
+    for (size_t row = 0; row < height(); row += rowsPerStrip) {
+        const size_t rows = std::min(rowsPerStrip, height() - row);
+        const long fpixel = row * width() + 1;
+        const long nelements = rows * width();
+        float *out = Xc->data() + row * width();
+
+        int res;
+        if (m_data->m_format == DOUBLE_IMG) {
+            double nullval = 0;  // don't check for null values in the image
+            res = fits_read_img(m_data->m_ptr, TDOUBLE, fpixel, nelements,
+                                &nullval, buffer.data(), &anynull,
+                                &m_data->m_status);
+            if (res == 0) {
+                const double *in = buffer.data();
+                for (long i = 0; i < nelements; ++i) {
+                    out[i] = bscale * in[i] + bzero;
+                }
             }
-
-            std::transform(
-                buffer.begin(), buffer.end(), buffer_flt.begin(),
-                [bscale, bzero](int c) { return bscale * c + bzero; });
-            it = std::copy(buffer_flt.begin(), buffer_flt.end(), it);
-        }
-    } else if (m_data->m_format == LONG_IMG) {
-        std::vector<long> buffer(width());
-        std::vector<float> buffer_flt(width());
-        long nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TLONG, fpixel, nbuffer, &nullval,
-                              buffer.data(), &anynull, &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("LONG: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
+        } else {
+            float nullval = 0;  // don't check for null values in the image
+            res = fits_read_img(m_data->m_ptr, TFLOAT, fpixel, nelements,
+                                &nullval, out, &anynull, &m_data->m_status);
+            if (res == 0 && (bscale != 1.f || bzero != 0.f)) {
+                for (long i = 0; i < nelements; ++i) {
+                    out[i] = bscale * out[i] + bzero;
+                }
             }
-
-            std::transform(
-                buffer.begin(), buffer.end(), buffer_flt.begin(),
-                [bscale, bzero](long c) { return bscale * c + bzero; });
-            it = std::copy(buffer_flt.begin(), buffer_flt.end(), it);
         }
-    } else if (m_data->m_format == LONGLONG_IMG) {
-        std::vector<long long> buffer(width());
-        std::vector<float> buffer_flt(width());
-        long long nullval = 0;  // don't check for null values in the image
-        for (size_t i = 0; i < height(); ++i, fpixel += nbuffer) {
-            if (fits_read_img(m_data->m_ptr, TLONGLONG, fpixel, nbuffer,
-                              &nullval, buffer.data(), &anynull,
-                              &m_data->m_status)) {
-                char error_string[FLEN_ERRMSG];
-                fits_get_errstatus(m_data->m_status, error_string);
-                fits_close_file(m_data->m_ptr, &m_data->m_status);
-                throw std::runtime_error("LONG: Cannot read strip " +
-                                         boost::lexical_cast<std::string>(i) +
-                                         ". " + error_string);
-            }
 
-            std::transform(
-                buffer.begin(), buffer.end(), buffer_flt.begin(),
-                [bscale, bzero](long long c) { return bscale * c + bzero; });
-            it = std::copy(buffer_flt.begin(), buffer_flt.end(), it);
+        if (res) {
+            char error_string[FLEN_ERRMSG];
+            fits_get_errstatus(m_data->m_status, error_string);
+            fits_close_file(m_data->m_ptr, &m_data->m_status);
+            m_data->m_ptr = nullptr;
+            throw std::runtime_error("Cannot read rows " +
+                                     boost::lexical_cast<std::string>(row) +
+                                     " to " +
+                                     boost::lexical_cast<std::string>(
+                                         row + rows - 1) +
+                                     ". " + error_string);
         }
     }
 
@@ -55,6 +55,8 @@ pfs::Frame *copy(const pfs::Frame *inFrame) {
     }
 
     pfs::copyTags(inFrame, outFrame);
+    // same content, same statistics
+    outFrame->copyCachedData(*inFrame);
 
 #ifdef TIMER_PROFILING
     f_timer.stop_and_update();
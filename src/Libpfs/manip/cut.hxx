@@ -27,36 +27,19 @@
 
 #include "cut.h"
 
-#include <algorithm>
 #include <cassert>
 
+#include <Libpfs/array2dview.h>
+
 namespace pfs {
 
 template <typename Type>
 void cut(const Array2D<Type> *from, Array2D<Type> *to, size_t x_ul, size_t y_ul,
          size_t x_br, size_t y_br) {
-    // assert( x_ul >= 0 );        // must be obvious... so obvious that x_ul is
-    // unsigned
-    // assert( y_ul >= 0 );        // must be obvious... so obvious that y_ul is
-    // unsigned
     assert(x_br <= from->getCols());
     assert(y_br <= from->getRows());
-    assert(to->getRows() <= from->getRows());
-    assert(to->getRows() <= from->getRows());
-
-    // if ( x_ul < 0 ) x_ul = 0; // unsigned
-    // if ( y_ul < 0 ) y_ul = 0; // unsigned
-    if (x_br > from->getCols()) x_br = from->getCols();
-    if (y_br > from->getRows()) y_br = from->getRows();
 
-    // update right border
-    x_br = from->getCols() - x_br;
-    int rEnd = (int)to->getRows();
-#pragma omp parallel for shared(rEnd)
-    for (int r = 0; r < rEnd; r++) {
-        std::copy(from->row_begin(r + y_ul) + x_ul,
-                  from->row_end(r + y_ul) - x_br, to->row_begin(r));
-    }
+    Array2DView<Type>(*from).cut(x_ul, y_ul, x_br, y_br).copyTo(*to);
 }
 
 }  // pfs
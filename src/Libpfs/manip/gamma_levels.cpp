@@ -22,68 +22,127 @@
 //! \brief apply gamma and black/white point to the input frame
 //! \author Davide Anastasia <davideanastasia@users.sourceforge.net>
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <iostream>
 
+#include "gamma_levels.h"
+
 #include "Libpfs/channel.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/utils/msec_timer.h"
+#include "opthelper.h"
+#include "sleef.c"
 
 namespace {
+//! samples converted per batch by the 8 bits path
+const size_t RGB32_BATCH = 256;
+
+//! \brief clamp to [0, 1], NaNs to 0
+inline float clamp01(float v) { return v > 0.f ? (v < 1.f ? v : 1.f) : 0.f; }
 
-template <typename T>
-inline T clamp(const T &v, const T &lower_bound, const T &upper_bound) {
-    if (v <= lower_bound) return lower_bound;
-    if (v >= upper_bound) return upper_bound;
-    return v;
+//! \brief 8 bits samples to [0, 1]
+struct ToFloat {
+    ToFloat() {
+        for (int i = 0; i < 256; ++i) lut[i] = i / 255.f;
+    }
+    float lut[256];
+};
+
+const ToFloat &toFloat() {
+    static const ToFloat instance;
+    return instance;
 }
 
-////! \note I assume that *in* contains only value between [0,1]
-// void gamma_levels_array(const pfs::Array2D* in, pfs::Array2D* out,
-//                        float black_in, float white_in,
-//                        float black_out, float white_out, float gamma)
-//{
-//    // same formula used inside GammaAndLevels::refreshLUT()
-//    //float value = powf( ( ((float)(i)/255.0f) - bin ) / (win-bin),
-//    expgamma);
-//    //LUT[i] = clamp(blackout+value*(whiteout-blackout),0,255);
-
-//    const float* in_vector = in->getRawData();
-//    float* out_vector = out->getRawData();
-
-//    const int ELEMS = in->getCols()*in->getRows();
-
-//    if (gamma != 1.0f)
-//    {
-//#pragma omp parallel for
-//        for (int idx = 0; idx < ELEMS; ++idx)
-//        {
-//            float tmp = (in_vector[idx] - black_in)/(white_in - black_in);
-//            tmp = powf(tmp, gamma);
-
-//            tmp = black_out + tmp*(white_out-black_out);
-
-//            out_vector[idx] = clamp(tmp, 0.0f, 1.0f);
-//        }
-//    }
-//    else
-//    {
-//#pragma omp parallel for
-//        for (int idx = 0; idx < ELEMS; ++idx)
-//        {
-//            float tmp = (in_vector[idx] - black_in)/(white_in - black_in);
-//            //tmp = powf(tmp, gamma);
-
-//            tmp = black_out + tmp*(white_out-black_out);
-
-//            out_vector[idx] = clamp(tmp, 0.0f, 1.0f);
-//        }
-//    }
-//}
+inline uint32_t toByte(float v) {
+    return static_cast<uint32_t>(v * 255.f + 0.5f);
+}
 }
 
 namespace pfs {
 
+GammaLevelsKernel::GammaLevelsKernel(float black_in, float white_in,
+                                     float black_out, float white_out,
+                                     float gamma)
+    : m_blackIn(black_in),
+      m_scaleIn(1.f / (white_in - black_in)),
+      m_blackOut(black_out),
+      m_rangeOut(white_out - black_out),
+      m_exponent(gamma - 1.0f) {}
+
+void GammaLevelsKernel::apply(const float *R_i, const float *G_i,
+                              const float *B_i, float *R_o, float *G_o,
+                              float *B_o, size_t size) const {
+    size_t i = 0;
+#ifdef __SSE2__
+    const vfloat blackInv = F2V(m_blackIn);
+    const vfloat scaleInv = F2V(m_scaleIn);
+    const vfloat blackOutv = F2V(m_blackOut);
+    const vfloat rangeOutv = F2V(m_rangeOut);
+    const vfloat exponentv = F2V(m_exponent);
+    const vfloat onev = F2V(1.f);
+    const vfloat wrv = F2V(0.2126f);
+    const vfloat wgv = F2V(0.7152f);
+    const vfloat wbv = F2V(0.0722f);
+    for (; i + 3 < size; i += 4) {
+        const vfloat red = LVFU(R_i[i]);
+        const vfloat green = LVFU(G_i[i]);
+        const vfloat blue = LVFU(B_i[i]);
+
+        // number between [0..1]
+        const vfloat L = wrv * red + wgv * green + wbv * blue;
+        const vfloat c =
+            (m_exponent == 0.f) ? onev : xexpf(exponentv * xlogf(L));
+        const vfloat scale = c * scaleInv * rangeOutv;
+
+        // _mm_max_ps returns its second operand for NaNs
+        STVFU(R_o[i], _mm_min_ps(_mm_max_ps(blackOutv + (red - blackInv) * scale, ZEROV), onev));
+        STVFU(G_o[i], _mm_min_ps(_mm_max_ps(blackOutv + (green - blackInv) * scale, ZEROV), onev));
+        STVFU(B_o[i], _mm_min_ps(_mm_max_ps(blackOutv + (blue - blackInv) * scale, ZEROV), onev));
+    }
+#endif
+    for (; i < size; ++i) {
+        const float red = R_i[i];
+        const float green = G_i[i];
+        const float blue = B_i[i];
+
+        // number between [0..1]
+        const float L = 0.2126f * red + 0.7152f * green + 0.0722f * blue;
+        const float c = (m_exponent == 0.f) ? 1.f : xexpf(m_exponent * xlogf(L));
+        const float scale = c * m_scaleIn * m_rangeOut;
+
+        R_o[i] = clamp01(m_blackOut + (red - m_blackIn) * scale);
+        G_o[i] = clamp01(m_blackOut + (green - m_blackIn) * scale);
+        B_o[i] = clamp01(m_blackOut + (blue - m_blackIn) * scale);
+    }
+}
+
+void GammaLevelsKernel::apply(const uint32_t *in, uint32_t *out,
+                              size_t size) const {
+    const float *lut = toFloat().lut;
+    float red[RGB32_BATCH];
+    float green[RGB32_BATCH];
+    float blue[RGB32_BATCH];
+
+    for (size_t begin = 0; begin < size; begin += RGB32_BATCH) {
+        const size_t count = std::min(RGB32_BATCH, size - begin);
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t px = in[begin + i];
+            red[i] = lut[(px >> 16) & 0xff];
+            green[i] = lut[(px >> 8) & 0xff];
+            blue[i] = lut[px & 0xff];
+        }
+
+        apply(red, green, blue, red, green, blue, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            out[begin + i] = 0xff000000u | (toByte(red[i]) << 16) |
+                             (toByte(green[i]) << 8) | toByte(blue[i]);
+        }
+    }
+}
+
 void gammaAndLevels(pfs::Frame *inFrame, float black_in, float white_in,
                     float black_out, float white_out, float gamma) {
 #ifdef TIMER_PROFILING
@@ -104,38 +163,15 @@ void gammaAndLevels(pfs::Frame *inFrame, float black_in, float white_in,
     inFrame->getXYZChannels(Xc, Yc, Zc);
     assert(Xc != nullptr && Yc != nullptr && Zc != nullptr);
 
-    const float *R_i = Xc->data();
-    const float *G_i = Yc->data();
-    const float *B_i = Zc->data();
+    const GammaLevelsKernel kernel(black_in, white_in, black_out, white_out,
+                                   gamma);
 
-    float *R_o = Xc->data();
-    float *G_o = Yc->data();
-    float *B_o = Zc->data();
-
-// float exp_gamma = 1.f/gamma;
 #pragma omp parallel for
-    for (int idx = 0; idx < outWidth * outHeight; ++idx) {
-        float red = R_i[idx];
-        float green = G_i[idx];
-        float blue = B_i[idx];
-
-        float L = 0.2126f * red + 0.7152f * green +
-                  0.0722f * blue;  // number between [0..1]
-
-        float c = powf(L, gamma - 1.0f);
-
-        red = (red - black_in) / (white_in - black_in);
-        red *= c;
-
-        green = (green - black_in) / (white_in - black_in);
-        green *= c;
-
-        blue = (blue - black_in) / (white_in - black_in);
-        blue *= c;
-
-        R_o[idx] = clamp(black_out + red * (white_out - black_out), 0.f, 1.f);
-        G_o[idx] = clamp(black_out + green * (white_out - black_out), 0.f, 1.f);
-        B_o[idx] = clamp(black_out + blue * (white_out - black_out), 0.f, 1.f);
+    for (int y = 0; y < outHeight; ++y) {
+        const size_t offset = static_cast<size_t>(y) * outWidth;
+        kernel.apply(Xc->data() + offset, Yc->data() + offset,
+                     Zc->data() + offset, Xc->data() + offset,
+                     Yc->data() + offset, Zc->data() + offset, outWidth);
     }
 
 #ifdef TIMER_PROFILING
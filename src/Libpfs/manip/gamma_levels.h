@@ -25,9 +25,38 @@
 #ifndef LIBPFS_GAMMA_LEVELS_H
 #define LIBPFS_GAMMA_LEVELS_H
 
+#include <cstddef>
+#include <cstdint>
+
 namespace pfs {
 class Frame;
 
+//! \brief Black/white points and gamma of RGB samples in [0, 1]
+//! \note The same kernel runs the preview of the Levels dialog and the final
+//! apply on the frame, so that they match.
+class GammaLevelsKernel {
+   public:
+    GammaLevelsKernel(float black_in, float white_in, float black_out,
+                      float white_out, float gamma = 1.0f);
+
+    //! \brief process \a size samples of the R, G, B planes
+    //! \note output planes can be the input ones
+    void apply(const float *R_i, const float *G_i, const float *B_i,
+               float *R_o, float *G_o, float *B_o, size_t size) const;
+
+    //! \brief process \a size pixels packed as 0xAARRGGBB (e.g. a row of a
+    //! QImage::Format_RGB32), output pixels are opaque
+    void apply(const uint32_t *in, uint32_t *out, size_t size) const;
+
+   private:
+    float m_blackIn;
+    float m_scaleIn;
+    float m_blackOut;
+    float m_rangeOut;
+    //! exponent of the luminance scaling the samples
+    float m_exponent;
+};
+
 void gammaAndLevels(pfs::Frame *in, float black_in, float white_in,
                     float black_out, float white_out, float gamma = 1.0f);
 }
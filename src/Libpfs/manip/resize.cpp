@@ -50,7 +50,13 @@ Frame *resize(Frame *frame, int xSize, InterpolationMethod m) {
 
     pfs::Frame *resizedFrame = new pfs::Frame(new_x, new_y);
 
-    const ChannelContainer &channels = frame->getChannels();
+    // shrink from the smallest level of the pyramid still larger than the
+    // output: it is shared by all the resizes of the frame
+    const std::shared_ptr<const Frame> level =
+        static_cast<const Frame *>(frame)->getPyramidLevel(new_x, new_y);
+    const Frame &source = level ? *level : *frame;
+
+    const ChannelContainer &channels = source.getChannels();
     for (ChannelContainer::const_iterator it = channels.begin();
          it != channels.end(); ++it) {
         pfs::Channel *newCh = resizedFrame->createChannel((*it)->getName());
@@ -24,34 +24,39 @@
 
 #include "rotate.h"
 
+#include <cassert>
+#include <cstddef>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/utils/transpose.h>
+
 namespace pfs {
 
 template <typename Type>
 void rotate(const pfs::Array2D<Type> *in, pfs::Array2D<Type> *out,
             bool clockwise) {
+    assert(in->getCols() == out->getRows());
+    assert(in->getRows() == out->getCols());
+
+    if (in->getCols() == 0 || in->getRows() == 0) return;
+
     const Type *Vin = in->data();
     Type *Vout = out->data();
 
-    const int I_ROWS = in->getRows();
-    const int I_COLS = in->getCols();
+    const std::ptrdiff_t I_ROWS = in->getRows();
+    const std::ptrdiff_t I_COLS = in->getCols();
 
-    // const int O_ROWS = out->getRows();
-    const int O_COLS = out->getCols();
+    const std::ptrdiff_t O_ROWS = out->getRows();
+    const std::ptrdiff_t O_COLS = out->getCols();
 
     if (clockwise) {
-#pragma omp parallel for
-        for (int j = 0; j < I_ROWS; j++) {
-            for (int i = 0; i < I_COLS; i++) {
-                Vout[(i + 1) * O_COLS - 1 - j] = Vin[j * I_COLS + i];
-            }
-        }
+        // transpose of the input read from its last row
+        utils::transpose(Vin + (I_ROWS - 1) * I_COLS, -I_COLS, Vout, O_COLS,
+                         I_COLS, I_ROWS);
     } else {
-#pragma omp parallel for
-        for (int j = 0; j < I_ROWS; j++) {
-            for (int i = 0; i < I_COLS; i++) {
-                Vout[(I_COLS - i - 1) * O_COLS + j] = Vin[j * I_COLS + i];
-            }
-        }
+        // transpose written from the last row of the output
+        utils::transpose(Vin, I_COLS, Vout + (O_ROWS - 1) * O_COLS, -O_COLS,
+                         I_COLS, I_ROWS);
     }
 }
 }
@@ -21,6 +21,8 @@
 
 #include <Libpfs/manip/shift.h>
 
+#include <Libpfs/frameview.h>
+
 namespace pfs {
 
 Frame *shift(const Frame &frame, int dx, int dy) {
@@ -29,19 +31,7 @@ Frame *shift(const Frame &frame, int dx, int dy) {
     f_timer.start();
 #endif
 
-    pfs::Frame *shiftedFrame =
-        new pfs::Frame(frame.getWidth(), frame.getHeight());
-
-    const ChannelContainer &channels = frame.getChannels();
-
-    for (ChannelContainer::const_iterator it = channels.begin();
-         it != channels.end(); ++it) {
-        pfs::Channel *newCh = shiftedFrame->createChannel((*it)->getName());
-
-        shift(**it, -dx, -dy, *newCh);
-    }
-
-    pfs::copyTags(&frame, shiftedFrame);
+    pfs::Frame *shiftedFrame = FrameView(frame).shift(dx, dy).materialize();
 
 #ifdef TIMER_PROFILING
     f_timer.stop_and_update();
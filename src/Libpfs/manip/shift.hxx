@@ -23,69 +23,22 @@
 #define PFS_SHIFT_HXX
 
 #include <Libpfs/array2d.h>
+#include <Libpfs/array2dview.h>
 #include <Libpfs/manip/shift.h>
 #include <Libpfs/utils/msec_timer.h>
 
-#include <algorithm>
 #include <iostream>
-#include <iterator>
-#include <numeric>
 
 namespace pfs {
 
 template <typename Type>
 void shift(const Array2D<Type> &in, int dx, int dy, Array2D<Type> &out) {
-    typedef Array2D<Type> Array2DType;
-
-    using namespace std;
-
 #ifdef TIMER_PROFILING
     msec_timer stop_watch;
     stop_watch.start();
 #endif
 
-    // fill first row... if any!
-    for (int idx = 0; idx < -dy; idx++) {
-        fill(out.row_begin(idx), out.row_end(idx), Type());
-    }
-
-    // fill middle portion
-    if (dx < 0) {
-        for (int row = max(0, -dy), rowEnd = in.getRows() - max(0, dy);
-             row < rowEnd; row++) {
-            // Begin output line
-            typename Array2DType::iterator itBegin = out.row_begin(row);
-            // Pivot iterator
-            typename Array2DType::iterator itTh = itBegin - dx;
-
-            // fill zero at the begin of the line
-            fill(itBegin, itTh, Type());
-            // copy data
-            copy(in.row_begin(row + dy), in.row_end(row + dy) + dx, itTh);
-        }
-    } else if (dx > 0) {
-        for (int row = max(0, -dy), rowEnd = in.getRows() - max(0, dy);
-             row < rowEnd; row++) {
-            // copy data
-            copy(in.row_begin(row + dy) + dx, in.row_end(row + dy),
-                 out.row_begin(row));
-            // fill zero
-            fill(out.row_end(row) - dx, out.row_end(row), Type());
-        }
-    } else {
-        for (int row = max(0, -dy), rowEnd = in.getRows() - max(0, dy);
-             row < rowEnd; row++) {
-            // copy data
-            copy(in.row_begin(row + dy), in.row_end(row + dy),
-                 out.row_begin(row));
-        }
-    }
-
-    // fill last rows... if any!
-    for (int idx = dy; idx > 0; idx--) {
-        fill(out.row_begin(out.getRows() - idx),
-             out.row_end(out.getRows() - idx), Type());
-    }
+    Array2DView<Type>(in).shift(dx, dy).copyTo(out);
 
 #ifdef TIMER_PROFILING
     stop_watch.stop_and_update();
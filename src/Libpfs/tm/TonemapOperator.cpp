@@ -212,7 +212,8 @@ struct TonemapOperatorReinhard02
                 opts->operator_options.reinhard02options.range,
                 opts->operator_options.reinhard02options.lower,
                 opts->operator_options.reinhard02options.upper,
-                opts->operator_options.reinhard02options.scales, ph);
+                opts->operator_options.reinhard02options.scales,
+                opts->operator_options.reinhard02options.fftconvolution, ph);
         } catch (...) {
             throw std::runtime_error("Reinhard02: Tonemap Failed");
         }
@@ -0,0 +1,159 @@
+/*
+ * This file is a part of LuminanceHDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "TonemapStageCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Libpfs/array2d.h"
+
+namespace {
+//! default budget: a handful of full resolution channels
+const size_t DEFAULT_CAPACITY = 512u * 1024u * 1024u;
+//! number of samples hashed by each task
+const size_t CHUNK_SIZE = 1u << 16;
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//! four independent lanes, so that the multiplications do not serialise
+uint64_t hashChunk(const float *data, size_t size) {
+    const uint64_t PRIME = 0x9e3779b97f4a7c15ULL;
+    uint64_t lanes[4] = {1, 2, 3, 4};
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        for (int l = 0; l < 4; ++l) {
+            uint32_t bits;
+            std::memcpy(&bits, data + i + l, sizeof(bits));
+            lanes[l] = (lanes[l] ^ bits) * PRIME;
+        }
+    }
+    for (; i < size; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, data + i, sizeof(bits));
+        lanes[0] = (lanes[0] ^ bits) * PRIME;
+    }
+    return mix(lanes[0] ^ mix(lanes[1] ^ mix(lanes[2] ^ mix(lanes[3]))));
+}
+
+size_t entrySize(const TonemapStageCache::Entry &value) {
+    return value->size() * sizeof(float);
+}
+}
+
+TonemapStageCache &TonemapStageCache::instance() {
+    static TonemapStageCache cache;
+    return cache;
+}
+
+TonemapStageCache::TonemapStageCache()
+    : m_size(0), m_capacity(DEFAULT_CAPACITY), m_computed(0) {}
+
+uint64_t TonemapStageCache::fingerprint(const pfs::Array2Df &data,
+                                        uint64_t seed) {
+    const size_t size = data.size();
+    const size_t numChunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const float *samples = data.data();
+
+    std::vector<uint64_t> chunks(numChunks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long c = 0; c < static_cast<long>(numChunks); ++c) {
+        const size_t begin = c * CHUNK_SIZE;
+        chunks[c] = hashChunk(samples + begin,
+                              std::min(CHUNK_SIZE, size - begin));
+    }
+
+    uint64_t h = mix(seed ^ mix(data.getCols() ^ mix(data.getRows())));
+    for (size_t c = 0; c < numChunks; ++c) {
+        h = mix(h ^ chunks[c]);
+    }
+    return h;
+}
+
+TonemapStageCache::Entry TonemapStageCache::find(const TonemapStageKey &key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::list<Item>::iterator it = m_items.begin(); it != m_items.end();
+         ++it) {
+        if (it->first == key) {
+            m_items.splice(m_items.begin(), m_items, it);
+            return m_items.front().second;
+        }
+    }
+    return Entry();
+}
+
+void TonemapStageCache::insert(const TonemapStageKey &key,
+                               const Entry &value) {
+    const size_t bytes = entrySize(value);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (bytes > m_capacity) return;
+
+    for (std::list<Item>::iterator it = m_items.begin(); it != m_items.end();
+         ++it) {
+        if (it->first == key) {
+            m_size -= entrySize(it->second);
+            m_items.erase(it);
+            break;
+        }
+    }
+    m_items.push_front(Item(key, value));
+    m_size += bytes;
+    evict();
+}
+
+void TonemapStageCache::setCapacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = bytes;
+    evict();
+}
+
+size_t TonemapStageCache::computed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_computed;
+}
+
+size_t TonemapStageCache::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+void TonemapStageCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_items.clear();
+    m_size = 0;
+    m_computed = 0;
+}
+
+void TonemapStageCache::evict() {
+    while (m_size > m_capacity && !m_items.empty()) {
+        m_size -= entrySize(m_items.back().second);
+        m_items.pop_back();
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is a part of LuminanceHDR package.
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef TONEMAPSTAGECACHE_H
+#define TONEMAPSTAGECACHE_H
+
+//! \brief Memoisation of the expensive stages of the tonemapping operators
+//! \note Operators are split in stages: an expensive one that depends on the
+//! input frame and on a subset of the parameters (a bilateral base layer, a
+//! solved luminance) and cheap final stages that depend on the rest. The
+//! output of the expensive stage is kept here, keyed by a fingerprint of its
+//! input and by the parameters it depends on, so that tweaking a parameter of
+//! a final stage only reruns that stage. \c TonemapOperator instances are
+//! created for every run, hence the cache is process wide and thread safe.
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Libpfs/array2d_fwd.h"
+
+class TonemapStageKey {
+   public:
+    //! \param stage unique name of the stage, e.g. "durand02.base"
+    //! \param input fingerprint of the data the stage reads
+    TonemapStageKey(const char *stage, uint64_t input)
+        : m_stage(stage), m_input(input) {}
+
+    //! \brief append a parameter the stage depends on
+    TonemapStageKey &operator<<(float value) {
+        m_params.push_back(value);
+        return *this;
+    }
+
+    bool operator==(const TonemapStageKey &other) const {
+        return m_input == other.m_input && m_stage == other.m_stage &&
+               m_params == other.m_params;
+    }
+
+   private:
+    std::string m_stage;
+    uint64_t m_input;
+    std::vector<float> m_params;
+};
+
+class TonemapStageCache {
+   public:
+    typedef std::shared_ptr<const pfs::Array2Df> Entry;
+
+    static TonemapStageCache &instance();
+
+    //! \brief fingerprint of the content of \a data, dimensions included
+    static uint64_t fingerprint(const pfs::Array2Df &data,
+                                uint64_t seed = 0);
+
+    //! \return the cached output of \a key, or an empty pointer
+    Entry find(const TonemapStageKey &key);
+
+    //! \brief store the output of \a key, evicting the least recently used
+    //! entries beyond the capacity. Outputs larger than the whole capacity
+    //! are not kept.
+    void insert(const TonemapStageKey &key, const Entry &value);
+
+    //! \brief return the output of \a key, running \a compute on a miss.
+    //! \a compute returns an empty pointer when it has been interrupted:
+    //! in that case nothing is stored.
+    template <typename Compute>
+    Entry getOrCompute(const TonemapStageKey &key, Compute compute) {
+        Entry value = find(key);
+        if (!value) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_computed;
+            }
+            value = compute();
+            if (value) insert(key, value);
+        }
+        return value;
+    }
+
+    //! \return number of outputs computed by getOrCompute() since the last
+    //! clear()
+    size_t computed() const;
+
+    //! \brief memory budget in bytes, 0 disables the cache
+    void setCapacity(size_t bytes);
+    size_t capacity() const;
+
+    void clear();
+
+   private:
+    TonemapStageCache();
+    TonemapStageCache(const TonemapStageCache &);
+    TonemapStageCache &operator=(const TonemapStageCache &);
+
+    void evict();
+
+    typedef std::pair<TonemapStageKey, Entry> Item;
+
+    mutable std::mutex m_mutex;
+    //! most recently used first
+    std::list<Item> m_items;
+    size_t m_size;
+    size_t m_capacity;
+    size_t m_computed;
+};
+
+#endif  // TONEMAPSTAGECACHE_H
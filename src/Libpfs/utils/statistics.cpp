@@ -0,0 +1,241 @@
+/*
+* This file is a part of Luminance HDR package.
+* ----------------------------------------------------------------------
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* ----------------------------------------------------------------------
+*/
+
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "Libpfs/array2d.h"
+#include "opthelper.h"
+#include "sleef.c"
+
+namespace pfs {
+namespace utils {
+
+namespace {
+const size_t HISTOGRAM_BINS = 65536;
+//! extra bin collecting the NaNs
+const size_t NAN_BIN = HISTOGRAM_BINS;
+const float LOG_EPS = 1e-4f;
+
+//! \brief float bits remapped so that their unsigned order is the order of
+//! the samples
+inline uint32_t orderedBits(float v) {
+    uint32_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+inline float fromOrderedBits(uint32_t o) {
+    const uint32_t u = (o & 0x80000000u) ? (o & 0x7fffffffu) : ~o;
+    float v;
+    std::memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+inline size_t histogramBin(float v) {
+    return (v != v) ? NAN_BIN : (orderedBits(v) >> 16);
+}
+
+inline float binLow(size_t bin) {
+    return fromOrderedBits(static_cast<uint32_t>(bin) << 16);
+}
+
+inline float binHigh(size_t bin) {
+    return fromOrderedBits((static_cast<uint32_t>(bin) << 16) | 0xffffu);
+}
+}
+
+ChannelStatistics::ChannelStatistics(const pfs::Array2Df &data)
+    : m_size(0),
+      m_min(0.f),
+      m_max(0.f),
+      m_minPositive(0.f),
+      m_logAverage(0.f),
+      m_histogram(HISTOGRAM_BINS + 1, 0) {
+    const int width = data.getCols();
+    const int height = data.getRows();
+
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    float minPositive = std::numeric_limits<float>::infinity();
+    double logSum = 0.0;
+
+#pragma omp parallel if (data.size() > HISTOGRAM_BINS)
+    {
+        std::vector<uint32_t> histogram(HISTOGRAM_BINS + 1, 0);
+        float minThr = std::numeric_limits<float>::infinity();
+        float maxThr = -std::numeric_limits<float>::infinity();
+        float minPositiveThr = std::numeric_limits<float>::infinity();
+        double logSumThr = 0.0;
+#ifdef __SSE2__
+        const __m128i signv = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        const __m128i nanBinv = _mm_set1_epi32(static_cast<int>(NAN_BIN));
+        const vfloat infv = F2V(std::numeric_limits<float>::infinity());
+        const vfloat epsv = F2V(LOG_EPS);
+        vfloat minThrv = infv;
+        vfloat maxThrv = F2V(-std::numeric_limits<float>::infinity());
+        vfloat minPositiveThrv = infv;
+        uint32_t bins[4];
+#endif
+
+#pragma omp for nowait
+        for (int y = 0; y < height; ++y) {
+            const float *row = data.data() + y * width;
+            float logSumRow = 0.f;
+            int x = 0;
+#ifdef __SSE2__
+            vfloat logSumRowv = ZEROV;
+            for (; x < width - 3; x += 4) {
+                const vfloat v = LVFU(row[x]);
+                const vfloat ordered = _mm_cmpord_ps(v, v);
+
+                // _mm_min_ps/_mm_max_ps return their second operand when
+                // the first one is NaN
+                minThrv = _mm_min_ps(v, minThrv);
+                maxThrv = _mm_max_ps(v, maxThrv);
+                minPositiveThrv = _mm_min_ps(
+                    _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps(v, ZEROV), v),
+                              _mm_andnot_ps(_mm_cmpgt_ps(v, ZEROV), infv)),
+                    minPositiveThrv);
+                logSumRowv += _mm_and_ps(ordered, xlogf(v + epsv));
+
+                // negative samples: ~bits, positive ones: bits | sign
+                const __m128i bits = _mm_castps_si128(v);
+                const __m128i flip =
+                    _mm_or_si128(_mm_srai_epi32(bits, 31), signv);
+                const __m128i key =
+                    _mm_srli_epi32(_mm_xor_si128(bits, flip), 16);
+                const __m128i nanMask = _mm_castps_si128(ordered);
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(bins),
+                    _mm_or_si128(_mm_and_si128(nanMask, key),
+                                 _mm_andnot_si128(nanMask, nanBinv)));
+                ++histogram[bins[0]];
+                ++histogram[bins[1]];
+                ++histogram[bins[2]];
+                ++histogram[bins[3]];
+            }
+            logSumRow += vhadd(logSumRowv);
+#endif
+            for (; x < width; ++x) {
+                const float v = row[x];
+                ++histogram[histogramBin(v)];
+                if (v != v) continue;
+
+                minThr = std::min(v, minThr);
+                maxThr = std::max(v, maxThr);
+                if (v > 0.f) minPositiveThr = std::min(v, minPositiveThr);
+                logSumRow += xlogf(v + LOG_EPS);
+            }
+            logSumThr += logSumRow;
+        }
+#ifdef __SSE2__
+        minThr = std::min(minThr, vhmin(minThrv));
+        maxThr = std::max(maxThr, vhmax(maxThrv));
+        minPositiveThr = std::min(minPositiveThr, vhmin(minPositiveThrv));
+#endif
+
+#pragma omp critical
+        {
+            min = std::min(min, minThr);
+            max = std::max(max, maxThr);
+            minPositive = std::min(minPositive, minPositiveThr);
+            logSum += logSumThr;
+            for (size_t i = 0; i <= HISTOGRAM_BINS; ++i) {
+                m_histogram[i] += histogram[i];
+            }
+        }
+    }
+
+    m_size = data.size() - m_histogram[NAN_BIN];
+    m_histogram.resize(HISTOGRAM_BINS);
+    if (m_size == 0) return;
+
+    m_min = min;
+    m_max = max;
+    m_minPositive =
+        (minPositive == std::numeric_limits<float>::infinity()) ? 0.f
+                                                                : minPositive;
+    m_logAverage = static_cast<float>(std::exp(logSum / m_size));
+}
+
+float ChannelStatistics::getPercentile(float p) const {
+    if (m_size == 0) return 0.f;
+
+    const double target = std::max(0.f, std::min(p, 1.f)) * m_size;
+    double count = 0.0;
+    for (size_t bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        const uint32_t samples = m_histogram[bin];
+        if (samples == 0) continue;
+        if (count + samples < target) {
+            count += samples;
+            continue;
+        }
+
+        float low = binLow(bin);
+        float high = binHigh(bin);
+        // also takes care of the bins at the infinities
+        if (!(low >= m_min)) low = m_min;
+        if (!(high <= m_max)) high = m_max;
+
+        const float fraction = static_cast<float>((target - count) / samples);
+        return low + fraction * (high - low);
+    }
+    return m_max;
+}
+
+std::vector<float> ChannelStatistics::getLogHistogram(int bins, float logMin,
+                                                      float logMax) const {
+    std::vector<float> P(std::max(bins, 0), 0.f);
+    if (bins <= 0 || !(logMax > logMin)) return P;
+
+    const float binWidth = (logMax - logMin) / bins;
+    const size_t firstPositive = orderedBits(0.f) >> 16;
+    const size_t lastFinite =
+        orderedBits(std::numeric_limits<float>::max()) >> 16;
+
+    float count = 0.f;
+    for (size_t bin = firstPositive; bin <= lastFinite; ++bin) {
+        const uint32_t samples = m_histogram[bin];
+        if (samples == 0) continue;
+
+        const float center =
+            fromOrderedBits((static_cast<uint32_t>(bin) << 16) | 0x8000u);
+        int idx = static_cast<int>(
+            std::floor((std::log10(center) - logMin) / binWidth));
+        if (idx > bins || idx < 0) continue;
+        if (idx == bins) idx = bins - 1;
+
+        P[idx] += samples;
+        count += samples;
+    }
+
+    if (count > 0.f) {
+        for (int i = 0; i < bins; ++i) P[i] /= count;
+    }
+    return P;
+}
+
+}  // utils
+}  // pfs
@@ -0,0 +1,79 @@
+/*
+* This file is a part of Luminance HDR package.
+* ----------------------------------------------------------------------
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* ----------------------------------------------------------------------
+*/
+
+#ifndef PFS_UTILS_STATISTICS_H
+#define PFS_UTILS_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Libpfs/array2d_fwd.h"
+
+namespace pfs {
+namespace utils {
+
+//! \brief Statistics of the samples of a channel: min, max, log-average,
+//! percentiles and histogram, computed in a single parallel pass.
+//! \note The histogram is keyed on the 16 most significant bits of the
+//! samples, so its bins are evenly spaced in the log domain (7 bits of
+//! mantissa, less than 1% apart) and building it takes no log per sample.
+//! Percentiles are interpolated inside those bins. NaNs are ignored.
+//! \sa pfs::Frame::getStatistics
+class ChannelStatistics {
+   public:
+    explicit ChannelStatistics(const pfs::Array2Df &data);
+
+    //! \return number of samples, NaNs excluded
+    size_t getSize() const { return m_size; }
+
+    float getMin() const { return m_min; }
+    float getMax() const { return m_max; }
+
+    //! \return smallest sample greater than zero, or 0 if there is none
+    float getMinPositive() const { return m_minPositive; }
+
+    //! \return exp(mean(log(sample + 1e-4))), the log-average used by the
+    //! tonemapping operators
+    float getLogAverage() const { return m_logAverage; }
+
+    //! \return value below which lies the fraction \a p (in [0, 1]) of the
+    //! samples
+    float getPercentile(float p) const;
+
+    //! \brief histogram of log10 of the positive samples over
+    //! [\a logMin, \a logMax], normalized to probabilities
+    std::vector<float> getLogHistogram(int bins, float logMin,
+                                       float logMax) const;
+
+   private:
+    size_t m_size;
+    float m_min;
+    float m_max;
+    float m_minPositive;
+    float m_logAverage;
+    //! 65536 bins, ordered as the samples
+    std::vector<uint32_t> m_histogram;
+};
+
+}  // utils
+}  // pfs
+
+#endif  // PFS_UTILS_STATISTICS_H
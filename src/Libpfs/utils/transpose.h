@@ -0,0 +1,63 @@
+/*
+* This file is a part of Luminance HDR package.
+* ----------------------------------------------------------------------
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* ----------------------------------------------------------------------
+*/
+
+#ifndef PFS_UTILS_TRANSPOSE_H
+#define PFS_UTILS_TRANSPOSE_H
+
+#include <cstddef>
+
+#include <Libpfs/array2d_fwd.h>
+
+//! \file transpose.h
+//! \brief Cache-blocked transpose of 2D buffers
+//!
+//! The matrix is walked in square tiles that fit L1 together with their
+//! transposed copy, each tile in 8x8 blocks transposed in registers (SSE
+//! for float). Reads and writes both stay sequential over a cache line,
+//! instead of one of them jumping a whole row at every element.
+//! Column passes of separable filters can transpose, run their row kernel
+//! and transpose back.
+
+namespace pfs {
+namespace utils {
+
+//! \brief out[c * outStride + r] = in[r * inStride + c], for \a rows rows and
+//! \a cols columns of \a in
+//! \note The strides are in elements and can be negative, to walk the rows
+//! of \a in or \a out backwards: this gives the rotations by 90 degrees.
+//! \a in and \a out must not overlap.
+template <typename Type>
+void transpose(const Type *in, std::ptrdiff_t inStride, Type *out,
+               std::ptrdiff_t outStride, size_t cols, size_t rows);
+
+//! \brief \a out (\a rows x \a cols) is the transpose of the row-major
+//! matrix \a in of \a cols x \a rows elements
+template <typename Type>
+void transpose(const Type *in, Type *out, size_t cols, size_t rows);
+
+//! \brief \a out is the transpose of \a in, it is resized if needed
+template <typename Type>
+void transpose(const Array2D<Type> &in, Array2D<Type> &out);
+
+}  // utils
+}  // pfs
+
+#include <Libpfs/utils/transpose.hxx>
+#endif  // PFS_UTILS_TRANSPOSE_H
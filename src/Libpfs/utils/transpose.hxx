@@ -0,0 +1,178 @@
+/*
+* This file is a part of Luminance HDR package.
+* ----------------------------------------------------------------------
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* ----------------------------------------------------------------------
+*/
+
+#ifndef PFS_UTILS_TRANSPOSE_HXX
+#define PFS_UTILS_TRANSPOSE_HXX
+
+#include <algorithm>
+#include <vector>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/utils/transpose.h>
+
+#ifdef __SSE2__
+#include <xmmintrin.h>
+#endif
+
+namespace pfs {
+namespace utils {
+namespace detail {
+
+//! side of the tiles: a tile of floats and its copy take 32KB
+static const std::ptrdiff_t TRANSPOSE_TILE = 64;
+//! side of the blocks transposed in registers
+static const std::ptrdiff_t TRANSPOSE_BLOCK = 8;
+
+template <typename Type>
+inline void transposeBlock(const Type *in, std::ptrdiff_t inStride, Type *out,
+                           std::ptrdiff_t outStride) {
+    for (std::ptrdiff_t r = 0; r < TRANSPOSE_BLOCK; ++r) {
+        for (std::ptrdiff_t c = 0; c < TRANSPOSE_BLOCK; ++c) {
+            out[c * outStride + r] = in[r * inStride + c];
+        }
+    }
+}
+
+#ifdef __SSE2__
+inline void transposeBlock4(const float *in, std::ptrdiff_t inStride,
+                            float *out, std::ptrdiff_t outStride) {
+    __m128 r0 = _mm_loadu_ps(in);
+    __m128 r1 = _mm_loadu_ps(in + inStride);
+    __m128 r2 = _mm_loadu_ps(in + 2 * inStride);
+    __m128 r3 = _mm_loadu_ps(in + 3 * inStride);
+
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + outStride, r1);
+    _mm_storeu_ps(out + 2 * outStride, r2);
+    _mm_storeu_ps(out + 3 * outStride, r3);
+}
+
+template <>
+inline void transposeBlock<float>(const float *in, std::ptrdiff_t inStride,
+                                  float *out, std::ptrdiff_t outStride) {
+    transposeBlock4(in, inStride, out, outStride);
+    transposeBlock4(in + 4, inStride, out + 4 * outStride, outStride);
+    transposeBlock4(in + 4 * inStride, inStride, out + 4, outStride);
+    transposeBlock4(in + 4 * inStride + 4, inStride, out + 4 * outStride + 4,
+                    outStride);
+}
+#endif
+
+template <typename Type>
+void transposeTile(const Type *in, std::ptrdiff_t inStride, Type *out,
+                   std::ptrdiff_t outStride, std::ptrdiff_t cols,
+                   std::ptrdiff_t rows) {
+    std::ptrdiff_t r = 0;
+    for (; r + TRANSPOSE_BLOCK <= rows; r += TRANSPOSE_BLOCK) {
+        std::ptrdiff_t c = 0;
+        for (; c + TRANSPOSE_BLOCK <= cols; c += TRANSPOSE_BLOCK) {
+            transposeBlock(in + r * inStride + c, inStride,
+                           out + c * outStride + r, outStride);
+        }
+        // right border of the tile
+        for (; c < cols; ++c) {
+            for (std::ptrdiff_t rr = r; rr < r + TRANSPOSE_BLOCK; ++rr) {
+                out[c * outStride + rr] = in[rr * inStride + c];
+            }
+        }
+    }
+    // bottom border of the tile
+    for (; r < rows; ++r) {
+        for (std::ptrdiff_t c = 0; c < cols; ++c) {
+            out[c * outStride + r] = in[r * inStride + c];
+        }
+    }
+}
+
+//! \brief full tile: the blocks are transposed into \a buffer, which is then
+//! written one whole row at a time
+//! \note Scattering the blocks straight into the output touches 64 rows that
+//! are far apart in memory at once, and the store buffers, the TLB and the
+//! cache sets run out on large images (mostly with power of two widths).
+template <typename Type>
+void transposeFullTile(const Type *in, std::ptrdiff_t inStride, Type *out,
+                       std::ptrdiff_t outStride, Type *buffer) {
+    for (std::ptrdiff_t r = 0; r < TRANSPOSE_TILE; r += TRANSPOSE_BLOCK) {
+        for (std::ptrdiff_t c = 0; c < TRANSPOSE_TILE; c += TRANSPOSE_BLOCK) {
+            transposeBlock(in + r * inStride + c, inStride,
+                           buffer + c * TRANSPOSE_TILE + r, TRANSPOSE_TILE);
+        }
+    }
+    for (std::ptrdiff_t c = 0; c < TRANSPOSE_TILE; ++c) {
+        std::copy(buffer + c * TRANSPOSE_TILE,
+                  buffer + (c + 1) * TRANSPOSE_TILE, out + c * outStride);
+    }
+}
+
+}  // detail
+
+template <typename Type>
+void transpose(const Type *in, std::ptrdiff_t inStride, Type *out,
+               std::ptrdiff_t outStride, size_t cols, size_t rows) {
+    using detail::TRANSPOSE_TILE;
+
+    const std::ptrdiff_t tilesX = (cols + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    const std::ptrdiff_t tilesY = (rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    const int tiles = static_cast<int>(tilesX * tilesY);
+
+#pragma omp parallel if (tiles > 1)
+    {
+        std::vector<Type> buffer(TRANSPOSE_TILE * TRANSPOSE_TILE);
+
+#pragma omp for
+        for (int t = 0; t < tiles; ++t) {
+            const std::ptrdiff_t r0 = (t / tilesX) * TRANSPOSE_TILE;
+            const std::ptrdiff_t c0 = (t % tilesX) * TRANSPOSE_TILE;
+            const std::ptrdiff_t tileCols = std::min(
+                TRANSPOSE_TILE, static_cast<std::ptrdiff_t>(cols) - c0);
+            const std::ptrdiff_t tileRows = std::min(
+                TRANSPOSE_TILE, static_cast<std::ptrdiff_t>(rows) - r0);
+
+            const Type *tileIn = in + r0 * inStride + c0;
+            Type *tileOut = out + c0 * outStride + r0;
+            if (tileCols == TRANSPOSE_TILE && tileRows == TRANSPOSE_TILE) {
+                detail::transposeFullTile(tileIn, inStride, tileOut,
+                                          outStride, buffer.data());
+            } else {
+                detail::transposeTile(tileIn, inStride, tileOut, outStride,
+                                      tileCols, tileRows);
+            }
+        }
+    }
+}
+
+template <typename Type>
+void transpose(const Type *in, Type *out, size_t cols, size_t rows) {
+    transpose(in, static_cast<std::ptrdiff_t>(cols), out,
+              static_cast<std::ptrdiff_t>(rows), cols, rows);
+}
+
+template <typename Type>
+void transpose(const Array2D<Type> &in, Array2D<Type> &out) {
+    out.resize(in.getRows(), in.getCols());
+    transpose(in.data(), out.data(), in.getCols(), in.getRows());
+}
+
+}  // utils
+}  // pfs
+
+#endif  // PFS_UTILS_TRANSPOSE_HXX
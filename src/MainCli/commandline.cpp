@@ -39,6 +39,8 @@
 #include <Exif/ExifOperations.h>
 #include <Fileformat/pfsoutldrimage.h>
 #include <HdrHTML/pfsouthdrhtml.h>
+#include <HdrWizard/BatchHdrEngine.h>
+#include <HdrWizard/ExifIndex.h>
 #include <Libpfs/manip/gamma_levels.h>
 #include <Libpfs/tm/TonemapOperator.h>
 #include "commandline.h"
@@ -89,6 +91,8 @@ CommandLineInterfaceManager::CommandLineInterfaceManager(const int argc,
       tmopts(TMOptionsOperations::getDefaultTMOptions()),
       tmofileparams(new pfs::Params()),
       verbose(false),
+      responseSampleSize(0),
+      responseCache(false),
       oldValue(0),
       maximum(100),
       started(false),
@@ -99,6 +103,8 @@ CommandLineInterfaceManager::CommandLineInterfaceManager(const int argc,
       htmlQuality(2),
       isProposedLdrName(false),
       isProposedHdrName(false),
+      batchBracketSize(3),
+      batchErrors(0),
       pageName(),
       imagesDir(),
       saveAlignedImagesPrefix(QLatin1String("")) {
@@ -189,7 +195,41 @@ int CommandLineInterfaceManager::execCommandLineParams() {
             .toUtf8()
             .constData())(
         "hdrCurveFilename", po::value<std::string>(),
-        tr("curve filename = your_file_here.m").toUtf8().constData());
+        tr("curve filename = your_file_here.m").toUtf8().constData())(
+        "hdrResponseSamples", po::value<int>(&responseSampleSize),
+        tr("N   Estimate the robertsonauto response curve on about N pixels "
+           "(Default is 0, every pixel)")
+            .toUtf8()
+            .constData())(
+        "hdrResponseCache", po::value<bool>(&responseCache),
+        tr("Reuse the robertsonauto response curve estimated for the same "
+           "camera, ISO, weight and response curve. true|false (Default is "
+           "false)")
+            .toUtf8()
+            .constData());
+
+    po::options_description batch_desc(
+        tr("Batch HDR creation  - one HDR per bracket of the images of a "
+           "directory, no tonemapping is performed")
+            .toUtf8()
+            .constData());
+    batch_desc.add_options()(
+        "batch", po::value<std::string>(),
+        tr("DIR   Create the HDRs of the images in DIR, taken in name order. "
+           "Loading, fusion and saving of consecutive brackets overlap.")
+            .toUtf8()
+            .constData())(
+        "bracket", po::value<int>(&batchBracketSize),
+        tr("VALUE   Number of images per bracket, 0 groups the images from "
+           "their EXIF timestamps and exposures (Default is 3)")
+            .toUtf8()
+            .constData())(
+        "batchOutput", po::value<std::string>(),
+        tr("DIR   Where to save the HDRs, named first-last_HdrCreationModel "
+           "with the extension given by -z (Default is the input directory, "
+           "exr)")
+            .toUtf8()
+            .constData());
 
     po::options_description ldr_desc(
         tr("LDR output parameters").toUtf8().constData());
@@ -368,7 +408,13 @@ reinhard02|\nreinhard05|mai|mantiuk06|mantiuk08|\nvanhateren|lischinski] (Defaul
         tr("lower scale FLOAT").toUtf8().constData())(
         "tmoR02High",
         po::value<int>(&tmopts->operator_options.reinhard02options.upper),
-        tr("upper scale FLOAT").toUtf8().constData());
+        tr("upper scale FLOAT").toUtf8().constData())(
+        "tmoR02Fft",
+        po::value<bool>(
+            &tmopts->operator_options.reinhard02options.fftconvolution),
+        tr("FFT convolution (false: recursive gaussian) true|false")
+            .toUtf8()
+            .constData());
     po::options_description tmo_reinhard05(
         tr(" Reinhard 05").toUtf8().constData());
     tmo_reinhard05.add_options()(
@@ -452,14 +498,19 @@ reinhard02|\nreinhard05|mai|mantiuk06|mantiuk08|\nvanhateren|lischinski] (Defaul
     po::options_description cmdline_options;
     cmdline_options.add(desc)
         .add(hdr_desc)
+        .add(batch_desc)
         .add(ldr_desc)
         .add(html_desc)
         .add(tmo_desc)
         .add(hidden);
 
     po::options_description cmdvisible_options;
-    cmdvisible_options.add(desc).add(hdr_desc).add(ldr_desc).add(html_desc).add(
-        tmo_desc);
+    cmdvisible_options.add(desc)
+        .add(hdr_desc)
+        .add(batch_desc)
+        .add(ldr_desc)
+        .add(html_desc)
+        .add(tmo_desc);
 
     try {
         po::store(po::command_line_parser(argc, argv)
@@ -583,6 +634,21 @@ reinhard02|\nreinhard05|mai|mantiuk06|mantiuk08|\nvanhateren|lischinski] (Defaul
                 printErrorAndExit(
                     tr("Error: Unknown HDR creation model specified."));
         }
+        if (vm.count("batch")) {
+            batchDir = QString::fromStdString(vm["batch"].as<std::string>());
+            if (!QDir(batchDir).exists())
+                printErrorAndExit(tr("Error: Batch directory not found."));
+        }
+        if (vm.count("batchOutput"))
+            batchOutputDir =
+                QString::fromStdString(vm["batchOutput"].as<std::string>());
+        if (batchBracketSize < 0)
+            printErrorAndExit(tr(
+                "Error: The number of images per bracket must not be negative."));
+        if (responseSampleSize < 0)
+            printErrorAndExit(
+                tr("Error: The number of response samples must not be "
+                   "negative."));
         if (vm.count("hdrCurveFilename"))
             hdrcreationconfig.inputResponseCurveFilename =
                 QString::fromStdString(
@@ -725,7 +791,8 @@ reinhard02|\nreinhard05|mai|mantiuk06|mantiuk08|\nvanhateren|lischinski] (Defaul
         }
     }
 
-    if (loadHdrFilename.isEmpty() && inputFiles.isEmpty()) {
+    if (loadHdrFilename.isEmpty() && inputFiles.isEmpty() &&
+        batchDir.isEmpty()) {
         cout << cmdvisible_options << endl;
         exit(0); // Exit here instead of returning to main complicating main code
     }
@@ -742,7 +809,16 @@ void CommandLineInterfaceManager::execCommandLineParamsSlot() {
                "number of input files."));
     }
     // now validate operation mode.
-    if (!inputFiles.isEmpty() && loadHdrFilename.isEmpty()) {
+    if (!batchDir.isEmpty()) {
+        if (!inputFiles.isEmpty() || !loadHdrFilename.isEmpty()) {
+            printErrorAndExit(
+                tr("Error: Batch mode does not take input files."));
+        }
+        operationMode = BATCH_HDR_MODE;
+
+        printIfVerbose(QObject::tr("Running in batch HDR-creation mode."),
+                       verbose);
+    } else if (!inputFiles.isEmpty() && loadHdrFilename.isEmpty()) {
         operationMode = CREATE_HDR_MODE;
 
         printIfVerbose(QObject::tr("Running in HDR-creation mode."), verbose);
@@ -754,7 +830,9 @@ void CommandLineInterfaceManager::execCommandLineParamsSlot() {
         exit(-1);
     }
 
-    if (operationMode == CREATE_HDR_MODE) {
+    if (operationMode == BATCH_HDR_MODE) {
+        runBatch();
+    } else if (operationMode == CREATE_HDR_MODE) {
         if (verbose) {
             LuminanceOptions luminance_options;
 
@@ -782,6 +860,8 @@ void CommandLineInterfaceManager::execCommandLineParamsSlot() {
 
         try {
             hdrCreationManager->setConfig(hdrcreationconfig);
+            hdrCreationManager->setResponseSampleSize(responseSampleSize);
+            hdrCreationManager->setResponseCacheEnabled(responseCache);
             hdrCreationManager->loadFiles(inputFiles);
         } catch (std::runtime_error &e) {
             printErrorAndExit(e.what());
@@ -809,6 +889,105 @@ void CommandLineInterfaceManager::execCommandLineParamsSlot() {
     }
 }
 
+void CommandLineInterfaceManager::runBatch() {
+    if (alignMode == AIS_ALIGN) {
+        printErrorAndExit(
+            tr("Error: Batch mode supports MTB alignment only."));
+    }
+
+    QStringList files = BatchHdrEngine::inputFiles(batchDir);
+    if (files.isEmpty() ||
+        (batchBracketSize != 0 && files.count() % batchBracketSize != 0)) {
+        printErrorAndExit(tr("Error: Total number of pictures must be a "
+                             "multiple of number of bracketed images."));
+    }
+    QList<QStringList> brackets;
+    if (batchBracketSize == 0) {
+        QStringList withoutEV;
+        brackets = ExifIndex::groupBrackets(ExifIndex::scan(files), &withoutEV);
+        foreach (const QString &file, withoutEV) {
+            printIfVerbose(
+                tr("Warning: %1 has no exposure data, skipped.").arg(file),
+                true);
+        }
+        printIfVerbose(tr("Found %1 brackets.").arg(brackets.count()),
+                       verbose);
+    } else {
+        for (int i = 0; i < files.count(); i += batchBracketSize) {
+            brackets << files.mid(i, batchBracketSize);
+        }
+    }
+    if (brackets.isEmpty()) {
+        // the engine is never started, nothing would end the event loop
+        printIfVerbose(tr("Error: No brackets found in %1.").arg(batchDir),
+                       true);
+        emit finishedParsing();
+        return;
+    }
+    if (batchOutputDir.isEmpty()) batchOutputDir = batchDir;
+    const QString extension = isProposedHdrName
+                                  ? QString::fromStdString(hdrExtension)
+                                  : QStringLiteral("exr");
+    const QString caption =
+        QObject::tr("Weights= ") +
+        getQString(hdrcreationconfig.weightFunction) +
+        QObject::tr(" - Response curve= ") +
+        getQString(hdrcreationconfig.responseCurve) +
+        QObject::tr(" - Model= ") + getQString(hdrcreationconfig.fusionOperator);
+
+    batchEngine.reset(new BatchHdrEngine);
+    connect(batchEngine.data(), &BatchHdrEngine::bracketWritten, this,
+            &CommandLineInterfaceManager::batchWritten);
+    connect(batchEngine.data(), &BatchHdrEngine::bracketFailed, this,
+            &CommandLineInterfaceManager::batchFailed);
+    connect(batchEngine.data(), &BatchHdrEngine::bracketDone, this,
+            &CommandLineInterfaceManager::batchDone);
+    connect(batchEngine.data(), &BatchHdrEngine::finished, this,
+            &CommandLineInterfaceManager::batchFinished);
+
+    batchEngine->setConfig(hdrcreationconfig);
+    batchEngine->setResponseSampleSize(responseSampleSize);
+    batchEngine->setResponseCacheEnabled(responseCache);
+    batchEngine->setAlignment(alignMode == MTB_ALIGN
+                                  ? BatchHdrEngine::MTB_ALIGNMENT
+                                  : BatchHdrEngine::NO_ALIGNMENT);
+    batchEngine->setAntiGhosting(threshold);
+
+    setProgressBar(brackets.count());
+    foreach (const QStringList &bracket, brackets) {
+        QFileInfo fi1(bracket.first());
+        QFileInfo fi2(bracket.last());
+        QString outName = fi1.completeBaseName();
+        if (bracket.first() != bracket.last()) {
+            outName += "-" + fi2.completeBaseName();
+        }
+        outName += "_" + caption + "." + extension;
+
+        batchEngine->enqueue(bracket, QDir(batchOutputDir).filePath(outName));
+    }
+}
+
+void CommandLineInterfaceManager::batchWritten(const QString &outName) {
+    printIfVerbose(tr("Image %1 saved successfully").arg(outName), verbose);
+}
+
+void CommandLineInterfaceManager::batchFailed(const QString &message) {
+    ++batchErrors;
+    printIfVerbose(tr("Error: %1").arg(message), true);
+}
+
+void CommandLineInterfaceManager::batchDone() {
+    updateProgressBar(oldValue + 1);
+}
+
+void CommandLineInterfaceManager::batchFinished() {
+    if (batchErrors != 0) {
+        printErrorAndExit(tr("Completed with errors"));
+    }
+    printIfVerbose(tr("Completed without errors"), verbose);
+    emit finishedParsing();
+}
+
 void CommandLineInterfaceManager::finishedLoadingInputFiles() {
     QStringList filesLackingExif = hdrCreationManager->getFilesWithoutExif();
     if (!filesLackingExif.isEmpty() && ev.isEmpty()) {
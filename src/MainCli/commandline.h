@@ -35,6 +35,7 @@
 #include <QStringList>
 
 #include <Core/TonemappingOptions.h>
+#include <HdrWizard/BatchHdrEngine.h>
 #include <HdrWizard/HdrCreationManager.h>
 #include <Libpfs/frame.h>
 #include <Libpfs/params.h>
@@ -53,6 +54,7 @@ class CommandLineInterfaceManager : public QObject {
     enum operation_mode {
         CREATE_HDR_MODE,
         LOAD_HDR_MODE,
+        BATCH_HDR_MODE,
         UNKNOWN_MODE
     } operationMode;
 
@@ -69,6 +71,8 @@ class CommandLineInterfaceManager : public QObject {
     QScopedPointer<pfs::Params> tmofileparams;
     bool verbose;
     FusionOperatorConfig hdrcreationconfig;
+    int responseSampleSize;
+    bool responseCache;
     QString loadHdrFilename;
     QStringList inputFiles;
     ez::ezETAProgressBar progressBar;
@@ -89,8 +93,14 @@ class CommandLineInterfaceManager : public QObject {
     QString saveAlignedImagesPrefix;
     QStringList validLdrExtensions;
     QStringList validHdrExtensions;
+    QString batchDir;
+    QString batchOutputDir;
+    int batchBracketSize;
+    int batchErrors;
+    QScopedPointer<BatchHdrEngine> batchEngine;
 
     void generateHTML();
+    void runBatch();
     void startTonemap();
 
    private slots:
@@ -103,6 +113,10 @@ class CommandLineInterfaceManager : public QObject {
     void updateProgressBar(int);
     void readData(const QByteArray &);
     void tonemapFailed(const QString &);
+    void batchWritten(const QString &);
+    void batchFailed(const QString &);
+    void batchDone();
+    void batchFinished();
 
    signals:
     void finishedParsing();
@@ -36,6 +36,7 @@ int main(int argc, char **argv) {
     LuminanceOptions lumOpts;
 
     TranslatorManager::setLanguage(lumOpts.getGuiLang(), false);
+    lumOpts.applyTmStageCacheSize();
 
     CommandLineInterfaceManager cli(argc, argv);
 
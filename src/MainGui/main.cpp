@@ -157,6 +157,7 @@ int main(int argc, char **argv) {
     TranslatorManager::setLanguage(LuminanceOptions().getGuiLang());
 
     LuminanceOptions().applyTheme(true);
+    LuminanceOptions().applyTmStageCacheSize();
 
     QStringList arguments = application.arguments();
 
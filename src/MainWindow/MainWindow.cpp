@@ -94,6 +94,7 @@
 #endif
 
 #include <Core/IOWorker.h>
+#include <Core/ExportQueue.h>
 #include <Core/TMWorker.h>
 #include <HdrWizard/AutoAntighosting.h>
 #include <HdrWizard/HdrWizard.h>
@@ -214,6 +215,7 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       m_Ui(new Ui::MainWindow),
       m_isFullscreenViewer(false),
+      m_progressiveGeneration(0),
       m_exportQueueSize(0),
       m_interpolationMethod(BilinearInterp),
       m_firstWindow(0),
@@ -227,6 +229,7 @@ MainWindow::MainWindow(pfs::Frame *curr_frame, const QString &new_file,
     : QMainWindow(parent),
       m_Ui(new Ui::MainWindow),
       m_isFullscreenViewer(false),
+      m_progressiveGeneration(0),
       m_exportQueueSize(0),
       m_interpolationMethod(BilinearInterp),
       m_firstWindow(0),
@@ -250,6 +253,8 @@ void MainWindow::init() {
     curr_num_ldr_open = 0;
     splash = 0;
     m_processingAWB = false;
+    m_levelsViewer = nullptr;
+    m_processingLevels = false;
 
     if (sm_NumMainWindows == 1) {
         // Register symbols on the first activation!
@@ -514,6 +519,8 @@ void MainWindow::createConnections() {
             this, &MainWindow::setActiveMainWindow);
     connect(&m_futureWatcher, &QFutureWatcherBase::finished, this,
             &MainWindow::whiteBalanceDone);
+    connect(&m_levelsWatcher, &QFutureWatcherBase::finished, this,
+            &MainWindow::levelsDone);
 }
 
 void MainWindow::loadOptions() {
@@ -854,7 +861,7 @@ void MainWindow::updateActions(int w) {
     m_Ui->rotateccw->setEnabled(isHdr);
     m_Ui->rotatecw->setEnabled(isHdr);
 
-    m_Ui->actionFix_Histogram->setEnabled(isLdr);
+    m_Ui->actionFix_Histogram->setEnabled(isLdr && !m_processingLevels);
     m_Ui->actionWhite_Balance->setEnabled(hasImage && !m_processingAWB);
     m_Ui->actionSoft_Proofing->setEnabled(isLdr && hasPrinterProfile);
     m_Ui->actionGamut_Check->setEnabled(isLdr && hasPrinterProfile);
@@ -1492,8 +1499,7 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     }
     m_TMThread->quit();
     m_TMThread->wait();
-    m_QueueThread->quit();  // should be idle, quit() ok
-    m_QueueThread->wait();
+    m_ExportQueue->waitForDone();
 
     clearRecentFileActions();
     QMainWindow::closeEvent(event);
@@ -1583,8 +1589,8 @@ void MainWindow::setupTM() {
     connect(m_TMWorker, &QObject::destroyed, m_TMThread, &QObject::deleteLater);
 
     // get back result!
-    connect(m_TMWorker, &TMWorker::tonemapSuccess, this,
-            &MainWindow::addLdrFrame);
+    connect(m_TMWorker, &TMWorker::tonemapPassSuccess, this,
+            &MainWindow::addProgressiveLdrFrame);
     connect(m_TMWorker, SIGNAL(tonemapFailed(QString)), this,
             SLOT(tonemapFailed(QString)));
 
@@ -1614,39 +1620,26 @@ void MainWindow::setupQueue() {
     connect(this, &QObject::destroyed, m_QueueProgressBar,
             &QObject::deleteLater);
 
-    m_QueueWorker = new TMWorker;
-    m_QueueThread = new QThread;
+    m_ExportQueue = new ExportQueue(this);
 
-    m_QueueWorker->moveToThread(m_QueueThread);
-
-    // Memory Management
-    connect(this, &QObject::destroyed, m_QueueWorker, &QObject::deleteLater);
-    connect(m_QueueWorker, &QObject::destroyed, m_QueueThread,
-            &QObject::deleteLater);
-
-    // get back result!
-    // connect(m_QueueWorker, SIGNAL(tonemapSuccess(pfs::Frame*,
-    // TonemappingOptions*)),
-    //    this, SLOT(addLdrFrame(pfs::Frame*, TonemappingOptions*)));
-    connect(m_QueueWorker, SIGNAL(tonemapFailed(QString)), this,
-            SLOT(tonemapFailed(QString)));
+    connect(m_ExportQueue, &ExportQueue::exportFailed, this,
+            &MainWindow::exportFailed);
 
     // progress bar handling
-    connect(m_QueueWorker, &TMWorker::tonemapBegin, this,
+    connect(m_ExportQueue, &ExportQueue::exportBegin, this,
             &MainWindow::exportBegin);
-    connect(m_QueueWorker, &TMWorker::tonemapEnd, this, &MainWindow::exportEnd);
+    connect(m_ExportQueue, &ExportQueue::exportEnd, this,
+            &MainWindow::exportEnd);
 
-    connect(m_QueueWorker, &TMWorker::tonemapSetValue, m_QueueProgressBar,
+    connect(m_ExportQueue, &ExportQueue::exportSetValue, m_QueueProgressBar,
             &TMOProgressIndicator::setValue);
-    connect(m_QueueWorker, &TMWorker::tonemapSetMaximum, m_QueueProgressBar,
+    connect(m_ExportQueue, &ExportQueue::exportSetMaximum, m_QueueProgressBar,
             &TMOProgressIndicator::setMaximum);
-    connect(m_QueueWorker, &TMWorker::tonemapSetMinimum, m_QueueProgressBar,
+    connect(m_ExportQueue, &ExportQueue::exportSetMinimum, m_QueueProgressBar,
             &TMOProgressIndicator::setMinimum);
-    connect(m_QueueProgressBar, &TMOProgressIndicator::terminate, m_QueueWorker,
-            &TMWorker::tonemapRequestTermination, Qt::DirectConnection);
-
-    // start thread waiting for signals (I/O requests)
-    m_QueueThread->start();
+    connect(m_QueueProgressBar, &TMOProgressIndicator::terminate,
+            m_ExportQueue, &ExportQueue::requestTermination,
+            Qt::DirectConnection);
 }
 
 void MainWindow::tonemapBegin() {
@@ -1668,10 +1661,22 @@ void MainWindow::exportBegin() {
 
 void MainWindow::exportEnd() {
     m_tonemapPanel->setExportQueueSize(--m_exportQueueSize);
+    // other exports may still be running
+    if (m_exportQueueSize > 0) return;
     m_QueueProgressBar->hide();
     m_QueueProgressBar->reset();
 }
 
+void MainWindow::exportFailed(const QString &error_msg) {
+    // the interactive tonemap is independent of the queue: its panels and
+    // progress bar are left alone, exportEnd() follows
+    if (error_msg != QLatin1String("Canceled")) {
+        QMessageBox::critical(this, tr("Luminance HDR"),
+                              tr("Export failed: %1").arg(error_msg),
+                              QMessageBox::Ok, QMessageBox::NoButton);
+    }
+}
+
 void MainWindow::tonemapImage(TonemappingOptions *opts) {
 #ifdef QT_DEBUG
     qDebug() << "Start Tone Mapping";
@@ -1725,11 +1730,14 @@ void MainWindow::tonemapImage(TonemappingOptions *opts) {
 #endif
         // CALL m_TMWorker->getTonemappedFrame(hdr_viewer->getHDRPfsFrame(),
         // opts);
+        // outdated passes of a previous request are abandoned
+        const int generation = m_TMWorker->supersede();
         QMetaObject::invokeMethod(
-            m_TMWorker, "computeTonemap", Qt::QueuedConnection,
+            m_TMWorker, "computeProgressiveTonemap", Qt::QueuedConnection,
             Q_ARG(pfs::Frame *, hdr_viewer->getFrame()),
             Q_ARG(TonemappingOptions *, opts),
-            Q_ARG(InterpolationMethod, m_interpolationMethod));
+            Q_ARG(InterpolationMethod, m_interpolationMethod),
+            Q_ARG(int, generation));
     }
 }
 
@@ -1747,13 +1755,9 @@ void MainWindow::exportImage(TonemappingOptions *opts) {
 
         m_tonemapPanel->setExportQueueSize(++m_exportQueueSize);
 
-        QMetaObject::invokeMethod(
-            m_QueueWorker, "computeTonemapAndExport", Qt::QueuedConnection,
-            Q_ARG(pfs::Frame *, hdr_viewer->getFrame()),
-            Q_ARG(TonemappingOptions *, opts), Q_ARG(pfs::Params, params),
-            Q_ARG(QString, exportDir), Q_ARG(QString, hdrName),
-            Q_ARG(QString, inputfname), Q_ARG(QVector<float>, m_inputExpoTimes),
-            Q_ARG(InterpolationMethod, m_interpolationMethod));
+        m_ExportQueue->enqueue(hdr_viewer->getFrame(), opts, params,
+                               exportDir, hdrName, inputfname,
+                               m_inputExpoTimes, m_interpolationMethod);
     }
 }
 
@@ -1769,7 +1773,11 @@ void MainWindow::addLdrFrame(pfs::Frame *frame,
 
     GenericViewer *n =
         static_cast<GenericViewer *>(m_tabwidget->currentWidget());
-    if (m_tonemapPanel->replaceLdr() && n != nullptr && !n->isHDR()) {
+    if (!m_progressiveViewer.isNull()) {
+        // refinement of a progressive tonemap
+        n = m_progressiveViewer;
+        n->setFrame(frame, tm_options);
+    } else if (m_tonemapPanel->replaceLdr() && n != nullptr && !n->isHDR()) {
         n->setFrame(frame, tm_options);
     } else {
         curr_num_ldr_open++;
@@ -1807,6 +1815,24 @@ void MainWindow::addLdrFrame(pfs::Frame *frame,
     }
 }
 
+void MainWindow::addProgressiveLdrFrame(pfs::Frame *frame,
+                                        TonemappingOptions *tm_options,
+                                        int generation) {
+    if (!m_TMWorker->isCurrent(generation)) {
+        delete frame;
+        return;
+    }
+    // the first pass of a request opens (or replaces) a viewer as usual, the
+    // following ones refine it
+    if (generation != m_progressiveGeneration) {
+        m_progressiveViewer.clear();
+        m_progressiveGeneration = generation;
+    }
+    addLdrFrame(frame, tm_options);
+    m_progressiveViewer =
+        static_cast<GenericViewer *>(m_tabwidget->currentWidget());
+}
+
 void MainWindow::tonemapFailed(const QString &error_msg) {
     if (error_msg != QLatin1String("Canceled")) {
         QMessageBox::critical(this, tr("Luminance HDR"),
@@ -2063,33 +2089,51 @@ void MainWindow::on_actionFix_Histogram_toggled(bool checked) {
 
         m_Ui->actionFix_Histogram->setDisabled(true);
 
-        connect(g_n_l.data(), SIGNAL(updateQImage(QImage)), current,
-                SLOT(setQImage(QImage)));
+        // the preview is rendered in place, the visible part first
+        g_n_l->setVisibleRect(current->getVisibleRect());
+        GammaAndLevels *dialog = g_n_l.data();
+        connect(current, &GenericViewer::changed, dialog, [dialog, current]() {
+            dialog->setVisibleRect(current->getVisibleRect());
+        });
+        connect(g_n_l.data(), &GammaAndLevels::updateQImageRect, current,
+                &GenericViewer::setQImageRect);
         int exit_status = g_n_l->exec();
 
         if (exit_status == 1) {
 #ifdef QT_DEBUG
             qDebug() << "GammaAndLevels accepted!";
 #endif
-            // pfs::Frame * frame = current->getFrame();
-            pfs::gammaAndLevels(
-                current->getFrame(), g_n_l->getBlackPointInput(),
-                g_n_l->getWhitePointInput(), g_n_l->getBlackPointOutput(),
-                g_n_l->getWhitePointOutput(), g_n_l->getGamma());
-
-            // current->setFrame(frame);
+            // the full resolution frame is processed in the background
+            m_processingLevels = true;
+            m_levelsViewer = current;
+            m_tabwidget->setTabEnabled(m_tabwidget->indexOf(current), false);
+
+            m_levelsWatcher.setFuture(QtConcurrent::run(boost::bind(
+                pfs::gammaAndLevels, current->getFrame(),
+                g_n_l->getBlackPointInput(), g_n_l->getWhitePointInput(),
+                g_n_l->getBlackPointOutput(), g_n_l->getWhitePointOutput(),
+                g_n_l->getGamma())));
         } else {
 #ifdef QT_DEBUG
             qDebug() << "GammaAndLevels refused!";
 #endif
             current->setQImage(g_n_l->getReferenceQImage());
+            m_Ui->actionFix_Histogram->setDisabled(false);
         }
 
-        m_Ui->actionFix_Histogram->setDisabled(false);
         m_Ui->actionFix_Histogram->setChecked(false);
     }
 }
 
+void MainWindow::levelsDone() {
+    m_processingLevels = false;
+    m_tabwidget->setTabEnabled(m_tabwidget->indexOf(m_levelsViewer), true);
+    m_tabwidget->setCurrentWidget(m_levelsViewer);
+    // the preview may still miss the tiles that were not shown
+    m_levelsViewer->updatePixmap();
+    m_Ui->actionFix_Histogram->setDisabled(false);
+}
+
 void MainWindow::on_actionWhite_Balance_triggered() {
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
     m_Ui->actionWhite_Balance->setEnabled(false);
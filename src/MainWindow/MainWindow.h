@@ -38,6 +38,7 @@
 #include <QFutureWatcher>
 #include <QMainWindow>
 #include <QMap>
+#include <QPointer>
 #include <QProgressBar>
 #include <QScopedPointer>
 #include <QScrollArea>
@@ -73,6 +74,7 @@ class TMOProgressIndicator;  // #include
 class TonemappingPanel;      // #include "TonemappingPanel/TonemappingPanel.h"
 class TonemappingOptions;    // #include "Core/TonemappingOptions.h"
 class TMWorker;
+class ExportQueue;  // #include "Core/ExportQueue.h"
 
 class UpdateChecker;  // #include "MainWindow/UpdateChecker.h"
 
@@ -155,6 +157,7 @@ class MainWindow : public QMainWindow {
     void on_actionFix_Histogram_toggled(bool checked);
     void on_actionWhite_Balance_triggered();
     void whiteBalanceDone();
+    void levelsDone();
 
     // Tool Bar Handling
     void Text_Under_Icons();
@@ -192,12 +195,15 @@ class MainWindow : public QMainWindow {
     void tonemapImage(TonemappingOptions *opts);
     void exportImage(TonemappingOptions *opts);
     void addLdrFrame(pfs::Frame *, TonemappingOptions *);
+    void addProgressiveLdrFrame(pfs::Frame *, TonemappingOptions *,
+                                int generation);
     // void addLDRResult(QImage*, quint16*);
     void tonemapFailed(const QString &);
 
     // Export queue
     void exportBegin();
     void exportEnd();
+    void exportFailed(const QString &);
 
     // lock functionalities
     void on_actionLock_toggled(bool);
@@ -337,10 +343,12 @@ class MainWindow : public QMainWindow {
     QThread *m_TMThread;
     TMWorker *m_TMWorker;
     TMOProgressIndicator *m_TMProgressBar;
+    // viewer showing the coarser passes of the current progressive tonemap
+    QPointer<GenericViewer> m_progressiveViewer;
+    int m_progressiveGeneration;
 
     // Export queue
-    QThread *m_QueueThread;
-    TMWorker *m_QueueWorker;
+    ExportQueue *m_ExportQueue;
     TMOProgressIndicator *m_QueueProgressBar;
 
     int m_exportQueueSize;
@@ -351,6 +359,9 @@ class MainWindow : public QMainWindow {
     QFutureWatcher<void> m_futureWatcher;
     GenericViewer *m_viewerToProcess;
     bool m_processingAWB;
+    QFutureWatcher<void> m_levelsWatcher;
+    GenericViewer *m_levelsViewer;
+    bool m_processingLevels;
     int m_firstWindow;
     int m_winId;  // unique MainWindow identifier
 
@@ -193,12 +193,18 @@ void PreferencesDialog::on_okButton_clicked() {
 
     // --- Batch TM
     luminance_options.setBatchTmNumThreads(m_Ui->numThreadspinBox->value());
+    luminance_options.setTmStageCacheSize(m_Ui->stageCacheSpinBox->value());
+    luminance_options.applyTmStageCacheSize();
 
     // --- Other Parameters
 
     QStringList ais_options = m_Ui->aisParamsLineEdit->text().split(
         QStringLiteral(" "), QString::SkipEmptyParts);
     luminance_options.setAlignImageStackOptions(ais_options, true);
+    luminance_options.setResponseSampleSize(
+        m_Ui->responseSamplesSpinBox->value());
+    luminance_options.setResponseCacheEnabled(
+        m_Ui->responseCacheCheckBox->isChecked());
 
     // --- RAW parameters
     luminance_options.setRawFourColorRGB(m_Ui->four_color_rgb_CB->isChecked());
@@ -540,10 +546,15 @@ void PreferencesDialog::from_options_to_gui() {
     m_Ui->lineEditTempPath->setText(luminance_options.getTempDir());
 
     m_Ui->numThreadspinBox->setValue(luminance_options.getBatchTmNumThreads());
+    m_Ui->stageCacheSpinBox->setValue(luminance_options.getTmStageCacheSize());
 
     m_Ui->aisParamsLineEdit->setText(
         luminance_options.getAlignImageStackOptions().join(
             QStringLiteral(" ")));
+    m_Ui->responseSamplesSpinBox->setValue(
+        luminance_options.getResponseSampleSize());
+    m_Ui->responseCacheCheckBox->setChecked(
+        luminance_options.isResponseCacheEnabled());
 
     m_Ui->previewsWidthSpinBox->setValue(luminance_options.getPreviewWidth());
 
@@ -22,13 +22,17 @@
  */
 
 #include <QDebug>
+#include <QRunnable>
 #include <QSharedPointer>
-#include <QtConcurrentMap>
+#include <QThread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "PreviewPanel.h"
 
 #include "Libpfs/frame.h"
-#include "Libpfs/manip/copy.h"
 #include "Libpfs/manip/gamma_levels.h"
 #include "Libpfs/manip/resize.h"
 
@@ -54,62 +58,52 @@ void resetTonemappingOptions(TonemappingOptions *tm_options,
     tm_options->tonemapSelection = false;
 }
 
-class PreviewLabelUpdater {
+//! \brief Renders the thumbnail of one PreviewLabel on the thread pool of
+//! the PreviewPanel.
+//! \note All the updaters of a request share the same (read only) reference
+//! frame: TMWorker::computeTonemap() makes its own working copy. The
+//! TonemappingOptions are copied when the request is made, so that the
+//! label can be changed meanwhile from the GUI thread.
+//! Each request takes a ticket from the label: when a newer request exists,
+//! the stale one is dropped before starting and its result is not published.
+class PreviewLabelUpdater : public QRunnable {
    public:
-    explicit PreviewLabelUpdater(QSharedPointer<pfs::Frame> reference_frame)
+    PreviewLabelUpdater(QSharedPointer<pfs::Frame> reference_frame,
+                        PreviewLabel *to_update,
+                        QSharedPointer<QAtomicInt> ticket_counter)
         : m_doAutolevels(false),
           m_autolevelThreshold(0.985f),
-          m_ReferenceFrame(reference_frame) {}
+          m_ReferenceFrame(reference_frame),
+          m_PreviewLabel(to_update),
+          m_TMOptions(*to_update->getTonemappingOptions()),
+          m_TicketCounter(ticket_counter),
+          m_Ticket(ticket_counter->fetchAndAddOrdered(1) + 1) {
+        resetTonemappingOptions(&m_TMOptions, m_ReferenceFrame.data());
+    }
 
     void setAutolevels(bool al, float th) {
         m_doAutolevels = al;
         m_autolevelThreshold = th;
     }
+
     //! \brief QRunnable::run() definition
     //! \caption I use shared pointer in this function, so I don't have to worry
     //! about memory allocation
     //! in case something wrong happens, it shouldn't leak
-    void operator()(PreviewLabel *to_update) {
-#ifdef QT_DEBUG
-// qDebug() << QThread::currentThread() << "running...";
-#endif
+    void run() override {
+        if (isStale()) return;
 
-        // retrieve TM parameters
-        TonemappingOptions *tm_options = to_update->getTonemappingOptions();
-        resetTonemappingOptions(tm_options, m_ReferenceFrame.data());
-
-        if (m_ReferenceFrame.isNull()) {
-#ifdef QT_DEBUG
-            qDebug() << "operator()() for TM"
-                     << static_cast<int>(tm_options->tmoperator)
-                     << " received a nullptr pointer";
-            return;
+#ifdef _OPENMP
+        // thumbnails are small: parallelism comes from the pool
+        omp_set_num_threads(1);
 #endif
-        }
-
-        // Copy Reference Frame
-        QSharedPointer<pfs::Frame> temp_frame(
-            pfs::copy(m_ReferenceFrame.data()));
-
-        // Tone Mapping
-        // QScopedPointer<TonemapOperator> tm_operator(
-        // TonemapOperator::getTonemapOperator(tm_options->tmoperator));
-        // tm_operator->tonemapFrame(temp_frame.data(), tm_options,
-        // fake_progress_helper);
 
-        // try { //Since nothing here actually throws this isn't useful, i need
-        // to
-        // check if returned frame != nullptr
         QScopedPointer<TMWorker> tmWorker(new TMWorker);
         QSharedPointer<pfs::Frame> frame(tmWorker->computeTonemap(
-            temp_frame.data(), tm_options, BilinearInterp));
+            m_ReferenceFrame.data(), &m_TMOptions, BilinearInterp));
 
+        QSharedPointer<QImage> qimage;
         if (!frame.isNull()) {
-            // Create QImage from pfs::Frame into QSharedPointer, and I give it
-            // to the
-            // preview panel
-            // QSharedPointer<QImage>
-            // qimage(fromLDRPFStoQImage(temp_frame.data()));
             if (m_doAutolevels) {
                 QSharedPointer<QImage> temp_qimage(
                     fromLDRPFStoQImage(frame.data()));
@@ -119,47 +113,34 @@ class PreviewLabelUpdater {
                 pfs::gammaAndLevels(frame.data(), minL, maxL, 0.f, 1.f, gammaL);
             }
 
-            QSharedPointer<QImage> qimage(fromLDRPFStoQImage(frame.data()));
-
-            //! \note I cannot use these 2 functions, because setPixmap must run
-            //! in
-            //! the GUI thread
-            // m_PreviewLabel->setPixmap( QPixmap::fromImage(*qimage) );
-            // m_PreviewLabel->adjustSize();
-            //! \note So I queue a SLOT request on the m_PreviewPanel
-            QMetaObject::invokeMethod(to_update, "assignNewQImage",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QSharedPointer<QImage>, qimage));
+            qimage.reset(fromLDRPFStoQImage(frame.data()));
         } else {
-            QSharedPointer<QImage> qimage(
-                new QImage(PREVIEW_WIDTH, PREVIEW_HEIGHT,
-                           QImage::Format_ARGB32_Premultiplied));
+            qimage.reset(new QImage(PREVIEW_WIDTH, PREVIEW_HEIGHT,
+                                    QImage::Format_ARGB32_Premultiplied));
             qimage->fill(QColor(
                 255, 0,
                 0));  // TODO Tonemapping failed, let's show a RED preview...
-            QMetaObject::invokeMethod(to_update, "assignNewQImage",
-                                      Qt::QueuedConnection,
-                                      Q_ARG(QSharedPointer<QImage>, qimage));
         }
-/*
-}
-catch (...) {
-    qDebug() << "PreviewLabelUpdater: caught exception";
-    QSharedPointer<QImage> qimage(new QImage);
-    QMetaObject::invokeMethod(to_update, "assignNewQImage",
-Qt::QueuedConnection,
-                              Q_ARG(QSharedPointer<QImage>, qimage));
-}
-*/
-#ifdef QT_DEBUG
-// qDebug() << QThread::currentThread() << "done!";
-#endif
+
+        if (isStale()) return;
+
+        //! \note setPixmap must run in the GUI thread, so I queue a SLOT
+        //! request on the label: each thumbnail shows up as soon as it is ready
+        QMetaObject::invokeMethod(m_PreviewLabel, "assignNewQImage",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QSharedPointer<QImage>, qimage));
     }
 
    private:
+    bool isStale() const { return m_TicketCounter->loadAcquire() != m_Ticket; }
+
     bool m_doAutolevels;
     float m_autolevelThreshold;
     QSharedPointer<pfs::Frame> m_ReferenceFrame;
+    PreviewLabel *m_PreviewLabel;
+    TonemappingOptions m_TMOptions;
+    QSharedPointer<QAtomicInt> m_TicketCounter;
+    int m_Ticket;
 };
 }
 
@@ -319,6 +300,12 @@ PreviewPanel::PreviewPanel(QWidget *parent)
                 &PreviewLabel::clicked),
             this, &PreviewPanel::tonemapPreview);
 
+    for (int i = 0; i < m_ListPreviewLabel.size(); ++i) {
+        m_Tickets.push_back(QSharedPointer<QAtomicInt>(new QAtomicInt(0)));
+    }
+    m_ThreadPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(),
+                                          m_ListPreviewLabel.size()));
+
     FlowLayout *flowLayout = new FlowLayout;
 
     flowLayout->addWidget(labelMantiuk06);
@@ -344,6 +331,9 @@ PreviewPanel::~PreviewPanel() {
 #ifdef QT_DEBUG
     qDebug() << "PreviewPanel::~PreviewPanel()";
 #endif
+    // running updaters still reference the labels
+    m_ThreadPool.clear();
+    m_ThreadPool.waitForDone();
 }
 
 void PreviewPanel::updatePreviews(pfs::Frame *frame, int index) {
@@ -359,27 +349,28 @@ void PreviewPanel::updatePreviews(pfs::Frame *frame, int index) {
         float ratio = ((float)frame_width) / frame_height;
         resized_width = PREVIEW_HEIGHT * ratio;
     }
-    // 1. make a resized copy
+    // 1. make a resized copy, shared by all the updaters
     QSharedPointer<pfs::Frame> current_frame(
         pfs::resize(frame, resized_width, BilinearInterp));
 
-    // 2. (non concurrent) for each PreviewLabel, call
-    // PreviewLabelUpdater::operator()
+    // 2. (concurrent) for each PreviewLabel, queue a PreviewLabelUpdater:
+    // requests still waiting in the pool are superseded by this one
     if (index == -1) {
-        foreach (PreviewLabel *current_label, m_ListPreviewLabel) {
-            PreviewLabelUpdater updater(current_frame);
-            updater.setAutolevels(m_doAutolevels, m_autolevelThreshold);
-            updater(current_label);
+        m_ThreadPool.clear();
+        for (int i = 0; i < m_ListPreviewLabel.size(); ++i) {
+            schedulePreview(current_frame, i);
         }
     } else {
-        PreviewLabelUpdater updater(current_frame);
-        updater.setAutolevels(m_doAutolevels, m_autolevelThreshold);
-        updater(m_ListPreviewLabel.at(index));
+        schedulePreview(current_frame, index);
     }
-    // 2. (concurrent) for each PreviewLabel, call
-    // PreviewLabelUpdater::operator()
-    // QtConcurrent::map (m_ListPreviewLabel, PreviewLabelUpdater(current_frame)
-    // );
+}
+
+void PreviewPanel::schedulePreview(QSharedPointer<pfs::Frame> frame,
+                                   int index) {
+    PreviewLabelUpdater *updater = new PreviewLabelUpdater(
+        frame, m_ListPreviewLabel.at(index), m_Tickets.at(index));
+    updater->setAutolevels(m_doAutolevels, m_autolevelThreshold);
+    m_ThreadPool.start(updater);
 }
 
 void PreviewPanel::tonemapPreview(TonemappingOptions *opts) {
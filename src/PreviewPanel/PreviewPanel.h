@@ -24,6 +24,10 @@
 #ifndef PREVIEWPANEL_IMPL_H
 #define PREVIEWPANEL_IMPL_H
 
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
 #include <QWidget>
 
 // forward declaration
@@ -58,9 +62,14 @@ class PreviewPanel : public QWidget {
     void startTonemapping(TonemappingOptions *);
 
    private:
+    void schedulePreview(QSharedPointer<pfs::Frame> frame, int index);
+
     int m_original_width_frame;
     bool m_doAutolevels;
     float m_autolevelThreshold;
     QVector<PreviewLabel *> m_ListPreviewLabel;
+    //! \brief last request made for each label (latest wins)
+    QVector<QSharedPointer<QAtomicInt>> m_Tickets;
+    QThreadPool m_ThreadPool;
 };
 #endif
@@ -29,19 +29,17 @@
 #define PYRAMID_ASHIKHMIN_H
 
 #include <stdio.h>
+#include <algorithm>
 
 #include <Libpfs/array2d.h>
 #include <Libpfs/array2d_fwd.h>
+#include <arch/allocator.h>
 
 using namespace pfs;
 
 class Pyramid {  // each level of a Gaussian pyramid
    public:
-    Pyramid() : width(0), height(0), size(0), kernel_size(0), lambda(0.), GP(nullptr), flag(0) {
-    };
-
-    ~Pyramid(){
-        //    delete GP;
+    Pyramid() : width(0), height(0), size(0), kernel_size(0), lambda(0.), flag(0) {
     };
 
     int width;
@@ -51,12 +49,14 @@ class Pyramid {  // each level of a Gaussian pyramid
 
     double lambda;
 
-    pfs::Array2Df *GP;
+    lhdrengine::AlignedVector<float> GP;
     int flag;
 
-    inline double getPixel(int x, int y) { return (*GP)(x, y); }
+    inline double getPixel(int x, int y) const { return GP[y * width + x]; }
+
+    inline void setPixel(int x, int y, double val) { GP[y * width + x] = val; }
 
-    inline void setPixel(int x, int y, double val) { (*GP)(x, y) = val; }
+    inline const float *row(int y) const { return GP.data() + y * width; }
 };
 
 ////////////////////////////////////////////////////////
@@ -91,10 +91,6 @@ class GaussianPyramid {
         constructPyramid(lum_map, im_width, im_height);
     }
 
-    ~GaussianPyramid() {
-        for (int i = 0; i < PYRAMID; i++) delete p[i].GP;
-    }
-
     double NoInterpolateLum(int newX, int newY, Pyramid *pl) {
 
         double lum;
@@ -182,7 +178,7 @@ class GaussianPyramid {
                     newY = (int)((double)y / lambda);
                     double bottom_lum = InterpolateLum(newX, newY, &p[bottom]);
 */
-                    (*p[i].GP)(x, y) = (1.0 - lambda) * top_lum + lambda * bottom_lum;
+                    p[i].setPixel(x, y, (1.0 - lambda) * top_lum + lambda * bottom_lum);
                 }
             }
         }
@@ -266,15 +262,13 @@ class GaussianPyramid {
         p[index].size = w * h;
         p[index].kernel_size = k_size;
         p[index].lambda = lambda;
-        p[index].GP = new pfs::Array2Df(w, h);
+        p[index].GP.assign(p[index].size, 0.f);
         p[index].flag = 1;
     }
 
     void constructPyramid(pfs::Array2Df *lum_map, int im_width, int im_height) {
         initializeNewLevel(0, im_width, im_height, 1, 1.0);
-        for (int y = 0; y < im_height; y++)
-            for (int x = 0; x < im_width; x++)
-                p[0].setPixel(x, y, (*lum_map)(x, y));
+        std::copy(lum_map->begin(), lum_map->end(), p[0].GP.begin());
 
         int current_index = 0;
         while (p[current_index].kernel_size < PYRAMID)
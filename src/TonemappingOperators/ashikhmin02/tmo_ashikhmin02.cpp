@@ -28,7 +28,9 @@
 
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 #include "Libpfs/array2d.h"
 #include "Libpfs/frame.h"
@@ -44,73 +46,142 @@
 
 //-------------------------------------------
 
-float calc_LAL_interpolated(GaussianPyramid *myPyramid, size_t x, size_t y, int s) {
-    double ratio = myPyramid->p[s - 1].lambda;
-
-    double newX = (double)x * ratio;
-    double newY = (double)y * ratio;
-    size_t X_int = (size_t)newX;
-    size_t Y_int = (size_t)newY;
-
-    double dx, dy, omdx, omdy;
-    dx = newX - (double)X_int;
-    omdx = 1. - dx;
-    dy = newY - (double)Y_int;
-    omdy = 1. - dy;
-
-    size_t w = myPyramid->p[s - 1].GP->getCols();
-    size_t h = myPyramid->p[s - 1].GP->getRows();
-
-    double g;
-    if (X_int < w - 1 && Y_int < h - 1) {
-        g = omdx * omdy * myPyramid->p[s - 1].getPixel(X_int, Y_int) +
-            dx * omdy * myPyramid->p[s - 1].getPixel(X_int + 1, Y_int) +
-            omdx * dy * myPyramid->p[s - 1].getPixel(X_int, Y_int + 1) +
-            dx * dy * myPyramid->p[s - 1].getPixel(X_int + 1, Y_int + 1);
-    } else if (X_int < w - 1 && Y_int >= h - 1) {
-        Y_int = h - 1;
-        g = omdx * myPyramid->p[s - 1].getPixel(X_int, Y_int) +
-            dx * myPyramid->p[s - 1].getPixel(X_int + 1, Y_int);
-    } else if (X_int >= w - 1 && Y_int < h - 1) {
-        X_int = w - 1;
-        g = omdy * myPyramid->p[s - 1].getPixel(X_int, Y_int) +
-            dy * myPyramid->p[s - 1].getPixel(X_int, Y_int + 1);
-    } else
-        g = myPyramid->p[s - 1].getPixel(w - 1, h - 1);
-
-    return g;
-}
-
-float calc_LAL(GaussianPyramid *myPyramid, int x, int y, int s) {
-    float ratio = myPyramid->p[s - 1].lambda;
+namespace {
 
-    float newX = (float)x * ratio;
-    float newY = (float)y * ratio;
-    unsigned int X_int = (unsigned int)newX;
-    unsigned int Y_int = (unsigned int)newY;
+// rows of the frame processed together by computeLAL()
+const int LAL_TILE_ROWS = 4;
 
-    if (X_int >= myPyramid->p[s - 1].GP->getCols())
-        X_int = myPyramid->p[s - 1].GP->getCols() - 1;
-    if (Y_int >= myPyramid->p[s - 1].GP->getRows())
-        Y_int = myPyramid->p[s - 1].GP->getRows() - 1;
+//! \brief bilinear sampling of a pyramid level at full resolution. Taps
+//! falling outside of the level are clamped to its last row/column.
+struct LevelSampling {
+    LevelSampling(const Pyramid &level, int ncols, int nrows)
+        : x0(ncols), x1(ncols), dx(ncols), y0(nrows), y1(nrows), dy(nrows) {
+        init(level.lambda, ncols, level.width, x0, x1, dx);
+        init(level.lambda, nrows, level.height, y0, y1, dy);
+    }
 
-    return myPyramid->p[s - 1].getPixel(X_int, Y_int);
+    std::vector<int> x0, x1;
+    std::vector<float> dx;
+    std::vector<int> y0, y1;
+    std::vector<float> dy;
+
+   private:
+    static void init(double ratio, int n, int size, std::vector<int> &i0,
+                     std::vector<int> &i1, std::vector<float> &d) {
+        for (int i = 0; i < n; i++) {
+            const double pos = (double)i * ratio;
+            const int i_int = (int)pos;
+            i0[i] = std::min(i_int, size - 1);
+            i1[i] = std::min(i_int + 1, size - 1);
+            d[i] = (float)(pos - (double)i_int);
+        }
+    }
+};
+
+//! \brief upsample rows [yBegin, yEnd) of \c level at full resolution
+void upsampleRows(const Pyramid &level, const LevelSampling &sampling,
+                  int yBegin, int yEnd, float *out) {
+    const int ncols = sampling.x0.size();
+    for (int y = yBegin; y < yEnd; y++, out += ncols) {
+        const float *r0 = level.row(sampling.y0[y]);
+        const float *r1 = level.row(sampling.y1[y]);
+        const float dy = sampling.dy[y];
+        for (int x = 0; x < ncols; x++) {
+            const int x0 = sampling.x0[x];
+            const int x1 = sampling.x1[x];
+            const float dx = sampling.dx[x];
+            const float top = r0[x0] + dx * (r0[x1] - r0[x0]);
+            const float bottom = r1[x0] + dx * (r1[x1] - r1[x0]);
+            out[x] = top + dy * (bottom - top);
+        }
+    }
 }
 
-float LAL(GaussianPyramid *myPyramid, int x, int y, float LOCAL_CONTRAST) {
-    float g, gg;
-    for (int s = 1; s <= SMAX; s++) {
-        // with interpolation
-        g = calc_LAL_interpolated(myPyramid, x, y, s);
-        gg = calc_LAL_interpolated(myPyramid, x, y, 2 * s);
+//! \brief Local adaptation luminance: for each pixel, the first scale s at
+//! which the contrast between the levels s and 2s of the pyramid reaches
+//! \c LOCAL_CONTRAST.
+//! \note The pyramid is walked level by level on tiles of rows: each level
+//! is upsampled once per tile, and pixels which already found their scale
+//! are masked out of the following ones. A tile stops as soon as all its
+//! pixels are done.
+void computeLAL(const GaussianPyramid &pyramid, pfs::Array2Df &la,
+                float LOCAL_CONTRAST, pfs::Progress &ph) {
+    const int ncols = la.getCols();
+    const int nrows = la.getRows();
+    const int numTiles = (nrows + LAL_TILE_ROWS - 1) / LAL_TILE_ROWS;
+
+    // levels s - 1 and 2s - 1, for s in [1, SMAX]
+    std::vector<LevelSampling> samplings;
+    for (int k = 0; k < 2 * SMAX; k++) {
+        samplings.push_back(LevelSampling(pyramid.p[k], ncols, nrows));
+    }
 
-        // w/o interpolation
-        //    g = calc_LAL(myPyramid, x, y, s);
-        //     gg = calc_LAL(myPyramid, x, y, 2*s);
+    int progress = 0;
+    ph.setValue(0);
 
-        if (fabs((g - gg) / g) >= LOCAL_CONTRAST) return g;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        const size_t tileSize = (size_t)LAL_TILE_ROWS * ncols;
+        std::vector<lhdrengine::AlignedVector<float>> maps(2 * SMAX);
+        std::vector<bool> upsampled(2 * SMAX);
+        lhdrengine::AlignedVector<float> lal(tileSize);
+        std::vector<unsigned char> done(tileSize);
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int t = 0; t < numTiles; t++) {
+            const int yBegin = t * LAL_TILE_ROWS;
+            const int yEnd = std::min(yBegin + LAL_TILE_ROWS, nrows);
+            const size_t n = (size_t)(yEnd - yBegin) * ncols;
+
+            auto level = [&](int k) -> const float * {
+                if (!upsampled[k]) {
+                    maps[k].resize(tileSize);
+                    upsampleRows(pyramid.p[k], samplings[k], yBegin, yEnd,
+                                 maps[k].data());
+                    upsampled[k] = true;
+                }
+                return maps[k].data();
+            };
+
+            std::fill(upsampled.begin(), upsampled.end(), false);
+            std::fill(done.begin(), done.end(), 0);
+            size_t remaining = n;
+
+            for (int s = 1; s <= SMAX && remaining > 0; s++) {
+                const float *g = level(s - 1);
+                const float *gg = level(2 * s - 1);
+
+                for (size_t i = 0; i < n; i++) {
+                    const unsigned char active = !done[i];
+                    const unsigned char found =
+                        active & (fabsf((g[i] - gg[i]) / g[i]) >= LOCAL_CONTRAST);
+                    lal[i] = active ? g[i] : lal[i];
+                    done[i] |= found;
+                    remaining -= found;
+                }
+            }
+
+            for (int y = yBegin; y < yEnd; y++) {
+                const float *src = lal.data() + (size_t)(y - yBegin) * ncols;
+                for (int x = 0; x < ncols; x++) {
+                    la(x, y) = src[x] == 0 ? EPSILON : src[x];
+                }
+            }
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                progress++;
+                ph.setValue(std::min(progress * 66 / numTiles, 66));
+            }
+        }
     }
-    return g;
+}
 }
 
 ////////////////////////////////////////////////////////
@@ -215,30 +286,7 @@ int tmo_ashikhmin02(pfs::Array2Df *Y, pfs::Array2Df *L, float maxLum,
 
     // LAL calculation
     pfs::Array2Df la(ncols, nrows);
-    int progress = 0;
-    int progressSteps = std::max(nrows / 80, 1u);
-    int phVal = 0;
-    ph.setValue(phVal);
-
-#ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,16)
-#endif
-    for (unsigned int y = 0; y < nrows; y++) {
-        for (unsigned int x = 0; x < ncols; x++) {
-            float lal = LAL(myPyramid, x, y, lc_value);
-            la(x, y) = lal == 0 ? EPSILON : lal;
-        }
-#ifdef _OPENMP
-        #pragma omp critical
-#endif
-        {
-            progress += 1;
-            if((progress % progressSteps) == 0) {
-                phVal ++;
-                ph.setValue(std::min(phVal,80));
-            }
-        }
-    }
+    computeLAL(*myPyramid, la, lc_value, ph);
 
     delete myPyramid;
 
@@ -247,7 +295,9 @@ int tmo_ashikhmin02(pfs::Array2Df *Y, pfs::Array2Df *L, float maxLum,
     // TM function
     float div = C(maxLum) - C(minLum);
     div = div != 0 ? div : EPSILON;
-    progressSteps = std::max(nrows / 20, 1u);
+    int progress = 0;
+    int phVal = 66;
+    int progressSteps = std::max(nrows / 34, 1u);
     // final computation for each pixel
 #ifdef _OPENMP
     #pragma omp parallel for schedule(dynamic,16)
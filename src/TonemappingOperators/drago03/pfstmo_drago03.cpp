@@ -29,6 +29,7 @@
  * $Id: pfstmo_drago03.cpp,v 1.3 2008/09/04 12:46:48 julians37 Exp $
  */
 
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <iostream>
@@ -36,6 +37,7 @@
 #include "Libpfs/exception.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/progress.h"
+#include "Libpfs/utils/statistics.h"
 #include "tmo_drago03.h"
 #include "../../opthelper.h"
 
@@ -50,6 +52,10 @@ void pfstmo_drago03(pfs::Frame &frame, float opt_biasValue, pfs::Progress &ph) {
 
     ph.setValue(0);
 
+    // taken before the channels, that drops the statistics cached by the frame
+    std::shared_ptr<const pfs::utils::ChannelStatistics> stats =
+        static_cast<const pfs::Frame &>(frame).getStatistics("Y");
+
     pfs::Channel *X, *Y, *Z;
     frame.getXYZChannels(X, Y, Z);
 
@@ -66,9 +72,8 @@ void pfstmo_drago03(pfs::Frame &frame, float opt_biasValue, pfs::Progress &ph) {
     int w = Yr.getCols();
     int h = Yr.getRows();
 
-    float maxLum;
-    float avLum;
-    calculateLuminance(w, h, Yr.data(), avLum, maxLum);
+    const float maxLum = std::max(stats->getMax(), 0.f);
+    const float avLum = stats->getLogAverage();
 
     pfs::Array2Df L(w, h);
     try {
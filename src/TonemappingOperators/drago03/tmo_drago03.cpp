@@ -51,61 +51,6 @@ inline float biasFunc(float b, float x) {
 const float LOG05 = -0.693147f;  // log(0.5)
 }
 
-void calculateLuminance(unsigned int width, unsigned int height, const float *Y,
-                        float &avLum, float &maxLum) {
-    avLum = 0.0f;
-    maxLum = 0.0f;
-
-    int size = width * height;
-
-#ifdef __SSE2__
-    vfloat maxLumv = ZEROV;
-    vfloat avLumv = ZEROV;
-#endif // __SSE2__
-
-#pragma omp parallel
-{
-    float eps = 1e-4f;
-    float avLumThr = 0.f;
-    float maxLumThr = 0.f;
-#ifdef __SSE2__
-    vfloat epsv = F2V(eps);
-    vfloat maxLumThrv = ZEROV;
-    vfloat avLumThrv = ZEROV;
-#endif // __SSE2__
-    #pragma omp for nowait
-    for(size_t i = 0; i < height; ++i) {
-        size_t j = 0;
-#ifdef __SSE2__
-        for (; j < width - 3; j+=4) {
-            vfloat Ywv = LVFU(Y[i * width + j]);
-            avLumThrv += xlogf(Ywv + epsv);
-            maxLumThrv = vmaxf(Ywv, maxLumThrv);
-        }
-#endif
-        for (; j < width; j++) {
-            float Yw = Y[i * width + j];
-            avLumThr += xlogf(Yw + eps);
-            maxLumThr = std::max(Yw, maxLumThr);
-        }
-    }
-#pragma omp critical
-{
-#ifdef __SSE2__
-    avLumv += avLumThrv;
-    maxLumv = vmaxf(maxLumv, maxLumThrv);
-#endif
-    avLum += avLumThr;
-    maxLum = std::max(maxLum, maxLumThr);
-}
-}
-#ifdef __SSE2__
-    avLum += vhadd(avLumv);
-    maxLum = std::max(maxLum, vhmax(maxLumv));
-#endif
-    avLum = exp(avLum / size);
-}
-
 void tmo_drago03(const pfs::Array2Df &Y, pfs::Array2Df &L, float maxLum,
                  float avLum, float bias, pfs::Progress &ph) {
     assert(Y.getRows() == L.getRows());
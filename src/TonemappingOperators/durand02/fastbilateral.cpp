@@ -27,140 +27,267 @@
  * $Id: fastbilateral.cpp,v 1.5 2008/09/09 18:10:49 rafm Exp $
  */
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include <Libpfs/array2d.h>
 #include <Libpfs/progress.h>
 #include "fastbilateral.h"
 
-#ifdef BRANCH_PREDICTION
-#define likely(x) __builtin_expect((x), 1)
-#define unlikely(x) __builtin_expect((x), 0)
-#else
-#define likely(x) (x)
-#define unlikely(x) (x)
-#endif
-#include "../../sleef.c"
-#include "../../opthelper.h"
-#include "../../lhdr_gauss.h"
-
 using namespace std;
 
-// TODO: use spatial convolution rather than FFT, should be much
-// faster except for a very large kernels
-// DONE
-
-// According to the original paper, downsampling can be used to speed
-// up computation. However, downsampling cannot be mathematically
-// justified and introduces large errors (mostly excessive bluring) in
-// the result of the bilateral filter. Therefore, in this
-// implementation, downsampling is disabled.
-
-#if 0
-/**
- * @brief upsampling and downsampling
- *
- * original code from pfssize
- */
-void upsampleArray( const pfs::Array2D *in, pfs::Array2D *out )
-{
-  float dx = (float)in->getCols() / (float)out->getCols();
-  float dy = (float)in->getRows() / (float)out->getRows();
-
-  float pad;
-
-  float filterSamplingX = max( modff( dx, &pad ), 0.01f );
-  float filterSamplingY = max( modff( dy, &pad ), 0.01f );
-
-  const int outRows = out->getRows();
-  const int outCols = out->getCols();
-
-  const float inRows = in->getRows();
-  const float inCols = in->getCols();
-
-  const float filterSize = 1;
-
-  float sx, sy;
-  int x, y;
-  for( y = 0, sy = -0.5 + dy/2; y < outRows; y++, sy += dy )
-    for( x = 0, sx = -0.5 + dx/2; x < outCols; x++, sx += dx ) {
-
-      float pixVal = 0;
-      float weight = 0;
-
-      for( float ix = max( 0, ceilf( sx-filterSize ) ); ix <= min( floorf(sx+filterSize), inCols-1 ); ix++ )
-        for( float iy = max( 0, ceilf( sy-filterSize ) ); iy <= min( floorf( sy+filterSize), inRows-1 ); iy++ ) {
-          float fx = fabs( sx - ix );
-          float fy = fabs( sy - iy );
-
-          const float fval = (1.0f-fx)*(1.0f-fy);
+// Bilateral grid (Paris and Durand, "A Fast Approximation of the Bilateral
+// Filter using a Signal Processing Approach", 2006).
+//
+// The filter is a Gaussian blur in the 3D space (x, y, intensity) of the
+// homogeneous values (I, 1), sliced back at (x, y, I(x, y)). The space is
+// sampled with one cell per standard deviation of each kernel, so the cost
+// is linear in the number of pixels and does not depend on sigma_s.
+//
+// Samples are splatted and sliced with trilinear weights: each of the two
+// operations adds a variance of 1/6 cell^2 per axis, so the grid kernel only
+// has to provide the remaining 2/3 to obtain the requested sigma.
+//
+// The grid is processed in tiles of TILE_SIZE x TILE_SIZE cells (plus an
+// apron for the kernel support), so that the working set of each thread
+// stays in cache and the memory use does not grow with the frame.
+
+namespace {
+
+const int TILE_SIZE = 32;
+const float GRID_VARIANCE = 2.f / 3.f;
+
+//! \brief Gaussian kernel of variance \c GRID_VARIANCE, in cells
+vector<float> gridKernel() {
+    const int radius = static_cast<int>(ceil(2.f * sqrt(GRID_VARIANCE)));
+    vector<float> kernel(2 * radius + 1);
+    float sum = 0.f;
+    for (int i = -radius; i <= radius; ++i) {
+        kernel[i + radius] = exp(-0.5f * i * i / GRID_VARIANCE);
+        sum += kernel[i + radius];
+    }
+    for (size_t i = 0; i < kernel.size(); ++i) {
+        kernel[i] /= sum;
+    }
+    return kernel;
+}
 
-          pixVal += (*in)( (int)ix, (int)iy ) * fval;
-          weight += fval;
+//! \brief convolve \c count groups of \c length samples along one axis of the
+//! grid. Each sample is a block of \c block contiguous floats, groups are
+//! \c groupStride floats apart. Samples outside the group are zero.
+void blurAxis(float *data, int count, size_t groupStride, int length,
+              size_t block, const vector<float> &kernel,
+              vector<float> &buffer) {
+    const int taps = static_cast<int>(kernel.size());
+    const int radius = taps / 2;
+
+    for (int g = 0; g < count; ++g) {
+        float *group = data + g * groupStride;
+        buffer.assign(block * (length + 2 * radius), 0.f);
+        copy(group, group + block * length, buffer.begin() + block * radius);
+
+        for (int i = 0; i < length; ++i) {
+            float *out = group + i * block;
+            const float *in = buffer.data() + i * block;
+            fill(out, out + block, 0.f);
+            for (int k = 0; k < taps; ++k) {
+                const float c = kernel[k];
+                const float *src = in + k * block;
+                for (size_t b = 0; b < block; ++b) {
+                    out[b] += c * src[b];
+                }
+            }
         }
-
-      if( weight == 0 ) {
-        fprintf( stderr, "%g %g %g %g\n", sx, sy, dx, dy );
-      }
-//      assert( weight != 0 );
-      (*out)(x,y) = pixVal / weight;
-
     }
 }
 
-void downsampleArray( const pfs::Array2D *in, pfs::Array2D *out )
-{
-  const float inRows = in->getRows();
-  const float inCols = in->getCols();
-
-  const int outRows = out->getRows();
-  const int outCols = out->getCols();
+class BilateralGrid {
+   public:
+    BilateralGrid(const pfs::Array2Df &I, float sigma_s, float sigma_r,
+                  float minI, float maxI)
+        : m_I(I),
+          m_width(I.getCols()),
+          m_height(I.getRows()),
+          m_kernel(gridKernel()),
+          m_radius(static_cast<int>(m_kernel.size()) / 2),
+          m_cellSize(max(sigma_s, 1.f)),
+          m_rangeCell(sigma_r),
+          m_minI(minI),
+          // cells beyond the range of the input are never sliced: their
+          // content can be dropped and the range axis needs no apron
+          m_depth(static_cast<int>((maxI - minI) / sigma_r) + 2),
+          m_cellsX(static_cast<int>((m_width - 1) / m_cellSize) + 1),
+          m_cellsY(static_cast<int>((m_height - 1) / m_cellSize) + 1) {}
+
+    int tilesX() const { return (m_cellsX + TILE_SIZE - 1) / TILE_SIZE; }
+    int tilesY() const { return (m_cellsY + TILE_SIZE - 1) / TILE_SIZE; }
+
+    //! \brief filter the pixels whose lower grid cell is in tile (tx, ty)
+    void filterTile(int tx, int ty, pfs::Array2Df &J, vector<float> &grid,
+                    vector<float> &buffer) const;
+
+   private:
+    //! \brief grid coordinate of intensity \c v
+    float rangeCoordinate(float v) const {
+        return (v - m_minI) / m_rangeCell;
+    }
 
-  const float dx = (float)in->getCols() / (float)out->getCols();
-  const float dy = (float)in->getRows() / (float)out->getRows();
+    //! \brief lower cell (relative to \c origin, at most \c maxCell) and
+    //! interpolation weight of the pixels in [from, to)
+    void cellCoordinates(int from, int to, int origin, int maxCell,
+                         vector<int> &cell, vector<float> &frac) const {
+        cell.resize(to - from);
+        frac.resize(to - from);
+        for (int p = from; p < to; ++p) {
+            const float g = p / m_cellSize - origin;
+            cell[p - from] = min(static_cast<int>(g), maxCell);
+            frac[p - from] = g - cell[p - from];
+        }
+    }
 
-  const float filterSize = 0.5;
+    //! \brief add (v, 1) to the cells (x, z), (x, z + 1), (x + 1, z) and
+    //! (x + 1, z + 1) of a row of the grid
+    static void splat(float *cell, size_t column, float v, float w0,
+                      float w1, float fz) {
+        const float w00 = w0 * (1.f - fz);
+        const float w01 = w0 * fz;
+        const float w10 = w1 * (1.f - fz);
+        const float w11 = w1 * fz;
+        cell[0] += w00 * v;
+        cell[1] += w00;
+        cell[2] += w01 * v;
+        cell[3] += w01;
+        cell[column] += w10 * v;
+        cell[column + 1] += w10;
+        cell[column + 2] += w11 * v;
+        cell[column + 3] += w11;
+    }
 
-  float sx, sy;
-  int x, y;
+    //! \brief interpolate the same cells of \c splat
+    static void slice(const float *cell, size_t column, float w0, float w1,
+                      float fz, float &v, float &w) {
+        const float w00 = w0 * (1.f - fz);
+        const float w01 = w0 * fz;
+        const float w10 = w1 * (1.f - fz);
+        const float w11 = w1 * fz;
+        v += w00 * cell[0] + w01 * cell[2] + w10 * cell[column] +
+             w11 * cell[column + 2];
+        w += w00 * cell[1] + w01 * cell[3] + w10 * cell[column + 1] +
+             w11 * cell[column + 3];
+    }
 
-  for( y = 0, sy = dy/2-0.5; y < outRows; y++, sy += dy )
-    for( x = 0, sx = dx/2-0.5; x < outCols; x++, sx += dx ) {
+    const pfs::Array2Df &m_I;
+    const int m_width;
+    const int m_height;
+    const vector<float> m_kernel;
+    const int m_radius;
+    const float m_cellSize;
+    const float m_rangeCell;
+    const float m_minI;
+    const int m_depth;
+    const int m_cellsX;
+    const int m_cellsY;
+};
+
+void BilateralGrid::filterTile(int tx, int ty, pfs::Array2Df &J,
+                               vector<float> &grid,
+                               vector<float> &buffer) const {
+    // interpolation reads cells [tile0, tile1]: the kernel needs m_radius
+    // more on each side, and these need the pixels of one more cell
+    const int tileX0 = tx * TILE_SIZE;
+    const int tileY0 = ty * TILE_SIZE;
+    const int tileX1 = min(tileX0 + TILE_SIZE, m_cellsX);
+    const int tileY1 = min(tileY0 + TILE_SIZE, m_cellsY);
+    const int apron = m_radius + 1;
+    const int x0 = tileX0 - apron;
+    const int y0 = tileY0 - apron;
+    const int gw = tileX1 - tileX0 + 1 + 2 * apron;
+    const int gh = tileY1 - tileY0 + 1 + 2 * apron;
+    const size_t column = 2 * size_t(m_depth);
+    const size_t row = column * gw;
+
+    grid.assign(row * gh, 0.f);
+
+    // splat the pixels with lower cell in [x0, x0 + gw - 2]
+    const int px0 = max(0, static_cast<int>(ceil(x0 * m_cellSize)));
+    const int px1 =
+        min(m_width, static_cast<int>(ceil((x0 + gw - 1) * m_cellSize)));
+    const int py0 = max(0, static_cast<int>(ceil(y0 * m_cellSize)));
+    const int py1 =
+        min(m_height, static_cast<int>(ceil((y0 + gh - 1) * m_cellSize)));
+
+    vector<int> cellX;
+    vector<float> fracX;
+    cellCoordinates(px0, px1, x0, gw - 2, cellX, fracX);
+
+    for (int y = py0; y < py1; ++y) {
+        float gy = y / m_cellSize - y0;
+        const int cy = min(static_cast<int>(gy), gh - 2);
+        const float fy = gy - cy;
+        float *grid0 = grid.data() + cy * row;
+        float *grid1 = grid0 + row;
+
+        for (int x = px0; x < px1; ++x) {
+            const int cx = cellX[x - px0];
+            const float fx = fracX[x - px0];
+            const float v = m_I(x, y);
+            const float gz = rangeCoordinate(v);
+            const int cz = static_cast<int>(gz);
+            const float fz = gz - cz;
+
+            const size_t offset = cx * column + 2 * cz;
+            splat(grid0 + offset, column, v, (1.f - fy) * (1.f - fx),
+                  (1.f - fy) * fx, fz);
+            splat(grid1 + offset, column, v, fy * (1.f - fx), fy * fx, fz);
+        }
+    }
 
-      float pixVal = 0;
-      float w = 0;
-      for( float ix = max( 0, ceilf( sx-dx*filterSize ) ); ix <= min( floorf( sx+dx*filterSize ), inCols-1 ); ix++ )
-        for( float iy = max( 0, ceilf( sy-dx*filterSize ) ); iy <= min( floorf( sy+dx*filterSize), inRows-1 ); iy++ ) {
-          pixVal += (*in)( (int)ix, (int)iy );
-          w += 1;
+    // blur along range, x and y
+    blurAxis(grid.data(), gw * gh, column, m_depth, 2, m_kernel, buffer);
+    blurAxis(grid.data(), gh, row, gw, column, m_kernel, buffer);
+    blurAxis(grid.data(), 1, 0, gh, row, m_kernel, buffer);
+
+    // slice the pixels with lower cell in [tile0, tile1)
+    const int sx0 = static_cast<int>(ceil(tileX0 * m_cellSize));
+    const int sx1 = min(m_width, static_cast<int>(ceil(tileX1 * m_cellSize)));
+    const int sy0 = static_cast<int>(ceil(tileY0 * m_cellSize));
+    const int sy1 =
+        min(m_height, static_cast<int>(ceil(tileY1 * m_cellSize)));
+
+    cellCoordinates(sx0, sx1, x0, gw - 2, cellX, fracX);
+
+    for (int y = sy0; y < sy1; ++y) {
+        float gy = y / m_cellSize - y0;
+        const int cy = min(static_cast<int>(gy), gh - 2);
+        const float fy = gy - cy;
+        const float *grid0 = grid.data() + cy * row;
+        const float *grid1 = grid0 + row;
+
+        for (int x = sx0; x < sx1; ++x) {
+            const int cx = cellX[x - sx0];
+            const float fx = fracX[x - sx0];
+            const float gz = rangeCoordinate(m_I(x, y));
+            const int cz = static_cast<int>(gz);
+            const float fz = gz - cz;
+
+            const size_t offset = cx * column + 2 * cz;
+            float v = 0.f;
+            float w = 0.f;
+            slice(grid0 + offset, column, (1.f - fy) * (1.f - fx),
+                  (1.f - fy) * fx, fz, v, w);
+            slice(grid1 + offset, column, fy * (1.f - fx), fy * fx, fz, v, w);
+            J(x, y) = w > 0.f ? v / w : m_I(x, y);
         }
-      (*out)(x,y) = pixVal/w;
     }
 }
 
-#endif
-
-/*
-Pseudocode from the paper:
-
-PiecewiseBilateral (Image I, spatial kernel fs , intensity influence gr )
-  J=0 // set the output to zero
-  for j=0..NB SEGMENTS
-    ij= minI+j.*(max(I)-min(I))/NB SEGMENTS
-    Gj=gr (I - ij ) // evaluate gr at each pixel
-    Kj=Gj x fs // normalization factor
-    Hj=Gj .* I // compute H for each pixel
-    Hj=Hj x fs
-    Jj=Hj ./ Kj // normalize
-    J=J+Jj .*  InterpolationWeight(I, ij )
-*/
+}  // anonymous
 
 void fastBilateralFilter(const pfs::Array2Df &I, pfs::Array2Df &J,
                          float sigma_s, float sigma_r, int /*downsample*/,
                          pfs::Progress &ph) {
-    int w = I.getCols();
-    int h = I.getRows();
-    int size = w * h;
+    const int size = I.getCols() * I.getRows();
 
     // find range of values in the input array
     float maxI = I(0);
@@ -172,117 +299,35 @@ void fastBilateralFilter(const pfs::Array2Df &I, pfs::Array2Df &J,
         float v = I(i);
         maxI = std::max(maxI, v);
         minI = std::min(minI, v);
-        J(i) = 0.0f;  // zero output
     }
 
-    pfs::Array2Df jJ(w, h);
-    pfs::Array2Df jG(w, h);
-    pfs::Array2Df jH(w, h);
-
-    const int NB_SEGMENTS = (int)ceil((maxI - minI) / sigma_r);
-    float stepI = (maxI - minI) / NB_SEGMENTS;
-
-    // piecewise bilateral
-    for (int j = 0; j < NB_SEGMENTS; j++) {
-        ph.setValue(j * 100 / NB_SEGMENTS);
-        if (ph.canceled()) break;
-
-        float jI = minI + j * stepI;  // current intensity value
+    // the range kernel is exp(-d^2 / sigma_r^2): its standard deviation is
+    // sigma_r / sqrt(2)
+    const BilateralGrid grid(I, sigma_s, sigma_r * float(M_SQRT1_2), minI,
+                             maxI);
+    const int tilesX = grid.tilesX();
+    const int numTiles = tilesX * grid.tilesY();
+    int done = 0;
 
 #ifdef _OPENMP
 #pragma omp parallel
 #endif
-{
-#ifdef __SSE2__
-        vfloat sqrsigma_rv = F2V(sigma_r * sigma_r);
-        vfloat jIv = F2V(jI);
-#endif
-#ifdef _OPENMP
-        #pragma omp for
-#endif
-        for (int i = 0; i < h; i++) {
-            int j = 0;
-#ifdef __SSE2__
-            for (; j < w-3; j+=4) {
-                vfloat Iv = LVFU(I(j, i));
-                vfloat dIv = Iv - jIv;
-                vfloat jGv = xexpf(-(dIv * dIv) / sqrsigma_rv);
-                STVFU(jG(j, i), jGv);
-                STVFU(jH(j, i), jGv * Iv);
-            }
-#endif
-            for (; j < w; j++) {
-                float dI = I(j, i) - jI;
-                jG(j, i) = xexpf(-(dI * dI) / (sigma_r * sigma_r));
-                jH(j, i) = jG(j, i) * I(j, i);
-            }
-        }
-}
-        float* gaussRows[h];
-
-        gaussRows[0] = jG.data();
-        for(int i = 1; i < h; ++i)
-            gaussRows[i] = gaussRows[i - 1] + w;
-#ifdef _OPENMP
-        #pragma omp parallel
-#endif
-        gaussianBlur(gaussRows, gaussRows, w, h, sigma_s);
+    {
+        vector<float> cells;
+        vector<float> buffer;
 
-        gaussRows[0] = jH.data();
-        for(int i = 1; i < h; ++i)
-            gaussRows[i] = gaussRows[i - 1] + w;
 #ifdef _OPENMP
-        #pragma omp parallel
+#pragma omp for schedule(dynamic)
 #endif
-        gaussianBlur(gaussRows, gaussRows, w, h, sigma_s);
+        for (int t = 0; t < numTiles; ++t) {
+            if (ph.canceled()) continue;
 
-#ifdef _OPENMP
-        #pragma omp parallel for
-#endif
-        for (int i = 0; i < h; i++) {
-            for (int j = 0; j < w; j++) {
-                float temp = jG(j, i);
-                jJ(j, i) = temp != 0.f ? jH(j, i) / temp : 0.f;
-            }
-        }
+            grid.filterTile(t % tilesX, t / tilesX, J, cells, buffer);
 
-        if (j == 0) {
-            // if the first segment - to account for the range boundary
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp critical
 #endif
-            for (int i = 0; i < size; i++) {
-                if (likely(I(i) > jI + stepI)) continue;  // wi = 0;
-                if (likely(I(i) > jI)) {
-                    float wi = (stepI - (I(i) - jI)) / stepI;
-                    J(i) += jJ(i)*wi;
-                } else
-                    J(i) += jJ(i);
-            }
-        } else if (j == NB_SEGMENTS - 1) {
-            // if the last segment - to account for the range boundary
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-            for (int i = 0; i < size; i++) {
-                if (I(i) < jI - stepI) continue;  // wi = 0;
-                if (likely(I(i) < jI)) {
-                    float wi = (stepI - (jI - I(i))) / stepI;
-                    J(i) += jJ(i)*wi;
-                } else
-                    J(i) += jJ(i);
-            }
-        } else {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-            for (int i = 0; i < size; i++) {
-                float wi = stepI - fabs(I(i) - jI);// / stepI;
-                if (unlikely(wi > 0.0f)) J(i) += jJ(i)*(wi/stepI);
-            }
+            ph.setValue(++done * 100 / numTiles);
         }
     }
-    //  delete Iz;
-    //  if( downsample != 1 )
-    //    delete JJ;
 }
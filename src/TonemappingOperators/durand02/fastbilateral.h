@@ -39,12 +39,15 @@ class Progress;
 //!
 //! @brief Fast bilateral filtering
 //!
-//! Pieceweise linear algorithm (fast).
+//! Bilateral grid algorithm, processed in tiles: the cost is linear in the
+//! number of pixels and does not depend on \c sigma_s.
 //!
 //! \param I [in] input array
 //! \param J [out] filtered array
 //! \param sigma_s sigma value for spatial kernel
 //! \param sigma_r sigma value for range kernel
+//! \param downsample unused, the grid already works at the scale of the
+//! kernels
 //!
 void fastBilateralFilter(const pfs::Array2Df &I, pfs::Array2Df &J,
                          float sigma_s, float sigma_r, int downsample,
@@ -41,6 +41,7 @@
 #include "Libpfs/array2d.h"
 #include "Libpfs/rt_algo.h"
 #include "Libpfs/progress.h"
+#include "Libpfs/tm/TonemapStageCache.h"
 #include "TonemappingOperators/pfstmo.h"
 
 #include "fastbilateral.h"
@@ -110,7 +111,6 @@ void tmo_durand02(pfs::Array2Df &R, pfs::Array2Df &G, pfs::Array2Df &B,
     size_t size = w * h;
 
     pfs::Array2Df I(w, h);       // intensities
-    pfs::Array2Df BASE(w, h);    // base layer
 
     float min_pos = 1e10f;  // minimum positive value (to avoid log(0))
 #ifdef __SSE2__
@@ -202,7 +202,22 @@ void tmo_durand02(pfs::Array2Df &R, pfs::Array2Df &G, pfs::Array2Df &B,
     }
 }
 
-    fastBilateralFilter(I, BASE, sigma_s, sigma_r, downsample, ph);
+    // the base layer depends only on the intensities and on the bilateral
+    // parameters: changing baseContrast or color_correction reruns only the
+    // recombination below
+    const TonemapStageKey baseKey =
+        TonemapStageKey("durand02.base", TonemapStageCache::fingerprint(I))
+        << sigma_s << sigma_r << static_cast<float>(downsample);
+    TonemapStageCache::Entry base =
+        TonemapStageCache::instance().getOrCompute(baseKey, [&]() {
+            std::shared_ptr<pfs::Array2Df> out =
+                std::make_shared<pfs::Array2Df>(w, h);
+            fastBilateralFilter(I, *out, sigma_s, sigma_r, downsample, ph);
+            return ph.canceled() ? TonemapStageCache::Entry()
+                                 : TonemapStageCache::Entry(out);
+        });
+    if (!base) return;
+    const pfs::Array2Df &BASE = *base;
 
     //!! FIX: find minimum and maximum luminance, but skip 1% of outliers
     float maxB;
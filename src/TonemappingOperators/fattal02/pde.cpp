@@ -34,591 +34,510 @@
 
 #include "pde.h"
 
-#include <math.h>
-#include <stdio.h>
-#include <stdlib.h>
+#include <algorithm>
 #include <cassert>
-#include <iostream>
+#include <cmath>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "Libpfs/array2d.h"
-#include "Libpfs/manip/copy.h"
 #include "Libpfs/progress.h"
-#include "Libpfs/utils/numeric.h"
-#include "Libpfs/utils/sse.h"
-
-#include "TonemappingOperators/pfstmo.h"
-
-using namespace std;
+#include "arch/allocator.h"
+#include "opthelper.h"
 
 //////////////////////////////////////////////////////////////////////
 
 // tune the multi-level solver
-#define MODYF 0 /* 1 or 0 (1 is better) */
-#define MINS 16 /* minimum size 4 6 or 100 */
-//#define MODYF_SQRT -1.0f /* -1 or 0 */
-#define SMOOTH_IT 1   // orig: 1
-#define BCG_STEPS 20  // orig: 20
-#define BCG_TOL 1e-3  // orig: 1e-3
-#define V_CYCLE 2     // orig: 2
-// post improvement of the solution using additional cg-iterations
-#define BCG_POST_IMPROVE false
-#define BCG_POST_STEPS 1000  // very slow if > 100, only use on small image
-#define BCG_POST_TOL 1e-7
-
-// precision
-#define EPS 1.0e-12
-
-#define OMP_THRESHOLD 1000000
-
-static void linbcg(unsigned long n, const float b[], float x[], float tol,
-                   int itmax, int *iter, float *err, int rows, int cols);
-
-inline float max(float a, float b) { return a > b ? a : b; }
+#define MINS 16          /* minimum size 4 6 or 100 */
+#define PRE_SMOOTH 2     // red-black sweeps before the coarse correction
+#define POST_SMOOTH 2    // red-black sweeps after the coarse correction
+#define V_CYCLE 2        // orig: 2
+#define COARSE_SWEEPS 100  // sweeps solving the coarsest grid
+#define MAX_CYCLES 20    // V-cycles on the finest grid
+#define FMG_TOL 1e-5f    // residual relative to the right hand side
 
-inline float min(float a, float b) { return a < b ? a : b; }
-
-//!! TODO: for debugging purposes
-// #define PFSEOL "\x0a"
-// static void dumpPFS( const char *fileName, const pfs::Array2D *data, const
-// char *channelName )
-// {
-//   FILE *fh = fopen( fileName, "wb" );
-//   assert( fh != nullptr );
-
-//   int width = data->getCols();
-//   int height = data->getRows();
-
-//   fprintf( fh, "PFS1" PFSEOL "%d %d" PFSEOL "1" PFSEOL "0" PFSEOL
-//     "%s" PFSEOL "0" PFSEOL "ENDH", width, height, channelName );
-
-//   for( int y = 0; y < height; y++ )
-//     for( int x = 0; x < width; x++ ) {
-//       fwrite( &((*data)(x,y)), sizeof( float ), 1, fh );
-//     }
-
-//   fclose( fh );
-// }
+// pixels of a level below which it is processed by one thread
+#define OMP_THRESHOLD 65536
 
 //////////////////////////////////////////////////////////////////////
 // Full Multigrid Algorithm for solving partial differential equations
+//
+// Every level solves L u = f with the 5 point laplacian, the missing
+// neighbours on the borders are left out of the stencil (Neumann boundary).
+// The stencil is not scaled by the grid spacing, which is folded into the
+// right hand side when it is restricted: f of a level is h^2 times the one
+// of the finest level, with h the ratio between their sizes.
 //////////////////////////////////////////////////////////////////////
 
-static void restrict(const pfs::Array2Df *in, pfs::Array2Df *out) {
-    const float inRows = in->getRows();
-    const float inCols = in->getCols();
-
-    const int outRows = out->getRows();
-    const int outCols = out->getCols();
-
-    const float dx = (float)in->getCols() / (float)out->getCols();
-    const float dy = (float)in->getRows() / (float)out->getRows();
+namespace {
 
-    const float filterSize = 0.5;
+typedef lhdrengine::AlignedVector<float> Buffer;
 
-    float sx, sy;
-    int x, y;
+inline int threadNum() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
 
-    for (y = 0, sy = dy / 2 - 0.5; y < outRows; y++, sy += dy) {
-        for (x = 0, sx = dx / 2 - 0.5; x < outCols; x++, sx += dx) {
-            float pixVal = 0;
-            float w = 0;
-            for (float ix = max(0, ceilf(sx - dx * filterSize));
-                 ix <= min(floorf(sx + dx * filterSize), inCols - 1); ix++)
-                for (float iy = max(0, ceilf(sy - dx * filterSize));
-                     iy <= min(floorf(sy + dx * filterSize), inRows - 1);
-                     iy++) {
-                    pixVal += (*in)((int)ix, (int)iy);
-                    w += 1;
-                }
-            (*out)(x, y) = pixVal / w;
-        }
+// sum of the neighbours of (x, y) inside the grid, and their number
+inline float neighbours(const float *u, int cols, int rows, int x, int y,
+                        int &count) {
+    const int i = y * cols + x;
+    float sum = 0.f;
+    count = 0;
+    if (x > 0) {
+        sum += u[i - 1];
+        ++count;
+    }
+    if (x + 1 < cols) {
+        sum += u[i + 1];
+        ++count;
     }
+    if (y > 0) {
+        sum += u[i - cols];
+        ++count;
+    }
+    if (y + 1 < rows) {
+        sum += u[i + cols];
+        ++count;
+    }
+    return sum;
 }
 
-// from_level>to_level, from_size>to_size
-// void restrict( pfs::Array2D *F, pfs::Array2D *T )
-// {
-// //   DEBUG_STR << "restrict" << endl;
-
-//   int sxt = T->getCols();
-//   int syt = T->getRows();
-//   int sxf = F->getCols();
-//   int syf = F->getRows();
-//   int x,y;
-
-//   float w[] = {.25, .5, .25};
-//   for( int x=0 ; x<sxt ; x++ )
-//     for( int y=0 ; y<syt ; y++ )
-//     {
-//       float sum=0.0; float norm=0.0f;
-//       for( int m=-1 ; m<=1 ; m++ )
-//     for( int n=-1 ; n<=1 ; n++ )
-//         {
-//           int xf = 2*x+m;
-//           int yf = 2*y+n;
-//           if( xf>=0 && yf>=0 && xf<sxf && yf<syf )
-//           {
-//             sum += w[1+m]*w[1+n] * (*F)(xf,yf);
-//             norm += w[1+m]*w[1+n];
-//           }
-//         }
-//       assert(norm!=0.0f);
-//       (*T)(x,y)=sum/norm;
-//     }
-// }
-
-static void prolongate(const pfs::Array2Df *in, pfs::Array2Df *out) {
-    float dx = (float)in->getCols() / (float)out->getCols();
-    float dy = (float)in->getRows() / (float)out->getRows();
-
-    const int outRows = out->getRows();
-    const int outCols = out->getCols();
-
-    const float inRows = in->getRows();
-    const float inCols = in->getCols();
-
-    const float filterSize = 1;
-
-    float sx, sy;
-    int x, y;
-    for (y = 0, sy = -dy / 2; y < outRows; y++, sy += dy)
-        for (x = 0, sx = -dx / 2; x < outCols; x++, sx += dx) {
-            float pixVal = 0;
-            float weight = 0;
-
-            for (float ix = max(0, ceilf(sx - filterSize));
-                 ix <= min(floorf(sx + filterSize), inCols - 1); ix++)
-                for (float iy = max(0, ceilf(sy - filterSize));
-                     iy <= min(floorf(sy + filterSize), inRows - 1); iy++) {
-                    float fx = fabs(sx - ix);
-                    float fy = fabs(sy - iy);
-
-                    const float fval = (1 - fx) * (1 - fy);
-
-                    pixVal += (*in)((int)ix, (int)iy) * fval;
-                    weight += fval;
-                }
-
-            assert(weight != 0);
-            (*out)(x, y) = pixVal / weight;
-        }
+inline void relaxPixel(float *u, const float *f, int cols, int rows, int x,
+                       int y) {
+    int count;
+    const float sum = neighbours(u, cols, rows, x, y, count);
+    if (count > 0) {
+        u[y * cols + x] = (sum - f[y * cols + x]) / count;
+    }
 }
 
-static void exact_sollution(pfs::Array2Df * /*F*/, pfs::Array2Df *U) {
-    //   DEBUG_STR << "exact sollution" << endl;
-
-    /*  int sx = F->getCols();
-      int sy = F->getRows();
-      int x,y;
-
-      float h = 1.0/sqrt(sx*sy*1.0f);
-      float h2 = h*h;
-    */
-    U->reset();
-
-    /* also works well?? */
-    return;
-
-    //   if( sx==3 && sy==3 )
-    //   {
-    //     (*U)(1,1) = -h2* (*F)(1,1) / 4.0f;
-
-    //     // boundary points
-    //     for( x=0 ; x<sx ; x++ )
-    //       (*U)(x,0) = (*U)(x,sy-1) = 0.0f;
-    //     for( y=0 ; y<sy ; y++ )
-    //       (*U)(0,y) = (*U)(sx-1,y) = 0.0f;
-    //   }
-    //   else
-    //   {
-    //     U.fill(0.0f); return;   /* also works well?? */
-
-    //     // TODO: this produces incorrect results
-    // //     solve_pde_sor(F,U);
-    // //     for( y=0 ; y<sy ; y++ )
-    // //       for( x=0 ; x<sx ; x++ )
-    // //         (*U)(x,y) *= h2;
-    //   }
+inline float defectPixel(const float *u, const float *f, int cols, int rows,
+                         int x, int y) {
+    int count;
+    const float sum = neighbours(u, cols, rows, x, y, count);
+    return f[y * cols + x] - (sum - count * u[y * cols + x]);
 }
 
-// static int rows, cols;
-
-// smooth u using f at level
-static void smooth(pfs::Array2Df *U, const pfs::Array2Df *F) {
-    //   DEBUG_STR << "smooth" << endl;
-
-    int rows = U->getRows();
-    int cols = U->getCols();
-
-    const int n = rows * cols;
-
-    int iter;
-    float err;
-
-    linbcg(n, F->data(), U->data(), BCG_TOL, BCG_STEPS, &iter, &err, rows,
-           cols);
-
-    //   fprintf( stderr, "." );
-
-    // Gauss relaxation is too slow
-
-    //   int sx = F->getCols();
-    //   int sy = F->getRows();
-    //   int x,y,i;
-    //   int shx;    shift x
-
-    //   float h = 1.0f/sqrt(sx*sy*1.0f);
-    //   float h2 = h*h;
-
-    //   h2 = 1;
-
-    //   for( int pass=0 ; pass<2 ; pass++ )
-    //   {
-    //     shx=pass;
-    //     for( y=0; y<sy ; y++ )
-    //     {
-    //       shx= (y+pass)%2;
-    //       for( x=shx ; x<sx ; x+=2 )
-    //       {
-    //         int w, n, e, s;
-    //         w = (x == 0 ? 0 : x-1);
-    //         n = (y == 0 ? 0 : y-1);
-    //         s = (y+1 == sy ? y : y+1);
-    //         e = (x+1 == sx ? x : x+1);
-
-    //     (*U)(x,y) = .25 * ( (*U)(e,y) + (*U)(w,y) + (*U)(x,s) + (*U)(x,n)
-    //           - h2 * (*F)(x,y) );
-    //       }
-    //     }
-    //   }
-}
-
-static void calculate_defect(pfs::Array2Df *D, const pfs::Array2Df *U,
-                             const pfs::Array2Df *F) {
-    //   DEBUG_STR << "calculate defect" << endl;
-
-    int sx = F->getCols();
-    int sy = F->getRows();
-
-    // float h = 1.0f/sqrt(sx*sy*1.0f);
-    // float h2i = 1.0/(h*h);
-
-    // h2i = 1;
-
-    for (int y = 0; y < sy; y++)
-        for (int x = 0; x < sx; x++) {
-            int w, n, e, s;
-            w = (x == 0 ? 0 : x - 1);
-            n = (y == 0 ? 0 : y - 1);
-            s = (y + 1 == sy ? y : y + 1);
-            e = (x + 1 == sx ? x : x + 1);
-
-            (*D)(x, y) = (*F)(x, y) - ((*U)(e, y) + (*U)(w, y) + (*U)(x, n) +
-                                       (*U)(x, s) - 4.0 * (*U)(x, y));
+// Gauss-Seidel on the pixels of row y with (x + y) % 2 == color: they only
+// read pixels of the other color, so that the row can be updated as a whole.
+// Only the pixels of the color are written.
+void relaxRow(float *u, const float *f, int cols, int rows, int y, int color) {
+    if (y == 0 || y + 1 == rows || cols < 3) {
+        for (int x = (y + color) & 1; x < cols; x += 2) {
+            relaxPixel(u, f, cols, rows, x, y);
         }
-}
-
-static void add_correction(pfs::Array2Df *U, const pfs::Array2Df *C) {
-    //   DEBUG_STR << "add_correction" << endl;
-
-    int sx = C->getCols();
-    int sy = C->getRows();
+        return;
+    }
 
-    for (int i = 0; i < sx * sy; i++) (*U)(i) += (*C)(i);
+    float *ur = u + y * cols;
+    const float *fr = f + y * cols;
+    if (((y + color) & 1) == 0) {
+        relaxPixel(u, f, cols, rows, 0, y);
+    }
+    int x = 1;
+#ifdef __SSE2__
+    // x is odd at the start of every vector, the pixels of the color are its
+    // elements first + 0 and first + 2. The left and right neighbours are
+    // shuffled from the vectors loaded before the update, which hold the
+    // right values for the other color: loading them from the row after the
+    // previous store stalls on the store forwarding.
+    const int first = (y + color + 1) & 1;
+    const vfloat quarterv = F2V(0.25f);
+    vfloat prevv = F2V(ur[0]);
+    vfloat curv = LVFU(ur[x]);
+    float relaxed[4];
+    for (; x + 4 <= cols - 1; x += 4) {
+        // only the first element is used, the others may be on the next row
+        const vfloat nextv = LVFU(ur[x + 4]);
+        const vfloat tl = _mm_shuffle_ps(prevv, curv, _MM_SHUFFLE(0, 0, 3, 3));
+        const vfloat leftv = _mm_shuffle_ps(tl, curv, _MM_SHUFFLE(2, 1, 2, 0));
+        const vfloat tr = _mm_shuffle_ps(curv, nextv, _MM_SHUFFLE(0, 0, 3, 3));
+        const vfloat rightv = _mm_shuffle_ps(curv, tr, _MM_SHUFFLE(2, 0, 2, 1));
+        const vfloat sumv =
+            leftv + rightv + LVFU(ur[x - cols]) + LVFU(ur[x + cols]);
+        STVFU(relaxed[0], quarterv * (sumv - LVFU(fr[x])));
+        ur[x + first] = relaxed[first];
+        ur[x + first + 2] = relaxed[first + 2];
+        prevv = curv;
+        curv = nextv;
+    }
+#endif
+    for (x += (x + y + color) & 1; x < cols - 1; x += 2) {
+        ur[x] = 0.25f *
+                (ur[x - 1] + ur[x + 1] + ur[x - cols] + ur[x + cols] - fr[x]);
+    }
+    if (((cols - 1 + y + color) & 1) == 0) {
+        relaxPixel(u, f, cols, rows, cols - 1, y);
+    }
 }
 
-void solve_pde_multigrid(pfs::Array2Df *F, pfs::Array2Df *U,
-                         pfs::Progress &ph) {
-    int xmax = F->getCols();
-    int ymax = F->getRows();
-
-    int i;   // index for simple loops
-    int k;   // index for iterating through levels
-    int k2;  // index for iterating through levels in V-cycles
-
-    // 1. restrict f to coarse-grid (by the way count the number of levels)
-    //      k=0: fine-grid = f
-    //      k=levels: coarsest-grid
-    int levels = 0;
-    int mins = (xmax < ymax) ? xmax : ymax;
-    while (mins >= MINS) {
-        levels++;
-        mins = mins / 2 + MODYF;
+// d = f - L u on row y
+void defectRow(const float *u, const float *f, int cols, int rows, int y,
+               float *d) {
+    if (y == 0 || y + 1 == rows || cols < 3) {
+        for (int x = 0; x < cols; ++x) {
+            d[x] = defectPixel(u, f, cols, rows, x, y);
+        }
+        return;
     }
 
-    // given function f restricted on levels
-    pfs::Array2Df **RHS = new pfs::Array2Df *[levels + 1];
+    const float *ur = u + y * cols;
+    const float *fr = f + y * cols;
+    d[0] = defectPixel(u, f, cols, rows, 0, y);
+    int x = 1;
+#ifdef __SSE2__
+    const vfloat fourv = F2V(4.f);
+    for (; x + 4 <= cols - 1; x += 4) {
+        const vfloat sumv = LVFU(ur[x - 1]) + LVFU(ur[x + 1]) +
+                            LVFU(ur[x - cols]) + LVFU(ur[x + cols]);
+        STVFU(d[x], LVFU(fr[x]) - (sumv - fourv * LVFU(ur[x])));
+    }
+#endif
+    for (; x < cols - 1; ++x) {
+        d[x] = fr[x] - (ur[x - 1] + ur[x + 1] + ur[x - cols] + ur[x + cols] -
+                        4.f * ur[x]);
+    }
+    d[cols - 1] = defectPixel(u, f, cols, rows, cols - 1, y);
+}
 
-    // approximate initial sollutions on levels
-    pfs::Array2Df **IU = new pfs::Array2Df *[levels + 1];
-    // target functions in cycles (approximate sollution error (uh - ~uh) )
-    pfs::Array2Df **VF = new pfs::Array2Df *[levels + 1];
+}  // anonymous
 
-    VF[0] = new pfs::Array2Df(xmax, ymax);
-    RHS[0] = F;
-    IU[0] = new pfs::Array2Df(xmax, ymax);
-    pfs::copy(U, IU[0]);
+struct PdeMultigrid::Level {
+    Level(int cols_, int rows_)
+        : cols(cols_), rows(rows_), u(nullptr), f(nullptr) {}
 
-    int sx = xmax;
-    int sy = ymax;
-    for (k = 0; k < levels; k++) {
-        // calculate size of next level
-        sx = sx / 2 + MODYF;
-        sy = sy / 2 + MODYF;
+    size_t size() const { return static_cast<size_t>(cols) * rows; }
+    bool parallel() const { return size() > OMP_THRESHOLD; }
 
-        RHS[k + 1] = new pfs::Array2Df(sx, sy);
-        IU[k + 1] = new pfs::Array2Df(sx, sy);
-        VF[k + 1] = new pfs::Array2Df(sx, sy);
+    // bilinear interpolation from the centres of the pixels of a level of
+    // ccols x crows
+    void setCoarser(int ccols, int crows) {
+        interpolation(cols, ccols, x0, x1, wx);
+        interpolation(rows, crows, y0, y1, wy);
+    }
 
-        // restrict from level k to level k+1 (coarser-grid)
-        restrict(RHS[k], RHS[k + 1]);
+    void relax(int sweeps);
+    double restrictTo(Level &coarse, bool fromDefect);
+    void prolongateFrom(const Level &coarse, bool add);
+    void solveExact();
+    double defectNorm();
+
+    int cols;
+    int rows;
+    float *u;  // the solution, U of the caller on the finest level
+    float *f;  // the right hand side, the defect of the finer level in cycles
+
+    Buffer ustore;
+    Buffer fstore;
+    // a row of the defect per thread
+    Buffer defect;
+
+    std::vector<int> x0, x1, y0, y1;
+    std::vector<float> wx, wy;
+
+   private:
+    static void interpolation(int n, int cn, std::vector<int> &i0,
+                              std::vector<int> &i1, std::vector<float> &w) {
+        i0.resize(n);
+        i1.resize(n);
+        w.resize(n);
+        const float scale = static_cast<float>(cn) / n;
+        for (int i = 0; i < n; ++i) {
+            const float s =
+                std::min(std::max((i + 0.5f) * scale - 0.5f, 0.f),
+                         static_cast<float>(cn - 1));
+            i0[i] = static_cast<int>(s);
+            i1[i] = std::min(i0[i] + 1, cn - 1);
+            w[i] = s - i0[i];
+        }
     }
+};
+
+void PdeMultigrid::Level::relax(int sweeps) {
+    // the vectors of a row read whole rows next to it: the even rows and the
+    // odd rows of a color are relaxed one after the other, so that no row is
+    // written while its neighbours read it. The result does not depend on
+    // the order, the pixels of a color do not read each other.
+#pragma omp parallel if (parallel())
+    for (int s = 0; s < sweeps; ++s) {
+        for (int color = 0; color < 2; ++color) {
+            for (int parity = 0; parity < 2; ++parity) {
+#pragma omp for schedule(static)
+                for (int y = parity; y < rows; y += 2) {
+                    relaxRow(u, f, cols, rows, y, color);
+                }
+            }
+        }
+    }
+}
 
-    // 2. find exact sollution at the coarsest-grid (k=levels)
-    exact_sollution(RHS[levels], IU[levels]);
-
-    // 3. nested iterations
-    for (k = levels - 1; k >= 0; k--) {
-        ph.setValue(20 + 70 * (levels - k) / (levels + 1));
-        // 4. interpolate sollution from last coarse-grid to finer-grid
-        // interpolate from level k+1 to level k (finer-grid)
-        prolongate(IU[k + 1], IU[k]);
-
-        // 4.1. first target function is the equation target function
-        //      (following target functions are the defect)
-        pfs::copy(RHS[k], VF[k]);
-
-        // 5. V-cycle (twice repeated)
-        for (int cycle = 0; cycle < V_CYCLE; cycle++) {
-            // 6. downward stroke of V
-            for (k2 = k; k2 < levels; k2++) {
-                // 7. pre-smoothing of initial sollution using target function
-                //    zero for initial guess at smoothing
-                //    (except for level k when iu contains prolongated result)
-                if (k2 != k) IU[k2]->reset();
-
-                //        fprintf( stderr, "Level: %d --------\n", k2 );
-
-                for (i = 0; i < SMOOTH_IT; i++) smooth(IU[k2], VF[k2]);
-
-                // 8. calculate defect at level
-                //    d[k2] = Lh * ~u[k2] - f[k2]
-                pfs::Array2Df *D =
-                    new pfs::Array2Df(IU[k2]->getCols(), IU[k2]->getRows());
-                calculate_defect(D, IU[k2], VF[k2]);
-
-                // 9. restrict deffect as target function for next coarser-grid
-                //    def -> f[k2+1]
-                restrict(D, VF[k2 + 1]);
-                delete D;
+// f of the coarse level is the sum of the blocks of 2x2 pixels of the defect
+// (or of f, if !fromDefect) of this level, times h^2 / pixels of the block.
+// The last block of a row or of a column also takes the odd pixel.
+// Returns the squared norm of what has been restricted.
+double PdeMultigrid::Level::restrictTo(Level &coarse, bool fromDefect) {
+    const int ccols = coarse.cols;
+    const int crows = coarse.rows;
+    const float h2 = static_cast<float>(cols) / ccols *
+                     static_cast<float>(rows) / crows;
+
+    double norm = 0.;
+#pragma omp parallel for reduction(+ : norm) if (parallel()) schedule(static)
+    for (int j = 0; j < crows; ++j) {
+        float *d = defect.data() + threadNum() * cols;
+        float *fc = coarse.f + j * ccols;
+        std::fill(fc, fc + ccols, 0.f);
+
+        const int yEnd = (j + 1 == crows) ? rows : 2 * j + 2;
+        for (int y = 2 * j; y < yEnd; ++y) {
+            const float *dr = f + y * cols;
+            if (fromDefect) {
+                defectRow(u, f, cols, rows, y, d);
+                dr = d;
+            }
+            float rowNorm = 0.f;
+            for (int x = 0; x < cols; ++x) {
+                rowNorm += dr[x] * dr[x];
             }
+            norm += rowNorm;
 
-            // 10. solve on coarsest-grid (target function is the deffect)
-            //     iu[levels] should contain sollution for
-            //     the f[levels] - last deffect, iu will now be the correction
-            exact_sollution(VF[levels], IU[levels]);
-
-            // 11. upward stroke of V
-            for (k2 = levels - 1; k2 >= k; k2--) {
-                // 12. interpolate correction from last coarser-grid to
-                // finer-grid
-                //     iu[k2+1] -> cor
-                pfs::Array2Df *C =
-                    new pfs::Array2Df(IU[k2]->getCols(), IU[k2]->getRows());
-                prolongate(IU[k2 + 1], C);
-
-                // 13. add interpolated correction to initial sollution at level
-                // k2
-                add_correction(IU[k2], C);
-                delete C;
-
-                //        fprintf( stderr, "Level: %d --------\n", k2 );
-
-                // 14. post-smoothing of current sollution using target function
-                for (i = 0; i < SMOOTH_IT; i++) smooth(IU[k2], VF[k2]);
+            for (int i = 0; i < ccols; ++i) {
+                fc[i] += dr[2 * i] + dr[2 * i + 1];
+            }
+            for (int x = 2 * ccols; x < cols; ++x) {
+                fc[ccols - 1] += dr[x];
             }
+        }
 
-        }  //--- end of V-cycle
-
-    }  //--- end of nested iteration
-
-    // 15. final sollution
-    //     IU[0] contains the final sollution
-
-    //   for( k=0 ; k<levels ; k++ ) {
-    //     char name[200];
-    //     sprintf( name, "u_%d.pfs", k );
-    //     dumpPFS( name, IU[k], "Y" );
-    //     sprintf( name, "rh_%d.pfs", k );
-    //     dumpPFS( name, RHS[k], "Y" );
-    //     sprintf( name, "v_%d.pfs", k );
-    //     dumpPFS( name, VF[k], "Y" );
-    //   }
-
-    pfs::copy(IU[0], U);
-
-    // further improvement of the solution
-    if (BCG_POST_IMPROVE) {
-        int iter;
-        float err;
-        // DEBUG_STR << "FMG: cg post improving ..., maxiter=" <<
-        // BCG_POST_STEPS;
-        // DEBUG_STR << ", tol=" << BCG_POST_TOL << std::endl;
-        linbcg((unsigned long) xmax * ymax, F->data(), U->data(), BCG_POST_TOL, BCG_POST_STEPS,
-               &iter, &err, ymax, xmax);
-        // DEBUG_STR << "FMG: cg post improvement: iter=" << iter << ", err=" <<
-        // err;
-        // DEBUG_STR << std::endl;
+        const int blockRows = yEnd - 2 * j;
+        const float w = h2 / (2 * blockRows);
+        for (int i = 0; i < ccols - 1; ++i) {
+            fc[i] *= w;
+        }
+        fc[ccols - 1] *= h2 / ((cols - 2 * (ccols - 1)) * blockRows);
     }
+    return norm;
+}
 
-    ph.setValue(90);
-
-    delete VF[0];
-    delete IU[0];
-
-    for (k = 1; k <= levels; k++) {
-        delete RHS[k];
-        delete IU[k];
-        delete VF[k];
+// u = P u_coarse, or u += P u_coarse if add
+void PdeMultigrid::Level::prolongateFrom(const Level &coarse, bool add) {
+    const int ccols = coarse.cols;
+#pragma omp parallel for if (parallel()) schedule(static)
+    for (int y = 0; y < rows; ++y) {
+        const float *c0 = coarse.u + y0[y] * ccols;
+        const float *c1 = coarse.u + y1[y] * ccols;
+        const float v = wy[y];
+        float *ur = u + y * cols;
+        for (int x = 0; x < cols; ++x) {
+            const float top = c0[x0[x]] + wx[x] * (c0[x1[x]] - c0[x0[x]]);
+            const float bottom = c1[x0[x]] + wx[x] * (c1[x1[x]] - c1[x0[x]]);
+            const float value = top + v * (bottom - top);
+            ur[x] = add ? ur[x] + value : value;
+        }
     }
-
-    delete[] RHS;
-    delete[] IU;
-    delete[] VF;
 }
 
-//#define EPS 1.0e-14
+// the coarsest level is small enough to be solved by relaxation alone
+void PdeMultigrid::Level::solveExact() {
+    // the Neumann problem has a solution only for f of zero mean
+    const size_t n = size();
+    double mean = 0.;
+    for (size_t i = 0; i < n; ++i) {
+        mean += f[i];
+    }
+    const float m = static_cast<float>(mean / n);
+    for (size_t i = 0; i < n; ++i) {
+        f[i] -= m;
+    }
 
-static void asolve(const float b[], float x[], int rows, int cols) {
-    for (int j = 0; j < rows * cols; j++) x[j] = -4 * b[j];
+    std::fill(u, u + n, 0.f);
+    relax(COARSE_SWEEPS);
 }
 
-#define idx(R, C) ((R)*cols + (C))
-
-static void atimes(const float x[], float res[], int rows, int cols) {
-#pragma omp parallel for shared(x, res) if (rows *cols > OMP_THRESHOLD) \
-                                                schedule(static)
-    for (int r = 1; r < rows - 1; r++)
-        for (int c = 1; c < cols - 1; c++) {
-            res[idx(r, c)] = x[idx(r - 1, c)] + x[idx(r + 1, c)] +
-                             x[idx(r, c - 1)] + x[idx(r, c + 1)] -
-                             4 * x[idx(r, c)];
+double PdeMultigrid::Level::defectNorm() {
+    double norm = 0.;
+#pragma omp parallel for reduction(+ : norm) if (parallel()) schedule(static)
+    for (int y = 0; y < rows; ++y) {
+        float *d = defect.data() + threadNum() * cols;
+        defectRow(u, f, cols, rows, y, d);
+        float rowNorm = 0.f;
+        for (int x = 0; x < cols; ++x) {
+            rowNorm += d[x] * d[x];
         }
+        norm += rowNorm;
+    }
+    return norm;
+}
 
-    for (int r = 1; r < rows - 1; r++) {
-        res[idx(r, 0)] = x[idx(r - 1, 0)] + x[idx(r + 1, 0)] + x[idx(r, 1)] -
-                         3 * x[idx(r, 0)];
-        res[idx(r, cols - 1)] = x[idx(r - 1, cols - 1)] +
-                                x[idx(r + 1, cols - 1)] + x[idx(r, cols - 2)] -
-                                3 * x[idx(r, cols - 1)];
+PdeMultigrid::PdeMultigrid() : m_residual(0.f), m_cycles(0) {}
+
+PdeMultigrid::~PdeMultigrid() {}
+
+void PdeMultigrid::allocate(size_t cols, size_t rows) {
+#ifdef _OPENMP
+    const size_t threads = omp_get_max_threads();
+#else
+    const size_t threads = 1;
+#endif
+
+    if (m_levels.empty() || m_levels[0]->cols != static_cast<int>(cols) ||
+        m_levels[0]->rows != static_cast<int>(rows)) {
+        m_levels.clear();
+
+        // the finest level solves in the array of the caller
+        m_levels.emplace_back(new Level(cols, rows));
+        m_levels[0]->fstore.resize(cols * rows);
+        m_levels[0]->f = m_levels[0]->fstore.data();
+
+        size_t sx = cols;
+        size_t sy = rows;
+        while (std::min(sx, sy) >= MINS) {
+            sx /= 2;
+            sy /= 2;
+            m_levels.back()->setCoarser(sx, sy);
+
+            Level *level = new Level(sx, sy);
+            m_levels.emplace_back(level);
+            level->ustore.resize(sx * sy);
+            level->fstore.resize(sx * sy);
+            level->u = level->ustore.data();
+            level->f = level->fstore.data();
+        }
     }
 
-    for (int c = 1; c < cols - 1; c++) {
-        res[idx(0, c)] = x[idx(1, c)] + x[idx(0, c - 1)] + x[idx(0, c + 1)] -
-                         3 * x[idx(0, c)];
-        res[idx(rows - 1, c)] = x[idx(rows - 2, c)] + x[idx(rows - 1, c - 1)] +
-                                x[idx(rows - 1, c + 1)] -
-                                3 * x[idx(rows - 1, c)];
+    for (auto &level : m_levels) {
+        if (level->defect.size() < threads * level->cols) {
+            level->defect.resize(threads * level->cols);
+        }
     }
-    res[idx(0, 0)] = x[idx(1, 0)] + x[idx(0, 1)] - 2 * x[idx(0, 0)];
-    res[idx(rows - 1, 0)] =
-        x[idx(rows - 2, 0)] + x[idx(rows - 1, 1)] - 2 * x[idx(rows - 1, 0)];
-    res[idx(0, cols - 1)] =
-        x[idx(1, cols - 1)] + x[idx(0, cols - 2)] - 2 * x[idx(0, cols - 1)];
-    res[idx(rows - 1, cols - 1)] = x[idx(rows - 2, cols - 1)] +
-                                   x[idx(rows - 1, cols - 2)] -
-                                   2 * x[idx(rows - 1, cols - 1)];
 }
 
-#undef idx
+float PdeMultigrid::vcycle(size_t k) {
+    const size_t levels = m_levels.size() - 1;
+
+    // downward stroke of V, the defect is the target function of the
+    // coarser level
+    double norm = 0.;
+    for (size_t k2 = k; k2 < levels; ++k2) {
+        Level &level = *m_levels[k2];
+        // zero initial guess of the correction, except on level k that
+        // contains the solution
+        if (k2 != k) {
+            std::fill(level.u, level.u + level.size(), 0.f);
+        }
+        level.relax(PRE_SMOOTH);
 
-static float snrm(unsigned long n, const float sx[]) {
-    float ans = 0.0f;
+        const double defect = level.restrictTo(*m_levels[k2 + 1], true);
+        if (k2 == k) {
+            norm = defect;
+        }
+    }
+
+    m_levels[levels]->solveExact();
 
-#pragma omp parallel for shared(sx) \
-    reduction(+ : ans) if (n > OMP_THRESHOLD) schedule(static)
-    for (long i = 0; i < static_cast<long>(n); i++) {
-        ans += sx[i] * sx[i];
+    // upward stroke of V
+    for (size_t k2 = levels; k2-- > k;) {
+        Level &level = *m_levels[k2];
+        level.prolongateFrom(*m_levels[k2 + 1], true);
+        level.relax(POST_SMOOTH);
     }
-    return sqrt(ans);
+    return static_cast<float>(std::sqrt(norm));
 }
 
-/**
- * Biconjugate Gradient Method
- * from Numerical Recipes in C
- */
-static void linbcg(unsigned long n, const float b[], float x[], float tol,
-                   int itmax, int *iter, float *err, int rows, int cols) {
-    float ak, akden, bk, bkden = 1.0, bknum, bnrm = 1.0;  // zm1nrm,znrm;
-    float *p, *pp, *r, *rr, *z, *zz;
-
-    p = new float[n + 1];
-    pp = new float[n + 1];
-    r = new float[n + 1];
-    rr = new float[n + 1];
-    z = new float[n + 1];
-    zz = new float[n + 1];
-
-    *iter = 0;
-    atimes(x, r, rows, cols);
-    for (unsigned long j = 0; j < n; j++) {
-        r[j] = b[j] - r[j];
+void PdeMultigrid::solve(const pfs::Array2Df &F, pfs::Array2Df &U,
+                         pfs::Progress &ph) {
+    const size_t cols = F.getCols();
+    const size_t rows = F.getRows();
+    assert(U.getCols() == cols && U.getRows() == rows);
+
+    allocate(cols, rows);
+    m_cycles = 0;
+    m_residual = 0.f;
+
+    Level &top = *m_levels[0];
+    top.u = U.data();
+
+    // right hand side of zero mean, as for the fft solver
+    const float *data = F.data();
+    const long n = static_cast<long>(cols * rows);
+    double sum = 0.;
+#pragma omp parallel for reduction(+ : sum) if (top.parallel())
+    for (long i = 0; i < n; i++) {
+        sum += data[i];
+    }
+    const float mean = static_cast<float>(sum / n);
+    double norm = 0.;
+#pragma omp parallel for reduction(+ : norm) if (top.parallel())
+    for (long i = 0; i < n; i++) {
+        top.f[i] = data[i] - mean;
+        norm += top.f[i] * top.f[i];
     }
-    for (unsigned long j = 0; j < n; j++) {
-        rr[j] = r[j];
+    const float fnorm = static_cast<float>(std::sqrt(norm));
+    if (fnorm == 0.f) {
+        U.fill(0.f);
+        ph.setValue(90);
+        return;
     }
-    atimes(r, rr, rows, cols);  // minimum residual
-    // znrm=1.0;
-    bnrm = snrm(n, b);
-    asolve(r, z, rows, cols);
-
-    while (*iter <= itmax) {
-        ++(*iter);
-        // zm1nrm=znrm;
-        asolve(rr, zz, rows, cols);
-        bknum = 0.0;
-#pragma omp parallel for shared(z, rr) reduction( \
-    + : bknum) if (n > OMP_THRESHOLD) schedule(static)
-        for (long j = 0; j < static_cast<long>(n); j++) {
-            bknum += z[j] * rr[j];
+
+    // 1. restrict f to every level
+    const size_t levels = m_levels.size() - 1;
+    for (size_t k = 0; k < levels; ++k) {
+        m_levels[k]->restrictTo(*m_levels[k + 1], false);
+    }
+
+    // 2. solve on the coarsest grid
+    m_levels[levels]->solveExact();
+
+    // 3. nested iterations: the solution of each level is the initial
+    // guess of the finer one, refined by V-cycles
+    for (size_t k = levels; k-- > 1;) {
+        m_levels[k]->prolongateFrom(*m_levels[k + 1], false);
+        for (int cycle = 0; cycle < V_CYCLE; ++cycle) {
+            vcycle(k);
         }
-        if (*iter == 1) {
-            for (long j = 0; j < static_cast<long>(n); j++) {
-                p[j] = z[j];
-            }
-            for (long j = 0; j < static_cast<long>(n); j++) {
-                pp[j] = zz[j];
-            }
-        } else {
-            bk = bknum / bkden;
-            pfs::utils::vadds(z, bk, p, p, n);
-            pfs::utils::vadds(zz, bk, pp, pp, n);
+
+        ph.setValue(20 + 20 * (levels - k) / levels);
+        if (ph.canceled()) {
+            return;
         }
-        bkden = bknum;
-        atimes(p, z, rows, cols);
-        akden = 0.0;
-#pragma omp parallel for shared(z, pp) reduction( \
-    + : akden) if (n > OMP_THRESHOLD) schedule(static)
-        for (long j = 0; j < static_cast<long>(n); j++) {
-            akden += z[j] * pp[j];
+    }
+
+    // 4. V-cycles on the finest grid until it converges
+    if (levels > 0) {
+        top.prolongateFrom(*m_levels[1], false);
+        while (m_cycles < MAX_CYCLES) {
+            const float residual = vcycle(0) / fnorm;
+            ++m_cycles;
+
+            const float done = std::log(residual) / std::log(FMG_TOL);
+            ph.setValue(40 + static_cast<int>(50 * std::min(std::max(done, 0.f),
+                                                            1.f)));
+            if (residual <= FMG_TOL || ph.canceled()) {
+                break;
+            }
         }
-        ak = bknum / akden;
-        atimes(pp, zz, rows, cols);
-        pfs::utils::vadds(x, ak, p, x, n);
-        pfs::utils::vsubs(r, ak, z, r, n);
-        pfs::utils::vsubs(rr, ak, zz, rr, n);
-        asolve(r, z, rows, cols);
-        // znrm = 1.0f;
-        *err = snrm(n, r) / bnrm;
-        //        fprintf( stderr, "iter=%4d err=%12.6f\n",*iter,*err);
-        if (*err <= tol) break;
     }
+    m_residual = static_cast<float>(std::sqrt(top.defectNorm())) / fnorm;
 
-    delete[] p;
-    delete[] pp;
-    delete[] r;
-    delete[] rr;
-    delete[] z;
-    delete[] zz;
+    // the solution is defined up to a constant
+    const float maxU = *std::max_element(U.begin(), U.end());
+    std::transform(U.begin(), U.end(), U.begin(),
+                   [maxU](float v) { return v - maxU; });
+
+    ph.setValue(90);
+}
+
+void solve_pde_multigrid(pfs::Array2Df *F, pfs::Array2Df *U,
+                         pfs::Progress &ph) {
+    // the levels hold several times the size of the frame: they are released
+    // with the solver once the solution is found
+    PdeMultigrid solver;
+    solver.solve(*F, *U, ph);
 }
-//#undef EPS
@@ -32,12 +32,58 @@
 #ifndef FMG_PDE_H
 #define FMG_PDE_H
 
+#include <memory>
+#include <vector>
+
 #include <Libpfs/array2d_fwd.h>
 
 namespace pfs {
 class Progress;
 }
 
+/**
+ * @brief Full multigrid solver of the poisson pde (Laplace U = F) with
+ * Neumann boundary conditions
+ *
+ * The levels of the grid are allocated by the first call of solve() and
+ * reused by the following calls of the same size. The smoother is a red-black
+ * Gauss-Seidel, parallel on the rows and vectorised along them; the defect
+ * is computed while it is restricted and the correction is added while it
+ * is prolongated, so that no level needs more than its solution and its
+ * right hand side.
+ */
+class PdeMultigrid {
+   public:
+    PdeMultigrid();
+    ~PdeMultigrid();
+
+    /**
+     * @brief solve the pde
+     *
+     * V-cycles on the finest grid are repeated until the residual is below
+     * the tolerance. Progress goes from 20 to 90 as the residual decreases.
+     *
+     * @param F array with divergence
+     * @param U [out] solution, with maximum 0
+     */
+    void solve(const pfs::Array2Df &F, pfs::Array2Df &U, pfs::Progress &ph);
+
+    //! @brief residual of the last solution, relative to the norm of F
+    float residual() const { return m_residual; }
+    //! @brief V-cycles run on the finest grid by the last solution
+    int cycles() const { return m_cycles; }
+
+   private:
+    struct Level;
+
+    void allocate(size_t cols, size_t rows);
+    float vcycle(size_t k);
+
+    std::vector<std::unique_ptr<Level>> m_levels;
+    float m_residual;
+    int m_cycles;
+};
+
 /**
  * @brief solve pde using full multrigrid algorithm
  *
@@ -36,12 +36,14 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include "Libpfs/colorspace/colorspace.h"
 #include "Libpfs/exception.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/progress.h"
+#include "Libpfs/tm/TonemapStageCache.h"
 #include "../../opthelper.h"
 #include "../../sleef.c"
 #define pow_F(a,b) (xexpf(b*xlogf(a)))
@@ -90,16 +92,32 @@ void pfstmo_fattal02(pfs::Frame &frame, float opt_alpha, float opt_beta,
     const int h = frame.getHeight();
 
     pfs::Array2Df Yr(w, h);
-    pfs::Array2Df L(w, h);
 
     pfs::transformRGB2Y(R, G, B, &Yr);
 
-    try {
-        tmo_fattal02(w, h, Yr, L, opt_alpha, opt_beta, opt_noise, newfattal,
-                     fftsolver, detail_level, ph);
-    } catch (...) {
-        throw pfs::Exception("Tonemapping Failed!");
-    }
+    // the compressed luminance depends only on the luminance and on the
+    // attenuation of the gradients: changing the saturation reruns only the
+    // color restoration below
+    const TonemapStageKey luminanceKey =
+        TonemapStageKey("fattal02.luminance",
+                        TonemapStageCache::fingerprint(Yr))
+        << opt_alpha << opt_beta << opt_noise << static_cast<float>(newfattal)
+        << static_cast<float>(fftsolver) << static_cast<float>(detail_level);
+    TonemapStageCache::Entry luminance =
+        TonemapStageCache::instance().getOrCompute(luminanceKey, [&]() {
+            std::shared_ptr<pfs::Array2Df> out =
+                std::make_shared<pfs::Array2Df>(w, h);
+            try {
+                tmo_fattal02(w, h, Yr, *out, opt_alpha, opt_beta, opt_noise,
+                             newfattal, fftsolver, detail_level, ph);
+            } catch (...) {
+                throw pfs::Exception("Tonemapping Failed!");
+            }
+            return ph.canceled() ? TonemapStageCache::Entry()
+                                 : TonemapStageCache::Entry(out);
+        });
+    if (!luminance) return;
+    const pfs::Array2Df &L = *luminance;
 
     if (!ph.canceled()) {
         pfs::Array2Df &arrayRed = *R;
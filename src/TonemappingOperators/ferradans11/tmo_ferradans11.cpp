@@ -93,7 +93,6 @@ static void dumpPFS( const char *fileName, const pfstmo::Array2D *data, const ch
 
 namespace {
 
-static inline bool abs_compare(float a, float b) { return fabs(a) < fabs(b); }
 /*Implementation, hardcoded of the R function */
 inline float apply_arctg_slope10(float Ip, float I, float I2, float I3, float I4,
                           float I5, float I6, float I7) {
@@ -205,26 +204,55 @@ float medval(const float* a, int length, bool multiThread = true) {
     return lhdrengine::accumulate(a, length, multiThread) / length;
 }
 
-float MSE(const float Im1[], const float Im2[], int largo) {
-
-    double res = 0.0; // use double precision for summations
-#pragma omp parallel for reduction(+:res)
-    for (int i = 0; i < largo; i++) {
-        res += fabs(Im1[i] - Im2[i]);
+//! \brief number of convolutions of the powers of a channel
+const int POWERS = 7;
+
+//! \brief plan of \a howmany 2D transforms of fil x col pixels, in place in
+//! rows padded to the (col / 2 + 1) complex numbers of the spectrum, built
+//! from the wisdom of FFTW if there is any
+//! \note fftw_mutex_plan must be held
+fftwf_plan planMany(bool forward, int fil, int col, int howmany, float *data,
+                    unsigned flags = FFTW_MEASURE) {
+    const int n[2] = {fil, col};
+    const int real[2] = {fil, 2 * (col / 2 + 1)};
+    const int complex[2] = {fil, col / 2 + 1};
+    const int realDist = real[0] * real[1];
+    const int complexDist = complex[0] * complex[1];
+    fftwf_complex *spectrum = reinterpret_cast<fftwf_complex *>(data);
+
+    auto plan = [&](unsigned f) {
+        return forward ? fftwf_plan_many_dft_r2c(
+                             2, n, howmany, data, real, 1, realDist, spectrum,
+                             complex, 1, complexDist, f)
+                       : fftwf_plan_many_dft_c2r(
+                             2, n, howmany, spectrum, complex, 1, complexDist,
+                             data, real, 1, realDist, f);
+    };
+    if (flags != FFTW_MEASURE) {
+        return plan(flags);
     }
-    return res / largo;
-}
-
-void producto(fftwf_complex *A, const fftwf_complex *B, int fil, int col) {
-
-    int length = fil * col;
 
-#pragma omp parallel for
-    for (int i = 0; i < length; i++) {
-        float a1 = (A[i][0] * B[i][1] + A[i][1] * B[i][0]);
-        A[i][0] = (A[i][0] * B[i][0] - A[i][1] * B[i][1]);
-        A[i][1] = a1;
+    // test for available wisdom
+    fftwf_plan p = plan(FFTW_WISDOM_ONLY);
+    if (!p) {
+        // no wisdom available, load wisdom from file
+        fftwf_import_wisdom_from_filename(LuminanceOptions()
+                                              .getFftwWisdomFileName()
+                                              .toStdString()
+                                              .c_str());
+        // test again for wisdom
+        p = plan(FFTW_WISDOM_ONLY);
+        if (!p) {
+            // build plan with FFTW_MEASURE
+            p = plan(FFTW_MEASURE);
+            // save the wisdom
+            fftwf_export_wisdom_to_filename(LuminanceOptions()
+                                                .getFftwWisdomFileName()
+                                                .toStdString()
+                                                .c_str());
+        }
     }
+    return p;
 }
 
 void nucleo_gaussiano(float res[], int fil, int col, float sigma) {
@@ -291,10 +319,11 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
     float dt = 0.2;                    // 1e-1;//
     float threshold_diff = dt / 20.0;  // 1e-5;//
 
-    float *RGBorig[3];
-    RGBorig[0] = new float[length];
-    RGBorig[1] = new float[length];
-    RGBorig[2] = new float[length];
+    // the channels are tonemapped in place
+    float *RGB[3] = {imR.data(), imG.data(), imB.data()};
+    Array2Df orig[3] = {Array2Df(col, fil), Array2Df(col, fil),
+                        Array2Df(col, fil)};
+    float *RGBorig[3] = {orig[0].data(), orig[1].data(), orig[2].data()};
 
 #pragma omp parallel for
     for (int i = 0; i < length; i++) {
@@ -303,20 +332,33 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
         RGBorig[2][i] = (float)max(imB(i), 0.f);
     }
 
+    // the powers of a channel and their spectra share, plane by plane, the
+    // rows of the in place transforms: (col / 2 + 1) complex numbers
+    const int padded = 2 * (col / 2 + 1);
+    const int planeSize = fil * padded;
+    const int spectrumSize = fil * (col / 2 + 1);
+
+    FFTW_MUTEX::fftw_mutex_alloc.lock();
+    float *planes = fftwf_alloc_real(static_cast<size_t>(POWERS) * planeSize);
+    fftwf_complex *G = fftwf_alloc_complex(spectrumSize);
+    FFTW_MUTEX::fftw_mutex_alloc.unlock();
+
+    const auto release = [&]() {
+        FFTW_MUTEX::fftw_mutex_free.lock();
+        fftwf_free(planes);
+        fftwf_free(G);
+        FFTW_MUTEX::fftw_mutex_free.unlock();
+    };
+
     ///////////////////////////////////////////
 
     ph.setValue(10);
 
-    float *RGB[3];
-    RGB[0] = new float[length];
-    RGB[1] = new float[length];
-    RGB[2] = new float[length];
-
     int iteration = 0;
     float difference = 1000.0f;
 
     float med[3];
-    float *aux = new float[length];
+    float *aux = planes;
     float median, mu[3];
 
     for (int k = 0; k < 3; k++) {
@@ -328,16 +370,9 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
         copy(RGBorig[k], RGBorig[k] + length, RGB[k]);
     }
 
-    delete[] aux;
-
     ph.setValue(15);
     if (ph.canceled()) {
-        delete[] RGBorig[0];
-        delete[] RGBorig[1];
-        delete[] RGBorig[2];
-        delete[] RGB[0];
-        delete[] RGB[1];
-        delete[] RGB[2];
+        release();
         return;
     }
 
@@ -393,12 +428,7 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
 
     ph.setValue(20);
     if (ph.canceled()) {
-        delete[] RGBorig[0];
-        delete[] RGBorig[1];
-        delete[] RGBorig[2];
-        delete[] RGB[0];
-        delete[] RGB[1];
-        delete[] RGB[2];
+        release();
         return;
     }
 
@@ -408,80 +438,17 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
         med[color] = medval(RGB[color], length, false);
     }
 
-    FFTW_MUTEX::fftw_mutex_alloc.lock();
-    float *RGB0 = fftwf_alloc_real(length);
-    float *u0 = fftwf_alloc_real(length);
-    float *u2 = fftwf_alloc_real(length);
-    float *u3 = fftwf_alloc_real(length);
-    float *u4 = fftwf_alloc_real(length);
-    float *u5 = fftwf_alloc_real(length);
-    float *u6 = fftwf_alloc_real(length);
-    float *u7 = fftwf_alloc_real(length);
-    FFTW_MUTEX::fftw_mutex_alloc.unlock();
-
+    // FFTW_MEASURE overwrites the planes: plan before they hold any data
     FFTW_MUTEX::fftw_mutex_plan.lock();
-    fftwf_complex *U = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-
-    // test for available wisdom
-    fftwf_plan pU = fftwf_plan_dft_r2c_2d(fil, col, u0, U, FFTW_WISDOM_ONLY);
-    if(!pU) {
-        // no wisdom available, load wisdom from file
-        fftwf_import_wisdom_from_filename(LuminanceOptions().getFftwWisdomFileName().toStdString().c_str());
-        // test again for wisdom
-        pU = fftwf_plan_dft_r2c_2d(fil, col, u0, U, FFTW_WISDOM_ONLY);
-        if(!pU) {
-            // build plan with FFTW_MEASURE
-            pU = fftwf_plan_dft_r2c_2d(fil, col, u0, U, FFTW_MEASURE);
-            // save the wisdom
-            fftwf_export_wisdom_to_filename(LuminanceOptions().getFftwWisdomFileName().toStdString().c_str());
-        }
-    }
-
-    fftwf_complex *U2 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU2 = fftwf_plan_dft_r2c_2d(fil, col, u2, U2, FFTW_WISDOM_ONLY);
-
-    fftwf_complex *U3 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU3 = fftwf_plan_dft_r2c_2d(fil, col, u3, U3, FFTW_WISDOM_ONLY);
-
-    fftwf_complex *U4 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU4 = fftwf_plan_dft_r2c_2d(fil, col, u4, U4, FFTW_WISDOM_ONLY);
-
-    fftwf_complex *U5 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU5 = fftwf_plan_dft_r2c_2d(fil, col, u5, U5, FFTW_WISDOM_ONLY);
-
-    fftwf_complex *U6 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU6 = fftwf_plan_dft_r2c_2d(fil, col, u6, U6, FFTW_WISDOM_ONLY);
-
-    fftwf_complex *U7 = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pU7 = fftwf_plan_dft_r2c_2d(fil, col, u7, U7, FFTW_WISDOM_ONLY);
-
-
-    float *iu = fftwf_alloc_real(length);
-    fftwf_plan pinvU = fftwf_plan_dft_c2r_2d(fil, col, U, iu, FFTW_WISDOM_ONLY);
-    if(!pinvU) {
-        // no wisdom available. Makes no sense to load wisdom from file because we just did that a few lines above.
-        // build plan with FFTW_MEASURE
-        pinvU = fftwf_plan_dft_c2r_2d(fil, col, U, iu, FFTW_MEASURE);
-        // save the wisdom
-        fftwf_export_wisdom_to_filename(LuminanceOptions().getFftwWisdomFileName().toStdString().c_str());
-    }
-
-    fftwf_plan pinvU2 = fftwf_plan_dft_c2r_2d(fil, col, U2, u2, FFTW_WISDOM_ONLY);
-
-    fftwf_plan pinvU3 = fftwf_plan_dft_c2r_2d(fil, col, U3, u3, FFTW_WISDOM_ONLY);
-
-    fftwf_plan pinvU4 = fftwf_plan_dft_c2r_2d(fil, col, U4, u4, FFTW_WISDOM_ONLY);
-
-    fftwf_plan pinvU5 = fftwf_plan_dft_c2r_2d(fil, col, U5, u5, FFTW_WISDOM_ONLY);
-
-    fftwf_plan pinvU6 = fftwf_plan_dft_c2r_2d(fil, col, U6, u6, FFTW_WISDOM_ONLY);
-
-    fftwf_plan pinvU7 = fftwf_plan_dft_c2r_2d(fil, col, U7, u7, FFTW_WISDOM_ONLY);
-
-    float alpha = min(col, fil) / invalpha;
-    float *g = fftwf_alloc_real(length);
+    fftwf_plan pForward = planMany(true, fil, col, POWERS, planes);
+    fftwf_plan pInverse = planMany(false, fil, col, POWERS, planes);
+    fftwf_plan pG = planMany(true, fil, col, 1, planes, FFTW_ESTIMATE);
     FFTW_MUTEX::fftw_mutex_plan.unlock();
 
+    // spectrum of the gaussian kernel, with the normalization of the inverse
+    // transform: computed in the second plane, transformed in the first one
+    float alpha = min(col, fil) / invalpha;
+    float *g = planes + planeSize;
     nucleo_gaussiano(g, fil, col, alpha);
     escala(g, length, 1.f, 0.f);
     fftshift(g, fil, col);
@@ -490,70 +457,40 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
     suma = lhdrengine::accumulate(g, length);
 
     float w = (1.0f / suma);
-    vsmul(g, w, g, length);
-
-    FFTW_MUTEX::fftw_mutex_plan.lock();
-    fftwf_complex *G =
-        (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * length);
-    fftwf_plan pG = fftwf_plan_dft_r2c_2d(fil, col, g, G, FFTW_WISDOM_ONLY);
-    FFTW_MUTEX::fftw_mutex_plan.unlock();
+#pragma omp parallel for
+    for (int i = 0; i < fil; i++) {
+        vsmul(g + i * col, w, planes + i * padded, col);
+    }
     fftwf_execute(pG);
-    FFTW_MUTEX::fftw_mutex_destroy_plan.lock();
-    fftwf_destroy_plan(pG);
+    const fftwf_complex *spectrum = reinterpret_cast<fftwf_complex *>(planes);
+#pragma omp parallel for
+    for (int i = 0; i < spectrumSize; i++) {
+        G[i][0] = norm * spectrum[i][0];
+        G[i][1] = norm * spectrum[i][1];
+    }
 
-    fftwf_free(g);
-    FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
+    const auto destroyPlans = [&]() {
+        FFTW_MUTEX::fftw_mutex_destroy_plan.lock();
+        fftwf_destroy_plan(pForward);
+        fftwf_destroy_plan(pInverse);
+        fftwf_destroy_plan(pG);
+        FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
+    };
 
     ph.setValue(30);
     if (ph.canceled()) {
-        delete[] RGBorig[0];
-        delete[] RGBorig[1];
-        delete[] RGBorig[2];
-        delete[] RGB[0];
-        delete[] RGB[1];
-        delete[] RGB[2];
-        FFTW_MUTEX::fftw_mutex_destroy_plan.lock();
-        fftwf_destroy_plan(pU);
-        fftwf_destroy_plan(pU2);
-        fftwf_destroy_plan(pU3);
-        fftwf_destroy_plan(pU4);
-        fftwf_destroy_plan(pU5);
-        fftwf_destroy_plan(pU6);
-        fftwf_destroy_plan(pU7);
-
-        fftwf_destroy_plan(pinvU);
-        fftwf_destroy_plan(pinvU2);
-        fftwf_destroy_plan(pinvU3);
-        fftwf_destroy_plan(pinvU4);
-        fftwf_destroy_plan(pinvU5);
-        fftwf_destroy_plan(pinvU6);
-        fftwf_destroy_plan(pinvU7);
-
-        fftwf_free(RGB0);
-        fftwf_free(u0);
-        fftwf_free(u2);
-        fftwf_free(u3);
-        fftwf_free(u4);
-        fftwf_free(u5);
-        fftwf_free(u6);
-        fftwf_free(u7);
-
-        fftwf_free(iu);
-
-        fftwf_free(U);
-        fftwf_free(U2);
-        fftwf_free(U3);
-        fftwf_free(U4);
-        fftwf_free(U5);
-        fftwf_free(U6);
-        fftwf_free(U7);
-
-        FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
+        destroyPlans();
+        release();
         return;
     }
     float delta = 0.f, oldDifference = 0.f;
     int steps;
 
+    float *conv[POWERS];
+    for (int k = 0; k < POWERS; k++) {
+        conv[k] = planes + k * planeSize;
+    }
+
     while (difference > threshold_diff) {
         if (ph.canceled()) {
             break;
@@ -563,71 +500,73 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
         difference = 0.0;
 
         for (int color = 0; color < colors; color++) {
-            copy(RGB[color], RGB[color] + length, u0);
-            copy(RGB[color], RGB[color] + length, RGB0);
-
-            transform(u0, u0 + length, u0, u2, multiplies<float>());
-            transform(u2, u2 + length, u0, u3, multiplies<float>());
-            transform(u3, u3 + length, u0, u4, multiplies<float>());
-            transform(u4, u4 + length, u0, u5, multiplies<float>());
-            transform(u5, u5 + length, u0, u6, multiplies<float>());
-            transform(u6, u6 + length, u0, u7, multiplies<float>());
-
-            fftwf_execute(pU);
-            producto(U, G, fil, col);
-            fftwf_execute(pinvU);
-
-            fftwf_execute(pU2);
-            producto(U2, G, fil, col);
-            fftwf_execute(pinvU2);
-
-            fftwf_execute(pU3);
-            producto(U3, G, fil, col);
-            fftwf_execute(pinvU3);
-
-            fftwf_execute(pU4);
-            producto(U4, G, fil, col);
-            fftwf_execute(pinvU4);
-
-            fftwf_execute(pU5);
-            producto(U5, G, fil, col);
-            fftwf_execute(pinvU5);
-
-            fftwf_execute(pU6);
-            producto(U6, G, fil, col);
-            fftwf_execute(pinvU6);
-
-            fftwf_execute(pU7);
-            producto(U7, G, fil, col);
-            fftwf_execute(pinvU7);
+            float *u = RGB[color];
 
+            // u, u^2 ... u^7 convolved with the gaussian, in one batch
 #pragma omp parallel for
-            for (int i = 0; i < length; i++) {
-                // compute contrast component
-                u0[i] = apply_arctg_slope10(u0[i], norm * iu[i], norm * u2[i], norm * u3[i],
-                                            norm * u4[i], norm * u5[i], norm * u6[i], norm * u7[i]);
+            for (int y = 0; y < fil; y++) {
+                for (int x = 0; x < col; x++) {
+                    const float u0 = u[y * col + x];
+                    float uk = u0;
+                    conv[0][y * padded + x] = uk;
+                    for (int k = 1; k < POWERS; k++) {
+                        uk *= u0;
+                        conv[k][y * padded + x] = uk;
+                    }
+                }
+            }
 
-                // project onto the interval [-1,1]
-                u0[i] = max(min(u0[i], 1.f), -1.f);
+            fftwf_execute(pForward);
+#pragma omp parallel for
+            for (int i = 0; i < spectrumSize; i++) {
+                const float g0 = G[i][0];
+                const float g1 = G[i][1];
+                for (int k = 0; k < POWERS; k++) {
+                    fftwf_complex &A = reinterpret_cast<fftwf_complex *>(
+                        conv[k])[i];
+                    const float a1 = A[0] * g1 + A[1] * g0;
+                    A[0] = A[0] * g0 - A[1] * g1;
+                    A[1] = a1;
+                }
+            }
+            fftwf_execute(pInverse);
+
+            // contrast component, projected onto the interval [-1,1], in
+            // place of the first convolution
+            float mabsv = 0.f;
+#pragma omp parallel for reduction(max : mabsv)
+            for (int y = 0; y < fil; y++) {
+                for (int x = 0; x < col; x++) {
+                    const int j = y * padded + x;
+                    float c = apply_arctg_slope10(
+                        u[y * col + x], conv[0][j], conv[1][j], conv[2][j],
+                        conv[3][j], conv[4][j], conv[5][j], conv[6][j]);
+                    c = max(min(c, 1.f), -1.f);
+                    conv[0][j] = c;
+                    mabsv = max(mabsv, fabs(c));
+                }
             }
 
             // normalizing R term to estandarize results
             //
-            float mabsv = fabs(*max_element(u0, u0 + length, abs_compare));
-
             float multiplier = 0.5f / mabsv;
 
             float norm1 = (1.0 + dt * (1.0 + 255.0 / 253.0));  // assuming alpha=255/253,beta=1
 
-#pragma omp parallel for
-            for (int i = 0; i < length; i++) {
-                RGB[color][i] = (RGB[color][i] + dt * (RGBorig[color][i] + multiplier * u0[i] + 255.f / 253.f * med[color])) / norm1;
-                // project onto the interval [0,1]
-                RGB[color][i] = max(min(RGB[color][i], 1.f), 0.f);
+            double mse = 0.0; // use double precision for summations
+#pragma omp parallel for reduction(+ : mse)
+            for (int y = 0; y < fil; y++) {
+                for (int x = 0; x < col; x++) {
+                    const int i = y * col + x;
+                    const float previous = u[i];
+                    float next = (previous + dt * (RGBorig[color][i] + multiplier * conv[0][y * padded + x] + 255.f / 253.f * med[color])) / norm1;
+                    // project onto the interval [0,1]
+                    next = max(min(next, 1.f), 0.f);
+                    u[i] = next;
+                    mse += fabs(previous - next);
+                }
             }
-
-            float mse = MSE(RGB0, RGB[color], length);
-            difference += mse;
+            difference += mse / length;
         }
         delta = fabs(oldDifference - difference);
         steps = (difference - threshold_diff) / delta;
@@ -635,66 +574,26 @@ void tmo_ferradans11(pfs::Array2Df &imR, pfs::Array2Df &imG, pfs::Array2Df &imB,
         if (iteration > 1) ph.setValue(30 + 69 / (steps + 1));
     }
 
-    FFTW_MUTEX::fftw_mutex_destroy_plan.lock();
-    fftwf_destroy_plan(pU);
-    fftwf_destroy_plan(pU2);
-    fftwf_destroy_plan(pU3);
-    fftwf_destroy_plan(pU4);
-    fftwf_destroy_plan(pU5);
-    fftwf_destroy_plan(pU6);
-    fftwf_destroy_plan(pU7);
-
-    fftwf_destroy_plan(pinvU);
-    fftwf_destroy_plan(pinvU2);
-    fftwf_destroy_plan(pinvU3);
-    fftwf_destroy_plan(pinvU4);
-    fftwf_destroy_plan(pinvU5);
-    fftwf_destroy_plan(pinvU6);
-    fftwf_destroy_plan(pinvU7);
-
-    fftwf_free(RGB0);
-    fftwf_free(u0);
-    fftwf_free(u2);
-    fftwf_free(u3);
-    fftwf_free(u4);
-    fftwf_free(u5);
-    fftwf_free(u6);
-    fftwf_free(u7);
-
-    fftwf_free(iu);
-
-    fftwf_free(U);
-    fftwf_free(U2);
-    fftwf_free(U3);
-    fftwf_free(U4);
-    fftwf_free(U5);
-    fftwf_free(U6);
-    fftwf_free(U7);
-
-    FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
+    destroyPlans();
+    release();
 
     ph.setValue(90);
 
+    // range between (0,1)
     for (int c = 0; c < 3; c++)
         escala(RGB[c], length, 1.f, 0.f);
 
-    // range between (0,1)
-    copy(RGB[0], RGB[0] + length, imR.begin());
-    copy(RGB[1], RGB[1] + length, imG.begin());
-    copy(RGB[2], RGB[2] + length, imB.begin());
-
-    delete[] RGBorig[0];
-    delete[] RGBorig[1];
-    delete[] RGBorig[2];
-    delete[] RGB[0];
-    delete[] RGB[1];
-    delete[] RGB[2];
-    FFTW_MUTEX::fftw_mutex_free.lock();
-    fftwf_free(G);
-    FFTW_MUTEX::fftw_mutex_free.unlock();
 #ifdef TIMER_PROFILING
     stop_watch.stop_and_update();
     cout << endl;
     cout << "tmo_ferradans11 = " << stop_watch.get_time() << " msec" << endl;
+    // channels (of the caller), original channels, powers and kernel spectrum
+    const size_t workingSet =
+        sizeof(float) * (6 * static_cast<size_t>(length) +
+                         static_cast<size_t>(POWERS) * planeSize) +
+        sizeof(fftwf_complex) * spectrumSize;
+    cout << "tmo_ferradans11 peak memory = "
+         << static_cast<float>(workingSet) / (1024 * 1024) << " MB (" << static_cast<float>(workingSet) / (sizeof(float) * length)
+         << " floats per pixel)" << endl;
 #endif
 }
@@ -66,6 +66,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #ifdef _OPENMP
@@ -80,6 +81,7 @@
 #include "arch/math.h"
 #include "contrast_domain.h"
 
+#include "multigrid.h"
 #include "pyramid.h"
 
 #include "Libpfs/progress.h"
@@ -89,6 +91,7 @@
 #include "Libpfs/utils/numeric.h"
 #include "Libpfs/utils/sse.h"
 #include "Libpfs/rt_algo.h"
+#include "Libpfs/tm/TonemapStageCache.h"
 
 using namespace pfs;
 
@@ -112,49 +115,195 @@ void multiplyA(PyramidT &px, const PyramidT &pC, const Array2Df &x,
 //
 namespace {
 const int NUM_BACKWARDS_CEILING = 3;
-}
+//! iterations after which r, u and w are computed again from x: their
+//! recurrences drift in float arithmetic
+const int RESIDUAL_REPLACEMENT = 50;
+//! elements of the fused update reduced in float
+const int FUSED_CHUNK = 1024;
+
+struct CGDots {
+    double ru;
+    double wu;
+    double rr;
+};
 
-void lincg(PyramidT &pyramid, PyramidT &pC, const Array2Df &b, Array2Df &x,
-           const int itmax, const float tol, Progress &ph) {
+// one pass over the vectors of an iteration of the pipelined cg:
+//   z = n + beta z, q = m + beta q, s = w + beta s, p = u + beta p,
+//   xOut = x + alpha p, r -= alpha s, u -= alpha q, w -= alpha z
+// and the dot products of the updated r, u and w.
+// Without preconditioner u, q and m are r, s and w and are not updated.
+template <bool Preconditioned>
+CGDots fusedUpdate(const float alpha, const float beta, const size_t size,
+                   const float *x, float *xOut, float *r, float *u, float *w,
+                   float *p, float *s, float *q, float *z, const float *m,
+                   const float *n) {
+    const int chunks = static_cast<int>((size + FUSED_CHUNK - 1) / FUSED_CHUNK);
+    double ru = 0.;
+    double wu = 0.;
+    double rr = 0.;
+#pragma omp parallel for reduction(+ : ru, wu, rr) schedule(static)
+    for (int c = 0; c < chunks; ++c) {
+        size_t i = static_cast<size_t>(c) * FUSED_CHUNK;
+        const size_t end = std::min(size, i + FUSED_CHUNK);
+        float ruChunk = 0.f;
+        float wuChunk = 0.f;
+        float rrChunk = 0.f;
+#ifdef __SSE2__
+        const vfloat alphav = F2V(alpha);
+        const vfloat betav = F2V(beta);
+        vfloat ruv = ZEROV;
+        vfloat wuv = ZEROV;
+        vfloat rrv = ZEROV;
+        for (; i + 4 <= end; i += 4) {
+            const vfloat rOldv = LVFU(r[i]);
+            const vfloat wOldv = LVFU(w[i]);
+            const vfloat uOldv = Preconditioned ? LVFU(u[i]) : rOldv;
+
+            const vfloat zv = LVFU(n[i]) + betav * LVFU(z[i]);
+            const vfloat sv = wOldv + betav * LVFU(s[i]);
+            const vfloat pv = uOldv + betav * LVFU(p[i]);
+            STVFU(z[i], zv);
+            STVFU(s[i], sv);
+            STVFU(p[i], pv);
+            STVFU(xOut[i], LVFU(x[i]) + alphav * pv);
+
+            const vfloat rv = rOldv - alphav * sv;
+            const vfloat wv = wOldv - alphav * zv;
+            STVFU(r[i], rv);
+            STVFU(w[i], wv);
+            vfloat uv = rv;
+            if (Preconditioned) {
+                const vfloat qv = LVFU(m[i]) + betav * LVFU(q[i]);
+                STVFU(q[i], qv);
+                uv = uOldv - alphav * qv;
+                STVFU(u[i], uv);
+            }
+            ruv += rv * uv;
+            wuv += wv * uv;
+            rrv += rv * rv;
+        }
+        ruChunk = vhadd(ruv);
+        wuChunk = vhadd(wuv);
+        rrChunk = vhadd(rrv);
+#endif
+        for (; i < end; ++i) {
+            z[i] = n[i] + beta * z[i];
+            s[i] = w[i] + beta * s[i];
+            float uOld = r[i];
+            if (Preconditioned) {
+                q[i] = m[i] + beta * q[i];
+                uOld = u[i];
+            }
+            p[i] = uOld + beta * p[i];
+            xOut[i] = x[i] + alpha * p[i];
+            r[i] -= alpha * s[i];
+            w[i] -= alpha * z[i];
+            float uNew = r[i];
+            if (Preconditioned) {
+                uNew = u[i] = uOld - alpha * q[i];
+            }
+            ruChunk += r[i] * uNew;
+            wuChunk += w[i] * uNew;
+            rrChunk += r[i] * r[i];
+        }
+        ru += ruChunk;
+        wu += wuChunk;
+        rr += rrChunk;
+    }
 
-    float rdotr_curr;
-    float rdotr_prev;
-    float rdotr_best;
-    float alpha;
-    float beta;
+    CGDots dots = {ru, wu, rr};
+    return dots;
+}
 
+CGDots dotProducts(const float *r, const float *u, const float *w,
+                   const size_t size) {
+    double ru = 0.;
+    double wu = 0.;
+    double rr = 0.;
+#pragma omp parallel for reduction(+ : ru, wu, rr)
+    for (long i = 0; i < static_cast<long>(size); ++i) {
+        ru += r[i] * u[i];
+        wu += w[i] * u[i];
+        rr += r[i] * r[i];
+    }
+    CGDots dots = {ru, wu, rr};
+    return dots;
+}
+}
+
+// Pipelined conjugate gradients [Ghysels and Vanroose 2014]: the recurrences
+// of s = A p, q = M^-1 s, z = A q and of u = M^-1 r, w = A u let every
+// vector of an iteration be updated in a single pass, that also computes
+// the dot products needed by the next one. The stability check of the
+// previous implementation (restart from the best x when the residual grows)
+// is kept.
+LinCGResult lincg(PyramidT &pyramid, PyramidT &pC, const Array2Df &b,
+                  Array2Df &x, const int itmax, const float tol, Progress &ph,
+                  bool precondition) {
+#ifdef TIMER_PROFILING
+    msec_timer stop_watch;
+    stop_watch.start();
+#endif
     const size_t rows = pyramid.getRows();
     const size_t cols = pyramid.getCols();
     const size_t n = rows * cols;
     const float tol2 = tol * tol;
 
-    Array2Df x_best(cols, rows);
+    std::unique_ptr<MultigridPreconditioner> M;
+    if (precondition) {
+        M.reset(new MultigridPreconditioner(pC));
+    }
+
+    Array2Df xNext(cols, rows);
+    Array2Df xBest(cols, rows);
     Array2Df r(cols, rows);
+    Array2Df w(cols, rows);
     Array2Df p(cols, rows);
-    Array2Df Ap(cols, rows);
+    Array2Df s(cols, rows);
+    Array2Df z(cols, rows);
+    Array2Df An(cols, rows);
+    // u = M^-1 r, q = M^-1 s and m = M^-1 w, the same vectors as r, s and w
+    // without preconditioner
+    Array2Df uStore(precondition ? cols : 0, precondition ? rows : 0);
+    Array2Df qStore(precondition ? cols : 0, precondition ? rows : 0);
+    Array2Df mStore(precondition ? cols : 0, precondition ? rows : 0);
+    Array2Df &u = precondition ? uStore : r;
+    Array2Df &q = precondition ? qStore : s;
+    Array2Df &m = precondition ? mStore : w;
 
     // bnrm2 = ||b||
     const float bnrm2 = utils::dotProduct(b.data(), n);
 
-    // r = b - Ax
-    multiplyA(pyramid, pC, x, r);                  // r = A x
-    utils::vsub(b.data(), r.data(), r.data(), n);  // r = b - r
-
-    // rdotr = r.r
-    rdotr_best = rdotr_curr = utils::dotProduct(r.data(), n);
-
-    // Setup initial vector
-    std::copy(r.begin(), r.end(), p.begin());       // p = r
-    std::copy(x.begin(), x.end(), x_best.begin());  // x_best = x
+    // r = b - A x, u = M^-1 r, w = A u and the directions from scratch
+    const auto restart = [&]() {
+        multiplyA(pyramid, pC, x, r);
+        utils::vsub(b.data(), r.data(), r.data(), n);
+        if (M) M->apply(r, u);
+        multiplyA(pyramid, pC, u, w);
+        p.fill(0.f);
+        s.fill(0.f);
+        q.fill(0.f);
+        z.fill(0.f);
+        return dotProducts(r.data(), u.data(), w.data(), n);
+    };
+
+    CGDots dots = restart();
+    float rdotr_curr = dots.rr;
+    float rdotr_prev;
+    float rdotr_best = rdotr_curr;
+    std::copy(x.begin(), x.end(), xBest.begin());  // x_best = x
 
     const float irdotr = rdotr_curr;
     int phvalue = ph.value() + 8;
     const float percent_sf = (100.0f - phvalue) / std::log(tol2 * bnrm2 / irdotr);
 
+    float alpha = 0.f;
+    float rdotu_prev = 0.f;
+    bool first = true;
+
     int iter = 0;
     int num_backwards = 0;
     for (; iter < itmax; ++iter) {
-        // TEST
         ph.setValue(
             static_cast<int>(phvalue + std::max(std::log(rdotr_curr / irdotr) * percent_sf, 0.f)));
         // User requested abort
@@ -162,25 +311,37 @@ void lincg(PyramidT &pyramid, PyramidT &pC, const Array2Df &b, Array2Df &x,
             break;
         }
 
-        // Ap = A p
-        multiplyA(pyramid, pC, p, Ap);
-
-        // alpha = r.r / (p . Ap)
-        alpha = rdotr_curr / utils::dotProduct(p.data(), Ap.data(), n);
-
-        // r = r - alpha Ap
-        utils::vsubs(r.data(), alpha, Ap.data(), r.data(), n);
-
-        // rdotr = r.r
+        // m = M^-1 w, n = A m
+        if (M) M->apply(w, m);
+        multiplyA(pyramid, pC, m, An);
+
+        const float rdotu = dots.ru;
+        const float beta = first ? 0.f : rdotu / rdotu_prev;
+        alpha = first ? rdotu / dots.wu
+                      : rdotu / (dots.wu - beta * rdotu / alpha);
+        first = false;
+
+        dots = precondition
+                   ? fusedUpdate<true>(alpha, beta, n, x.data(), xNext.data(),
+                                       r.data(), u.data(), w.data(), p.data(),
+                                       s.data(), q.data(), z.data(), m.data(),
+                                       An.data())
+                   : fusedUpdate<false>(alpha, beta, n, x.data(),
+                                        xNext.data(), r.data(), u.data(),
+                                        w.data(), p.data(), s.data(), q.data(),
+                                        z.data(), m.data(), An.data());
+        // xNext keeps the previous x
+        x.swap(xNext);
+        rdotu_prev = rdotu;
         rdotr_prev = rdotr_curr;
-        rdotr_curr = utils::dotProduct(r.data(), n);
+        rdotr_curr = dots.rr;
 
         // Have we gone unstable?
         if (rdotr_curr > rdotr_prev) {
             // Save where we've got to
             if (num_backwards == 0 && rdotr_prev < rdotr_best) {
                 rdotr_best = rdotr_prev;
-                std::copy(x.begin(), x.end(), x_best.begin());
+                xBest.swap(xNext);
             }
 
             num_backwards++;
@@ -188,40 +349,27 @@ void lincg(PyramidT &pyramid, PyramidT &pC, const Array2Df &b, Array2Df &x,
             num_backwards = 0;
         }
 
-        // x = x + alpha * p
-        utils::vadds(x.data(), alpha, p.data(), x.data(), n);
-
         // Exit if we're done
-        // fprintf(stderr, "iter:%d err:%f\n", iter+1, sqrtf(rdotr/bnrm2));
         if (rdotr_curr / bnrm2 < tol2) break;
 
         if (num_backwards > NUM_BACKWARDS_CEILING) {
             // Reset
             num_backwards = 0;
-            std::copy(x_best.begin(), x_best.end(), x.begin());
-
-            // r = Ax
-            multiplyA(pyramid, pC, x, r);
-
-            // r = b - r
-            utils::vsub(b.data(), r.data(), r.data(), n);
-
-            // rdotr = r.r
-            rdotr_best = rdotr_curr = utils::dotProduct(r.data(), r.size());
-
-            // p = r
-            std::copy(r.begin(), r.end(), p.begin());
-        } else {
-            // p = r + beta * p
-            beta = rdotr_curr / rdotr_prev;
-            utils::vadds(r.data(), beta, p.data(), p.data(), n);
+            std::copy(xBest.begin(), xBest.end(), x.begin());
+            dots = restart();
+            rdotr_best = rdotr_curr = dots.rr;
+            first = true;
+        } else if ((iter + 1) % RESIDUAL_REPLACEMENT == 0) {
+            dots = restart();
+            rdotr_curr = dots.rr;
+            first = true;
         }
     }
 
     // Use the best version we found
     if (rdotr_curr > rdotr_best) {
         rdotr_curr = rdotr_best;
-        std::copy(x_best.begin(), x_best.end(), x.begin());
+        x.swap(xBest);
     }
 
     if (rdotr_curr / bnrm2 > tol2) {
@@ -242,6 +390,16 @@ void lincg(PyramidT &pyramid, PyramidT &pC, const Array2Df &b, Array2Df &x,
                       << tol << ")" << std::endl;
         }
     }
+
+#ifdef TIMER_PROFILING
+    stop_watch.stop_and_update();
+    cout << "lincg: " << iter << " iterations, "
+         << stop_watch.get_time() / std::max(iter, 1) << " msec/iteration"
+         << endl;
+#endif
+
+    LinCGResult result = {iter, std::sqrt(rdotr_curr / bnrm2)};
+    return result;
 }
 
 void transformToLuminance(PyramidT &pp, Array2Df &Y, const int itmax,
@@ -458,33 +616,50 @@ int tmo_mantiuk06_contmap(Array2Df &R, Array2Df &G, Array2Df &B, Array2Df &Y,
     normalizeLuminanceAndRGB(R, G, B, Y);
     ph.setValue(2);
 
-    // create pyramid
-    PyramidT pp(r, c);
-    ph.setValue(6);
+    // the solved luminance depends only on the normalized luminance and on
+    // the contrast parameters: changing saturationFactor reruns only
+    // denormalizeRGB
+    const TonemapStageKey key =
+        TonemapStageKey("mantiuk06.luminance",
+                        TonemapStageCache::fingerprint(Y))
+        << contrastFactor << detailfactor << static_cast<float>(itmax)
+        << tol;
+    TonemapStageCache &cache = TonemapStageCache::instance();
+    TonemapStageCache::Entry solved = cache.find(key);
+    if (solved) {
+        std::copy(solved->begin(), solved->end(), Y.begin());
+    } else {
+        // create pyramid
+        PyramidT pp(r, c);
+        ph.setValue(6);
 
-    // calculate gradients for pyramid (Y won't be changed)
-    pp.computeGradients(Y);
+        // calculate gradients for pyramid (Y won't be changed)
+        pp.computeGradients(Y);
 
-    // transform gradients to R
-    pp.transformToR(detailfactor);
-    ph.setValue(13);
+        // transform gradients to R
+        pp.transformToR(detailfactor);
+        ph.setValue(13);
 
-    // Contrast map
-    if (contrastFactor > 0.0f) {
-        // Contrast mapping
-        pp.scale(contrastFactor);
-    } else {
-        // Contrast equalization
-        contrastEqualization(pp, -contrastFactor);
-    }
+        // Contrast map
+        if (contrastFactor > 0.0f) {
+            // Contrast mapping
+            pp.scale(contrastFactor);
+        } else {
+            // Contrast equalization
+            contrastEqualization(pp, -contrastFactor);
+        }
 
-    // transform R to gradients
-    pp.transformToG(detailfactor);
-    ph.setValue(40);
+        // transform R to gradients
+        pp.transformToG(detailfactor);
+        ph.setValue(40);
 
-    // transform gradients to luminance Y (pp -> Y)
-    transformToLuminance(pp, Y, itmax, tol, ph);
-    denormalizeLuminance(Y);
+        // transform gradients to luminance Y (pp -> Y)
+        transformToLuminance(pp, Y, itmax, tol, ph);
+        if (ph.canceled()) return PFSTMO_ABORTED;
+
+        denormalizeLuminance(Y);
+        cache.insert(key, std::make_shared<const Array2Df>(Y));
+    }
     denormalizeRGB(R, G, B, Y, saturationFactor);
 
 #ifdef TIMER_PROFILING
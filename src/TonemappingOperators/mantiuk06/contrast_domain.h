@@ -40,6 +40,8 @@
 #include <Libpfs/array2d_fwd.h>
 #include "TonemappingOperators/pfstmo.h"
 
+class PyramidT;
+
 //! \brief: Tone mapping algorithm [Mantiuk2006]
 //!
 //! \param R red channel
@@ -61,4 +63,22 @@ int tmo_mantiuk06_contmap(pfs::Array2Df &R, pfs::Array2Df &G, pfs::Array2Df &B,
                           int itmax /*= 200*/, float tol /*= 1e-3*/,
                           pfs::Progress &ph);
 
+//! \brief convergence of lincg()
+struct LinCGResult {
+    int iterations;
+    //! \brief ||b - A x|| / ||b||
+    float residual;
+};
+
+//! \brief solve A x = b, A being the sum of the divergences of the
+//! gradients of x weighted by \a pC (see multiplyA())
+//!
+//! \param pyramid used as a buffer, overwritten
+//! \param x initial guess and solution
+//! \param precondition use a multigrid preconditioner: the iterations are
+//! more expensive, but much fewer
+LinCGResult lincg(PyramidT &pyramid, PyramidT &pC, const pfs::Array2Df &b,
+                  pfs::Array2Df &x, int itmax, float tol, pfs::Progress &ph,
+                  bool precondition = true);
+
 #endif
@@ -0,0 +1,355 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include "multigrid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace pfs;
+
+namespace {
+//! damping of the Jacobi smoother: the diagonal of the coarser terms
+//! underestimates them, 0.7 already diverges on some images
+const float SMOOTH_DAMPING = 0.5f;
+//! sweeps of the smoother before and after the coarse correction
+const int SMOOTH_SWEEPS = 1;
+//! sweeps solving the coarsest grid
+const int COARSE_SWEEPS = 32;
+//! pixels of a grid below which it is processed by one thread
+const int OMP_THRESHOLD = 65536;
+
+//! \brief one grid: weights of the edges towards right (gX) and bottom (gY)
+//! and the vector u they apply to
+struct Grid {
+    Grid(const PyramidS &weights, float *u_)
+        : cols(weights.getCols()),
+          rows(weights.getRows()),
+          w(weights.data()),
+          u(u_) {}
+
+    bool parallel() const { return cols * rows > OMP_THRESHOLD; }
+
+    // sum of the weighted neighbours of (x, y), and the sum of the weights
+    float neighbours(int x, int y, float &diagonal) const {
+        const int i = y * cols + x;
+        float sum = 0.f;
+        diagonal = 0.f;
+        if (x > 0) {
+            sum += w[i - 1].gX() * u[i - 1];
+            diagonal += w[i - 1].gX();
+        }
+        if (x + 1 < cols) {
+            sum += w[i].gX() * u[i + 1];
+            diagonal += w[i].gX();
+        }
+        if (y > 0) {
+            sum += w[i - cols].gY() * u[i - cols];
+            diagonal += w[i - cols].gY();
+        }
+        if (y + 1 < rows) {
+            sum += w[i].gY() * u[i + cols];
+            diagonal += w[i].gY();
+        }
+        return sum;
+    }
+
+    // sum of the weights around (x, y)
+    float weights(int x, int y) const {
+        const int i = y * cols + x;
+        float diagonal = 0.f;
+        if (x > 0) diagonal += w[i - 1].gX();
+        if (x + 1 < cols) diagonal += w[i].gX();
+        if (y > 0) diagonal += w[i - cols].gY();
+        if (y + 1 < rows) diagonal += w[i].gY();
+        return diagonal;
+    }
+
+    // out = scale * out + divergence of the weighted gradient of u
+    void addProduct(float *out, float scale = 1.f) const {
+#pragma omp parallel for if (parallel())
+        for (int y = 0; y < rows; ++y) {
+            const XYGradient *wRow = w + y * cols;
+            const float *uRow = u + y * cols;
+            float *o = out + y * cols;
+            for (int x = 0; x < cols; ++x) {
+                o[x] *= scale;
+            }
+            for (int x = 0; x + 1 < cols; ++x) {
+                const float flux = wRow[x].gX() * (uRow[x + 1] - uRow[x]);
+                o[x] += flux;
+                o[x + 1] -= flux;
+            }
+            if (y + 1 < rows) {
+                for (int x = 0; x < cols; ++x) {
+                    o[x] += wRow[x].gY() * (uRow[x + cols] - uRow[x]);
+                }
+            }
+            if (y > 0) {
+                const XYGradient *wUp = wRow - cols;
+                for (int x = 0; x < cols; ++x) {
+                    o[x] -= wUp[x].gY() * (uRow[x] - uRow[x - cols]);
+                }
+            }
+        }
+    }
+
+    // out += diagonal of the divergence of the weighted gradient
+    void addDiagonal(float *out) const {
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < cols; ++x) {
+                out[y * cols + x] -= weights(x, y);
+            }
+        }
+    }
+
+    // Gauss-Seidel on the pixels with (x + y) % 2 == color
+    void relax(const float *f, int color) {
+#pragma omp parallel for if (parallel())
+        for (int y = 0; y < rows; ++y) {
+            for (int x = (y + color) & 1; x < cols; x += 2) {
+                float diagonal;
+                const float sum = neighbours(x, y, diagonal);
+                if (diagonal > 0.f) {
+                    u[y * cols + x] = (sum - f[y * cols + x]) / diagonal;
+                }
+            }
+        }
+    }
+
+    int cols;
+    int rows;
+    const XYGradient *w;
+    float *u;
+};
+
+// pixel of the coarse grid of n pixels that aggregates pixel i, the last
+// one takes the odd pixel
+inline int aggregate(int i, int n) { return std::min(i / 2, n - 1); }
+}
+
+MultigridPreconditioner::MultigridPreconditioner(const PyramidT &pC)
+    : m_pC(pC),
+      m_weights(pC),
+      m_u(pC.numLevels()),
+      m_f(pC.numLevels()),
+      m_uData(pC.numLevels()),
+      m_fData(pC.numLevels()),
+      m_product(pC.numLevels()),
+      m_down(pC.numLevels()),
+      m_smoother(pC.numLevels()) {
+    if (pC.numLevels() == 0) {
+        return;
+    }
+    m_product[0] = Array2Df(pC.getCols(), pC.getRows());
+
+    PyramidT::const_iterator itC = pC.begin();
+    PyramidT::iterator itFine = m_weights.begin();
+    float scale = 1.f;
+    for (size_t k = 1; k < pC.numLevels(); ++k) {
+        ++itC;
+        const PyramidS &fine = *itFine;
+        PyramidS &coarse = *(++itFine);
+        const int cols = coarse.getCols();
+        const int rows = coarse.getRows();
+        // multiplyA() downsamples by averaging, the sums of the aggregates
+        // multiply the weights of the level by 4 each time
+        scale *= 4.f;
+
+#pragma omp parallel for
+        for (int j = 0; j < rows; ++j) {
+            const int yEnd = (j + 1 == rows) ? fine.getRows() : 2 * j + 2;
+            const int xEnd = fine.getCols();
+            for (int i = 0; i < cols; ++i) {
+                XYGradient &w = coarse(i, j);
+                w = (*itC)(i, j) * scale;
+                // edges between the aggregate (i, j) and the next ones
+                if (i + 1 < cols) {
+                    for (int y = 2 * j; y < yEnd; ++y) {
+                        w.gX() += fine(2 * i + 1, y).gX();
+                    }
+                }
+                if (j + 1 < rows) {
+                    const int iEnd = (i + 1 == cols) ? xEnd : 2 * i + 2;
+                    for (int x = 2 * i; x < iEnd; ++x) {
+                        w.gY() += fine(x, 2 * j + 1).gY();
+                    }
+                }
+            }
+        }
+
+        m_u[k] = Array2Df(cols, rows);
+        m_f[k] = Array2Df(cols, rows);
+        m_uData[k] = m_u[k].data();
+        m_fData[k] = m_f[k].data();
+        m_product[k] = Array2Df(cols, rows);
+        m_down[k] = Array2Df(cols, rows);
+    }
+
+    // diagonal of the operator of every grid: the diagonal of the terms of
+    // multiplyA() coarser than k is the diagonal of their level, a quarter
+    // of it for every upsampling
+    Array2Df coarser;
+    for (size_t k = pC.numLevels(); k-- > 0;) {
+        const PyramidS &weights = *(m_weights.begin() + k);
+        Array2Df diagonal(weights.getCols(), weights.getRows());
+        Array2Df terms(weights.getCols(), weights.getRows());
+        if (coarser.size() > 0) {
+            matrixUpsample(weights.getCols(), weights.getRows(),
+                           coarser.data(), terms.data());
+            const float s = std::ldexp(1.f, 2 * static_cast<int>(k) - 2);
+            for (size_t i = 0; i < terms.size(); ++i) {
+                diagonal(i) = s * terms(i);
+                terms(i) *= 0.25f;
+            }
+        } else {
+            diagonal.fill(0.f);
+            terms.fill(0.f);
+        }
+        Grid(weights, NULL).addDiagonal(diagonal.data());
+        Grid(*(pC.begin() + k), NULL).addDiagonal(terms.data());
+
+        // the coarsest grid is solved by Gauss-Seidel
+        if (k + 1 < pC.numLevels()) {
+            for (size_t i = 0; i < diagonal.size(); ++i) {
+                diagonal(i) =
+                    diagonal(i) < 0.f ? SMOOTH_DAMPING / diagonal(i) : 0.f;
+            }
+            m_smoother[k].swap(diagonal);
+        }
+        coarser.swap(terms);
+    }
+}
+
+void MultigridPreconditioner::apply(const Array2Df &r, Array2Df &z) {
+    assert(r.getCols() == m_weights.getCols());
+    assert(r.getRows() == m_weights.getRows());
+    assert(z.getCols() == r.getCols() && z.getRows() == r.getRows());
+
+    if (m_weights.numLevels() == 0) {
+        std::copy(r.begin(), r.end(), z.begin());
+        return;
+    }
+    // the smoother only reads r
+    m_uData[0] = z.data();
+    m_fData[0] = const_cast<float *>(r.data());
+    vcycle(0);
+}
+
+void MultigridPreconditioner::coarserTerms(size_t level, const float *x,
+                                           float *out) {
+    const PyramidS &fine = *(m_weights.begin() + level);
+    if (level + 1 == m_weights.numLevels()) {
+        std::fill(out, out + fine.size(), 0.f);
+        return;
+    }
+    const size_t next = level + 1;
+    matrixDownsample(fine.getCols(), fine.getRows(), x, m_down[next].data());
+    coarserTerms(next, m_down[next].data(), m_product[next].data());
+    Grid(*(m_pC.begin() + next), m_down[next].data())
+        .addProduct(m_product[next].data());
+    matrixUpsample(fine.getCols(), fine.getRows(), m_product[next].data(), out);
+}
+
+void MultigridPreconditioner::multiply(size_t level, float *out) {
+    Grid grid(*(m_weights.begin() + level), m_uData[level]);
+    coarserTerms(level, grid.u, out);
+    grid.addProduct(out, std::ldexp(1.f, 2 * static_cast<int>(level)));
+}
+
+void MultigridPreconditioner::vcycle(size_t level) {
+    Grid grid(*(m_weights.begin() + level), m_uData[level]);
+    const float *f = m_fData[level];
+    const int size = grid.cols * grid.rows;
+
+    if (level + 1 == m_weights.numLevels()) {
+        // the grid is singular (Neumann boundary): relax the part of f that
+        // has a solution (f of the first level belongs to the caller)
+        if (level > 0) {
+            double mean = 0.;
+            for (int i = 0; i < size; ++i) {
+                mean += f[i];
+            }
+            const float m = static_cast<float>(mean / size);
+            for (int i = 0; i < size; ++i) {
+                m_fData[level][i] -= m;
+            }
+        }
+        std::fill(grid.u, grid.u + size, 0.f);
+        for (int s = 0; s < COARSE_SWEEPS; ++s) {
+            grid.relax(f, s & 1);
+            grid.relax(f, !(s & 1));
+        }
+        return;
+    }
+
+    const float *smoother = m_smoother[level].data();
+    float *product = m_product[level].data();
+#pragma omp parallel for if (grid.parallel())
+    for (int i = 0; i < size; ++i) {
+        grid.u[i] = smoother[i] * f[i];
+    }
+    for (int s = 1; s < SMOOTH_SWEEPS; ++s) {
+        multiply(level, product);
+#pragma omp parallel for if (grid.parallel())
+        for (int i = 0; i < size; ++i) {
+            grid.u[i] += smoother[i] * (f[i] - product[i]);
+        }
+    }
+
+    // f of the coarse grid is the sum of the defect over each aggregate
+    multiply(level, product);
+    Grid coarse(*(m_weights.begin() + level + 1), m_uData[level + 1]);
+    float *coarseF = m_fData[level + 1];
+#pragma omp parallel for if (grid.parallel())
+    for (int j = 0; j < coarse.rows; ++j) {
+        float *fc = coarseF + j * coarse.cols;
+        std::fill(fc, fc + coarse.cols, 0.f);
+        const int yEnd = (j + 1 == coarse.rows) ? grid.rows : 2 * j + 2;
+        for (int y = 2 * j; y < yEnd; ++y) {
+            for (int x = 0; x < grid.cols; ++x) {
+                const int i = y * grid.cols + x;
+                fc[aggregate(x, coarse.cols)] += f[i] - product[i];
+            }
+        }
+    }
+
+    vcycle(level + 1);
+
+    // piecewise constant interpolation of the correction
+#pragma omp parallel for if (grid.parallel())
+    for (int y = 0; y < grid.rows; ++y) {
+        const float *uc =
+            coarse.u + aggregate(y, coarse.rows) * coarse.cols;
+        float *u = grid.u + y * grid.cols;
+        for (int x = 0; x < grid.cols; ++x) {
+            u[x] += uc[aggregate(x, coarse.cols)];
+        }
+    }
+
+    for (int s = 0; s < SMOOTH_SWEEPS; ++s) {
+        multiply(level, product);
+#pragma omp parallel for if (grid.parallel())
+        for (int i = 0; i < size; ++i) {
+            grid.u[i] += smoother[i] * (f[i] - product[i]);
+        }
+    }
+}
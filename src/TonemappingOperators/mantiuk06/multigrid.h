@@ -0,0 +1,81 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+//! \brief Multigrid preconditioner of the conjugate gradients of Mantiuk06
+
+#ifndef MANTIUK06_MULTIGRID_H
+#define MANTIUK06_MULTIGRID_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Libpfs/array2d.h"
+#include "pyramid.h"
+
+//! \brief one V-cycle approximating the inverse of multiplyA()
+//!
+//! multiplyA() sums, over the levels k of the pyramid, the divergence of the
+//! gradients weighted by pC(k) of the image downsampled k times, upsampled
+//! back. The grids of the V-cycle are the levels of the same \c PyramidT: a
+//! pixel of a coarse grid aggregates 2x2 pixels of the finer one.
+//! The operator of grid k is its Galerkin product with a piecewise constant
+//! interpolation: the weight of an edge is the sum of the weights of the finer
+//! grid across it, plus 4^k pC(k); the levels coarser than k are still those
+//! of multiplyA(), scaled by 4^k.
+//! The smoother is a damped Jacobi on the whole operator of the grid, the
+//! coarsest grid is solved by red-black Gauss-Seidel. The preconditioner is
+//! symmetric (up to the odd sizes of the levels) and can be used by cg.
+//! \note \a pC must outlive the preconditioner
+class MultigridPreconditioner {
+   public:
+    explicit MultigridPreconditioner(const PyramidT &pC);
+
+    //! \brief z = M^-1 r, \a z and \a r have the size of the first level
+    void apply(const pfs::Array2Df &r, pfs::Array2Df &z);
+
+   private:
+    void vcycle(size_t level);
+
+    //! \brief out = the terms of multiplyA() coarser than \a level, applied
+    //! to \a x of the size of \a level
+    void coarserTerms(size_t level, const float *x, float *out);
+
+    //! \brief out = operator of the grid of \a level applied to its u
+    void multiply(size_t level, float *out);
+
+    const PyramidT &m_pC;
+    //! \brief weights of the edges of every grid
+    PyramidT m_weights;
+    //! \brief correction and right hand side of every grid, the first one
+    //! uses the arrays of apply()
+    std::vector<pfs::Array2Df> m_u;
+    std::vector<pfs::Array2Df> m_f;
+    std::vector<float *> m_uData;
+    std::vector<float *> m_fData;
+    //! \brief product of the operator of every grid, also the product by
+    //! the coarser terms of the vectors of m_down
+    std::vector<pfs::Array2Df> m_product;
+    //! \brief downsampled vector of coarserTerms()
+    std::vector<pfs::Array2Df> m_down;
+    //! \brief damped inverse of the diagonal of every grid but the coarsest
+    std::vector<pfs::Array2Df> m_smoother;
+};
+
+#endif  // MANTIUK06_MULTIGRID_H
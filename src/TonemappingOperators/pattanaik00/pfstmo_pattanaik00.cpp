@@ -41,6 +41,7 @@
 #include "Libpfs/exception.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/progress.h"
+#include "Libpfs/utils/statistics.h"
 
 namespace {
 void multiplyChannels(pfs::Array2Df &X, pfs::Array2Df &Y, pfs::Array2Df &Z,
@@ -80,6 +81,13 @@ void pfstmo_pattanaik00(pfs::Frame &frame, bool local, float multiplier,
 
     std::unique_ptr<VisualAdaptationModel> am(new VisualAdaptationModel());
 
+    // the adaptation to the unscaled luminance comes from the statistics
+    // cached by the frame: take them before the channels, that drops them
+    std::shared_ptr<const pfs::utils::ChannelStatistics> stats;
+    if (!local && !timedependence && autolum && multiplier == 1.0f) {
+        stats = static_cast<const pfs::Frame &>(frame).getStatistics("Y");
+    }
+
     pfs::Channel *X, *Y, *Z;
     frame.getXYZChannels(X, Y, Z);
     //---
@@ -98,6 +106,8 @@ void pfstmo_pattanaik00(pfs::Frame &frame, bool local, float multiplier,
         if (!timedependence) {
             if (!autolum)
                 am->setAdaptation(Acone, Arod);
+            else if (stats)
+                am->setAdaptation(*stats);
             else
                 am->setAdaptation(*Y);
         } else
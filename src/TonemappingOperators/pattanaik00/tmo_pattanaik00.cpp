@@ -39,6 +39,7 @@
 #include "Libpfs/pfs.h"
 #include "Libpfs/progress.h"
 #include "Libpfs/utils/msec_timer.h"
+#include "Libpfs/utils/statistics.h"
 #include "TonemappingOperators/pfstmo.h"
 #include "../../sleef.c"
 #include "../../opthelper.h"
@@ -502,6 +503,12 @@ void VisualAdaptationModel::setAdaptation(const pfs::Array2Df &Y) {
     setAdaptation(Acone, Acone);
 }
 
+void VisualAdaptationModel::setAdaptation(
+    const pfs::utils::ChannelStatistics &stats) {
+    float Acone = (stats.getLogAverage() - 1e-4f) * 5.0f;
+    setAdaptation(Acone, Acone);
+}
+
 float VisualAdaptationModel::calculateLogAvgLuminance(const pfs::Array2Df &Y) {
 
     float avLum = 0.0f;
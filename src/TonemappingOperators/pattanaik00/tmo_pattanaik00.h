@@ -39,6 +39,9 @@
 namespace pfs {
 // class Frame;
 class Progress;
+namespace utils {
+class ChannelStatistics;
+}
 }
 
 class VisualAdaptationModel;
@@ -110,6 +113,11 @@ class VisualAdaptationModel {
     //! \param Y luminance map of HDR image
     void setAdaptation(const pfs::Array2Df &Y);
 
+    //! @brief Set adaptation level appropriate for a lumiance map, from its
+    //! statistics
+    //! \param stats statistics of the luminance map of HDR image
+    void setAdaptation(const pfs::utils::ChannelStatistics &stats);
+
     //! Get cone adaptation level
     float getAcone() const { return Acone; }
 
@@ -77,6 +77,7 @@
 #define REINHARD02_RANGE 8
 #define REINHARD02_LOWER 1
 #define REINHARD02_UPPER 43
+#define REINHARD02_FFT_CONVOLUTION true
 
 // Reinhard 05
 #define REINHARD05_BRIGHTNESS -10.0f
@@ -72,7 +72,8 @@ void pfstmo_pattanaik00(pfs::Frame &frame, bool local, float multiplier,
                         float Acone, float Arod, bool autolum,
                         pfs::Progress &ph);
 void pfstmo_reinhard02(pfs::Frame &frame, float key, float phi, int num,
-                       int low, int high, bool use_scales, pfs::Progress &ph);
+                       int low, int high, bool use_scales,
+                       bool fft_convolution, pfs::Progress &ph);
 void pfstmo_reinhard05(pfs::Frame &frame, float brightness,
                        float chromaticadaptation, float lightadaptation,
                        pfs::Progress &ph);
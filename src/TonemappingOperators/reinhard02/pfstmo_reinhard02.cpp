@@ -42,7 +42,8 @@
 #include "../../opthelper.h"
 
 void pfstmo_reinhard02(pfs::Frame &frame, float key, float phi, int num,
-                       int low, int high, bool use_scales, pfs::Progress &ph) {
+                       int low, int high, bool use_scales,
+                       bool fft_convolution, pfs::Progress &ph) {
 
     //--- default tone mapping parameters;
     // float key = 0.18;
@@ -51,6 +52,7 @@ void pfstmo_reinhard02(pfs::Frame &frame, float key, float phi, int num,
     // int low = 1;
     // int high = 43;
     // bool use_scales = false;
+    // bool fft_convolution = true;
     bool temporal_coherent = false;
 #ifndef NDEBUG
     std::cout << "pfstmo_reinhard02 (";
@@ -59,7 +61,8 @@ void pfstmo_reinhard02(pfs::Frame &frame, float key, float phi, int num,
     std::cout << ", range: " << num;
     std::cout << ", lower scale: " << low;
     std::cout << ", upper scale: " << high;
-    std::cout << ", use scales: " << use_scales << ")" << std::endl;
+    std::cout << ", use scales: " << use_scales;
+    std::cout << ", fft convolution: " << fft_convolution << ")" << std::endl;
 #endif
 
     ph.setValue(0);
@@ -79,7 +82,7 @@ void pfstmo_reinhard02(pfs::Frame &frame, float key, float phi, int num,
     pfs::Array2Df L(w, h);
 
     Reinhard02 tmoperator(Y, &L, use_scales, key, phi, num, low, high,
-                          temporal_coherent, ph);
+                          temporal_coherent, ph, fft_convolution);
 
     try {
         tmoperator.tmo_reinhard02();
@@ -41,6 +41,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 #include <arch/math.h>
 
 #include "tmo_reinhard02.h"
@@ -49,11 +50,13 @@
 #include <Libpfs/array2d.h>
 #include <Libpfs/array2d_fwd.h>
 #include <Libpfs/progress.h>
+#include <Libpfs/tm/TonemapStageCache.h>
 #include <Libpfs/utils/msec_timer.h>
 #include <TonemappingOperators/pfstmo.h>
 #include "Common/LuminanceOptions.h"
 #include "../../sleef.c"
 #include "../../opthelper.h"
+#include "../../lhdr_gauss.h"
 #ifdef TIMER_PROFILING
 #define BENCHMARK
 #endif
@@ -81,7 +84,7 @@ static CVTS      cvts             = {0, 0};
 static bool temporal_coherent;
 */
 #define pow_F(a,b) (xexpf(b*xlogf(a)))
-#define V1(x, y, i) (m_convolved_image[i][y][x])
+#define V1(x, y, i) ((*m_convolved_image)(x, (i) * m_cvts.ymax + (y)))
 
 #define SIGMA_I(i) \
     (m_sigma_0 + ((float)i / (float)m_range) * (m_sigma_1 - m_sigma_0))
@@ -234,7 +237,8 @@ void Reinhard02::build_image_fft() {
     FFTW_MUTEX::fftw_mutex_destroy_plan.unlock();
 }
 
-void Reinhard02::convolve_filter(int scale, fftwf_complex *convolution_fft) {
+void Reinhard02::convolve_filter(int scale, fftwf_complex *convolution_fft,
+                                 pfs::Array2Df &convolved_image) {
 
     fftwf_plan p;
     FFTW_MUTEX::fftw_mutex_plan.lock();
@@ -273,29 +277,157 @@ void Reinhard02::convolve_filter(int scale, fftwf_complex *convolution_fft) {
 #pragma omp parallel for
     for (size_t y = 0; y < m_cvts.ymax; y++)
         for (size_t x = 0, i = y * m_cvts.xmax; x < m_cvts.xmax; x++, i++)
-            m_convolved_image[scale][y][x] = m_convolution_fft[i][0];
+            convolved_image(x, scale * m_cvts.ymax + y) = convolution_fft[i][0];
 }
 
-void Reinhard02::compute_fourier_convolution() {
+void Reinhard02::allocate_fft() {
+    const size_t length = m_cvts.xmax * m_cvts.ymax;
 
-    // activate parallel execution of fft routines
-    init_fftw();
-    //initialise_fft(m_cvts.xmax, m_cvts.ymax);
-    build_image_fft();
+    FFTW_MUTEX::fftw_mutex_alloc.lock();
+    m_image_fft = (fftwf_complex *)fftwf_alloc_complex(length);
+    m_filter_fft = (fftwf_complex **)fftwf_alloc_complex(m_range);
+    for (int scale = 0; scale < m_range; scale++) {
+        m_filter_fft[scale] = (fftwf_complex *)fftwf_alloc_complex(length);
+    }
+    m_convolution_fft = (fftwf_complex *)fftwf_alloc_complex(length);
+    FFTW_MUTEX::fftw_mutex_alloc.unlock();
+}
 
-    build_gaussian_fft();
+void Reinhard02::free_fft() {
+    if (m_image_fft == nullptr) return;
 
+    FFTW_MUTEX::fftw_mutex_free.lock();
     for (int scale = 0; scale < m_range; scale++) {
+        fftwf_free(m_filter_fft[scale]);
+    }
+    fftwf_free(m_filter_fft);
+    fftwf_free(m_convolution_fft);
+    fftwf_free(m_image_fft);
+    FFTW_MUTEX::fftw_mutex_free.unlock();
+
+    m_filter_fft = nullptr;
+    m_convolution_fft = nullptr;
+    m_image_fft = nullptr;
+}
+
+// The convolved images depend only on the image scaled to the midtone and on
+// the scales: they are kept in the stage cache, so that changing phi reruns
+// only tonemap_image(). The FFTs are allocated only when they are computed.
+bool Reinhard02::compute_fourier_convolution() {
+    const TonemapStageKey scalesKey =
+        TonemapStageKey("reinhard02.scales",
+                        TonemapStageCache::fingerprint(*m_Y))
+        << m_key << static_cast<float>(m_range)
+        << static_cast<float>(m_scale_low)
+        << static_cast<float>(m_scale_high);
+
+    m_convolved_image =
+        TonemapStageCache::instance().getOrCompute(scalesKey, [this]() {
+            std::shared_ptr<pfs::Array2Df> convolved_image =
+                std::make_shared<pfs::Array2Df>(m_cvts.xmax,
+                                                m_cvts.ymax * m_range);
+
+            allocate_fft();
+            // activate parallel execution of fft routines
+            init_fftw();
+            //initialise_fft(m_cvts.xmax, m_cvts.ymax);
+            build_image_fft();
+
+            build_gaussian_fft();
+
+            for (int scale = 0; scale < m_range && !m_ph.canceled();
+                 scale++) {
 #ifndef NDEBUG
-            fprintf(stderr, "Computing convolved image at scale %i%c", scale,
-                    (char)13);
+                fprintf(stderr, "Computing convolved image at scale %i%c",
+                        scale, (char)13);
 #endif
-        m_ph.setValue(70 + 28 * scale / m_range);
-        convolve_filter(scale, m_convolution_fft);
-    }
+                m_ph.setValue(70 + 28 * scale / m_range);
+                convolve_filter(scale, m_convolution_fft, *convolved_image);
+            }
 #ifndef NDEBUG
-    fprintf(stderr, "\n");
+            fprintf(stderr, "\n");
 #endif
+            free_fft();
+
+            return m_ph.canceled()
+                       ? TonemapStageCache::Entry()
+                       : TonemapStageCache::Entry(convolved_image);
+        });
+    return static_cast<bool>(m_convolved_image);
+}
+
+//
+// Recursive Gaussian functions
+//
+
+// Standard deviation of the Gaussian profile used by gaussian_filter at a
+// given scale: exp(-x^2 / (k s)^2) has sigma = k s / sqrt(2)
+float Reinhard02::scale_sigma(int scale) const {
+    return m_k * S_I(scale) * boost::math::float_constants::one_div_root_two;
+}
+
+// Local operator on top of the recursive Gaussian in lhdr_gauss.h.
+// Scales are computed one after the other and only V1 and V2 of the current
+// scale are kept in memory: once the activity of a pixel exceeds the
+// threshold its adaptation luminance is stored and the pixel is not
+// considered anymore. Borders are replicated instead of wrapped around.
+void Reinhard02::tonemap_image_recursive() {
+    const int W = m_cvts.xmax;
+    const int H = m_cvts.ymax;
+    const size_t length = m_cvts.xmax * m_cvts.ymax;
+
+    pfs::Array2Df center(W, H);
+    pfs::Array2Df surround(W, H);
+    pfs::Array2Df adaptation(W, H);
+    std::vector<unsigned char> selected(length, 0);
+
+    std::vector<float *> v1Rows(H);
+    std::vector<float *> v2Rows(H);
+    for (int y = 0; y < H; y++) {
+        v1Rows[y] = center.data() + y * W;
+        v2Rows[y] = surround.data() + y * W;
+    }
+    float **v1 = v1Rows.data();
+    float **v2 = v2Rows.data();
+
+#pragma omp parallel
+    gaussianBlur(m_image, v1, W, H, scale_sigma(0));
+
+    size_t remaining = length;
+    for (int scale = 0; scale < m_range - 1 && remaining > 0; scale++) {
+        m_ph.setValue(30 + 68 * scale / m_range);
+        if (m_ph.canceled()) return;
+
+#pragma omp parallel
+        gaussianBlur(m_image, v2, W, H, scale_sigma(scale + 1));
+
+        const float norm = (m_key * m_twopowphi) / lhdrengine::SQR(S_I(scale));
+        size_t found = 0;
+#pragma omp parallel for reduction(+:found)
+        for (int y = 0; y < H; y++) {
+            for (int x = 0, i = y * W; x < W; x++, i++) {
+                if (selected[i]) continue;
+                const float activity = (v1[y][x] - v2[y][x]) / (norm + v1[y][x]);
+                if (fabs(activity) > m_threshold) {
+                    adaptation(i) = v1[y][x];
+                    selected[i] = 1;
+                    found++;
+                }
+            }
+        }
+        remaining -= found;
+
+        std::swap(v1, v2);
+    }
+
+    // pixels below the threshold at every scale adapt to the largest one
+#pragma omp parallel for
+    for (int y = 0; y < H; y++) {
+        for (int x = 0, i = y * W; x < W; x++, i++) {
+            const float v = selected[i] ? adaptation(i) : v1[y][x];
+            m_image[y][x] /= 1.f + v;
+        }
+    }
 }
 
 //
@@ -426,7 +558,8 @@ void Reinhard02::scale_to_midtone() {
 
 Reinhard02::Reinhard02(const pfs::Array2Df *Y, pfs::Array2Df *L,
                        bool use_scales, float key, float phi, int num, int low,
-                       int high, bool temporal_coherent, pfs::Progress &ph)
+                       int high, bool temporal_coherent, pfs::Progress &ph,
+                       bool fft_convolution)
     : m_cvts(CVTS()),
       m_sigma_0(0),
       m_sigma_1(0),
@@ -436,6 +569,7 @@ Reinhard02::Reinhard02(const pfs::Array2Df *Y, pfs::Array2Df *L,
       m_L(L),
       m_use_scales(use_scales),
       m_use_border(false),
+      m_fft_convolution(fft_convolution),
       m_key(key),
       m_twopowphi(pow(2.f,phi)),
       m_white(1e20),
@@ -446,14 +580,15 @@ Reinhard02::Reinhard02(const pfs::Array2Df *Y, pfs::Array2Df *L,
       m_bbeta(0.f),
       m_threshold(0.05f),
       m_k(1.f / (2.f * 1.4142136f)),
-      m_ph(ph)
+      m_ph(ph),
+      m_filter_fft(nullptr),
+      m_image_fft(nullptr),
+      m_convolution_fft(nullptr)
 {
 
     m_cvts.xmax = m_Y->getCols();
     m_cvts.ymax = m_Y->getRows();
 
-    int length = m_cvts.xmax * m_cvts.ymax;
-
     m_sigma_0 = logf(m_scale_low);
     m_sigma_1 = logf(m_scale_high);
 
@@ -463,40 +598,11 @@ Reinhard02::Reinhard02(const pfs::Array2Df *Y, pfs::Array2Df *L,
     for (size_t y = 0; y < m_cvts.ymax; y++) {
         m_image[y] = &(*m_L)(0,y);
     }
-    if (use_scales) {
-        m_convolved_image = (float ***)malloc(m_range * sizeof(float **));
-        FFTW_MUTEX::fftw_mutex_alloc.lock();
-        m_image_fft = (fftwf_complex *)fftwf_alloc_complex(length);
-        m_filter_fft = (fftwf_complex **)fftwf_alloc_complex(m_range);
-        for (int scale = 0; scale < m_range; scale++) {
-            m_filter_fft[scale] = (fftwf_complex *)fftwf_alloc_complex(length);
-            m_convolved_image[scale] = (float **)malloc(m_cvts.ymax * sizeof(float *));
-            m_convolved_image[scale][0] = (float *)malloc(length * sizeof(float));
-            for (size_t y = 1; y < m_cvts.ymax; y++)
-                m_convolved_image[scale][y] = m_convolved_image[scale][0] + y * m_cvts.xmax;
-        }
-        m_convolution_fft = (fftwf_complex *)fftwf_alloc_complex(m_cvts.xmax * m_cvts.ymax);
-        FFTW_MUTEX::fftw_mutex_alloc.unlock();
-    }
 }
 
 Reinhard02::~Reinhard02() {
     free(m_image);
-    if (m_use_scales) {
-        FFTW_MUTEX::fftw_mutex_free.lock();
-        for (int scale = 0; scale < m_range; scale++) {
-            fftwf_free(m_filter_fft[scale]);
-        }
-        fftwf_free(m_filter_fft);
-        fftwf_free(m_convolution_fft);
-        fftwf_free(m_image_fft);
-        FFTW_MUTEX::fftw_mutex_free.unlock();
-        for (int scale = 0; scale < m_range; scale++) {
-            free(m_convolved_image[scale][0]);
-            free(m_convolved_image[scale]);
-        }
-        free(m_convolved_image);
-    }
+    free_fft();
 }
 
 void Reinhard02::tmo_reinhard02() {
@@ -521,11 +627,13 @@ void Reinhard02::tmo_reinhard02() {
     m_ph.setValue(30);
     if (m_ph.canceled()) goto end;
 
-    if (m_use_scales) {
-        compute_fourier_convolution();
-    }
+    if (m_use_scales && !m_fft_convolution) {
+        tonemap_image_recursive();
+    } else {
+        if (m_use_scales && !compute_fourier_convolution()) goto end;
 
-    tonemap_image();
+        tonemap_image();
+    }
 
     m_ph.setValue(99);
 
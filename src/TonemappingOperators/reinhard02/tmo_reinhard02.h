@@ -34,6 +34,8 @@
 
 #include <fftw3.h>
 
+#include <memory>
+
 #include <Libpfs/array2d_fwd.h>
 
 namespace pfs {
@@ -60,12 +62,16 @@ typedef float COLOR[3]; /* red, green, blue (or X,Y,Z) */
  * @param num number of scales to use in computation (default: 8)
  * @param low size in pixels of smallest scale (should be kept at 1)
  * @param high size in pixels of largest scale (default 1.6^8 = 43)
+ * @param fft_convolution true: compute the scales through FFT convolution,
+ *        false: use recursive Gaussian filtering, which keeps only two scales
+ *        in memory at any time
  */
 class Reinhard02 {
    public:
     Reinhard02(const pfs::Array2Df *Y, pfs::Array2Df *L, bool use_scales,
                float key, float phi, int num, int low, int high,
-               bool temporal_coherent, pfs::Progress &ph);
+               bool temporal_coherent, pfs::Progress &ph,
+               bool fft_convolution = true);
 
     ~Reinhard02();
 
@@ -80,6 +86,7 @@ class Reinhard02 {
     pfs::Array2Df *m_L;
     bool m_use_scales;
     bool m_use_border;
+    bool m_fft_convolution;
     float m_key, m_twopowphi, m_white;
     int m_range, m_scale_low, m_scale_high;
     const float m_alpha;
@@ -91,7 +98,8 @@ class Reinhard02 {
     fftwf_complex **m_filter_fft;
     fftwf_complex *m_image_fft;
     fftwf_complex *m_convolution_fft;
-    float ***m_convolved_image;
+    //! convolved images of all the scales, one below the other
+    std::shared_ptr<const pfs::Array2Df> m_convolved_image;
 
     float bessel(float);
     float kaiserbessel(float, float, float);
@@ -102,7 +110,11 @@ class Reinhard02 {
     void gaussian_filter(fftwf_complex *, float, float) const;
     void build_gaussian_fft();
     void build_image_fft();
-    void convolve_filter(int, fftwf_complex *);
-    void compute_fourier_convolution();
+    void convolve_filter(int, fftwf_complex *, pfs::Array2Df &);
+    void allocate_fft();
+    void free_fft();
+    bool compute_fourier_convolution();
+    float scale_sigma(int) const;
+    void tonemap_image_recursive();
 };
 #endif // TMO_REINHARD02_H
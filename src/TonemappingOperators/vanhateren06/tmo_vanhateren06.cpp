@@ -29,22 +29,112 @@
 
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
 #include <iostream>
-#include <gsl/gsl_poly.h>
+#include <limits>
+#include <memory>
 
 #include "Libpfs/array2d.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/progress.h"
+#include "Libpfs/tm/TonemapStageCache.h"
 #include "Libpfs/utils/msec_timer.h"
 #include "Libpfs/utils/clamp.h"
 #include <Libpfs/colorspace/normalizer.h>
 #include "lhdr_math.h"
+#include "opthelper.h"
 #include "tmo_vanhateren06.h"
 
 using namespace pfs;
 using namespace pfs::colorspace;
 using namespace std;
 
+namespace {
+constexpr int lutSize = 65536;
+//! bins of the lookup table solved by a thread from a fresh seed
+constexpr int lutBlock = 1024;
+constexpr int maxIterations = 64;
+
+// The table inverts a_C x^5 + x^4 = K, K > 0, for its largest real root, the
+// positive one. For x > 0 the polynomial is increasing and convex: Newton
+// started at the right of the root decreases monotonically towards it, and
+// the root of a bin, whose K is smaller, is below the root of the previous.
+
+//! \brief starting point of Newton at the right of the root
+template <typename T>
+T upperBound(T K, T a_C) {
+    if (K <= T(0)) return T(0);
+    return std::min(std::pow(K, T(0.25)), std::pow(K / a_C, T(0.2)));
+}
+
+//! \brief refine \a x, not below the root, to the root of a_C x^5 + x^4 = K
+template <typename T>
+T newtonRoot(T K, T a_C, T x, T tolerance) {
+    for (int it = 0; it < maxIterations; ++it) {
+        const T x3 = x * x * x;
+        const T df = x3 * (T(4) + T(5) * a_C * x);
+        if (!(df > T(0))) break;
+        const T next = std::max(x - (x3 * x * (T(1) + a_C * x) - K) / df, T(0));
+        const T delta = x - next;
+        x = next;
+        if (delta <= tolerance * x) break;
+    }
+    return x;
+}
+
+//! \brief lookup[i] = root of a_C x^5 + x^4 + minVal + lutscale i = 0, the
+//! bins of a block are seeded by the roots of the previous ones
+void buildLookup(float *lookup, float minVal, float lutscale, float a_C) {
+    const float tolerance = 4.f * std::numeric_limits<float>::epsilon();
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int block = 0; block < lutSize; block += lutBlock) {
+        const int blockEnd = block + lutBlock;
+        int i = block;
+#ifdef __SSE2__
+        // four consecutive bins per vector, seeded by the four bins before
+        const vfloat minValv = F2V(minVal);
+        const vfloat lutscalev = F2V(lutscale);
+        const vfloat offsetv = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+        const vfloat a_Cv = F2V(a_C);
+        const vfloat onev = F2V(1.f);
+        const vfloat fourv = F2V(4.f);
+        const vfloat fivev = F2V(5.f);
+        const vfloat tinyv = F2V(std::numeric_limits<float>::min());
+        const vfloat tolerancev = F2V(tolerance);
+        vfloat xv = _mm_set_ps(upperBound(-(minVal + lutscale * (i + 3)), a_C),
+                               upperBound(-(minVal + lutscale * (i + 2)), a_C),
+                               upperBound(-(minVal + lutscale * (i + 1)), a_C),
+                               upperBound(-(minVal + lutscale * i), a_C));
+        for (; i < blockEnd; i += 4) {
+            const vfloat Kv =
+                ZEROV - (minValv + lutscalev * (F2V(i) + offsetv));
+            for (int it = 0; it < maxIterations; ++it) {
+                const vfloat x3v = xv * xv * xv;
+                const vfloat fv = x3v * xv * (onev + a_Cv * xv) - Kv;
+                const vfloat dfv = x3v * (fourv + fivev * a_Cv * xv);
+                // K <= 0 has no positive root, x stays at 0
+                const vfloat nextv = vmaxf(xv - fv / vmaxf(dfv, tinyv), ZEROV);
+                const vfloat deltav = xv - nextv;
+                xv = nextv;
+                if (!_mm_movemask_ps(_mm_cmpgt_ps(deltav, tolerancev * xv))) {
+                    break;
+                }
+            }
+            STVFU(lookup[i], xv);
+        }
+#endif
+        float x = i < blockEnd ? upperBound(-(minVal + lutscale * i), a_C) : 0.f;
+        for (; i < blockEnd; ++i) {
+            x = newtonRoot(-(minVal + lutscale * i), a_C, x, tolerance);
+            lookup[i] = x;
+        }
+    }
+}
+}  // anonymous
+
 int tmo_vanhateren06(Array2Df &L, float pupil_area, Progress &ph) {
 #ifdef TIMER_PROFILING
     msec_timer stop_watch;
@@ -64,20 +154,13 @@ int tmo_vanhateren06(Array2Df &L, float pupil_area, Progress &ph) {
     const float C_beta = 2.8e-3; // 1/ms
 
     //Calculate Ios,max
-    double polIosMax[] = {-1.0/C_beta, 0.0, 0.0, 0.0, 1.0, a_C};
-    gsl_poly_complex_workspace* ws = gsl_poly_complex_workspace_alloc(6);
-    double roots[10];
-    gsl_poly_complex_solve(polIosMax, 6, ws, roots);
-    gsl_poly_complex_workspace_free(ws);
-
-    for (int i = 0; i < 10 ; i += 2) {
-        roots[i>>1] = roots[i];
-    }
-
-    const float maxIos = (float) *max_element(roots, roots + 5);
+    const double K_IosMax = 1.0 / C_beta;
+    const float maxIos = (float) newtonRoot<double>(
+        K_IosMax, a_C, upperBound<double>(K_IosMax, a_C),
+        4.0 * std::numeric_limits<double>::epsilon());
 
     float minVal = std::numeric_limits<float>::max();
-    float maxVal = std::numeric_limits<float>::min();
+    float maxVal = std::numeric_limits<float>::lowest();
 
 #ifdef _OPENMP
     #pragma omp parallel for reduction(min:minVal) reduction(max:maxVal)
@@ -91,34 +174,23 @@ int tmo_vanhateren06(Array2Df &L, float pupil_area, Progress &ph) {
 
     ph.setValue(33);
 
-    constexpr int lutSize = 65536;
     const float scale = (lutSize - 1) / (maxVal - minVal);
 
-    float lookup[lutSize];
-
     const float lutscale = (maxVal - minVal) / (lutSize - 1);
 
-#ifdef _OPENMP
-    #pragma omp parallel
-#endif
-    {
-        gsl_poly_complex_workspace* wsp = gsl_poly_complex_workspace_alloc(6);
-        double base[] = {0.0, 0.0, 0.0, 0.0, 1.0, a_C};
-        double roots[10];
-#ifdef _OPENMP
-        #pragma omp for nowait
-#endif
-        for (size_t i = 0; i < lutSize; ++i) {
-            base[0] = minVal + lutscale * i;
-            gsl_poly_complex_solve (base, 6, wsp, roots);
-            double maxRoot = roots[0];
-            for (int k = 2; k < 10; k += 2) {
-                maxRoot = std::max(maxRoot, roots[k]);
-            }
-            lookup[i] = maxRoot;
-        }
-        gsl_poly_complex_workspace_free (wsp);
-    }
+    // the table depends only on the range of the values, pupil_area
+    // included: reruns on the same image, or one with the same extremes,
+    // reuse it
+    const TonemapStageKey lutKey =
+        TonemapStageKey("vanhateren06.lut", 0) << minVal << maxVal;
+    TonemapStageCache::Entry lut =
+        TonemapStageCache::instance().getOrCompute(lutKey, [&]() {
+            std::shared_ptr<pfs::Array2Df> out =
+                std::make_shared<pfs::Array2Df>(lutSize, 1);
+            buildLookup(out->data(), minVal, lutscale, a_C);
+            return TonemapStageCache::Entry(out);
+        });
+    const float *lookup = lut->data();
 
     ph.setValue(66);
 
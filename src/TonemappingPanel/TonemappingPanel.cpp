@@ -216,6 +216,8 @@ TonemappingPanel::TonemappingPanel(int mainWinNumber, PreviewPanel *panel,
     upperGang = new Gang(m_Ui->upperSlider, m_Ui->upperdsb, nullptr, nullptr, nullptr,
                          nullptr, 1.f, 100.f, REINHARD02_UPPER);
     usescalesGang = new Gang(nullptr, nullptr, m_Ui->usescalescheckbox);
+    fftconvolutionGang =
+        new Gang(nullptr, nullptr, m_Ui->fftconvolutioncheckbox);
 
     // reinhard05
     brightnessGang =
@@ -360,6 +362,7 @@ TonemappingPanel::~TonemappingPanel() {
     delete lowerGang;
     delete upperGang;
     delete usescalesGang;
+    delete fftconvolutionGang;
     delete brightnessGang;
     delete chromaticGang;
     delete lightGang;
@@ -556,7 +559,8 @@ void TonemappingPanel::createDatabase() {
     res = query.exec(
         QStringLiteral(" CREATE TABLE IF NOT EXISTS reinhard02 (scales boolean \
                        NOT nullptr, key real, phi real, range int, lower int, \
-                       upper int, pregamma real, comment varchar(150), postsaturation real, postgamma real);"));
+                       upper int, pregamma real, comment varchar(150), postsaturation real, postgamma real, \
+                       fftconvolution boolean NOT nullptr DEFAULT 1);"));
     if (res == false) qDebug() << query.lastError();
 
     res = query.exec(QStringLiteral(
@@ -567,6 +571,12 @@ void TonemappingPanel::createDatabase() {
         res = query.exec(QStringLiteral(
                 " ALTER TABLE reinhard02 ADD COLUMN postgamma real NOT nullptr DEFAULT 1;"));
     }
+    res = query.exec(QStringLiteral(
+                " SELECT fftconvolution FROM reinhard02; "));
+    if (res == false) {
+        res = query.exec(QStringLiteral(
+                " ALTER TABLE reinhard02 ADD COLUMN fftconvolution boolean NOT nullptr DEFAULT 1;"));
+    }
     // Reinhard05
     res = query.exec(QStringLiteral(
         " CREATE TABLE IF NOT EXISTS reinhard05 (brightness real, \
@@ -686,6 +696,8 @@ void TonemappingPanel::on_defaultButton_clicked() {
             lowerGang->setDefault();
             upperGang->setDefault();
             m_Ui->usescalescheckbox->setChecked(false);
+            m_Ui->fftconvolutioncheckbox->setChecked(
+                REINHARD02_FFT_CONVOLUTION);
             break;
         case reinhard05:
             brightnessGang->setDefault();
@@ -906,6 +918,8 @@ void TonemappingPanel::fillToneMappingOptions(bool exportMode) {
                 (int)lowerGang->v();
             m_toneMappingOptions->operator_options.reinhard02options.upper =
                 (int)upperGang->v();
+            m_toneMappingOptions->operator_options.reinhard02options
+                .fftconvolution = fftconvolutionGang->isCheckBox1Checked();
             break;
         case reinhard05:
             m_toneMappingOptions->tmoperator = reinhard05;
@@ -991,6 +1005,7 @@ void TonemappingPanel::setupUndo() {
             break;
         case reinhard02:
             usescalesGang->setupUndo();
+            fftconvolutionGang->setupUndo();
             keyGang->setupUndo();
             phiGang->setupUndo();
             range2Gang->setupUndo();
@@ -1073,6 +1088,7 @@ void TonemappingPanel::onUndoRedo(bool undo) {
             break;
         case reinhard02:
             (usescalesGang->*redoUndo)();
+            (fftconvolutionGang->*redoUndo)();
             (keyGang->*redoUndo)();
             (phiGang->*redoUndo)();
             (range2Gang->*redoUndo)();
@@ -1258,6 +1274,9 @@ void TonemappingPanel::fromGui2Txt(QString destination) {
         out << "RANGE=" << range2Gang->v() << endl;
         out << "LOWER=" << lowerGang->v() << endl;
         out << "UPPER=" << upperGang->v() << endl;
+        out << "FFTCONVOLUTION="
+            << (m_Ui->fftconvolutioncheckbox->isChecked() ? "YES" : "NO")
+            << endl;
     } else if (current_page == m_Ui->page_reinhard05) {
         out << "TMO="
             << "Reinhard05" << endl;
@@ -1484,6 +1503,9 @@ void TonemappingPanel::fromTxt2Gui() {
             m_Ui->lowerSlider->setValue(lowerGang->v2p(value.toFloat()));
         } else if (field == QLatin1String("UPPER")) {
             m_Ui->upperSlider->setValue(upperGang->v2p(value.toFloat()));
+        } else if (field == QLatin1String("FFTCONVOLUTION")) {
+            m_Ui->fftconvolutioncheckbox->setChecked(value !=
+                                                     QLatin1String("NO"));
         } else if (field == QLatin1String("BRIGHTNESS")) {
             m_Ui->brightnessSlider->setValue(
                 brightnessGang->v2p(value.toFloat()));
@@ -1647,8 +1669,10 @@ void TonemappingPanel::saveParameters() {
                     int   irange = (int)range2Gang->v();
                     int   lower = (int)lowerGang->v();
                     int   upper = (int)upperGang->v();
+                    bool  fftconvolution =
+                        fftconvolutionGang->isCheckBox1Checked();
                     execReinhard02Query(scales, key, phi, irange, lower, upper,
-                                        comment);
+                                        fftconvolution, comment);
                 }
                 break;
             case reinhard05:
@@ -1721,7 +1745,7 @@ void TonemappingPanel::loadParameters() {
         float multiplier, rod, cone;
         bool autolum, local;
         // Reinhard 02
-        bool scales;
+        bool scales, fftconvolution;
         float key, phi;
         int irange, lower, upper;
         // Reinhard 05
@@ -1946,10 +1970,13 @@ void TonemappingPanel::loadParameters() {
                 irange = tmopts->operator_options.reinhard02options.range;
                 lower = tmopts->operator_options.reinhard02options.lower;
                 upper = tmopts->operator_options.reinhard02options.upper;
+                fftconvolution =
+                    tmopts->operator_options.reinhard02options.fftconvolution;
                 pregamma = tmopts->pregamma;
                 postsaturation = tmopts->postsaturation;
                 postgamma = tmopts->postgamma;
                 m_Ui->usescalescheckbox->setChecked(scales);
+                m_Ui->fftconvolutioncheckbox->setChecked(fftconvolution);
                 m_Ui->keySlider->setValue(key);
                 m_Ui->keydsb->setValue(key);
                 m_Ui->phiSlider->setValue(phi);
@@ -2317,6 +2344,7 @@ void TonemappingPanel::execPattanaikQuery(bool autolum, bool local, float cone,
 
 void TonemappingPanel::execReinhard02Query(bool scales, float key, float phi,
                                            int range, int lower, int upper,
+                                           bool fftconvolution,
                                            QString comment) {
     qDebug() << "TonemappingPanel::execReinhard02Query";
     QSqlDatabase db = QSqlDatabase::database(m_databaseconnection);
@@ -2326,9 +2354,9 @@ void TonemappingPanel::execReinhard02Query(bool scales, float key, float phi,
     float postgamma = m_Ui->postgammadsb->value();
     query.prepare(
         "INSERT INTO reinhard02 (scales, key, phi, range, lower, upper, \
-        pregamma, comment, postsaturation, postgamma) \
+        pregamma, comment, postsaturation, postgamma, fftconvolution) \
         VALUES (:scales, :key, :phi, :range, :lower, :upper, :pregamma, \
-        :comment)");
+        :comment, :postsaturation, :postgamma, :fftconvolution)");
     query.bindValue(QStringLiteral(":scales"), scales);
     query.bindValue(QStringLiteral(":key"), key);
     query.bindValue(QStringLiteral(":phi"), phi);
@@ -2339,6 +2367,7 @@ void TonemappingPanel::execReinhard02Query(bool scales, float key, float phi,
     query.bindValue(QStringLiteral(":comment"), comment);
     query.bindValue(QStringLiteral(":postsaturation"), postsaturation);
     query.bindValue(QStringLiteral(":postgamma"), postgamma);
+    query.bindValue(QStringLiteral(":fftconvolution"), fftconvolution);
     bool res = query.exec();
     if (res == false) qDebug() << query.lastError();
 }
@@ -2578,6 +2607,8 @@ void TonemappingPanel::updatePreviewsCB(bool state) {
     // Reinhard02
     else if (eventSender == m_Ui->usescalescheckbox)
         tmopts->operator_options.reinhard02options.scales = state;
+    else if (eventSender == m_Ui->fftconvolutioncheckbox)
+        tmopts->operator_options.reinhard02options.fftconvolution = state;
     // Ashikhmin
     else if (eventSender == m_Ui->simpleCheckBox)
         tmopts->operator_options.ashikhminoptions.simple = state;
@@ -2689,6 +2720,8 @@ void TonemappingPanel::setRealtimePreviews(bool toggled) {
                 SLOT(updatePreviews(double)));
         connect(m_Ui->usescalescheckbox, &QCheckBox::stateChanged, this,
                 &TonemappingPanel::updatePreviewsCB);
+        connect(m_Ui->fftconvolutioncheckbox, &QCheckBox::stateChanged, this,
+                &TonemappingPanel::updatePreviewsCB);
 
         // Reinhard05
         connect(m_Ui->brightnessdsb, SIGNAL(valueChanged(double)), this,
@@ -2809,6 +2842,8 @@ void TonemappingPanel::setRealtimePreviews(bool toggled) {
                 SLOT(updatePreviews(double)));
         disconnect(m_Ui->usescalescheckbox, &QCheckBox::stateChanged, this,
                 &TonemappingPanel::updatePreviewsCB);
+        disconnect(m_Ui->fftconvolutioncheckbox, &QCheckBox::stateChanged,
+                   this, &TonemappingPanel::updatePreviewsCB);
 
         // Reinhard05
         disconnect(m_Ui->brightnessdsb, SIGNAL(valueChanged(double)), this,
@@ -68,6 +68,7 @@ class TonemappingPanel : public QWidget {
         *multiplierGang, *coneGang, *rodGang, *autoYGang, *pattalocalGang,
         // reinhard02
         *keyGang, *phiGang, *range2Gang, *lowerGang, *upperGang, *usescalesGang,
+        *fftconvolutionGang,
         // reinhard05
         *brightnessGang, *chromaticGang, *lightGang,
         // ferwerda96
@@ -143,7 +144,7 @@ class TonemappingPanel : public QWidget {
     void execFerwerdaQuery(float, float, QString);
     void execKimKautzQuery(float, float, QString);
     void execPattanaikQuery(bool, bool, float, float, float, QString);
-    void execReinhard02Query(bool, float, float, int, int, int, QString);
+    void execReinhard02Query(bool, float, float, int, int, int, bool, QString);
     void execReinhard05Query(float, float, float, QString);
     void execVanHaterenQuery(float, QString);
     void execLischinskiQuery(float, QString);
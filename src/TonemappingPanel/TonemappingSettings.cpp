@@ -371,7 +371,7 @@ void TonemappingSettings::fillPreviews() {
         QStringLiteral("SELECT *, 'reinhard02' AS operator FROM reinhard02");
     m_modelPreviews->setQuery(sqlQuery, db);
 
-    bool scales;
+    bool scales, fftconvolution;
     float key, phi;
     int irange, lower, upper;
 
@@ -396,6 +396,9 @@ void TonemappingSettings::fillPreviews() {
         upper = m_modelPreviews->record(selectedRow)
                     .value(QStringLiteral("upper"))
                     .toInt();
+        fftconvolution = m_modelPreviews->record(selectedRow)
+                             .value(QStringLiteral("fftconvolution"))
+                             .toBool();
 
         fillCommonValues(tmoReinhard02, origxsize, PREVIEW_WIDTH, reinhard02,
                          m_modelPreviews->record(selectedRow));
@@ -406,6 +409,8 @@ void TonemappingSettings::fillPreviews() {
         tmoReinhard02->operator_options.reinhard02options.range = irange;
         tmoReinhard02->operator_options.reinhard02options.lower = lower;
         tmoReinhard02->operator_options.reinhard02options.upper = upper;
+        tmoReinhard02->operator_options.reinhard02options.fftconvolution =
+            fftconvolution;
 
         addPreview(new PreviewLabel(0, tmoReinhard02, index++),
                    m_modelPreviews->record(selectedRow));
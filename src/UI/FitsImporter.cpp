@@ -53,6 +53,58 @@ using namespace pfs::colorspace;
 static const int previewWidth = 300;
 static const int previewHeight = 200;
 
+namespace {
+
+//! \brief composite \a size pixels of the channels: red, green and blue are
+//! weighted, the lightness is replaced by \a luminance (if not null) and
+//! \a hAlpha, weighted by \a hAlphaWeight, is added to red
+void composite(const float *red, const float *green, const float *blue,
+               const float *luminance, const float *hAlpha, float redRed,
+               float greenGreen, float blueBlue, float hAlphaWeight,
+               size_t size, float *outRed, float *outGreen, float *outBlue) {
+    if (luminance == nullptr) {
+        // branch free, vectorized by the compiler
+        for (size_t i = 0; i < size; ++i) {
+            const float r = redRed * red[i];
+            outRed[i] = r + hAlphaWeight * hAlpha[i];
+            outGreen[i] = greenGreen * green[i];
+            outBlue[i] = blueBlue * blue[i];
+        }
+        return;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        float r = redRed * red[i];
+        float g = greenGreen * green[i];
+        float b = blueBlue * blue[i];
+        float h, s, l;
+        rgb2hsl(r, g, b, h, s, l);
+        hsl2rgb(h, s, luminance[i], r, g, b);
+        outRed[i] = r + hAlphaWeight * hAlpha[i];
+        outGreen[i] = g;
+        outBlue[i] = b;
+    }
+}
+
+//! \brief red of \a image scaled to the size of the preview, in [0, 1]
+std::vector<float> previewOf(const QImage &image) {
+    const QImage scaled =
+        image.scaled(previewWidth, previewHeight)
+            .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    ConvertSample<float, uint8_t> toFloat;
+
+    std::vector<float> preview(previewWidth * previewHeight);
+    for (int j = 0; j < previewHeight; j++) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(scaled.scanLine(j));
+        float *out = preview.data() + j * previewWidth;
+        for (int i = 0; i < previewWidth; i++) {
+            out[i] = toFloat(qRed(line[i]));
+        }
+    }
+    return preview;
+}
+
+}  // anonymous
+
 FitsImporter::~FitsImporter() { delete m_frame; }
 
 FitsImporter::FitsImporter(QWidget *parent)
@@ -192,24 +244,31 @@ void FitsImporter::on_pushButtonLoad_clicked() {
     m_tmpdata.push_back(HdrCreationItem(m_luminosityChannel));
     m_tmpdata.push_back(HdrCreationItem(m_hChannel));
 
-    // parallel load of the data...
-    // connect(&m_futureWatcher, SIGNAL(finished()), this,
-    // SLOT(loadFilesDone()),
-    // Qt::DirectConnection);
+    // parallel load of the data: the channels are independent files
+    std::vector<QString> errors(m_tmpdata.size());
+    QVector<int> indexes;
+    for (int i = 0; i < static_cast<int>(m_tmpdata.size()); ++i) {
+        indexes.push_back(i);
+    }
+    QtConcurrent::blockingMap(indexes, [this, &errors](int &i) {
+        try {
+            LoadFile loadFile(true);
+            loadFile(m_tmpdata[i]);
+        } catch (std::runtime_error &err) {
+            errors[i] = QString(err.what());
+        } catch (...) {
+            errors[i] = QStringLiteral("unknown error");
+        }
+    });
 
-    // Start the computation.
-    // m_futureWatcher.setFuture( QtConcurrent::map(m_tmpdata.begin(),
-    // m_tmpdata.end(), LoadFile()) );
     QString error_string;
-    try {
-        std::for_each(m_tmpdata.begin(), m_tmpdata.end(), LoadFile(true));
-    } catch (std::runtime_error &err) {
-        QApplication::restoreOverrideCursor();
-        error_string = QString(err.what());
-        qDebug() << err.what();
-    } catch (...) {
-        QApplication::restoreOverrideCursor();
-        error_string = QStringLiteral("unknown error");
+    for (const QString &error : errors) {
+        if (!error.isEmpty()) {
+            QApplication::restoreOverrideCursor();
+            error_string = error;
+            qDebug() << error;
+            break;
+        }
     }
 
     loadFilesDone(error_string);
@@ -242,7 +301,7 @@ void FitsImporter::loadFilesDone(QString error_string) {
             m_data.clear();
             m_tmpdata.clear();
             m_contents.clear();
-            m_qimages.clear();
+            m_previews.clear();
             m_Ui->pushButtonLoad->setEnabled(true);
             // QApplication::restoreOverrideCursor();
             return;
@@ -262,7 +321,7 @@ void FitsImporter::loadFilesDone(QString error_string) {
         m_data.clear();
         m_tmpdata.clear();
         m_contents.clear();
-        m_qimages.clear();
+        m_previews.clear();
         m_Ui->pushButtonLoad->setEnabled(true);
         m_Ui->pushButtonPreview->setEnabled(true);
         QApplication::restoreOverrideCursor();
@@ -294,58 +353,30 @@ void FitsImporter::buildPreview() {
     QImage tempImage(previewWidth, previewHeight,
                      QImage::Format_ARGB32_Premultiplied);
 
-    ConvertSample<float, uint8_t> toFloat;
-    ConvertToQRgb convertToQRgb(1.f + gamma);
-    if (!m_luminosityChannel.isEmpty()) {
-        for (int j = 0; j < previewHeight; j++) {
-            for (int i = 0; i < previewWidth; i++) {
-                float red = toFloat(qRed(m_qimages[0].pixel(i, j)));
-                float green = toFloat(qRed(m_qimages[1].pixel(i, j)));
-                float blue = toFloat(qRed(m_qimages[2].pixel(i, j)));
-                float luminance = toFloat(qRed(m_qimages[3].pixel(i, j)));
-                float h_alpha = toFloat(qRed(m_qimages[4].pixel(i, j)));
-                float r = redRed * red /*+ redGreen * green + redBlue * blue*/;
-                float g =
-                    /*greenRed * red +*/ greenGreen *
-                    green /*+ greenBlue * blue*/;
-                float b =
-                    /*blueRed * red + blueGreen * green + */ blueBlue * blue;
-                float h, s, l;
-                rgb2hsl(r, g, b, h, s, l);
-                hsl2rgb(h, s, luminance, r, g, b);
-                float redH = r + 0.2f * h_alpha;
-                if (r > 1.0f) r = 1.0f;
-                if (g > 1.0f) g = 1.0f;
-                if (b > 1.0f) b = 1.0f;
-                if (redH > 1.0f) redH = 1.0f;
-                QRgb rgb;
-                convertToQRgb(redH, g, b, rgb);
-                tempImage.setPixel(i, j, rgb);
-            }
-        }
-    } else {
-        for (int j = 0; j < previewHeight; j++) {
-            for (int i = 0; i < previewWidth; i++) {
-                float red = toFloat(qRed(m_qimages[0].pixel(i, j)));
-                float green = toFloat(qRed(m_qimages[1].pixel(i, j)));
-                float blue = toFloat(qRed(m_qimages[2].pixel(i, j)));
-                float h_alpha = toFloat(qRed(m_qimages[4].pixel(i, j)));
-                float r = redRed * red /*+ redGreen * green + redBlue * blue*/;
-                float g =
-                    /*greenRed * red +*/ greenGreen *
-                    green /*+ greenBlue * blue*/;
-                float b =
-                    /*blueRed * red + blueGreen * green +*/ blueBlue * blue;
-                float redH = r + 0.2f * h_alpha;
-                if (r > 1.0f) r = 1.0f;
-                if (g > 1.0f) g = 1.0f;
-                if (b > 1.0f) b = 1.0f;
-                if (redH > 1.0f) redH = 1.0f;
-
-                QRgb rgb;
-                convertToQRgb(redH, g, b, rgb);
-                tempImage.setPixel(i, j, rgb);
-            }
+    const float *luminance =
+        m_luminosityChannel.isEmpty() ? nullptr : m_previews[3].data();
+    const ConvertToQRgb convertToQRgb(1.f + gamma);
+    // scanLine() may detach the image: not from the threads of the loop
+    uchar *bits = tempImage.bits();
+    const int bytesPerLine = tempImage.bytesPerLine();
+
+#pragma omp parallel for
+    for (int j = 0; j < previewHeight; j++) {
+        const size_t offset = j * previewWidth;
+        float r[previewWidth];
+        float g[previewWidth];
+        float b[previewWidth];
+        composite(m_previews[0].data() + offset,
+                  m_previews[1].data() + offset,
+                  m_previews[2].data() + offset,
+                  luminance ? luminance + offset : nullptr,
+                  m_previews[4].data() + offset, redRed, greenGreen, blueBlue,
+                  0.2f, previewWidth, r, g, b);
+
+        QRgb *line = reinterpret_cast<QRgb *>(bits + j * bytesPerLine);
+        for (int i = 0; i < previewWidth; i++) {
+            convertToQRgb(std::min(r[i], 1.0f), std::min(g[i], 1.0f),
+                          std::min(b[i], 1.0f), line[i]);
         }
     }
     m_Ui->previewLabel->setPixmap(QPixmap::fromImage(tempImage));
@@ -380,18 +411,15 @@ void FitsImporter::buildContents() {
     for (size_t i = 0; i < m_data.size(); i++) {
         if (m_data[i].filename().isEmpty()) {
             std::fill(m_contents[i].begin(), m_contents[i].end(), 0.0f);
-            QImage tmpImage(previewWidth, previewHeight,
-                            QImage::Format_ARGB32_Premultiplied);
-            tmpImage.fill(0);
-            m_qimages.push_back(tmpImage);
+            m_previews.push_back(
+                std::vector<float>(previewWidth * previewHeight, 0.0f));
         } else {
             Channel *C = m_data[i].frame()->getChannel("X");
             pfs::colorspace::Normalizer normalize(datamin, datamax);
 
             std::transform(C->begin(), C->end(), C->begin(), normalize);
             std::copy(C->begin(), C->end(), m_contents[i].begin());
-            m_qimages.push_back(
-                m_data[i].qimage().scaled(previewWidth, previewHeight));
+            m_previews.push_back(previewOf(m_data[i].qimage()));
         }
     }
 }
@@ -405,28 +433,19 @@ void FitsImporter::buildFrame() {
     Channel *Xc, *Yc, *Zc;
     m_frame->createXYZChannels(Xc, Yc, Zc);
 
-    if (!m_luminosityChannel.isEmpty()) {
-        for (size_t i = 0; i < m_width * m_height; i++) {
-            // float r = redRed * m_contents[2][i];
-            float r = redRed * m_contents[0][i];
-            float g = greenGreen * m_contents[1][i];
-            float b = blueBlue * m_contents[2][i];
-            float h, s, l;
-            rgb2hsl(r, g, b, h, s, l);
-            hsl2rgb(h, s, m_contents[3][i], r, g, b);
-            (*Xc)(i) = r + m_contents[4][i];
-            (*Yc)(i) = g;
-            (*Zc)(i) = b;
-        }
-    } else {
-        for (size_t i = 0; i < m_width * m_height; i++) {
-            float r = redRed * m_contents[0][i];
-            float g = greenGreen * m_contents[1][i];
-            float b = blueBlue * m_contents[2][i];
-            (*Xc)(i) = r + m_contents[4][i];
-            (*Yc)(i) = g;
-            (*Zc)(i) = b;
-        }
+    const float *luminance =
+        m_luminosityChannel.isEmpty() ? nullptr : m_contents[3].data();
+
+#pragma omp parallel for schedule(dynamic)
+    for (long j = 0; j < static_cast<long>(m_height); j++) {
+        const size_t offset = j * m_width;
+        composite(m_contents[0].data() + offset,
+                  m_contents[1].data() + offset,
+                  m_contents[2].data() + offset,
+                  luminance ? luminance + offset : nullptr,
+                  m_contents[4].data() + offset, redRed, greenGreen, blueBlue,
+                  1.f, m_width, Xc->data() + offset, Yc->data() + offset,
+                  Zc->data() + offset);
     }
 }
 
@@ -542,8 +561,7 @@ void FitsImporter::on_pushButtonClockwise_clicked() {
     }
     Channel *C = m_data[index].frame()->getChannel("X");
     std::copy(C->begin(), C->end(), m_contents[index].begin());
-    QImage tmp = m_data[index].qimage().scaled(previewWidth, previewHeight);
-    m_qimages[index].swap(tmp);
+    m_previews[index] = previewOf(m_data[index].qimage());
     // buildPreview();
     m_Ui->pushButtonClockwise->setEnabled(true);
     QApplication::restoreOverrideCursor();
@@ -618,7 +636,7 @@ void FitsImporter::on_pushButtonReset_clicked() {
     m_data.clear();
     m_tmpdata.clear();
     m_contents.clear();
-    m_qimages.clear();
+    m_previews.clear();
     m_Ui->lineEditRed->clear();
     m_Ui->lineEditGreen->clear();
     m_Ui->lineEditBlue->clear();
@@ -110,7 +110,8 @@ class FitsImporter : public QWizard {
     HdrCreationItemContainer m_data;
     HdrCreationItemContainer m_tmpdata;
     std::vector<std::vector<float>> m_contents;
-    std::vector<QImage> m_qimages;
+    //! channels scaled to the size of the preview, in [0, 1]
+    std::vector<std::vector<float>> m_previews;
 
     QStringList m_filenames;
     // QFutureWatcher<void> m_futureWatcher;
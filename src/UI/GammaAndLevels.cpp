@@ -29,28 +29,38 @@
 #include <cassert>
 #include <cmath>
 
+#include "Libpfs/manip/gamma_levels.h"
 #include "UI/GammaAndLevels.h"
 #include "UI/ui_GammaAndLevels.h"
 
 namespace {
-static inline int clamp(const float &v, const float &minV, const float &maxV) {
-    if (v <= minV) return minV;
-    if (v >= maxV) return maxV;
-    return (int)(v + 0.5f);
-}
+const int TILE_SIZE = 256;
+//! tiles rendered per timer tick, out of the visible area
+const int IDLE_TILES = 8;
 }
 
 GammaAndLevels::GammaAndLevels(QWidget *parent, const QImage &data)
     : QDialog(parent, Qt::Dialog),
-      m_ReferenceQImage(data),
+      m_ReferenceQImage(data.convertToFormat(QImage::Format_RGB32)),
       blackin(0),
       whitein(255),
       blackout(0),
       whiteout(255),
       gamma(1.0f),
-      m_Ui(new Ui::LevelsDialog) {
+      m_Ui(new Ui::LevelsDialog),
+      m_Preview(m_ReferenceQImage),
+      m_tilesX((m_Preview.width() + TILE_SIZE - 1) / TILE_SIZE),
+      m_visibleRect(m_Preview.rect()) {
     m_Ui->setupUi(this);
 
+    // the preview starts as the reference image
+    m_validTiles.fill(
+        true, m_tilesX * ((m_Preview.height() + TILE_SIZE - 1) / TILE_SIZE));
+    m_renderTimer.setSingleShot(true);
+    m_renderTimer.setInterval(0);
+    connect(&m_renderTimer, &QTimer::timeout, this,
+            &GammaAndLevels::renderTiles);
+
     QVBoxLayout *qvl = new QVBoxLayout;
     qvl->setMargin(0);
     qvl->setSpacing(1);
@@ -181,46 +191,73 @@ void GammaAndLevels::refreshLUT() {
     qDebug() << "Update Look-Up-Table and send update QImage to viewer";
 #endif
 
-    // values in 0..1 range
-    float bin = static_cast<float>(blackin) / 255.0f;
-    float win = static_cast<float>(whitein) / 255.0f;
-    float expgamma = 1.0f / gamma;
-
-    // Build new QImage from the reference one
-    const QRgb *src = reinterpret_cast<const QRgb *>(m_ReferenceQImage.bits());
-
-    QImage previewimage(m_ReferenceQImage.width(), m_ReferenceQImage.height(),
-                        QImage::Format_RGB32);
-    QRgb *dst = reinterpret_cast<QRgb *>(previewimage.bits());
-
-#pragma omp parallel for shared(src, dst)
-    for (int i = 0; i < m_ReferenceQImage.width() * m_ReferenceQImage.height();
-         ++i) {
-        float red = static_cast<float>(qRed(src[i])) / 255.f;
-        float green = static_cast<float>(qGreen(src[i])) / 255.f;
-        float blue = static_cast<float>(qBlue(src[i])) / 255.f;
-
-        float L = 0.2126f * red + 0.7152f * green +
-                  0.0722f * blue;  // number between [0..1]
-
-        float c = powf(L, expgamma - 1.0f);
-
-        red = (red - bin) / (win - bin);
-        red *= c;
+    m_validTiles.fill(false);
+    m_renderTimer.start();
+}
 
-        green = (green - bin) / (win - bin);
-        green *= c;
+void GammaAndLevels::setVisibleRect(const QRect &rect) {
+    m_visibleRect = rect & m_Preview.rect();
+}
 
-        blue = (blue - bin) / (win - bin);
-        blue *= c;
+void GammaAndLevels::renderTiles() {
+    const QRect bounds = m_Preview.rect();
+
+    QVector<QRect> tiles;
+    const auto addTile = [&](int tx, int ty) {
+        bool &valid = m_validTiles[ty * m_tilesX + tx];
+        if (!valid) {
+            tiles.push_back(
+                QRect(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE) &
+                bounds);
+            valid = true;
+        }
+    };
 
-        dst[i] =
-            qRgb(clamp(blackout + red * (whiteout - blackout), 0.f, 255.f),
-                 clamp(blackout + green * (whiteout - blackout), 0.f, 255.f),
-                 clamp(blackout + blue * (whiteout - blackout), 0.f, 255.f));
+    if (!m_visibleRect.isEmpty()) {
+        for (int ty = m_visibleRect.top() / TILE_SIZE;
+             ty <= m_visibleRect.bottom() / TILE_SIZE; ++ty) {
+            for (int tx = m_visibleRect.left() / TILE_SIZE;
+                 tx <= m_visibleRect.right() / TILE_SIZE; ++tx) {
+                addTile(tx, ty);
+            }
+        }
     }
+    // the visible tiles are up to date, go on with the others
+    if (tiles.isEmpty()) {
+        for (int t = 0; t < m_validTiles.size() && tiles.size() < IDLE_TILES;
+             ++t) {
+            addTile(t % m_tilesX, t / m_tilesX);
+        }
+    }
+    if (tiles.isEmpty()) return;
+
+    // values in 0..1 range, the same kernel processes the frame on accept
+    const pfs::GammaLevelsKernel kernel(
+        blackin / 255.f, whitein / 255.f, blackout / 255.f, whiteout / 255.f,
+        getGamma());
+
+    // scanLine() may detach the image: detach once, outside of the parallel
+    // region, and address the rows from its bits
+    uchar *bits = m_Preview.bits();
+    const int bytesPerLine = m_Preview.bytesPerLine();
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles.size(); ++t) {
+        const QRect &tile = tiles.at(t);
+        for (int y = tile.top(); y <= tile.bottom(); ++y) {
+            const QRgb *src = reinterpret_cast<const QRgb *>(
+                                  m_ReferenceQImage.constScanLine(y)) +
+                              tile.left();
+            QRgb *dst = reinterpret_cast<QRgb *>(bits + y * bytesPerLine) +
+                        tile.left();
+            kernel.apply(src, dst, tile.width());
+        }
+    }
+
+    QRect updated;
+    foreach (const QRect &tile, tiles) updated |= tile;
+    emit updateQImageRect(m_Preview, updated);
 
-    emit updateQImage(previewimage);
+    if (m_validTiles.contains(false)) m_renderTimer.start();
 }
 
 QImage GammaAndLevels::getReferenceQImage() { return m_ReferenceQImage; }
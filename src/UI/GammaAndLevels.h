@@ -26,6 +26,8 @@
 
 #include <QDialog>
 #include <QImage>
+#include <QTimer>
+#include <QVector>
 #include <QWidget>
 
 #include "Viewers/GenericViewer.h"
@@ -115,6 +117,15 @@ class GammaAndLevels : public QDialog {
 
     QScopedPointer<Ui::LevelsDialog> m_Ui;
 
+    //! preview, rendered in tiles: the visible ones first, the others when
+    //! idle
+    QImage m_Preview;
+    QVector<bool> m_validTiles;
+    int m_tilesX;
+    QRect m_visibleRect;
+    //! coalesces the parameter changes in a single render
+    QTimer m_renderTimer;
+
     void refreshLUT();
 
    public:
@@ -129,10 +140,16 @@ class GammaAndLevels : public QDialog {
     float getWhitePointOutput();
     float getGamma();
 
+   public slots:
+    //! \brief part of the image shown to the user, rendered first
+    void setVisibleRect(const QRect &rect);
+
    signals:
-    void updateQImage(QImage image);
+    //! \brief \a rect of \a image has been updated
+    void updateQImageRect(const QImage &image, const QRect &rect);
 
    private slots:
+    void renderTiles();
     void resetValues();
     void updateBlackIn(int);
     void updateGamma(double);
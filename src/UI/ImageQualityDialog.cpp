@@ -30,23 +30,85 @@
 #include <QByteArray>
 #include <QDebug>
 #include <QImage>
+#include <QPainter>
 #include <QString>
+#include <QtConcurrentRun>
 
-#include <Libpfs/io/jpegwriter.h>
-#include <Libpfs/io/pngwriter.h>
+#include <Libpfs/io/filesizeestimator.h>
+
+using pfs::io::FileSizeEstimator;
 
 namespace {
 const static QString IMAGE_QUALITY_KEY =
     QStringLiteral("imagequalitydialog/quality");
 const static int IMAGE_QUALITY_DEFAULT = 98;
+//! msec the quality has to stay still before the exact encode
+const static int EXACT_SIZE_DELAY = 500;
 }
 
+//! \brief estimated file size across the quality range
+class FileSizeCurve : public QWidget {
+   public:
+    explicit FileSizeCurve(QWidget *parent)
+        : QWidget(parent), m_estimator(nullptr), m_quality(0) {
+        setMinimumSize(101, 20);
+        setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Preferred);
+    }
+
+    void setEstimator(const FileSizeEstimator *estimator) {
+        m_estimator = estimator;
+        update();
+    }
+
+    void setQuality(int quality) {
+        m_quality = quality;
+        update();
+    }
+
+   protected:
+    void paintEvent(QPaintEvent *) override {
+        if (!m_estimator) return;
+
+        const double maxSize =
+            qMax(static_cast<double>(m_estimator->estimate(100)), 1.0);
+        const qreal w = width() - 1;
+        const qreal h = height() - 1;
+        const auto point = [&](int quality) {
+            return QPointF(w * quality / 100.0,
+                           h - h * m_estimator->estimate(quality) / maxSize);
+        };
+
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+
+        QPolygonF curve;
+        for (int quality = 0; quality <= 100; ++quality) {
+            curve << point(quality);
+        }
+        painter.setPen(palette().color(QPalette::Mid));
+        painter.drawPolyline(curve);
+
+        painter.setPen(palette().color(QPalette::Highlight));
+        painter.drawLine(QPointF(w * m_quality / 100.0, 0),
+                         QPointF(w * m_quality / 100.0, h));
+        painter.setBrush(palette().color(QPalette::Highlight));
+        painter.drawEllipse(point(m_quality), 2, 2);
+    }
+
+   private:
+    const FileSizeEstimator *m_estimator;
+    int m_quality;
+};
+
 ImageQualityDialog::ImageQualityDialog(const pfs::Frame *frame,
                                        const QString &fmt, int defaultValue,
                                        QWidget *parent)
     : QDialog(parent),
       m_frame(frame),
       m_format(fmt),
+      m_exactQuality(-1),
+      m_exactPending(false),
+      m_curve(nullptr),
       m_ui(new Ui::ImgQualityDialog),
       m_options(new LuminanceOptions()) {
     m_ui->setupUi(this);
@@ -59,11 +121,33 @@ ImageQualityDialog::ImageQualityDialog(const pfs::Frame *frame,
         m_ui->spinBox->setValue(100);
     }
 
-    if (frame) {
+    FileSizeEstimator::Format format;
+    if (frame && FileSizeEstimator::fromString(
+                     m_format.toLower().toStdString(), format)) {
+        m_curve = new FileSizeCurve(m_ui->fileSizePanel);
+        m_ui->horizontalLayout_2->insertWidget(2, m_curve);
+
+        m_exactTimer.setSingleShot(true);
+        m_exactTimer.setInterval(EXACT_SIZE_DELAY);
+        connect(&m_exactTimer, &QTimer::timeout, this,
+                &ImageQualityDialog::startExactSize);
+        connect(&m_estimatorWatcher, &QFutureWatcherBase::finished, this,
+                &ImageQualityDialog::estimatorReady);
+        connect(&m_exactWatcher, &QFutureWatcherBase::finished, this,
+                &ImageQualityDialog::exactSizeDone);
+
         connect(m_ui->spinBox, SIGNAL(valueChanged(int)), this,
                 SLOT(reset(int)));
         connect(m_ui->horizontalSlider, &QAbstractSlider::valueChanged, this,
                 &ImageQualityDialog::reset);
+
+        // the frame outlives the dialog, see the destructor
+        const pfs::Frame *source = frame;
+        m_estimatorWatcher.setFuture(QtConcurrent::run([source, format]() {
+            return std::make_shared<FileSizeEstimator>(*source, format);
+        }));
+        m_ui->label_filesize->setText(tr("Estimating..."));
+        m_exactTimer.start();
     } else {
         m_ui->fileSizePanel->setVisible(false);
     }
@@ -75,6 +159,9 @@ ImageQualityDialog::ImageQualityDialog(const pfs::Frame *frame,
 }
 
 ImageQualityDialog::~ImageQualityDialog() {
+    // the encoders read m_frame
+    m_estimatorWatcher.waitForFinished();
+    m_exactWatcher.waitForFinished();
     if (m_frame) {
         m_options->setValue(IMAGE_QUALITY_KEY, getQuality());
     }
@@ -85,39 +172,69 @@ int ImageQualityDialog::getQuality(void) const {
 }
 
 void ImageQualityDialog::on_getSizeButton_clicked() {
-    pfs::Params params("quality", (size_t)getQuality());
-
-    setCursor(QCursor(Qt::WaitCursor));
-    int size = 0;
-    if (m_format.startsWith(QLatin1String("jp"))) {
-        pfs::io::JpegWriter writer;
-        writer.write(*m_frame, params);
-        size = writer.getFileSize();
-    } else if (m_format.startsWith(QLatin1String("png"))) {
-        pfs::io::PngWriter writer;
-        writer.write(*m_frame, params);
-        size = writer.getFileSize();
-    } else {
+    m_exactTimer.stop();
+    startExactSize();
+}
+
+void ImageQualityDialog::startExactSize() {
+    if (m_exactWatcher.isRunning()) {
+        m_exactPending = true;
         return;
     }
-    //    else
-    //    {
-    //        QByteArray ba;
-    //        QBuffer buffer(&ba);
-    //        buffer.open(QIODevice::WriteOnly);
-    //        m_image->save(&buffer, m_format.toLatin1().constData(), quality);
-    //        size = ba.size();
-    //    }
-
-    QLocale def;
-    QString s = def.toString(size);
-    // the JPG on disk differs by 374 more bytes
-    // label_filesize->setText(QString::number( ba.size() ));
-    // the JPG on disk differs by 374 more bytes
-    m_ui->label_filesize->setText(s);
-    setCursor(QCursor(Qt::ArrowCursor));
+    m_exactPending = false;
+    if (m_estimator && m_estimator->isExact(getQuality())) return;
+
+    FileSizeEstimator::Format format;
+    FileSizeEstimator::fromString(m_format.toLower().toStdString(), format);
+    const pfs::Frame *source = m_frame;
+    const int quality = getQuality();
+
+    m_exactQuality = quality;
+    m_exactWatcher.setFuture(QtConcurrent::run([source, format, quality]() {
+        return FileSizeEstimator::encodedSize(*source, format, quality);
+    }));
+    showFileSize();
+}
+
+void ImageQualityDialog::estimatorReady() {
+    m_estimator = m_estimatorWatcher.result();
+    m_curve->setEstimator(m_estimator.get());
+    m_curve->setQuality(getQuality());
+    showFileSize();
+}
+
+void ImageQualityDialog::exactSizeDone() {
+    const size_t size = m_exactWatcher.result();
+    if (m_estimator && size > 0) {
+        m_estimator->refine(m_exactQuality, size);
+        m_curve->update();
+    }
+    if (m_exactQuality == getQuality()) {
+        // a size of 0 means that the encode failed
+        m_ui->label_filesize->setText(
+            size > 0 ? QLocale().toString(qulonglong(size)) : tr("n/a"));
+    }
+    m_exactQuality = -1;
+
+    if (m_exactPending) startExactSize();
+}
+
+void ImageQualityDialog::showFileSize() {
+    const int quality = getQuality();
+    if (m_estimator && m_estimator->isExact(quality)) {
+        m_ui->label_filesize->setText(
+            QLocale().toString(qulonglong(m_estimator->estimate(quality))));
+    } else if (m_estimator) {
+        m_ui->label_filesize->setText(
+            tr("~%1").arg(QLocale().toString(
+                qulonglong(m_estimator->estimate(quality)))));
+    } else if (m_exactQuality != quality) {
+        m_ui->label_filesize->setText(tr("Unknown"));
+    }
 }
 
-void ImageQualityDialog::reset(int) {
-    m_ui->label_filesize->setText(tr("Unknown"));
+void ImageQualityDialog::reset(int quality) {
+    if (m_curve) m_curve->setQuality(quality);
+    showFileSize();
+    m_exactTimer.start();
 }
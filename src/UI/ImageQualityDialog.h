@@ -25,7 +25,11 @@
 #define IMAGEQUALITYDIALOG_H
 
 #include <QDialog>
+#include <QFutureWatcher>
 #include <QScopedPointer>
+#include <QTimer>
+
+#include <memory>
 
 #include "Common/LuminanceOptions.h"
 
@@ -35,8 +39,13 @@ class ImgQualityDialog;
 
 namespace pfs {
 class Frame;
+namespace io {
+class FileSizeEstimator;
+}
 }
 
+class FileSizeCurve;
+
 class ImageQualityDialog : public QDialog {
     Q_OBJECT
 
@@ -51,10 +60,28 @@ class ImageQualityDialog : public QDialog {
     void on_getSizeButton_clicked();
     void reset(int);
 
+    void estimatorReady();
+    void startExactSize();
+    void exactSizeDone();
+
    protected:
+    void showFileSize();
+
     const pfs::Frame *m_frame;
     QString m_format;
 
+    //! size across the quality range, from a sample of the frame
+    std::shared_ptr<pfs::io::FileSizeEstimator> m_estimator;
+    QFutureWatcher<std::shared_ptr<pfs::io::FileSizeEstimator>>
+        m_estimatorWatcher;
+    //! exact size of the chosen quality, encoded in background
+    QFutureWatcher<size_t> m_exactWatcher;
+    int m_exactQuality;
+    bool m_exactPending;
+    //! waits for the quality to settle before the exact encode
+    QTimer m_exactTimer;
+    FileSizeCurve *m_curve;
+
     QScopedPointer<Ui::ImgQualityDialog> m_ui;
     QScopedPointer<LuminanceOptions> m_options;
 };
@@ -30,6 +30,7 @@
 #include <QDebug>
 #include <QDrag>
 #include <QMimeData>
+#include <QPainter>
 #include <QScrollBar>
 
 #include "Libpfs/frame.h"
@@ -344,6 +345,39 @@ void GenericViewer::setQImage(const QImage &qimage) {
     mPixmap->setPixmap(pixmap);
 }
 
+void GenericViewer::setQImageRect(const QImage &qimage, const QRect &rect) {
+    QPixmap pixmap = mPixmap->pixmap();
+    if (pixmap.size() != qimage.size()) {
+        setQImage(qimage);
+        return;
+    }
+    const QRect area = rect & qimage.rect();
+    if (area.isEmpty()) return;
+
+    // drop the reference of the item first, or painting on the pixmap would
+    // copy it as a whole
+    mPixmap->setPixmap(QPixmap());
+    {
+        QPainter painter(&pixmap);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        // the painter works in device independent pixels
+        painter.scale(1.0 / pixmap.devicePixelRatio(),
+                      1.0 / pixmap.devicePixelRatio());
+        painter.drawImage(area.topLeft(), qimage, area);
+    }
+    mPixmap->setPixmap(pixmap);
+}
+
+QRect GenericViewer::getVisibleRect() const {
+    const QPixmap pixmap = mPixmap->pixmap();
+    const QRectF visible =
+        mPixmap->mapFromScene(mView->mapToScene(mView->viewport()->rect()))
+            .boundingRect();
+    const qreal ratio = pixmap.devicePixelRatio();
+    const QRectF pixels(visible.topLeft() * ratio, visible.size() * ratio);
+    return pixels.toAlignedRect() & pixmap.rect();
+}
+
 int GenericViewer::getWidth() {
     if (mFrame)
         return mFrame->getWidth();
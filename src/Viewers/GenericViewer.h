@@ -149,6 +149,13 @@ class GenericViewer : public QWidget {
     //! \brief set new QImage
     void setQImage(const QImage &qimage);
 
+    //! \brief copy \a rect of \a qimage, that has the size of the shown
+    //! image, on the shown image
+    void setQImageRect(const QImage &qimage, const QRect &rect);
+
+    //! \brief returns the part of the image shown in the viewport, in pixels
+    QRect getVisibleRect() const;
+
     //! \brief
     void setDevicePixelRatio(const float s);
 
@@ -44,6 +44,7 @@
 #include "Libpfs/channel.h"
 #include "Libpfs/frame.h"
 #include "Libpfs/utils/msec_timer.h"
+#include "Libpfs/utils/statistics.h"
 #include "Libpfs/utils/sse.h"
 
 namespace  // anonymous namespace
@@ -53,8 +54,9 @@ namespace  // anonymous namespace
 // the code,
 // because it will only used inside this compilation unit
 
-const pfs::Array2Df *getPrimaryChannel(const pfs::Frame &frame) {
-    return frame.getChannel("Y");
+std::shared_ptr<const pfs::utils::ChannelStatistics> getPrimaryStatistics(
+    const pfs::Frame &frame) {
+    return frame.getStatistics("Y");
 }
 
 }  // end anonymous namespace
@@ -71,7 +73,7 @@ HdrViewer::HdrViewer(pfs::Frame *frame, QWidget *parent, bool ns)
     // I prefer to do everything by hand, so the flow of the calls is clear
     m_lumRange->blockSignals(true);
 
-    m_lumRange->setHistogramImage(getPrimaryChannel(*getFrame()));
+    m_lumRange->setHistogramStatistics(getPrimaryStatistics(*getFrame()));
     m_lumRange->fitToDynamicRange();
 
     m_mappingMethod =
@@ -153,7 +155,7 @@ void HdrViewer::updatePixmap() {
     refreshPixmap();
 
     // I need to set the histogram again during the setFrame function
-    m_lumRange->setHistogramImage(getPrimaryChannel(*getFrame()));
+    m_lumRange->setHistogramStatistics(getPrimaryStatistics(*getFrame()));
     m_lumRange->fitToDynamicRange();
     m_lumRange->blockSignals(false);
 }
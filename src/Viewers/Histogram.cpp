@@ -27,56 +27,13 @@
 
 #include "Histogram.h"
 
-#include <assert.h>
-#include <math.h>
+#include <Libpfs/utils/statistics.h>
 
-#include <Libpfs/array2d.h>
+Histogram::Histogram(int bins) : bins(bins), P(bins, 0.f) {}
 
-Histogram::Histogram(int bins, int accuracy)
-    : bins(bins), accuracy(accuracy), P(new float[bins]) {}
-
-Histogram::~Histogram() { delete[] P; }
-
-void Histogram::computeLog(const pfs::Array2Df *image) {
-    const int size = image->getRows() * image->getCols();
-
-    float max, min;  // Find min, max
-    {
-        min = 999999999.0f;
-        max = -999999999.0f;
-
-        for (int i = 0; i < size; i += accuracy) {
-            float v = (*image)(i);
-            if (v > max)
-                max = v;
-            else if (v < min)
-                min = v;
-        }
-    }
-    computeLog(image, min, max);
-}
-
-void Histogram::computeLog(const pfs::Array2Df *image, float min, float max) {
-    const int size = image->getRows() * image->getCols();
-
-    // Empty all bins
-    for (int i = 0; i < bins; i++) P[i] = 0;
-
-    float count = 0;
-    float binWidth = (max - min) / (float)bins;
-    for (int i = 0; i < size; i += accuracy) {
-        float v = (*image)(i);
-        if (v <= 0) continue;
-        v = log10(v);
-        int bin = (int)((v - min) / binWidth);
-        if (bin > bins || bin < 0) continue;
-        if (bin == bins) bin = bins - 1;
-        P[bin] += 1;
-        count++;
-    }
-
-    // Normalize, to get probability
-    for (int i = 0; i < bins; i++) P[i] /= (float)(count / accuracy);
+void Histogram::computeLog(const pfs::utils::ChannelStatistics &stats,
+                           float min, float max) {
+    P = stats.getLogHistogram(bins, min, max);
 }
 
 float Histogram::getMaxP() const {
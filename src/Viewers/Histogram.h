@@ -28,21 +28,27 @@
  */
 
 #include <assert.h>
-#include "Libpfs/array2d_fwd.h"
+#include <vector>
 #include "noncopyable.h"
 
+namespace pfs {
+namespace utils {
+class ChannelStatistics;
+}
+}
+
 class Histogram : public lhdrengine::NonCopyable {
     int bins;
-    int accuracy;
 
-    float *P;
+    std::vector<float> P;
 
    public:
-    explicit Histogram(int bins, int accuracy = 1);
-    ~Histogram();
+    explicit Histogram(int bins);
 
-    void computeLog(const pfs::Array2Df *image);
-    void computeLog(const pfs::Array2Df *image, float min, float max);
+    //! \brief histogram of log10 of the samples over [min, max], taken from
+    //! the statistics of the channel
+    void computeLog(const pfs::utils::ChannelStatistics &stats, float min,
+                    float max);
 
     int getBins() const { return bins; }
 
@@ -38,7 +38,7 @@
 #include <QMouseEvent>
 #include <cassert>
 
-#include <Libpfs/array2d.h>
+#include <Libpfs/utils/statistics.h>
 
 #include "Histogram.h"
 
@@ -57,8 +57,7 @@ LuminanceRangeWidget::LuminanceRangeWidget(QWidget *parent)
       dragMode(DRAG_NO),
       showVP(false),
       valuePointer(0.f),
-      histogram(nullptr),
-      histogramImage(nullptr)
+      histogram(nullptr)
 
 {
     setFrameStyle(QFrame::Panel | QFrame::Sunken);
@@ -102,16 +101,11 @@ void LuminanceRangeWidget::paintEvent(QPaintEvent * /*pe */) {
     }
 
     // Paint histogram
-    if (histogramImage != nullptr) {
+    if (histogramStats) {
         if (histogram == nullptr || histogram->getBins() != fRect.width()) {
             delete histogram;
-            // Build histogram from at least 5000 pixels
-            int accuracy =
-                histogramImage->getRows() * histogramImage->getCols() / 5000;
-            //       int accuracy =1;
-            if (accuracy < 1) accuracy = 1;
-            histogram = new Histogram(fRect.width(), accuracy);
-            histogram->computeLog(histogramImage, minValue, maxValue);
+            histogram = new Histogram(fRect.width());
+            histogram->computeLog(*histogramStats, minValue, maxValue);
         }
 
         float maxP = histogram->getMaxP();
@@ -254,26 +248,18 @@ void LuminanceRangeWidget::shrinkRange() {
     emit updateRangeWindow();
 }
 
-void LuminanceRangeWidget::setHistogramImage(const pfs::Array2Df *image) {
-    histogramImage = image;
+void LuminanceRangeWidget::setHistogramStatistics(
+    const std::shared_ptr<const pfs::utils::ChannelStatistics> &stats) {
+    histogramStats = stats;
     delete histogram;
     histogram = nullptr;
     update();
 }
 
 void LuminanceRangeWidget::fitToDynamicRange() {
-    if (histogramImage != nullptr) {
-        float min = 99999999.0f;
-        float max = -99999999.0f;
-
-        int size = histogramImage->getRows() * histogramImage->getCols();
-        for (int i = 0; i < size; i++) {
-            float v = (*histogramImage)(i);
-            if (v > max)
-                max = v;
-            else if (v < min)
-                min = v;
-        }
+    if (histogramStats) {
+        float min = histogramStats->getMin();
+        float max = histogramStats->getMax();
 
         if (min <= 0.000001f)
             min = 0.000001f;  // If data contains negative values
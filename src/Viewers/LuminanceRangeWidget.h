@@ -28,7 +28,7 @@
 #define LUMINANCERANGE_WIDGET_H
 
 #include <QFrame>
-#include "Libpfs/array2d_fwd.h"
+#include <memory>
 #include "Viewers/Histogram.h"
 
 class LuminanceRangeWidget : public QFrame {
@@ -75,7 +75,7 @@ class LuminanceRangeWidget : public QFrame {
     float valuePointer;
 
     Histogram *histogram;
-    const pfs::Array2Df *histogramImage;
+    std::shared_ptr<const pfs::utils::ChannelStatistics> histogramStats;
 
     QRect getPaintRect() const;
 
@@ -85,7 +85,8 @@ class LuminanceRangeWidget : public QFrame {
 
     void setRangeWindowMinMax(float min, float max);
 
-    void setHistogramImage(const pfs::Array2Df *image);
+    void setHistogramStatistics(
+        const std::shared_ptr<const pfs::utils::ChannelStatistics> &stats);
 
     void showValuePointer(float value);
     void hideValuePointer();
@@ -0,0 +1,79 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#ifndef ARCH_ALLOCATOR_H
+#define ARCH_ALLOCATOR_H
+
+//! \file allocator.h
+//! \brief STL allocator returning memory aligned for SIMD loads, built on
+//! top of the _mm_malloc()/_mm_free() pair of arch/malloc.h
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "arch/malloc.h"
+
+namespace lhdrengine {
+
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator {
+   public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if (n == 0) return nullptr;
+
+        void *p = _mm_malloc(n * sizeof(T), Alignment);
+        if (p == nullptr) throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, std::size_t) noexcept { _mm_free(p); }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment> &,
+                const AlignedAllocator<U, Alignment> &) {
+    return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment> &,
+                const AlignedAllocator<U, Alignment> &) {
+    return false;
+}
+
+//! \brief contiguous buffer starting on a cache line
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+}  // lhdrengine
+
+#endif  // ARCH_ALLOCATOR_H
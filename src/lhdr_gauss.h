@@ -666,11 +666,9 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
 }
 }
 
-void gaussianBlur(float** src, float** dst, const int W, const int H, const double sigma)
+inline void gaussianBlur(float** src, float** dst, const int W, const int H, const double sigma)
 {
     gaussianBlurImpl<float>(src, dst, W, H, sigma);
 }
 
-void gaussianBlur(float** src, float** dst, const int W, const int H, const double sigma);
-
 #endif
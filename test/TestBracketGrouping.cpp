@@ -0,0 +1,105 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <HdrWizard/ExifIndex.h>
+
+namespace {
+
+ExifIndex::Entry shot(const QString &name, double timestamp, float ev,
+                      float iso = 100.f) {
+    ExifIndex::Entry entry;
+    entry.fileName = name;
+    entry.timestamp = timestamp;
+    entry.averageLuminance = std::pow(2.f, ev);
+    entry.exposureTime = 0.1f;
+    entry.fNumber = 8.f;
+    entry.iso = iso;
+    entry.width = 600;
+    entry.height = 400;
+    return entry;
+}
+
+}  // anonymous
+
+TEST(TestBracketGrouping, SplitsOnTimeGap) {
+    QVector<ExifIndex::Entry> entries;
+    entries << shot("a", 100., -2.f) << shot("b", 100.5, 0.f)
+            << shot("c", 101., 2.f) << shot("d", 200., -2.f)
+            << shot("e", 200.5, 0.f) << shot("f", 201., 2.f);
+
+    QList<QStringList> brackets = ExifIndex::groupBrackets(entries);
+    ASSERT_EQ(brackets.size(), 2);
+    EXPECT_EQ(brackets[0], QStringList() << "a" << "b" << "c");
+    EXPECT_EQ(brackets[1], QStringList() << "d" << "e" << "f");
+}
+
+TEST(TestBracketGrouping, SplitsOnRepeatedEV) {
+    // brackets of different sizes shot back to back
+    QVector<ExifIndex::Entry> entries;
+    entries << shot("a", 0., 0.f) << shot("b", 0.5, -1.f)
+            << shot("c", 1., 1.f) << shot("d", 1.5, 0.f)
+            << shot("e", 2., -2.f) << shot("f", 2.5, -1.f)
+            << shot("g", 3., 1.f) << shot("h", 3.5, 2.f);
+
+    QList<QStringList> brackets = ExifIndex::groupBrackets(entries);
+    ASSERT_EQ(brackets.size(), 2);
+    EXPECT_EQ(brackets[0].size(), 3);
+    EXPECT_EQ(brackets[1].size(), 5);
+}
+
+TEST(TestBracketGrouping, SortsByTimestamp) {
+    QVector<ExifIndex::Entry> entries;
+    entries << shot("c", 2., 2.f) << shot("a", 1., -2.f)
+            << shot("b", 1.5, 0.f);
+
+    QList<QStringList> brackets = ExifIndex::groupBrackets(entries);
+    ASSERT_EQ(brackets.size(), 1);
+    EXPECT_EQ(brackets[0], QStringList() << "a" << "b" << "c");
+}
+
+TEST(TestBracketGrouping, SplitsOnSettings) {
+    QVector<ExifIndex::Entry> entries;
+    entries << shot("a", 0., -1.f) << shot("b", 0.5, 1.f)
+            << shot("c", 1., -1.f, 400.f) << shot("d", 1.5, 1.f, 400.f);
+
+    QList<QStringList> brackets = ExifIndex::groupBrackets(entries);
+    ASSERT_EQ(brackets.size(), 2);
+    EXPECT_EQ(brackets[1], QStringList() << "c" << "d");
+}
+
+TEST(TestBracketGrouping, MissingExif) {
+    QVector<ExifIndex::Entry> entries;
+    ExifIndex::Entry noExif;
+    noExif.fileName = "b";
+    entries << shot("a", 0., -1.f) << noExif << shot("c", 1., 1.f);
+
+    // without every timestamp the order of the input is kept, the image
+    // without EV is left out
+    QStringList withoutEV;
+    QList<QStringList> brackets =
+        ExifIndex::groupBrackets(entries, &withoutEV);
+    ASSERT_EQ(brackets.size(), 1);
+    EXPECT_EQ(brackets[0], QStringList() << "a" << "c");
+    EXPECT_EQ(withoutEV, QStringList() << "b");
+}
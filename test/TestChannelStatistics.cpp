@@ -0,0 +1,123 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/manip/copy.h>
+#include <Libpfs/utils/statistics.h>
+
+using namespace pfs;
+using namespace pfs::utils;
+
+TEST(TestChannelStatistics, Reference) {
+    std::mt19937 gen(7);
+    std::lognormal_distribution<float> dist(0.f, 3.f);
+
+    // odd width: exercises the tail of the rows
+    Array2Df data(301, 257);
+    for (size_t i = 0; i < data.size(); ++i) data(i) = dist(gen);
+    data(10) = -2.f;
+    data(20) = 0.f;
+    data(30) = std::numeric_limits<float>::quiet_NaN();
+
+    std::vector<float> sorted;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (!std::isnan(data(i))) sorted.push_back(data(i));
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    ChannelStatistics stats(data);
+
+    ASSERT_EQ(sorted.size(), stats.getSize());
+    EXPECT_EQ(sorted.front(), stats.getMin());
+    EXPECT_EQ(sorted.back(), stats.getMax());
+    EXPECT_EQ(*std::upper_bound(sorted.begin(), sorted.end(), 0.f),
+              stats.getMinPositive());
+
+    // the negative sample is NaN in the log domain
+    EXPECT_TRUE(std::isnan(stats.getLogAverage()));
+
+    for (float p = 0.01f; p < 1.f; p += 0.07f) {
+        const float expected = sorted[static_cast<size_t>(p * sorted.size())];
+        EXPECT_NEAR(expected, stats.getPercentile(p), expected * 0.01f);
+    }
+    EXPECT_EQ(stats.getMin(), stats.getPercentile(0.f));
+    EXPECT_EQ(stats.getMax(), stats.getPercentile(1.f));
+
+    data(10) = 1.f;
+    double logSum = 0.0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (!std::isnan(data(i))) logSum += std::log(data(i) + 1e-4f);
+    }
+    ChannelStatistics positive(data);
+    const double expected = std::exp(logSum / sorted.size());
+    EXPECT_NEAR(expected, positive.getLogAverage(), expected * 1e-6);
+}
+
+TEST(TestChannelStatistics, LogHistogram) {
+    Array2Df data(10, 10);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data(i) = (i < 25) ? 0.01f : (i < 75 ? 1.f : 100.f);
+    }
+
+    const std::vector<float> P =
+        ChannelStatistics(data).getLogHistogram(4, -3.f, 3.f);
+
+    ASSERT_EQ(4u, P.size());
+    EXPECT_FLOAT_EQ(0.25f, P[0]);
+    EXPECT_FLOAT_EQ(0.5f, P[1] + P[2]);
+    EXPECT_FLOAT_EQ(0.25f, P[3]);
+}
+
+TEST(TestChannelStatistics, FrameCache) {
+    Frame frame(16, 8);
+    Channel *Y = frame.createChannel("Y");
+    std::fill(Y->begin(), Y->end(), 2.f);
+
+    const Frame &constFrame = frame;
+    std::shared_ptr<const ChannelStatistics> stats =
+        constFrame.getStatistics("Y");
+    ASSERT_TRUE(stats);
+    EXPECT_EQ(2.f, stats->getMax());
+    EXPECT_EQ(stats, constFrame.getStatistics("Y"));
+    EXPECT_FALSE(constFrame.getStatistics("X"));
+
+    // a copy shares the statistics
+    std::unique_ptr<Frame> other(pfs::copy(&frame));
+    EXPECT_EQ(stats, static_cast<const Frame &>(*other).getStatistics("Y"));
+
+    // taking the channel for writing drops them
+    (*frame.getChannel("Y"))(0) = 5.f;
+    EXPECT_EQ(5.f, constFrame.getStatistics("Y")->getMax());
+
+    // unless the channel pointer was taken before
+    (*Y)(1) = 7.f;
+    EXPECT_EQ(5.f, constFrame.getStatistics("Y")->getMax());
+    frame.contentChanged();
+    EXPECT_EQ(7.f, constFrame.getStatistics("Y")->getMax());
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/progress.h>
+#include <Libpfs/utils/msec_timer.h>
+#include <TonemappingOperators/durand02/fastbilateral.h>
+
+namespace {
+
+void fillLogLuminance(pfs::Array2Df &I) {
+    for (size_t y = 0; y < I.getRows(); y++) {
+        for (size_t x = 0; x < I.getCols(); x++) {
+            I(x, y) = std::log(
+                0.01f +
+                std::exp(4.f * std::sin(x / 53.f) * std::cos(y / 37.f)) +
+                ((x / 64 + y / 64) % 2 ? 20.f : 0.f));
+        }
+    }
+}
+
+// brute force filter, with the same kernels of fastBilateralFilter
+void bilateralReference(const pfs::Array2Df &I, pfs::Array2Df &J,
+                        float sigma_s, float sigma_r) {
+    const int w = I.getCols();
+    const int h = I.getRows();
+    const int r = static_cast<int>(std::ceil(3.f * sigma_s));
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            double v = 0.;
+            double k = 0.;
+            for (int py = std::max(0, y - r); py <= std::min(h - 1, y + r);
+                 py++) {
+                for (int px = std::max(0, x - r); px <= std::min(w - 1, x + r);
+                     px++) {
+                    const float d = I(px, py) - I(x, y);
+                    const double m =
+                        std::exp(-((px - x) * (px - x) + (py - y) * (py - y)) /
+                                 (2.f * sigma_s * sigma_s)) *
+                        std::exp(-d * d / (sigma_r * sigma_r));
+                    v += m * I(px, py);
+                    k += m;
+                }
+            }
+            J(x, y) = v / k;
+        }
+    }
+}
+
+double psnr(const pfs::Array2Df &A, const pfs::Array2Df &B, float range) {
+    double error = 0.;
+    for (size_t i = 0; i < A.size(); i++) {
+        error += (A(i) - B(i)) * (A(i) - B(i));
+    }
+    error /= A.size();
+    return 10. * std::log10(range * range / error);
+}
+}
+
+class Durand02Bilateral
+    : public ::testing::TestWithParam<std::pair<float, float>> {};
+
+TEST_P(Durand02Bilateral, MatchesBruteForce) {
+    const float sigma_s = GetParam().first;
+    const float sigma_r = GetParam().second;
+
+    pfs::Array2Df I(200, 150);
+    pfs::Array2Df J(200, 150);
+    pfs::Array2Df reference(200, 150);
+    pfs::Progress ph;
+
+    fillLogLuminance(I);
+    fastBilateralFilter(I, J, sigma_s, sigma_r, 1, ph);
+    bilateralReference(I, reference, sigma_s, sigma_r);
+
+    const float range = *std::max_element(I.begin(), I.end()) -
+                        *std::min_element(I.begin(), I.end());
+    EXPECT_GE(psnr(J, reference, range), 45.);
+}
+
+INSTANTIATE_TEST_CASE_P(Durand02, Durand02Bilateral,
+                        ::testing::Values(std::make_pair(2.f, 0.4f),
+                                          std::make_pair(8.f, 0.4f),
+                                          std::make_pair(2.f, 2.f),
+                                          std::make_pair(8.f, 2.f)));
+
+// timing only, run with --gtest_also_run_disabled_tests: the cost of the grid
+// should not depend on sigma_s
+TEST(Durand02Bilateral, DISABLED_Benchmark) {
+    pfs::Array2Df I(2000, 1500);
+    pfs::Array2Df J(2000, 1500);
+    pfs::Progress ph;
+
+    fillLogLuminance(I);
+    for (float sigma_s = 2.f; sigma_s <= 64.f; sigma_s *= 2.f) {
+        msec_timer timer;
+        timer.start();
+        fastBilateralFilter(I, J, sigma_s, 0.4f, 1, ph);
+        timer.stop_and_update();
+
+        std::cout << "sigma_s = " << sigma_s << ": " << timer.get_time()
+                  << " msec" << std::endl;
+    }
+}
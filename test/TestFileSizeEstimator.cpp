@@ -0,0 +1,116 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+#include <Libpfs/channel.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/io/filesizeestimator.h>
+
+using namespace pfs;
+using namespace pfs::io;
+
+namespace {
+
+//! gradients with some noise, the same texture all over the frame
+void fillFrame(Frame &frame) {
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+
+    Channel *R, *G, *B;
+    frame.createXYZChannels(R, G, B);
+    const int width = frame.getWidth();
+    const int height = frame.getHeight();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const float fx = static_cast<float>(x % 200) / 200.f;
+            const float fy = static_cast<float>(y % 150) / 150.f;
+            (*R)(x, y) = std::min(std::max(fx + noise(gen), 0.f), 1.f);
+            (*G)(x, y) = std::min(std::max(fy + noise(gen), 0.f), 1.f);
+            (*B)(x, y) = std::min(std::max(0.5f + noise(gen), 0.f), 1.f);
+        }
+    }
+}
+
+}  // anonymous
+
+TEST(TestFileSizeEstimator, SmallFrameIsExact) {
+    Frame frame(100, 80);
+    fillFrame(frame);
+
+    FileSizeEstimator jpeg(frame, FileSizeEstimator::FORMAT_JPEG);
+    EXPECT_EQ(FileSizeEstimator::encodedSize(frame,
+                                             FileSizeEstimator::FORMAT_JPEG, 90),
+              jpeg.estimate(90));
+
+    FileSizeEstimator png(frame, FileSizeEstimator::FORMAT_PNG);
+    EXPECT_EQ(FileSizeEstimator::encodedSize(frame,
+                                             FileSizeEstimator::FORMAT_PNG, 40),
+              png.estimate(40));
+}
+
+TEST(TestFileSizeEstimator, Estimate) {
+    Frame frame(1600, 1200);
+    fillFrame(frame);
+
+    FileSizeEstimator estimator(frame, FileSizeEstimator::FORMAT_JPEG);
+    const int qualities[] = {10, 60, 75, 98};
+    for (int quality : qualities) {
+        const double exact = static_cast<double>(FileSizeEstimator::encodedSize(
+            frame, FileSizeEstimator::FORMAT_JPEG, quality));
+        EXPECT_NEAR(1.0, estimator.estimate(quality) / exact, 0.25);
+    }
+
+    // size grows with the quality
+    for (int quality = 1; quality <= 100; ++quality) {
+        EXPECT_TRUE(estimator.estimate(quality - 1) <=
+                    estimator.estimate(quality));
+    }
+}
+
+TEST(TestFileSizeEstimator, Refine) {
+    Frame frame(1024, 768);
+    fillFrame(frame);
+
+    FileSizeEstimator estimator(frame, FileSizeEstimator::FORMAT_JPEG);
+    const size_t exact =
+        FileSizeEstimator::encodedSize(frame, FileSizeEstimator::FORMAT_JPEG, 85);
+    const size_t before = estimator.estimate(86);
+
+    EXPECT_FALSE(estimator.isExact(85));
+    estimator.refine(85, exact);
+    EXPECT_TRUE(estimator.isExact(85));
+    EXPECT_EQ(exact, estimator.estimate(85));
+    // the rest of the curve follows the correction
+    EXPECT_NE(before, estimator.estimate(86));
+}
+
+TEST(TestFileSizeEstimator, Format) {
+    FileSizeEstimator::Format format;
+    EXPECT_TRUE(FileSizeEstimator::fromString("jpg", format));
+    EXPECT_EQ(FileSizeEstimator::FORMAT_JPEG, format);
+    EXPECT_TRUE(FileSizeEstimator::fromString("jpeg", format));
+    EXPECT_TRUE(FileSizeEstimator::fromString("png", format));
+    EXPECT_EQ(FileSizeEstimator::FORMAT_PNG, format);
+    EXPECT_FALSE(FileSizeEstimator::fromString("tiff", format));
+}
@@ -0,0 +1,134 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include <Libpfs/channel.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/manip/resize.h>
+
+using namespace pfs;
+
+namespace {
+
+void fillFrame(Frame &frame, bool smooth) {
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    Channel *X, *Y, *Z;
+    frame.createXYZChannels(X, Y, Z);
+    for (size_t y = 0; y < frame.getHeight(); ++y) {
+        for (size_t x = 0; x < frame.getWidth(); ++x) {
+            if (smooth) {
+                (*X)(x, y) = 0.5f + 0.4f * std::sin(x * 0.01f);
+                (*Y)(x, y) = 0.5f + 0.4f * std::cos(y * 0.013f);
+                (*Z)(x, y) = 0.5f + 0.2f * std::sin((x + y) * 0.007f);
+            } else {
+                (*X)(x, y) = dist(gen);
+                (*Y)(x, y) = dist(gen);
+                (*Z)(x, y) = dist(gen);
+            }
+        }
+    }
+}
+
+}  // anonymous
+
+TEST(TestFramePyramid, Levels) {
+    Frame frame(203, 101);
+    fillFrame(frame, false);
+    const Frame &cframe = frame;
+
+    std::shared_ptr<const Frame> level = cframe.getPyramidLevel(90, 40);
+    ASSERT_TRUE(level != nullptr);
+    EXPECT_EQ(101u, level->getWidth());
+    EXPECT_EQ(50u, level->getHeight());
+
+    const Channel *X = cframe.getChannel("X");
+    const Channel *LX = level->getChannel("X");
+    ASSERT_TRUE(LX != nullptr);
+    for (size_t y = 0; y < level->getHeight(); ++y) {
+        for (size_t x = 0; x < level->getWidth(); ++x) {
+            const float expected =
+                0.25f * ((*X)(2 * x, 2 * y) + (*X)(2 * x + 1, 2 * y) +
+                         (*X)(2 * x, 2 * y + 1) + (*X)(2 * x + 1, 2 * y + 1));
+            EXPECT_NEAR(expected, (*LX)(x, y), 1e-6f);
+        }
+    }
+
+    std::shared_ptr<const Frame> smaller = cframe.getPyramidLevel(20, 10);
+    ASSERT_TRUE(smaller != nullptr);
+    EXPECT_EQ(25u, smaller->getWidth());
+    EXPECT_EQ(12u, smaller->getHeight());
+
+    // cached
+    EXPECT_EQ(level, cframe.getPyramidLevel(100, 50));
+    // first level already too small
+    EXPECT_TRUE(cframe.getPyramidLevel(102, 10) == nullptr);
+}
+
+TEST(TestFramePyramid, Invalidation) {
+    Frame frame(64, 64);
+    fillFrame(frame, false);
+
+    std::shared_ptr<const Frame> level =
+        static_cast<const Frame &>(frame).getPyramidLevel(16, 16);
+    ASSERT_TRUE(level != nullptr);
+
+    Channel *X, *Y, *Z;
+    frame.getXYZChannels(X, Y, Z);
+    std::fill(X->begin(), X->end(), 0.5f);
+
+    std::shared_ptr<const Frame> updated =
+        static_cast<const Frame &>(frame).getPyramidLevel(16, 16);
+    ASSERT_TRUE(updated != nullptr);
+    EXPECT_NE(level, updated);
+    EXPECT_FLOAT_EQ(0.5f, (*updated->getChannel("X"))(3, 3));
+}
+
+// shrinking from the pyramid stays close to shrinking the whole frame
+TEST(TestFramePyramid, Resize) {
+    Frame frame(1000, 600);
+    fillFrame(frame, true);
+
+    const InterpolationMethod methods[] = {BilinearInterp, LanczosInterp};
+    for (InterpolationMethod m : methods) {
+        std::unique_ptr<Frame> resized(pfs::resize(&frame, 230, m));
+        ASSERT_TRUE(resized != nullptr);
+        EXPECT_EQ(230u, resized->getWidth());
+        EXPECT_EQ(138u, resized->getHeight());
+
+        Frame reference(230, 138);
+        Channel *X = reference.createChannel("X");
+        pfs::resize(frame.getChannel("X"), X, m);
+
+        const Channel *RX = resized->getChannel("X");
+        for (size_t y = 2; y + 2 < 138; ++y) {
+            for (size_t x = 2; x + 2 < 230; ++x) {
+                EXPECT_NEAR((*X)(x, y), (*RX)(x, y), 0.02f);
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "Libpfs/array2dview.h"
+#include "Libpfs/frame.h"
+#include "Libpfs/frameview.h"
+#include "Libpfs/manip/cut.h"
+#include "Libpfs/manip/shift.h"
+
+#include "SeqInt.h"
+
+using namespace pfs;
+
+TEST(TestFrameView, CutIsAWindow)
+{
+    Array2Df input(6, 5);
+    std::generate(input.begin(), input.end(), SeqInt());
+
+    Array2DViewf view = Array2DViewf(input).cut(1, 2, 5, 4);
+
+    ASSERT_EQ(view.getCols(), 4u);
+    ASSERT_EQ(view.getRows(), 2u);
+    ASSERT_EQ(view.getStride(), 6u);
+    EXPECT_TRUE(view.isInside());
+    // no copy: the rows of the view are the rows of the array
+    EXPECT_EQ(&*view.row_begin(0), &input(1, 2));
+    EXPECT_EQ(view(3, 1), input(4, 3));
+
+    // nested cuts are relative to the view
+    Array2DViewf nested = view.cut(1, 1, 10, 10);
+    ASSERT_EQ(nested.getCols(), 3u);
+    ASSERT_EQ(nested.getRows(), 1u);
+    EXPECT_EQ(nested(0, 0), input(2, 3));
+}
+
+TEST(TestFrameView, ShiftHasBorder)
+{
+    Array2Df input(6, 5);
+    std::generate(input.begin(), input.end(), SeqInt());
+
+    Array2DViewf view = Array2DViewf(input).shift(-2, 1);
+    EXPECT_FALSE(view.isInside());
+    EXPECT_EQ(view.colBegin(), 2u);
+    EXPECT_EQ(view.colEnd(), 6u);
+    EXPECT_EQ(view.rowBegin(), 0u);
+    EXPECT_EQ(view.rowEnd(), 4u);
+
+    // input(c, r) = 6*r + c, the view reads input(c - 2, r + 1)
+    const float expected[5][6] = {{0, 0, 6, 7, 8, 9},
+                                  {0, 0, 12, 13, 14, 15},
+                                  {0, 0, 18, 19, 20, 21},
+                                  {0, 0, 24, 25, 26, 27},
+                                  {0, 0, 0, 0, 0, 0}};
+    for (size_t r = 0; r < 5; ++r) {
+        for (size_t c = 0; c < 6; ++c) {
+            ASSERT_EQ(view(c, r), expected[r][c]);
+        }
+    }
+
+    // entirely outside
+    Array2DViewf outside = Array2DViewf(input).shift(10, 0);
+    EXPECT_EQ(outside.colBegin(), outside.colEnd());
+    EXPECT_EQ(outside(0, 0), 0.f);
+}
+
+TEST(TestFrameView, CutOfShift)
+{
+    Array2Df input(7, 6);
+    std::generate(input.begin(), input.end(), SeqInt());
+
+    Array2Df output(4, 3);
+    Array2DViewf(input).shift(2, -1).cut(2, 1, 6, 4).copyTo(output);
+
+    // input(c, r) = 7*r + c, the output reads input(c + 4, r): the last
+    // column is beyond the right border
+    const float expected[3][4] = {
+        {4, 5, 6, 0}, {11, 12, 13, 0}, {18, 19, 20, 0}};
+    for (size_t r = 0; r < 3; ++r) {
+        for (size_t c = 0; c < 4; ++c) {
+            ASSERT_EQ(output(c, r), expected[r][c]);
+        }
+    }
+}
+
+TEST(TestFrameView, Materialize)
+{
+    Frame frame(6, 5);
+    Channel *X;
+    Channel *Y;
+    Channel *Z;
+    frame.createXYZChannels(X, Y, Z);
+    std::generate(X->begin(), X->end(), SeqInt());
+    std::generate(Y->begin(), Y->end(), SeqInt());
+    std::generate(Z->begin(), Z->end(), SeqInt());
+    frame.getTags().setTag("TAG", "value");
+
+    FrameView view = FrameView(frame).shift(1, 2).cut(1, 1, 4, 5);
+    ASSERT_EQ(view.getWidth(), 3u);
+    ASSERT_EQ(view.getHeight(), 4u);
+
+    std::unique_ptr<Frame> output(view.materialize());
+    ASSERT_EQ(output->getWidth(), 3u);
+    ASSERT_EQ(output->getHeight(), 4u);
+    EXPECT_EQ(output->getTags().getTag("TAG"), "value");
+
+    // frame(c, r) = 6*r + c, the view reads frame(c, r - 1): the first row
+    // is beyond the top border
+    const float expected[] = {0, 0, 0, 0, 1, 2, 6, 7, 8, 12, 13, 14};
+    const Channel *outY = output->getChannel("Y");
+    ASSERT_TRUE(outY != NULL);
+    for (size_t idx = 0; idx < outY->size(); ++idx) {
+        ASSERT_EQ((*outY)(idx), expected[idx]);
+        ASSERT_EQ(view.channel("Y")(idx % 3, idx / 3), expected[idx]);
+    }
+    EXPECT_EQ(view.channel("missing").size(), 0u);
+}
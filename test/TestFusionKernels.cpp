@@ -0,0 +1,156 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <HdrCreation/fusionkernels.h>
+
+using namespace libhdr::fusion;
+
+namespace {
+
+const size_t SIZE = 4096;
+const float EXPOSURES[] = {0.125f, 0.5f, 2.f, 8.f};
+const size_t NUM_EXPOSURES = sizeof(EXPOSURES) / sizeof(EXPOSURES[0]);
+
+const ResponseCurveType RESPONSES[] = {RESPONSE_LINEAR, RESPONSE_GAMMA,
+                                       RESPONSE_LOG10, RESPONSE_SRGB};
+const WeightFunctionType WEIGHTS[] = {WEIGHT_TRIANGULAR, WEIGHT_GAUSSIAN,
+                                      WEIGHT_PLATEAU, WEIGHT_FLAT};
+
+//! samples of every exposure, for the three channels
+struct Bracket {
+    Bracket() : data(3 * NUM_EXPOSURES, std::vector<float>(SIZE)) {
+        for (size_t i = 0; i < NUM_EXPOSURES; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                std::vector<float> &samples = data[c * NUM_EXPOSURES + i];
+                const float scale = 1.f + 0.2f * c;
+                for (size_t k = 0; k < SIZE; ++k) {
+                    const float radiance =
+                        scale * std::pow(10.f, -3.f + 3.f * k / SIZE);
+                    samples[k] = std::min(1.f, EXPOSURES[i] * radiance);
+                }
+                channels[c].push_back(samples.data());
+            }
+        }
+    }
+
+    std::vector<std::vector<float>> data;
+    DataList channels[3];
+};
+
+//! \brief Debevec merge as computed before the fused kernel: the response of
+//! the red channel is used for the three channels
+void referenceDebevec(const ResponseCurve &response,
+                      const WeightFunction &weight, const Bracket &bracket,
+                      std::vector<float> *out) {
+    for (size_t k = 0; k < SIZE; ++k) {
+        double sum[3] = {0., 0., 0.};
+        double sumWeight = 0.;
+        for (size_t i = 0; i < NUM_EXPOSURES; ++i) {
+            const float r = bracket.channels[0][i][k];
+            const float g = bracket.channels[1][i][k];
+            const float b = bracket.channels[2][i][k];
+            const float w = (weight(r) + weight(g) + weight(b)) / 3.f;
+            const float samples[3] = {r, g, b};
+            for (int c = 0; c < 3; ++c) {
+                sum[c] += (std::log(response(samples[c])) -
+                           std::log(EXPOSURES[i])) * w;
+            }
+            sumWeight += w;
+        }
+        for (int c = 0; c < 3; ++c) {
+            out[c][k] = std::exp(sum[c] / sumWeight);
+        }
+    }
+}
+
+void fused(const ResponseCurve &response, const WeightFunction &weight,
+           const Bracket &bracket, std::vector<float> *out) {
+    std::vector<float> logExposures;
+    for (float t : EXPOSURES) logExposures.push_back(std::log(t));
+
+    FusionLuts luts(response, weight);
+    for (int c = 0; c < 3; ++c) out[c].resize(SIZE);
+    fuseDebevec(luts, bracket.channels[0], bracket.channels[1],
+                bracket.channels[2], logExposures.data(), out[0].data(),
+                out[1].data(), out[2].data(), SIZE);
+}
+}
+
+TEST(FusionKernels, DebevecMatchesReferenceOnPredefinedResponses) {
+    const Bracket bracket;
+
+    for (ResponseCurveType responseType : RESPONSES) {
+        for (WeightFunctionType weightType : WEIGHTS) {
+            const ResponseCurve response(responseType);
+            const WeightFunction weight(weightType);
+
+            std::vector<float> expected[3];
+            for (int c = 0; c < 3; ++c) expected[c].resize(SIZE);
+            referenceDebevec(response, weight, bracket, expected);
+
+            std::vector<float> actual[3];
+            fused(response, weight, bracket, actual);
+
+            for (int c = 0; c < 3; ++c) {
+                for (size_t k = 0; k < SIZE; ++k) {
+                    if (std::isnan(expected[c][k])) {
+                        // no trusted sample: both divide by a zero weight
+                        ASSERT_TRUE(std::isnan(actual[c][k]));
+                        continue;
+                    }
+                    ASSERT_NEAR(actual[c][k], expected[c][k],
+                                1e-4f * expected[c][k])
+                        << "response " << responseType << " weight "
+                        << weightType << " channel " << c << " sample " << k;
+                }
+            }
+        }
+    }
+}
+
+TEST(FusionKernels, DebevecUsesTheResponseOfEachChannel) {
+    const Bracket bracket;
+    const WeightFunction weight(WEIGHT_TRIANGULAR);
+
+    // custom curves: twice the linear response on green, half on blue
+    ResponseCurve response(RESPONSE_LINEAR);
+    for (size_t i = 0; i < ResponseCurve::NUM_BINS; ++i) {
+        response.get(RESPONSE_CHANNEL_GREEN)[i] *= 2.f;
+        response.get(RESPONSE_CHANNEL_BLUE)[i] *= 0.5f;
+    }
+    std::vector<float> custom[3];
+    fused(response, weight, bracket, custom);
+
+    std::vector<float> linear[3];
+    fused(ResponseCurve(RESPONSE_LINEAR), weight, bracket, linear);
+
+    for (size_t k = 0; k < SIZE; ++k) {
+        if (std::isnan(linear[0][k])) continue;
+        ASSERT_NEAR(custom[0][k], linear[0][k], 1e-4f * linear[0][k]);
+        ASSERT_NEAR(custom[1][k], 2.f * linear[1][k], 2e-4f * linear[1][k]);
+        ASSERT_NEAR(custom[2][k], 0.5f * linear[2][k], 1e-4f * linear[2][k]);
+    }
+}
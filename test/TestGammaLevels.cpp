@@ -0,0 +1,126 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Libpfs/manip/gamma_levels.h>
+
+namespace {
+
+struct Levels {
+    float blackIn, whiteIn, blackOut, whiteOut, gamma;
+};
+
+float reference(const Levels &l, float v, float L) {
+    const float c = std::pow(L, l.gamma - 1.0f);
+    const float out =
+        l.blackOut + (v - l.blackIn) / (l.whiteIn - l.blackIn) * c *
+                         (l.whiteOut - l.blackOut);
+    return std::max(0.f, std::min(out, 1.f));
+}
+
+const Levels LEVELS[] = {{0.f, 1.f, 0.f, 1.f, 1.f},
+                         {0.1f, 0.8f, 0.05f, 0.9f, 1.f},
+                         {0.2f, 0.9f, 0.f, 1.f, 0.45f},
+                         {0.f, 0.7f, 0.1f, 1.f, 2.2f}};
+
+}  // anonymous
+
+TEST(TestGammaLevels, Float) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    // odd size, to run the tail
+    const size_t size = 1023;
+    std::vector<float> R(size), G(size), B(size);
+    for (size_t i = 0; i < size; ++i) {
+        R[i] = dist(gen);
+        G[i] = dist(gen);
+        B[i] = dist(gen);
+    }
+
+    for (const Levels &l : LEVELS) {
+        std::vector<float> Ro(size), Go(size), Bo(size);
+        pfs::GammaLevelsKernel(l.blackIn, l.whiteIn, l.blackOut, l.whiteOut,
+                               l.gamma)
+            .apply(R.data(), G.data(), B.data(), Ro.data(), Go.data(),
+                   Bo.data(), size);
+
+        for (size_t i = 0; i < size; ++i) {
+            const float L = 0.2126f * R[i] + 0.7152f * G[i] + 0.0722f * B[i];
+            EXPECT_NEAR(reference(l, R[i], L), Ro[i], 1e-5f);
+            EXPECT_NEAR(reference(l, G[i], L), Go[i], 1e-5f);
+            EXPECT_NEAR(reference(l, B[i], L), Bo[i], 1e-5f);
+        }
+    }
+}
+
+// the preview on 8 bits samples matches the frame processing, rounded
+TEST(TestGammaLevels, Rgb32) {
+    std::mt19937 gen(11);
+
+    const size_t size = 777;
+    std::vector<uint32_t> in(size);
+    for (size_t i = 0; i < size; ++i) in[i] = gen();
+
+    for (const Levels &l : LEVELS) {
+        std::vector<uint32_t> out(size);
+        pfs::GammaLevelsKernel(l.blackIn, l.whiteIn, l.blackOut, l.whiteOut,
+                               l.gamma)
+            .apply(in.data(), out.data(), size);
+
+        for (size_t i = 0; i < size; ++i) {
+            const float r = ((in[i] >> 16) & 0xff) / 255.f;
+            const float g = ((in[i] >> 8) & 0xff) / 255.f;
+            const float b = (in[i] & 0xff) / 255.f;
+            const float L = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+
+            EXPECT_EQ(0xffu, out[i] >> 24);
+            EXPECT_NEAR(reference(l, r, L) * 255.f,
+                        static_cast<float>((out[i] >> 16) & 0xff), 0.501f);
+            EXPECT_NEAR(reference(l, g, L) * 255.f,
+                        static_cast<float>((out[i] >> 8) & 0xff), 0.501f);
+            EXPECT_NEAR(reference(l, b, L) * 255.f,
+                        static_cast<float>(out[i] & 0xff), 0.501f);
+        }
+    }
+}
+
+// black pixels with gamma < 1 and NaNs end up at 0
+TEST(TestGammaLevels, Degenerate) {
+    const float R[5] = {0.f, NAN, 0.f, 0.f, 0.5f};
+    const float G[5] = {0.f, 0.f, 0.f, 0.f, 0.5f};
+    const float B[5] = {0.f, 0.f, 0.f, 0.f, 0.5f};
+    float Ro[5], Go[5], Bo[5];
+
+    pfs::GammaLevelsKernel(0.f, 1.f, 0.f, 1.f, 0.5f)
+        .apply(R, G, B, Ro, Go, Bo, 5);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(0.f, Ro[i]);
+        EXPECT_EQ(0.f, Go[i]);
+        EXPECT_EQ(0.f, Bo[i]);
+    }
+    EXPECT_NEAR(std::sqrt(0.5f), Ro[4], 1e-5f);
+}
@@ -0,0 +1,174 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/progress.h>
+#include <Libpfs/utils/msec_timer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "TonemappingOperators/mantiuk06/contrast_domain.h"
+#include "TonemappingOperators/mantiuk06/multigrid.h"
+#include "TonemappingOperators/mantiuk06/pyramid.h"
+
+// divG_sum = A * x = sum(divG(x))
+void multiplyA(PyramidT &px, const PyramidT &pC, const pfs::Array2Df &x,
+               pfs::Array2Df &sumOfDivG);
+
+namespace {
+// log luminance with smooth gradients, a sharp disk, texture and noise
+void testImage(pfs::Array2Df &Y) {
+    const int cols = Y.getCols();
+    const int rows = Y.getRows();
+    srand(7);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            const int dx = x - cols / 2;
+            const int dy = y - rows / 3;
+            Y(x, y) = 2.f * std::sin(x * 0.01f) * std::cos(y * 0.007f) +
+                      (dx * dx + dy * dy < cols * cols / 16 ? 3.f : 0.f) +
+                      0.3f * ((x / 7 + y / 5) % 2) +
+                      0.05f * static_cast<float>(rand()) / RAND_MAX;
+        }
+    }
+}
+
+// the system of transformToLuminance(): gradients contrast compressed
+struct Problem {
+    explicit Problem(const pfs::Array2Df &Y)
+        : pp(Y.getRows(), Y.getCols()),
+          pC(Y.getRows(), Y.getCols()),
+          b(Y.getCols(), Y.getRows()) {
+        pp.computeGradients(Y);
+        pp.transformToR(1.f);
+        pp.scale(0.3f);
+        pp.transformToG(1.f);
+
+        pp.computeScaleFactors(pC);
+        PyramidT pb(pp);
+        pb.multiply(pC);
+        pb.computeSumOfDivergence(b);
+    }
+
+    PyramidT pp;
+    PyramidT pC;
+    pfs::Array2Df b;
+};
+
+float relativeResidual(Problem &problem, const pfs::Array2Df &x) {
+    pfs::Array2Df Ax(x.getCols(), x.getRows());
+    multiplyA(problem.pp, problem.pC, x, Ax);
+    double num = 0.;
+    double den = 0.;
+    for (size_t i = 0; i < x.size(); ++i) {
+        num += (problem.b(i) - Ax(i)) * (problem.b(i) - Ax(i));
+        den += problem.b(i) * problem.b(i);
+    }
+    return std::sqrt(num / den);
+}
+
+// largest difference of a and b, up to a constant (the null space of A)
+float maxDifference(const pfs::Array2Df &a, const pfs::Array2Df &b) {
+    double mean = 0.;
+    for (size_t i = 0; i < a.size(); ++i) {
+        mean += a(i) - b(i);
+    }
+    mean /= a.size();
+    float diff = 0.f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff = std::max(
+            diff, std::abs(a(i) - b(i) - static_cast<float>(mean)));
+    }
+    return diff;
+}
+}
+
+TEST(TestMantiuk06Solver, PreconditionerIsSymmetric) {
+    pfs::Array2Df Y(301, 203);
+    testImage(Y);
+    Problem problem(Y);
+    MultigridPreconditioner M(problem.pC);
+
+    pfs::Array2Df a(Y.getCols(), Y.getRows());
+    pfs::Array2Df b(Y.getCols(), Y.getRows());
+    pfs::Array2Df Ma(Y.getCols(), Y.getRows());
+    pfs::Array2Df Mb(Y.getCols(), Y.getRows());
+    for (size_t i = 0; i < a.size(); ++i) {
+        a(i) = std::sin(0.1f * i);
+        b(i) = std::cos(0.37f * i);
+    }
+    M.apply(a, Ma);
+    M.apply(b, Mb);
+
+    double bMa = 0.;
+    double aMb = 0.;
+    double aMa = 0.;
+    for (size_t i = 0; i < a.size(); ++i) {
+        bMa += b(i) * Ma(i);
+        aMb += a(i) * Mb(i);
+        aMa += a(i) * Ma(i);
+    }
+    // odd sizes of the levels break the symmetry slightly
+    EXPECT_NEAR(bMa, aMb, 1e-3 * std::abs(aMa));
+    // A is negative semidefinite, and so is its approximate inverse
+    EXPECT_LT(aMa, 0.);
+}
+
+TEST(TestMantiuk06Solver, Benchmark) {
+    pfs::Array2Df Y(1000, 700);
+    testImage(Y);
+    Problem problem(Y);
+    pfs::Progress ph;
+
+    pfs::Array2Df xCg(Y);
+    msec_timer timer;
+    timer.start();
+    const LinCGResult cg =
+        lincg(problem.pp, problem.pC, problem.b, xCg, 500, 1e-3f, ph, false);
+    timer.stop_and_update();
+    const double cgTime = timer.get_time();
+    std::cout << "cg: " << cg.iterations << " iterations, "
+              << cgTime / cg.iterations << " msec/iteration, " << cgTime
+              << " msec, residual " << cg.residual << std::endl;
+
+    pfs::Array2Df xPcg(Y);
+    timer.reset();
+    timer.start();
+    const LinCGResult pcg =
+        lincg(problem.pp, problem.pC, problem.b, xPcg, 500, 1e-3f, ph, true);
+    timer.stop_and_update();
+    const double pcgTime = timer.get_time();
+    std::cout << "multigrid pcg: " << pcg.iterations << " iterations, "
+              << pcgTime / pcg.iterations << " msec/iteration, " << pcgTime
+              << " msec, residual " << pcg.residual << std::endl;
+
+    EXPECT_LE(cg.residual, 1e-3f);
+    EXPECT_LE(pcg.residual, 1e-3f);
+    // the recurrences of the pipelined cg follow the true residual
+    EXPECT_NEAR(relativeResidual(problem, xCg), cg.residual, 1e-4f);
+    EXPECT_NEAR(relativeResidual(problem, xPcg), pcg.residual, 1e-4f);
+    EXPECT_LT(pcg.iterations * 4, cg.iterations);
+    EXPECT_LE(maxDifference(xCg, xPcg), 5e-2f);
+}
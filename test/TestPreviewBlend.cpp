@@ -0,0 +1,144 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include <HdrWizard/PreviewBlend.h>
+
+namespace {
+
+void fillRandom(QImage &image, std::mt19937 &gen) {
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            line[x] = gen();
+        }
+    }
+}
+
+QRgb sample(const QImage &image, int x, int y) {
+    if (x < 0 || y < 0 || x >= image.width() || y >= image.height()) {
+        return PREVIEW_OUT_OF_BOUNDS;
+    }
+    return reinterpret_cast<const QRgb *>(image.constScanLine(y))[x];
+}
+
+}  // anonymous
+
+// every pixel of the rendered rect is the blend of the shifted samples, or of
+// black where a shifted image does not cover it
+TEST(TestPreviewBlend, ShiftedRect) {
+    std::mt19937 gen(42);
+    for (int run = 0; run < 200; ++run) {
+        QImage movable(1 + gen() % 70, 1 + gen() % 40, QImage::Format_ARGB32);
+        QImage pivot(1 + gen() % 80, 1 + gen() % 50, QImage::Format_ARGB32);
+        fillRandom(movable, gen);
+        fillRandom(pivot, gen);
+        QImage out(movable.size(), QImage::Format_RGB32);
+
+        const PreviewBlendMode mode = static_cast<PreviewBlendMode>(gen() % 4);
+        const int mx = static_cast<int>(gen() % 41) - 20;
+        const int my = static_cast<int>(gen() % 41) - 20;
+        const int px = static_cast<int>(gen() % 41) - 20;
+        const int py = static_cast<int>(gen() % 41) - 20;
+        const QRect rect(static_cast<int>(gen() % movable.width()) - 3,
+                         static_cast<int>(gen() % movable.height()) - 3,
+                         1 + gen() % movable.width(),
+                         1 + gen() % movable.height());
+
+        blendPreviewRect(mode, movable, mx, my, pivot, px, py, out, rect);
+
+        const QRect area = rect & out.rect();
+        for (int y = area.top(); y <= area.bottom(); ++y) {
+            for (int x = area.left(); x <= area.right(); ++x) {
+                const QRgb expected =
+                    blendPreviewPixel(mode, sample(movable, x - mx, y - my),
+                                      sample(pivot, x - px, y - py)) |
+                    0xff000000;
+                ASSERT_EQ(expected, out.pixel(x, y));
+            }
+        }
+    }
+}
+
+TEST(TestPreviewBlend, WeightedSamples) {
+    const QRgb m = qRgba(200, 100, 0, 255);
+    const QRgb p = qRgba(100, 100, 255, 128);
+
+    EXPECT_EQ(qRgba(149, 49, 128, 255), blendPreviewPixel(BLEND_DIFF, m, p));
+    EXPECT_EQ(qRgba(125, 75, 64, 255), blendPreviewPixel(BLEND_ADD, m, p));
+
+    QRgb out[5];
+    const QRgb movable[5] = {m, m, m, m, m};
+    const QRgb pivot[5] = {p, p, p, p, p};
+    blendPreviewRow(BLEND_DIFF, movable, pivot, out, 5);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(qRgba(149, 49, 128, 255), out[i]);
+    }
+}
+
+// a zoomed out level is blended from the samples of its tiles, and the
+// samples of a shifted image are those of the unshifted one
+TEST(TestPreviewBlend, Level) {
+    std::mt19937 gen(7);
+    QImage movable(1000, 700, QImage::Format_ARGB32);
+    QImage pivot(1000, 700, QImage::Format_ARGB32);
+    fillRandom(movable, gen);
+    fillRandom(pivot, gen);
+
+    const int step = 4;
+    PreviewLevel movableLevel;
+    PreviewLevel pivotLevel;
+    movableLevel.reset(&movable, step);
+    pivotLevel.reset(&pivot, step);
+    ASSERT_EQ(250, movableLevel.image().width());
+    ASSERT_EQ(175, movableLevel.image().height());
+
+    // the tile of the pivot is taken once, whatever the shift of the movable
+    const QRect tile(0, 0, 250, 175);
+    QImage out(movableLevel.image().size(), QImage::Format_RGB32);
+    for (int mx = -3; mx <= 3; ++mx) {
+        movableLevel.prepare(tile.translated(-mx, 1));
+        pivotLevel.prepare(tile);
+        blendPreviewRect(BLEND_DIFF, movableLevel.image(), mx, -1,
+                         pivotLevel.image(), 0, 0, out, tile);
+
+        for (int y = 0; y < out.height(); ++y) {
+            for (int x = 0; x < out.width(); ++x) {
+                const QRgb expected =
+                    blendPreviewPixel(
+                        BLEND_DIFF,
+                        sample(movable, (x - mx) * step, (y + 1) * step),
+                        sample(pivot, x * step, y * step)) |
+                    0xff000000;
+                ASSERT_EQ(expected, out.pixel(x, y));
+            }
+        }
+    }
+
+    // the same image and step keep the samples, step 1 is the image itself
+    pivotLevel.reset(&pivot, step);
+    EXPECT_EQ(pivot.pixel(8, 4), pivotLevel.image().pixel(2, 1));
+    pivotLevel.reset(&pivot, 1);
+    EXPECT_EQ(pivot.size(), pivotLevel.image().size());
+    EXPECT_EQ(pivot.pixel(5, 3), pivotLevel.image().pixel(5, 3));
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/progress.h>
+#include <TonemappingOperators/reinhard02/tmo_reinhard02.h>
+
+namespace {
+
+void fillLuminance(pfs::Array2Df &Y) {
+    for (size_t y = 0; y < Y.getRows(); y++) {
+        for (size_t x = 0; x < Y.getCols(); x++) {
+            Y(x, y) = 0.01f +
+                      std::exp(4.f * std::sin(x / 13.f) * std::cos(y / 17.f)) +
+                      ((x / 32 + y / 32) % 2 ? 20.f : 0.f);
+        }
+    }
+}
+}
+
+// The recursive engine uses replicated borders instead of the periodic ones
+// of the FFT, so only the inner part of the frame is compared
+TEST(Reinhard02, RecursiveMatchesFFT) {
+    const size_t W = 320;
+    const size_t H = 240;
+    const size_t border = 48;
+
+    pfs::Array2Df Y(W, H);
+    fillLuminance(Y);
+
+    pfs::Array2Df Lfft(W, H);
+    pfs::Array2Df Lrec(W, H);
+    pfs::Progress ph;
+
+    Reinhard02 fft(&Y, &Lfft, true, 0.18f, 1.f, 8, 1, 43, false, ph, true);
+    fft.tmo_reinhard02();
+    Reinhard02 rec(&Y, &Lrec, true, 0.18f, 1.f, 8, 1, 43, false, ph, false);
+    rec.tmo_reinhard02();
+
+    double error = 0.;
+    double reference = 0.;
+    for (size_t y = border; y < H - border; y++) {
+        for (size_t x = border; x < W - border; x++) {
+            error += std::fabs(Lfft(x, y) - Lrec(x, y));
+            reference += Lfft(x, y);
+        }
+    }
+
+    ASSERT_LE(error / reference, 0.02);
+}
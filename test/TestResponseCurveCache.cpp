@@ -0,0 +1,124 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <Common/LuminanceOptions.h>
+#include <HdrWizard/ResponseCurveCache.h>
+
+using namespace libhdr::fusion;
+
+namespace {
+
+ResponseCurveCache::Key key() {
+    ResponseCurveCache::Key key;
+    key.camera = QStringLiteral("Canon Canon EOS 5D 1234");
+    key.iso = 100;
+    key.weight = WEIGHT_TRIANGULAR;
+    key.response = RESPONSE_LINEAR;
+    return key;
+}
+
+bool sameCurves(const ResponseCurve &a, const ResponseCurve &b) {
+    for (int c = 0; c < 3; ++c) {
+        const ResponseChannel channel = static_cast<ResponseChannel>(c);
+        if (a.get(channel) != b.get(channel)) return false;
+    }
+    return true;
+}
+
+//! \brief every test runs on its own settings database, in a temporary home
+class ResponseCurveCacheTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        ASSERT_TRUE(m_home.isValid());
+        m_oldHome = qgetenv("HOME");
+        qputenv("HOME", QFile::encodeName(m_home.path()));
+        ASSERT_TRUE(QDir(m_home.path())
+                        .mkpath(LuminanceOptions::LUMINANCE_HDR_HOME_FOLDER));
+    }
+
+    void TearDown() override { qputenv("HOME", m_oldHome); }
+
+   private:
+    QTemporaryDir m_home;
+    QByteArray m_oldHome;
+};
+}
+
+TEST_F(ResponseCurveCacheTest, MissOnEmptyCache) {
+    ResponseCurve response(RESPONSE_LINEAR);
+    EXPECT_FALSE(ResponseCurveCache::load(key(), response));
+    EXPECT_EQ(response.getType(), RESPONSE_LINEAR);
+}
+
+TEST_F(ResponseCurveCacheTest, HitAfterStore) {
+    const ResponseCurve stored(RESPONSE_GAMMA);
+    ASSERT_TRUE(ResponseCurveCache::store(key(), stored));
+
+    ResponseCurve response(RESPONSE_LINEAR);
+    ASSERT_TRUE(ResponseCurveCache::load(key(), response));
+    EXPECT_EQ(response.getType(), RESPONSE_CUSTOM);
+    EXPECT_TRUE(sameCurves(response, stored));
+}
+
+TEST_F(ResponseCurveCacheTest, StoreReplaces) {
+    ASSERT_TRUE(
+        ResponseCurveCache::store(key(), ResponseCurve(RESPONSE_GAMMA)));
+    const ResponseCurve stored(RESPONSE_SRGB);
+    ASSERT_TRUE(ResponseCurveCache::store(key(), stored));
+
+    ResponseCurve response(RESPONSE_LINEAR);
+    ASSERT_TRUE(ResponseCurveCache::load(key(), response));
+    EXPECT_TRUE(sameCurves(response, stored));
+}
+
+TEST_F(ResponseCurveCacheTest, MissOnAnyOtherKey) {
+    ASSERT_TRUE(
+        ResponseCurveCache::store(key(), ResponseCurve(RESPONSE_GAMMA)));
+
+    ResponseCurveCache::Key otherCamera = key();
+    otherCamera.camera = QStringLiteral("Nikon D700 5678");
+    ResponseCurveCache::Key otherIso = key();
+    otherIso.iso = 400;
+    ResponseCurveCache::Key otherWeight = key();
+    otherWeight.weight = WEIGHT_GAUSSIAN;
+    ResponseCurveCache::Key otherResponse = key();
+    otherResponse.response = RESPONSE_SRGB;
+
+    ResponseCurve response(RESPONSE_LINEAR);
+    EXPECT_FALSE(ResponseCurveCache::load(otherCamera, response));
+    EXPECT_FALSE(ResponseCurveCache::load(otherIso, response));
+    EXPECT_FALSE(ResponseCurveCache::load(otherWeight, response));
+    EXPECT_FALSE(ResponseCurveCache::load(otherResponse, response));
+    EXPECT_EQ(response.getType(), RESPONSE_LINEAR);
+}
+
+int main(int argc, char **argv) {
+    // the SQLite driver is a plugin
+    QCoreApplication app(argc, argv);
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <HdrCreation/robertson02.h>
+#include <Libpfs/frame.h>
+
+using namespace libhdr::fusion;
+
+namespace {
+
+const size_t WIDTH = 320;
+const size_t HEIGHT = 240;
+const float EXPOSURES[] = {0.25f, 1.f, 4.f};
+
+// scene radiance: a ramp over four decades, modulated along y
+float radiance(size_t x, size_t y, int channel) {
+    const float ramp = std::pow(10.f, -3.f + 4.f * x / (WIDTH - 1));
+    const float modulation = 1.f + 0.5f * std::sin(0.05f * y + channel);
+    return ramp * modulation;
+}
+
+// camera: gamma curve, clipped and quantized on 8 bits
+float camera(float exposure) {
+    const float value = std::pow(std::min(1.f, exposure), 1.f / 2.2f);
+    return std::floor(value * 255.f + 0.5f) / 255.f;
+}
+
+std::vector<FrameEnhanced> bracket() {
+    std::vector<FrameEnhanced> frames;
+    for (float t : EXPOSURES) {
+        pfs::FramePtr frame(new pfs::Frame(WIDTH, HEIGHT));
+        pfs::Channel *channels[3];
+        frame->createXYZChannels(channels[0], channels[1], channels[2]);
+        for (int c = 0; c < 3; ++c) {
+            for (size_t y = 0; y < HEIGHT; ++y) {
+                for (size_t x = 0; x < WIDTH; ++x) {
+                    (*channels[c])(x, y) = camera(t * radiance(x, y, c));
+                }
+            }
+        }
+        frames.push_back(FrameEnhanced(frame, t));
+    }
+    return frames;
+}
+
+pfs::Frame *merge(size_t sampleSize, ResponseCurve &response) {
+    RobertsonOperatorAuto robertson;
+    robertson.setSampleSize(sampleSize);
+    WeightFunction weight(WEIGHT_TRIANGULAR);
+    IFusionOperator &fusion = robertson;
+    return fusion.computeFusion(response, weight, bracket());
+}
+
+// the merged frames are defined up to a scale factor: spread of the ratio of
+// \a a to \a b around its median
+float ratioSpread(const pfs::Channel &a, const pfs::Channel &b) {
+    std::vector<float> ratios;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (b(i) > 0.f) ratios.push_back(a(i) / b(i));
+    }
+    std::nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2,
+                     ratios.end());
+    const float median = ratios[ratios.size() / 2];
+
+    std::vector<float> deviations;
+    for (float ratio : ratios) {
+        deviations.push_back(std::fabs(ratio / median - 1.f));
+    }
+    std::nth_element(deviations.begin(),
+                     deviations.begin() + deviations.size() / 2,
+                     deviations.end());
+    return deviations[deviations.size() / 2];
+}
+}
+
+TEST(Robertson02, SampleSizeOfTheFrame) {
+    ResponseCurve fullResponse(RESPONSE_LINEAR);
+    std::unique_ptr<pfs::Frame> full(merge(0, fullResponse));
+
+    ResponseCurve sampledResponse(RESPONSE_LINEAR);
+    std::unique_ptr<pfs::Frame> sampled(
+        merge(WIDTH * HEIGHT, sampledResponse));
+
+    // same path: only the order of the per-thread sums may differ
+    for (int c = 0; c < 3; ++c) {
+        const ResponseChannel channel = static_cast<ResponseChannel>(c);
+        for (size_t m = 0; m < ResponseCurve::NUM_BINS; ++m) {
+            const float expected = fullResponse.get(channel)[m];
+            ASSERT_NEAR(sampledResponse.get(channel)[m], expected,
+                        1e-4f * expected);
+        }
+    }
+}
+
+TEST(Robertson02, SampledEstimation) {
+    ResponseCurve fullResponse(RESPONSE_LINEAR);
+    std::unique_ptr<pfs::Frame> full(merge(0, fullResponse));
+
+    // about 1/15 of the pixels
+    ResponseCurve sampledResponse(RESPONSE_LINEAR);
+    std::unique_ptr<pfs::Frame> sampled(merge(5000, sampledResponse));
+
+    pfs::Channel *fullChannels[3];
+    pfs::Channel *sampledChannels[3];
+    full->getXYZChannels(fullChannels[0], fullChannels[1], fullChannels[2]);
+    sampled->getXYZChannels(sampledChannels[0], sampledChannels[1],
+                            sampledChannels[2]);
+
+    for (int c = 0; c < 3; ++c) {
+        // the curve is applied to every pixel: same radiance map, up to the
+        // noise of the estimation
+        EXPECT_LT(ratioSpread(*sampledChannels[c], *fullChannels[c]), 0.02f);
+
+        // both curves are normalized on their middle value: the well exposed
+        // part of the response is the same
+        const ResponseChannel channel = static_cast<ResponseChannel>(c);
+        for (size_t m = ResponseCurve::NUM_BINS / 4;
+             m < ResponseCurve::NUM_BINS * 7 / 8; ++m) {
+            const float expected = fullResponse.get(channel)[m];
+            ASSERT_NEAR(sampledResponse.get(channel)[m], expected,
+                        0.1f * expected);
+        }
+    }
+}
@@ -0,0 +1,217 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/frame.h>
+#include <Libpfs/progress.h>
+#include <Libpfs/tm/TonemapStageCache.h>
+#include <TonemappingOperators/durand02/tmo_durand02.h>
+#include <TonemappingOperators/pfstmo.h>
+#include <TonemappingOperators/reinhard02/tmo_reinhard02.h>
+
+namespace {
+
+void fillChannel(pfs::Array2Df &C, float phase) {
+    for (size_t y = 0; y < C.getRows(); y++) {
+        for (size_t x = 0; x < C.getCols(); x++) {
+            C(x, y) = 0.01f +
+                      std::exp(4.f * std::sin(x / 23.f + phase) *
+                               std::cos(y / 17.f)) +
+                      ((x / 32 + y / 32) % 2 ? 20.f : 0.f);
+        }
+    }
+}
+
+struct Rgb {
+    Rgb(size_t w, size_t h) : R(w, h), G(w, h), B(w, h) {
+        fillChannel(R, 0.f);
+        fillChannel(G, 0.5f);
+        fillChannel(B, 1.f);
+    }
+
+    pfs::Array2Df R;
+    pfs::Array2Df G;
+    pfs::Array2Df B;
+};
+
+//! \brief frame holding the channels of \a rgb in its XYZ channels
+pfs::Frame *makeFrame(const Rgb &rgb) {
+    pfs::Frame *frame = new pfs::Frame(rgb.R.getCols(), rgb.R.getRows());
+    pfs::Channel *X, *Y, *Z;
+    frame->createXYZChannels(X, Y, Z);
+    std::copy(rgb.R.begin(), rgb.R.end(), X->begin());
+    std::copy(rgb.G.begin(), rgb.G.end(), Y->begin());
+    std::copy(rgb.B.begin(), rgb.B.end(), Z->begin());
+    return frame;
+}
+
+void expectSameChannels(pfs::Frame &reference, pfs::Frame &cached) {
+    pfs::Channel *X0, *Y0, *Z0;
+    pfs::Channel *X1, *Y1, *Z1;
+    reference.getXYZChannels(X0, Y0, Z0);
+    cached.getXYZChannels(X1, Y1, Z1);
+    for (size_t i = 0; i < X0->size(); ++i) {
+        ASSERT_EQ((*X0)(i), (*X1)(i));
+        ASSERT_EQ((*Y0)(i), (*Y1)(i));
+        ASSERT_EQ((*Z0)(i), (*Z1)(i));
+    }
+}
+
+TonemapStageCache::Entry makeEntry(size_t w, size_t h) {
+    return std::make_shared<const pfs::Array2Df>(w, h);
+}
+
+}  // anonymous
+
+TEST(TestTonemapStageCache, Fingerprint) {
+    pfs::Array2Df A(64, 32);
+    fillChannel(A, 0.f);
+    pfs::Array2Df B(A);
+
+    EXPECT_EQ(TonemapStageCache::fingerprint(A),
+              TonemapStageCache::fingerprint(B));
+
+    B(10, 10) += 1e-3f;
+    EXPECT_NE(TonemapStageCache::fingerprint(A),
+              TonemapStageCache::fingerprint(B));
+
+    // same content, different shape
+    pfs::Array2Df C(32, 64);
+    std::copy(A.begin(), A.end(), C.begin());
+    EXPECT_NE(TonemapStageCache::fingerprint(A),
+              TonemapStageCache::fingerprint(C));
+}
+
+TEST(TestTonemapStageCache, LeastRecentlyUsedEviction) {
+    TonemapStageCache &cache = TonemapStageCache::instance();
+    const size_t entryBytes = 100 * 100 * sizeof(float);
+    cache.clear();
+    cache.setCapacity(2 * entryBytes);
+
+    const TonemapStageKey a = TonemapStageKey("test", 1) << 1.f;
+    const TonemapStageKey b = TonemapStageKey("test", 1) << 2.f;
+    const TonemapStageKey c = TonemapStageKey("test", 2) << 1.f;
+
+    cache.insert(a, makeEntry(100, 100));
+    cache.insert(b, makeEntry(100, 100));
+    EXPECT_TRUE(cache.find(a));  // a is now the most recent
+    cache.insert(c, makeEntry(100, 100));
+
+    EXPECT_TRUE(cache.find(a));
+    EXPECT_FALSE(cache.find(b));
+    EXPECT_TRUE(cache.find(c));
+
+    // too large to be kept at all
+    const TonemapStageKey d = TonemapStageKey("test", 3);
+    cache.insert(d, makeEntry(200, 200));
+    EXPECT_FALSE(cache.find(d));
+    EXPECT_TRUE(cache.find(a));
+
+    cache.setCapacity(0);
+    EXPECT_FALSE(cache.find(a));
+    EXPECT_FALSE(cache.find(c));
+}
+
+// rerunning Durand02 with a different base contrast hits the cached base
+// layer and must give the same result of a run from scratch
+TEST(TestTonemapStageCache, Durand02BaseContrast) {
+    const size_t w = 301;
+    const size_t h = 203;
+    TonemapStageCache &cache = TonemapStageCache::instance();
+    cache.setCapacity(64 * 1024 * 1024);
+    cache.clear();
+
+    pfs::Progress ph;
+    Rgb warmup(w, h);
+    tmo_durand02(warmup.R, warmup.G, warmup.B, 8.f, 0.4f, 5.f, 1, true, ph);
+
+    Rgb cached(w, h);
+    tmo_durand02(cached.R, cached.G, cached.B, 8.f, 0.4f, 3.f, 1, true, ph);
+
+    cache.clear();
+    Rgb reference(w, h);
+    tmo_durand02(reference.R, reference.G, reference.B, 8.f, 0.4f, 3.f, 1,
+                 true, ph);
+
+    for (size_t i = 0; i < w * h; ++i) {
+        ASSERT_EQ(reference.R(i), cached.R(i));
+        ASSERT_EQ(reference.G(i), cached.G(i));
+        ASSERT_EQ(reference.B(i), cached.B(i));
+    }
+}
+
+// a different saturation reruns only the color restoration of Fattal02
+TEST(TestTonemapStageCache, Fattal02Saturation) {
+    const size_t w = 301;
+    const size_t h = 203;
+    TonemapStageCache &cache = TonemapStageCache::instance();
+    cache.setCapacity(64 * 1024 * 1024);
+    cache.clear();
+
+    pfs::Progress ph;
+    const Rgb rgb(w, h);
+    std::unique_ptr<pfs::Frame> warmup(makeFrame(rgb));
+    pfstmo_fattal02(*warmup, 1.f, 0.9f, 0.8f, 0.f, true, false, 3, ph);
+
+    std::unique_ptr<pfs::Frame> cached(makeFrame(rgb));
+    pfstmo_fattal02(*cached, 1.f, 0.9f, 0.6f, 0.f, true, false, 3, ph);
+
+    cache.clear();
+    std::unique_ptr<pfs::Frame> reference(makeFrame(rgb));
+    pfstmo_fattal02(*reference, 1.f, 0.9f, 0.6f, 0.f, true, false, 3, ph);
+
+    expectSameChannels(*reference, *cached);
+}
+
+// a different phi reuses the convolved images of Reinhard02
+TEST(TestTonemapStageCache, Reinhard02Phi) {
+    const size_t w = 160;
+    const size_t h = 120;
+    TonemapStageCache &cache = TonemapStageCache::instance();
+    cache.setCapacity(64 * 1024 * 1024);
+    cache.clear();
+
+    pfs::Progress ph;
+    pfs::Array2Df Y(w, h);
+    fillChannel(Y, 0.f);
+
+    pfs::Array2Df warmup(w, h);
+    Reinhard02(&Y, &warmup, true, 0.18f, 1.f, 8, 1, 43, false, ph, true)
+        .tmo_reinhard02();
+
+    pfs::Array2Df cached(w, h);
+    Reinhard02(&Y, &cached, true, 0.18f, 4.f, 8, 1, 43, false, ph, true)
+        .tmo_reinhard02();
+
+    cache.clear();
+    pfs::Array2Df reference(w, h);
+    Reinhard02(&Y, &reference, true, 0.18f, 4.f, 8, 1, 43, false, ph, true)
+        .tmo_reinhard02();
+
+    for (size_t i = 0; i < w * h; ++i) {
+        ASSERT_EQ(reference(i), cached(i));
+    }
+}
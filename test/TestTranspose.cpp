@@ -0,0 +1,98 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/utils/transpose.h>
+
+#include "SeqInt.h"
+
+using namespace pfs;
+
+namespace {
+
+template <typename Type>
+void checkTranspose(size_t cols, size_t rows) {
+    std::vector<Type> input(cols * rows);
+    std::generate(input.begin(), input.end(), SeqInt());
+    std::vector<Type> output(cols * rows);
+
+    utils::transpose(input.data(), output.data(), cols, rows);
+
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            ASSERT_EQ(input[r * cols + c], output[c * rows + r]);
+        }
+    }
+}
+
+}  // anonymous
+
+TEST(TestTranspose, Float) {
+    // sizes around the 8x8 blocks and the 64x64 tiles
+    const size_t sizes[] = {1, 3, 8, 13, 64, 71, 130};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j) {
+            checkTranspose<float>(sizes[i], sizes[j]);
+        }
+    }
+}
+
+TEST(TestTranspose, Int) {
+    checkTranspose<int>(67, 9);
+    checkTranspose<int>(9, 67);
+}
+
+TEST(TestTranspose, NegativeStride) {
+    const size_t cols = 70;
+    const size_t rows = 19;
+
+    Array2Df input(cols, rows);
+    std::generate(input.begin(), input.end(), SeqInt());
+    Array2Df output(rows, cols);
+
+    // rows of the output written backwards
+    utils::transpose(input.data(), cols, output.data() + (cols - 1) * rows,
+                     -static_cast<std::ptrdiff_t>(rows), cols, rows);
+
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            ASSERT_EQ(input(c, r), output(r, cols - 1 - c));
+        }
+    }
+}
+
+TEST(TestTranspose, Array2D) {
+    Array2Df input(37, 11);
+    std::generate(input.begin(), input.end(), SeqInt());
+    Array2Df output;
+
+    utils::transpose(input, output);
+    ASSERT_EQ(output.getCols(), 11u);
+    ASSERT_EQ(output.getRows(), 37u);
+
+    Array2Df back;
+    utils::transpose(output, back);
+    ASSERT_TRUE(std::equal(input.begin(), input.end(), back.begin()));
+}
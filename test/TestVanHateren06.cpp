@@ -0,0 +1,105 @@
+/*
+ * This file is a part of Luminance HDR package
+ * ----------------------------------------------------------------------
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ----------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <Libpfs/array2d.h>
+#include <Libpfs/progress.h>
+#include <Libpfs/tm/TonemapStageCache.h>
+#include <TonemappingOperators/vanhateren06/tmo_vanhateren06.h>
+
+namespace {
+
+const double k_beta = 1.6e-4;
+const double a_C = 9e-2;
+const double C_beta = 2.8e-3;
+
+// positive root of a_C x^5 + x^4 = K by bisection
+double coneRoot(double K) {
+    double lo = 0.;
+    double hi = std::pow(K, 0.25);
+    for (int i = 0; i < 200; ++i) {
+        const double mid = 0.5 * (lo + hi);
+        (mid * mid * mid * mid * (1. + a_C * mid) < K ? lo : hi) = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+double reference(float L, float pupil_area) {
+    const double K = 1. / (C_beta + k_beta * L * pupil_area);
+    return 1. - coneRoot(K) / coneRoot(1. / C_beta);
+}
+
+// luminance from 1e-3 to 1e2 cd/m^2: brighter, the root goes as K^(1/4)
+// near K = 0 and the linear interpolation of the table dominates the error
+void fillLuminance(pfs::Array2Df &L) {
+    for (size_t i = 0; i < L.size(); ++i) {
+        L(i) = std::pow(10.f, -3.f + 5.f * i / (L.size() - 1));
+    }
+}
+
+}  // anonymous
+
+TEST(TestVanHateren06, MatchesRoots) {
+    const float pupil_area = 10.f;
+    pfs::Array2Df L(512, 256);
+    fillLuminance(L);
+    pfs::Array2Df in(L);
+    pfs::Progress ph;
+
+    TonemapStageCache::instance().clear();
+    tmo_vanhateren06(L, pupil_area, ph);
+
+    double maxError = 0.;
+    for (size_t i = 0; i < L.size(); ++i) {
+        maxError =
+            std::max(maxError, std::abs(L(i) - reference(in(i), pupil_area)));
+    }
+    EXPECT_LT(maxError, 1e-5);
+}
+
+TEST(TestVanHateren06, CachedTable) {
+    const float pupil_area = 10.f;
+    pfs::Array2Df first(300, 200);
+    fillLuminance(first);
+    pfs::Array2Df second(first);
+    pfs::Array2Df brighter(first);
+    brighter(0) = 1e3f;
+    pfs::Progress ph;
+    TonemapStageCache &cache = TonemapStageCache::instance();
+
+    cache.clear();
+    tmo_vanhateren06(first, pupil_area, ph);
+    EXPECT_EQ(cache.computed(), 1u);
+
+    // same range of values: the table is reused
+    tmo_vanhateren06(second, pupil_area, ph);
+    EXPECT_EQ(cache.computed(), 1u);
+    for (size_t i = 0; i < first.size(); ++i) {
+        ASSERT_EQ(first(i), second(i));
+    }
+
+    // another range: a new table
+    tmo_vanhateren06(brighter, pupil_area, ph);
+    EXPECT_EQ(cache.computed(), 2u);
+}